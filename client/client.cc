@@ -361,6 +361,88 @@ client :: traverse_props_program(std::vector<std::pair<std::string, node_prog::t
     return *run_node_program(node_prog::TRAVERSE_PROPS, initial_args);
 }
 
+node_prog::bidir_reach_params
+client :: run_bidir_reach_program(node_prog::bidir_reach_params &params)
+{
+    node_prog::bidir_reach_params reply;
+
+    while (true) {
+        message::message msg;
+        msg.prepare_message(message::CLIENT_BIDIR_REACH_REQ, params);
+        busybee_returncode send_code = send_coord(msg.buf);
+
+        if (send_code == BUSYBEE_DISRUPTED) {
+            reconfigure();
+            continue;
+        } else if (send_code != BUSYBEE_SUCCESS) {
+            WDEBUG << "bidir reach send msg fail with " << send_code << std::endl;
+            return reply;
+        }
+
+        busybee_returncode recv_code = recv_coord(&msg.buf);
+
+        switch (recv_code) {
+            case BUSYBEE_DISRUPTED:
+            case BUSYBEE_TIMEOUT:
+            reconfigure();
+            break;
+
+            case BUSYBEE_SUCCESS:
+            msg.unpack_message(message::BIDIR_REACH_RETURN, reply);
+            return reply;
+
+            default:
+            WDEBUG << "bidir reach recv msg fail with " << recv_code << std::endl;
+            return reply;
+        }
+    }
+}
+
+bool
+client :: run_bsp_program(node_prog::bsp_params &params,
+    std::vector<std::pair<std::string, double>> &ranks,
+    std::vector<std::pair<std::string, uint64_t>> &labels)
+{
+    while (true) {
+        message::message msg;
+        msg.prepare_message(message::CLIENT_BSP_REQ, params);
+        busybee_returncode send_code = send_coord(msg.buf);
+
+        if (send_code == BUSYBEE_DISRUPTED) {
+            reconfigure();
+            continue;
+        } else if (send_code != BUSYBEE_SUCCESS) {
+            WDEBUG << "bsp send msg fail with " << send_code << std::endl;
+            return false;
+        }
+
+        busybee_returncode recv_code = recv_coord(&msg.buf);
+
+        switch (recv_code) {
+            case BUSYBEE_DISRUPTED:
+            case BUSYBEE_TIMEOUT:
+            reconfigure();
+            break;
+
+            case BUSYBEE_SUCCESS: {
+                uint64_t req_id;
+                ranks.clear();
+                labels.clear();
+                msg.unpack_message(message::BSP_RETURN, req_id, ranks, labels);
+                if (req_id != 0) {
+                    return true;
+                }
+                // timestamper was restoring, retry
+                break;
+            }
+
+            default:
+            WDEBUG << "bsp recv msg fail with " << recv_code << std::endl;
+            return false;
+        }
+    }
+}
+
 void
 client :: start_migration()
 {
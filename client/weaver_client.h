@@ -34,6 +34,8 @@
 #include "node_prog/edge_count_program.h"
 #include "node_prog/edge_get_program.h"
 #include "node_prog/traverse_with_props.h"
+#include "node_prog/bsp_program.h"
+#include "node_prog/bidir_reach_program.h"
 
 namespace cl
 {
@@ -73,6 +75,12 @@ namespace cl
             node_prog::edge_count_params edge_count_program(std::vector<std::pair<std::string, node_prog::edge_count_params>> &initial_args);
             node_prog::edge_get_params edge_get_program(std::vector<std::pair<std::string, node_prog::edge_get_params>> &initial_args);
             node_prog::traverse_props_params traverse_props_program(std::vector<std::pair<std::string, node_prog::traverse_props_params>> &initial_args);
+            // reachability searched from both ends, coordinated by the timestamper
+            node_prog::bidir_reach_params run_bidir_reach_program(node_prog::bidir_reach_params &params);
+            // whole graph analytics at a single snapshot, ranks are filled for pagerank, labels otherwise
+            bool run_bsp_program(node_prog::bsp_params &params,
+                std::vector<std::pair<std::string, double>> &ranks,
+                std::vector<std::pair<std::string, uint64_t>> &labels);
 
             void start_migration();
             void single_stream_migration();
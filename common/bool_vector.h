@@ -52,6 +52,18 @@ namespace weaver_util
         return true;
     }
 
+    inline size_t
+    count(const std::vector<bool> &v)
+    {
+        size_t cnt = 0;
+        for (size_t i = 0; i < v.size(); i++) {
+            if (v[i]) {
+                cnt++;
+            }
+        }
+        return cnt;
+    }
+
     inline void
     set_bool_vec(std::vector<bool> &vec, bool val)
     {
@@ -17,6 +17,7 @@
 #include "common/weaver_constants.h"
 #include "common/config_constants.h"
 #include "common/cache_constants.h"
+#include "common/vclock.h"
 
 bool
 init_config_constants(const char *config_file_name)
@@ -31,6 +32,8 @@ init_config_constants(const char *config_file_name)
     KronosPort = UINT16_MAX;
     ServerManagerIpaddr = NULL;
     ServerManagerPort = UINT16_MAX;
+    NodePlacement = PLACEMENT_ROUND_ROBIN;
+    PartitionKey = NULL;
 
     FILE *config_file = nullptr;
     if (config_file_name != nullptr) {
@@ -136,6 +139,30 @@ init_config_constants(const char *config_file_name)
                     PARSE_VALUE_SCALAR;
                     PARSE_INT(MaxCacheEntries);
 
+                } else if (strncmp((const char*)token.data.scalar.value, "node_placement", 14) == 0) {
+                    yaml_token_delete(&token);
+                    PARSE_VALUE_SCALAR;
+                    if (strcmp((const char*)token.data.scalar.value, "round_robin") == 0) {
+                        NodePlacement = PLACEMENT_ROUND_ROBIN;
+                    } else if (strcmp((const char*)token.data.scalar.value, "edge") == 0) {
+                        NodePlacement = PLACEMENT_EDGE;
+                    } else if (strcmp((const char*)token.data.scalar.value, "partition_key") == 0) {
+                        NodePlacement = PLACEMENT_PARTITION_KEY;
+                    } else if (strcmp((const char*)token.data.scalar.value, "ldg") == 0) {
+                        NodePlacement = PLACEMENT_LDG;
+                    } else {
+                        WDEBUG << "unknown node placement " << token.data.scalar.value << std::endl;
+                        yaml_token_delete(&token);
+                        return false;
+                    }
+                    yaml_token_delete(&token);
+
+                } else if (strncmp((const char*)token.data.scalar.value, "partition_key", 13) == 0) {
+                    yaml_token_delete(&token);
+                    PARSE_VALUE_SCALAR;
+                    PartitionKey = strdup((const char*)token.data.scalar.value);
+                    yaml_token_delete(&token);
+
                 } else if (strncmp((const char*)token.data.scalar.value, "hyperdex_coord", 14) == 0) {
                     yaml_token_delete(&token);
                     PARSE_VALUE_IPADDR_PORT_BLOCK(HyperdexCoord);
@@ -197,7 +224,16 @@ init_config_constants(const char *config_file_name)
         return false;
     }
 
+    if (NodePlacement == PLACEMENT_PARTITION_KEY && PartitionKey == NULL) {
+        WDEBUG << "node_placement partition_key needs a partition_key property name" << std::endl;
+        return false;
+    }
+
     ClkSz = NumVts+1; // one entry for each vt + an (configuration) epoch number
+    if (ClkSz > MAX_CLK_SZ) {
+        WDEBUG << "at most " << (MAX_CLK_SZ-1) << " vector timestampers supported" << std::endl;
+        return false;
+    }
     NumShards = 0;
     //NumEffectiveServers = NumVts + NumShards;
     MaxNumServers = 1000; // should be greater than NumActualServers = (NumEffectiveServers * (1+NumBackups))
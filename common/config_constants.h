@@ -39,6 +39,18 @@ extern char *ServerManagerIpaddr;
 extern uint16_t ServerManagerPort;
 extern std::vector<std::pair<char*, uint16_t>> ServerManagerLocs;
 
+// shard for nodes created by a tx, chosen at the timestamper
+enum node_placement_t
+{
+    PLACEMENT_ROUND_ROBIN, // default
+    PLACEMENT_EDGE, // with first endpoint of an edge to this node in the same tx, whose shard is known
+    PLACEMENT_PARTITION_KEY, // hash of value of node property PartitionKey, set in the same tx
+    PLACEMENT_LDG // linear deterministic greedy on endpoints of edges in the same tx and shard node counts
+};
+
+extern node_placement_t NodePlacement;
+extern char *PartitionKey;
+
 bool init_config_constants(const char *config_file_name=NULL);
 void update_config_constants(uint64_t num_shards);
 uint64_t get_num_shards();
@@ -65,6 +77,8 @@ uint64_t get_num_shards();
     char *ServerManagerIpaddr; \
     uint16_t ServerManagerPort; \
     std::vector<std::pair<char*, uint16_t>> ServerManagerLocs; \
+    node_placement_t NodePlacement; \
+    char *PartitionKey; \
     uint16_t MaxCacheEntries;
 
 
@@ -13,13 +13,234 @@
 
 #include "common/event_order.h"
 #include "common/config_constants.h"
+#include "common/kronos_batcher.h"
 
+using order::kronos_cache;
 using order::oracle;
+using order::kronos_query;
+using order::kronos_query_ptr;
+using order::kronos_batcher;
+
+#define NO_SLOT UINT32_MAX
+
+// counters of all oracles of the process, see oracle::publish_cache_stats
+static std::atomic<uint64_t> process_hits(0);
+static std::atomic<uint64_t> process_misses(0);
+static std::atomic<uint64_t> process_evictions(0);
+
+kronos_cache :: kronos_cache()
+    : slots(KRONOS_CACHE_CLOCKS)
+    , hand(0)
+{
+    for (cached_clock &c: slots) {
+        c.fp = 0;
+        c.gen = 0;
+        c.referenced = false;
+        c.num_after = 0;
+    }
+    index.reserve(KRONOS_CACHE_CLOCKS);
+    stats.hits = 0;
+    stats.misses = 0;
+    stats.evictions = 0;
+}
+
+// 64-bit mix of all clock entries, never 0
+uint64_t
+kronos_cache :: fingerprint(const vc::vclock_t &clk)
+{
+    uint64_t fp = clk.size();
+    for (uint64_t x: clk) {
+        fp ^= x + 0x9e3779b97f4a7c15ULL + (fp << 6) + (fp >> 2);
+        fp ^= fp >> 31;
+        fp *= 0xbf58476d1ce4e5b9ULL;
+        fp ^= fp >> 29;
+    }
+    return fp == 0? 1 : fp;
+}
+
+// find clk, verifying the whole clock in case of fingerprint collision
+bool
+kronos_cache :: lookup(const vc::vclock_t &clk, uint32_t &slot)
+{
+    auto iter = index.find(fingerprint(clk));
+    if (iter == index.end() || slots[iter->second].clk != clk) {
+        return false;
+    }
+    slot = iter->second;
+    return true;
+}
+
+// clock hand sweep, a slot referenced since the last sweep gets a second chance
+// never returns pinned
+uint32_t
+kronos_cache :: evict(uint32_t pinned)
+{
+    while (true) {
+        uint32_t cur = hand;
+        hand = (hand + 1) % slots.size();
+        cached_clock &c = slots[cur];
+        if (cur == pinned) {
+            continue;
+        }
+        if (c.referenced) {
+            c.referenced = false;
+        } else {
+            index.erase(c.fp);
+            stats.evictions++;
+            return cur;
+        }
+    }
+}
+
+// clk must not be in the cache
+// returns NO_SLOT if clk collides with the pinned clock
+uint32_t
+kronos_cache :: insert(const vc::vclock_t &clk, uint32_t pinned)
+{
+    uint64_t fp = fingerprint(clk);
+    uint32_t slot;
+    auto iter = index.find(fp);
+    if (iter != index.end()) {
+        // different clock with same fingerprint, replace it
+        slot = iter->second;
+        if (slot == pinned) {
+            return NO_SLOT;
+        }
+    } else if (index.size() < slots.size()) {
+        // free slots remain, find one from the hand
+        while (slots[hand].fp != 0) {
+            hand = (hand + 1) % slots.size();
+        }
+        slot = hand;
+    } else {
+        slot = evict(pinned);
+    }
+
+    cached_clock &c = slots[slot];
+    c.clk = clk;
+    c.fp = fp;
+    c.gen++;
+    c.referenced = true;
+    c.num_after = 0;
+    index[fp] = slot;
+    return slot;
+}
+
+// true if the cache orders the clock in slot before clk, directly or via vector clock order of a successor
+bool
+kronos_cache :: happens_before(uint32_t slot, const vc::vclock_t &clk)
+{
+    cached_clock &c = slots[slot];
+    uint32_t num = c.num_after < KRONOS_CACHE_SUCCESSORS? c.num_after : KRONOS_CACHE_SUCCESSORS;
+    for (uint32_t i = 0; i < num; i++) {
+        cached_clock &after = slots[c.after[i]];
+        if (after.gen != c.after_gen[i]) {
+            continue; // successor evicted
+        }
+        int cmp = vc::compare_clocks(after.clk, clk);
+        if (cmp == 0 || cmp == 2) {
+            c.referenced = true;
+            after.referenced = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+int
+kronos_cache :: compare(const vc::vclock_t &clk1, const vc::vclock_t &clk2)
+{
+    uint32_t slot;
+    if (lookup(clk1, slot) && happens_before(slot, clk2)) {
+        stats.hits++;
+        return 0;
+    }
+    if (lookup(clk2, slot) && happens_before(slot, clk1)) {
+        stats.hits++;
+        return 1;
+    }
+    stats.misses++;
+    return -1;
+}
+
+void
+kronos_cache :: add(const vc::vclock_t &clk1, const vc::vclock_t &clk2)
+{
+    uint32_t slot1, slot2;
+    if (!lookup(clk1, slot1)) {
+        slot1 = insert(clk1, NO_SLOT);
+    }
+    if (!lookup(clk2, slot2)) {
+        slot2 = insert(clk2, slot1);
+        if (slot2 == NO_SLOT) {
+            return;
+        }
+    }
+
+    cached_clock &c = slots[slot1];
+    uint32_t pos = c.num_after++ % KRONOS_CACHE_SUCCESSORS;
+    c.after[pos] = slot2;
+    c.after_gen[pos] = slots[slot2].gen;
+}
+
+void
+kronos_cache :: remove(const vc::vclock_t &clk)
+{
+    uint32_t slot;
+    if (lookup(clk, slot)) {
+        cached_clock &c = slots[slot];
+        index.erase(c.fp);
+        c.fp = 0;
+        c.gen++;
+        c.num_after = 0;
+    }
+}
+
+#undef NO_SLOT
 
 oracle :: oracle()
-    : kronos_cl(chronos_client_create(KronosIpaddr, KronosPort))
-    , cache_hits(0)
-{ }
+    : shared_hits(0)
+    , kronos_pairs(0)
+    , cache_lookups(0)
+{
+    published.hits = 0;
+    published.misses = 0;
+    published.evictions = 0;
+}
+
+oracle :: ~oracle()
+{
+    publish_cache_stats();
+}
+
+// add counters since the last publish to the process totals
+void
+oracle :: publish_cache_stats()
+{
+    kronos_cache_stats cur;
+    get_cache_stats(cur);
+    process_hits.fetch_add(cur.hits - published.hits, std::memory_order_relaxed);
+    process_misses.fetch_add(cur.misses - published.misses, std::memory_order_relaxed);
+    process_evictions.fetch_add(cur.evictions - published.evictions, std::memory_order_relaxed);
+    published = cur;
+}
+
+void
+oracle :: get_process_cache_stats(kronos_cache_stats &stats)
+{
+    stats.hits = process_hits.load(std::memory_order_relaxed);
+    stats.misses = process_misses.load(std::memory_order_relaxed);
+    stats.evictions = process_evictions.load(std::memory_order_relaxed);
+}
+
+void
+oracle :: get_cache_stats(kronos_cache_stats &stats)
+{
+    kcache.get_stats(stats);
+    // pairs which missed kcache were either found in the shared cache or sent to Kronos
+    stats.hits += shared_hits;
+    stats.misses = kronos_pairs;
+}
 
 // static members
 
@@ -29,36 +250,10 @@ oracle :: oracle()
 int
 oracle :: compare_two_clocks(const vc::vclock_t &clk1, const vc::vclock_t &clk2)
 {
-    int ret = 2;
-
     assert(clk1.size() == ClkSz);
     assert(clk2.size() == ClkSz);
 
-    // check epoch number
-    if (clk1[0] < clk2[0]) {
-        return 0;
-    } else if (clk1[0] > clk2[0]) {
-        return 1;
-    }
-
-    // same epoch number, compare each entry in vector
-    for (uint64_t i = 1; i < ClkSz; i++) {
-        if ((clk1[i] < clk2[i]) && (ret != 0)) {
-            if (ret == 2) {
-                ret = 0;
-            } else {
-                return -1;
-            }
-        } else if ((clk1[i] > clk2[i]) && (ret != 1)) {
-            if (ret == 2) {
-                ret = 1;
-            } else {
-                return -1;
-            }
-        }
-    }
-
-    return ret;
+    return vc::compare_clocks(clk1, clk2);
 }
 
 // method which only compares vector clocks
@@ -153,124 +348,150 @@ oracle :: equal_or_happens_before_no_kronos(const vc::vclock_t &vclk1, const vc:
 }
 
 
-// non-static members which use kronos_cl
+// non-static members which use Kronos
 
-// vector clock comparison method
-// will call Kronos if clocks are incomparable
-// returns index of earliest clock`
-int64_t
-oracle :: compare_vts(const std::vector<vc::vclock> &clocks)
+// vector clock comparison, using Kronos orders cached by this oracle or by the process kronos_batcher
+// returns true and index of earliest clock in small_idx if comparison was decisive
+// large is as in compare_vts_no_kronos
+bool
+oracle :: compare_vts_cached(const std::vector<vc::vclock> &clocks, std::vector<bool> &large, int64_t &small_idx)
 {
-    std::vector<bool> large;
-    int64_t ret_idx = INT64_MAX;
-
-    compare_vts_no_kronos(clocks, large, ret_idx);
-    if (ret_idx != INT64_MAX) {
+    small_idx = INT64_MAX;
+    compare_vts_no_kronos(clocks, large, small_idx);
+    if (small_idx != INT64_MAX) {
         // Kronos not required
-        return ret_idx;
-    } else {
-        // check cache
-        uint64_t num_clks = clocks.size();
-        for (uint64_t i = 0; i < num_clks; i++) {
-            for (uint64_t j = i+1; j < num_clks; j++) {
-                if (!large.at(i) && !large.at(j)) {
-                    int cmp = kcache.compare(clocks[i].clock, clocks[j].clock);
-                    if (cmp == 0) {
-                        large[j] = true;
-                        cache_hits++;
-                    } else if (cmp == 1) {
-                        large[i] = true;
-                        cache_hits++;
-                    } else {
-                        assert(cmp == -1);
+        return true;
+    }
+
+    // check cache
+    if (++cache_lookups % KRONOS_STATS_INTERVAL == 0) {
+        publish_cache_stats();
+    }
+    kronos_batcher &batcher = kronos_batcher::get();
+    uint64_t num_clks = clocks.size();
+    for (uint64_t i = 0; i < num_clks; i++) {
+        for (uint64_t j = i+1; j < num_clks; j++) {
+            if (!large.at(i) && !large.at(j)) {
+                int cmp = kcache.compare(clocks[i].clock, clocks[j].clock);
+                if (cmp == -1) {
+                    cmp = batcher.compare_cached(clocks[i].clock, clocks[j].clock);
+                    if (cmp != -1) {
+                        shared_hits++;
                     }
                 }
+                if (cmp == 0) {
+                    large[j] = true;
+                } else if (cmp == 1) {
+                    large[i] = true;
+                } else {
+                    assert(cmp == -1);
+                }
             }
         }
-        uint64_t num_large = std::count(large.begin(), large.end(), true);
-        if (num_large == (num_clks-1)) {
-            // Kronos not required
-            return get_false_position(large);
-        }
+    }
+    uint64_t num_large = std::count(large.begin(), large.end(), true);
+    if (num_large == (num_clks-1)) {
+        // Kronos not required
+        small_idx = get_false_position(large);
+        return true;
+    }
 
-        // need to call Kronos
-        uint64_t num_pairs = ((num_clks - num_large) * (num_clks - num_large - 1)) / 2;
-        weaver_pair *wpair = (weaver_pair*)malloc(sizeof(weaver_pair) * num_pairs);
-        weaver_pair *wp = wpair;
-        uint64_t epoch_num = UINT64_MAX;
-
-        for (uint64_t i = 0; i < num_clks; i++) {
-            for (uint64_t j = i+1; j < num_clks; j++) {
-                if (!large.at(i) && !large.at(j)) {
-                    wp->lhs = (uint64_t*)malloc(sizeof(uint64_t) * ClkSz);
-                    wp->rhs = (uint64_t*)malloc(sizeof(uint64_t) * ClkSz);
-
-                    if (epoch_num == UINT64_MAX) {
-                        epoch_num = clocks[i].clock[0];
-                    } else {
-                        assert(clocks[i].clock[0] == epoch_num);
-                        assert(clocks[j].clock[0] == epoch_num);
-                    }
+    return false;
+}
 
-                    for (uint64_t k = 0; k < ClkSz; k++) {
-                        wp->lhs[k] = clocks[i].clock[k];
-                        wp->rhs[k] = clocks[j].clock[k];
-                    }
-                    wp->lhs_id = clocks[i].vt_id;
-                    wp->rhs_id = clocks[j].vt_id;
-                    wp->flags = CHRONOS_SOFT_FAIL;
-                    wp->order = CHRONOS_HAPPENS_BEFORE;
-                    wp++;
+// soft Kronos query for all pairs of clocks which may be the earliest
+std::shared_ptr<order::kronos_query>
+oracle :: make_query(const std::vector<vc::vclock> &clocks, const std::vector<bool> &large)
+{
+    kronos_query_ptr query(new kronos_query(true));
+    uint64_t num_clks = clocks.size();
+    uint64_t epoch_num = UINT64_MAX;
+
+    for (uint64_t i = 0; i < num_clks; i++) {
+        for (uint64_t j = i+1; j < num_clks; j++) {
+            if (!large.at(i) && !large.at(j)) {
+                if (epoch_num == UINT64_MAX) {
+                    epoch_num = clocks[i].clock[0];
+                } else {
+                    assert(clocks[i].clock[0] == epoch_num);
+                    assert(clocks[j].clock[0] == epoch_num);
                 }
+                query->lhs.emplace_back(clocks[i]);
+                query->rhs.emplace_back(clocks[j]);
             }
         }
+    }
 
-        chronos_returncode status;
-        ssize_t cret;
-
-        int64_t ret = kronos_cl->weaver_order(wpair, num_pairs, &status, &cret);
-        ret = kronos_cl->wait(ret, 100000, &status);
-
-        wp = wpair;
-        std::vector<bool> large_upd = large;
-        for (uint64_t i = 0; i < num_clks; i++) {
-            for (uint64_t j = i+1; j < num_clks; j++) {
-                if (!large.at(i) && !large.at(j)) {
-                    // retrieve and set order
-                    assert((wp->order == CHRONOS_HAPPENS_BEFORE) || (wp->order == CHRONOS_HAPPENS_AFTER));
-                    // fine-grained locking for cache.add() so that other requests are not blocked for a long time
-                    switch (wp->order) {
-                        case CHRONOS_HAPPENS_BEFORE:
-                            large_upd.at(j) = true;
-                            kcache.add(clocks[i].clock, clocks[j].clock);
-                            break;
-
-                        case CHRONOS_HAPPENS_AFTER:
-                            large_upd.at(i) = true;
-                            kcache.add(clocks[j].clock, clocks[i].clock);
-                            break;
-
-                        default:
-                            WDEBUG << "cannot reach here" << std::endl;
-                            assert(false);
-                    }
-                    free(wp->lhs);
-                    free(wp->rhs);
-                    wp++;
+    return query;
+}
+
+// vector clock comparison method
+// will call Kronos if clocks are incomparable, batched with requests from other threads
+// returns index of earliest clock`
+int64_t
+oracle :: compare_vts(const std::vector<vc::vclock> &clocks)
+{
+    std::vector<bool> large;
+    int64_t ret_idx;
+
+    if (compare_vts_cached(clocks, large, ret_idx)) {
+        return ret_idx;
+    }
+
+    // need to call Kronos
+    kronos_query_ptr query = make_query(clocks, large);
+    kronos_pairs += query->lhs.size();
+    kronos_batcher::get().submit(query).wait();
+
+    uint64_t num_clks = clocks.size();
+    uint64_t p = 0;
+    std::vector<bool> large_upd = large;
+    for (uint64_t i = 0; i < num_clks; i++) {
+        for (uint64_t j = i+1; j < num_clks; j++) {
+            if (!large.at(i) && !large.at(j)) {
+                // retrieve and set order
+                switch (query->order[p++]) {
+                    case CHRONOS_HAPPENS_BEFORE:
+                        large_upd.at(j) = true;
+                        kcache.add(clocks[i].clock, clocks[j].clock);
+                        break;
+
+                    case CHRONOS_HAPPENS_AFTER:
+                        large_upd.at(i) = true;
+                        kcache.add(clocks[j].clock, clocks[i].clock);
+                        break;
+
+                    default:
+                        WDEBUG << "cannot reach here" << std::endl;
+                        assert(false);
                 }
             }
         }
-        free(wpair);
+    }
 
-        for (uint64_t min_pos = 0; min_pos < num_clks; min_pos++) {
-            if (!large_upd.at(min_pos)) {
-                return min_pos;
-            }
+    for (uint64_t min_pos = 0; min_pos < num_clks; min_pos++) {
+        if (!large_upd.at(min_pos)) {
+            return min_pos;
         }
-        // should never reach here
-        assert(false);
-        return INT64_MAX;
     }
+    // should never reach here
+    assert(false);
+    return INT64_MAX;
+}
+
+bool
+oracle :: compare_vts_async(const std::vector<vc::vclock> &clocks, int64_t &small_idx, std::function<void()> ready)
+{
+    std::vector<bool> large;
+    if (compare_vts_cached(clocks, large, small_idx)) {
+        return true;
+    }
+
+    kronos_query_ptr query = make_query(clocks, large);
+    kronos_pairs += query->lhs.size();
+    query->callback = std::move(ready);
+    kronos_batcher::get().submit(query);
+    return false;
 }
 
 // compare two vector clocks
@@ -309,10 +530,19 @@ oracle :: clock_creat_before_del_after(const vc::vclock &req_vclock, const vc::v
 bool
 oracle :: assign_vt_order(const std::vector<vc::vclock> &before, const vc::vclock &after)
 {
+    std::vector<vc::vclock> after_vec(before.size(), after);
+    return assign_vt_order(before, after_vec);
+}
+
+bool
+oracle :: assign_vt_order(const std::vector<vc::vclock> &before, const std::vector<vc::vclock> &after)
+{
+    assert(before.size() == after.size());
+
     // check if can compare without kronos
     std::vector<uint64_t> need_kronos;
     for (uint64_t i = 0; i < before.size(); i++) {
-        int cmp = compare_two_clocks(before[i].clock, after.clock);
+        int cmp = compare_two_clocks(before[i].clock, after[i].clock);
         if (cmp >= 1) {
             return false;
         } else if (cmp == -1) {
@@ -324,40 +554,13 @@ oracle :: assign_vt_order(const std::vector<vc::vclock> &before, const vc::vcloc
         return true;
     }
 
-    // need to call Kronos
-
-    uint64_t num_pairs = need_kronos.size();
-    weaver_pair *wpair = (weaver_pair*)malloc(sizeof(weaver_pair) * num_pairs);
-    
-    // prep kronos args
-    for (uint64_t i = 0; i < num_pairs; i++) {
-        weaver_pair &wp = wpair[i];
-        uint64_t idx = need_kronos[i];
-        wp.lhs = (uint64_t*)malloc(sizeof(uint64_t) * ClkSz);
-        wp.rhs = (uint64_t*)malloc(sizeof(uint64_t) * ClkSz);
-        for (uint64_t k = 0; k < ClkSz; k++) {
-            wp.lhs[k] = before[idx].clock[k];
-            wp.rhs[k] = after.clock[k];
-        }
-        wp.lhs_id = before[idx].vt_id;
-        wp.rhs_id = after.vt_id;
-        wp.flags = 0;
-        wp.order = CHRONOS_HAPPENS_BEFORE;
+    // need to call Kronos, all pairs in a single call so that the assignment is all or nothing
+    kronos_query_ptr query(new kronos_query(false));
+    for (uint64_t idx: need_kronos) {
+        query->lhs.emplace_back(before[idx]);
+        query->rhs.emplace_back(after[idx]);
     }
+    kronos_batcher::get().submit(query).wait();
 
-    // actual kronos call
-    chronos_returncode status;
-    ssize_t cret;
-    int64_t ret = kronos_cl->weaver_order(wpair, num_pairs, &status, &cret);
-    ret = kronos_cl->wait(ret, 100000, &status);
-
-    // check kronos returned orders
-    for (uint64_t i = 0; i < num_pairs; i++) {
-        if (wpair[i].order != CHRONOS_HAPPENS_BEFORE) {
-            free(wpair);
-            return false;
-        }
-    }
-    free(wpair);
-    return true;
+    return query->success;
 }
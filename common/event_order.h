@@ -16,6 +16,10 @@
 #define weaver_common_event_order_h_
 
 #include <list>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <functional>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -25,88 +29,90 @@
 
 namespace order
 {
+    struct kronos_query;
+
+    struct kronos_cache_stats
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+    };
+
+    // a cached clock, and the clocks Kronos ordered after it
+    struct cached_clock
+    {
+        vc::vclock_t clk;
+        uint64_t fp; // fingerprint of clk, 0 if slot is free
+        uint32_t gen; // incremented on reuse of slot, invalidates references to the old clock
+        bool referenced; // for CLOCK eviction
+        uint32_t num_after;
+        uint32_t after[KRONOS_CACHE_SUCCESSORS]; // slots, ring buffer
+        uint32_t after_gen[KRONOS_CACHE_SUCCESSORS];
+    };
+
+    // fixed capacity cache of orders returned by Kronos for concurrent clocks
+    // clocks are found by 64-bit fingerprint and verified on lookup, a colliding clock replaces the old one
+    // when full, a slot is reclaimed by CLOCK (second chance) eviction
+    // each clock keeps its latest KRONOS_CACHE_SUCCESSORS successors, and an order is also found
+    // transitively: a -> c in the cache and c before or equal to b as vector clocks gives a -> b
     class kronos_cache
     {
         private:
-            // vclock -> id which represents the clock. Space saving optimization
-            std::unordered_map<vc::vclock_t, uint64_t> id_map;
-            // unique clock id generating counter
-            uint64_t id_gen;
-            // vclock -> set of vclocks that happen after it
-            std::unordered_map<uint64_t, std::unordered_set<uint64_t>> happens_before_list;
+            std::vector<cached_clock> slots;
+            std::unordered_map<uint64_t, uint32_t> index; // fingerprint -> slot
+            uint32_t hand;
+            kronos_cache_stats stats;
+
+            static uint64_t fingerprint(const vc::vclock_t &clk);
+            bool lookup(const vc::vclock_t &clk, uint32_t &slot);
+            uint32_t insert(const vc::vclock_t &clk, uint32_t pinned);
+            uint32_t evict(uint32_t pinned);
+            bool happens_before(uint32_t slot, const vc::vclock_t &clk);
 
         public:
-            kronos_cache() : id_gen(0) { }
+            kronos_cache();
 
             // return the index (0 or 1) of smaller clock if exists in cache
             // return -1 if doesn't exist
-            int compare(const vc::vclock_t &clk1, const vc::vclock_t &clk2)
-            {
-                if (id_map.find(clk1) != id_map.end()
-                 && id_map.find(clk2) != id_map.end()) {
-                    uint64_t id1 = id_map[clk1];
-                    uint64_t id2 = id_map[clk2];
-                    WDEBUG << "possible Kronos cache, looking up now\n";
-                    if (happens_before_list.find(id1) != happens_before_list.end()) {
-                        if (happens_before_list[id1].find(id2) != happens_before_list[id1].end()) {
-                            WDEBUG << "Kronos cache hit!\n";
-                            return 0;
-                        }
-                    }
-                    if (happens_before_list.find(id2) != happens_before_list.end()) {
-                        if (happens_before_list[id2].find(id1) != happens_before_list[id2].end()) {
-                            WDEBUG << "Kronos cache hit!\n";
-                            return 1;
-                        }
-                    }
-                }
-                return -1;
-            }
-
+            int compare(const vc::vclock_t &clk1, const vc::vclock_t &clk2);
             // clk1 happens before clk2
-            void add(const vc::vclock_t &clk1, const vc::vclock_t &clk2)
-            {
-                uint64_t id1, id2;
-
-                if (id_map.find(clk1) != id_map.end()) {
-                    id1 = id_map[clk1];
-                } else {
-                    id1 = id_gen++;
-                    id_map[clk1] = id1;
-                }
-
-                if (id_map.find(clk2) != id_map.end()) {
-                    id2 = id_map[clk2];
-                } else {
-                    id2 = id_gen++;
-                    id_map[clk2] = id2;
-                }
-
-                happens_before_list[id1].emplace(id2);
-            }
-
-            void remove(const vc::vclock_t &clk)
-            {
-                if (id_map.find(clk) != id_map.end()) {
-                    happens_before_list.erase(id_map[clk]);
-                    id_map.erase(clk);
-                }
-            }
+            void add(const vc::vclock_t &clk1, const vc::vclock_t &clk2);
+            void remove(const vc::vclock_t &clk);
+            void get_stats(kronos_cache_stats &s) const { s = stats; }
     };
 
     class oracle
     {
         private:
-            std::unique_ptr<chronos_client> kronos_cl;
-            uint64_t cache_hits;
             kronos_cache kcache;
+            uint64_t shared_hits; // pairs not in kcache, found in cache shared by all oracles
+            uint64_t kronos_pairs; // pairs sent to Kronos
+            uint64_t cache_lookups; // compare calls which reached the caches
+            kronos_cache_stats published; // part of the counters already added to the process totals
+
+        private:
+            void publish_cache_stats();
+            bool compare_vts_cached(const std::vector<vc::vclock> &clocks, std::vector<bool> &large, int64_t &small_idx);
+            std::shared_ptr<kronos_query> make_query(const std::vector<vc::vclock> &clocks, const std::vector<bool> &large);
 
         public:
             oracle();
+            ~oracle();
             int64_t compare_vts(const std::vector<vc::vclock> &clocks);
+            // returns true and index of earliest clock if it can be found without waiting for Kronos
+            // else sends the undecided pairs to Kronos and returns false, ready is called once their order
+            // is cached, after which this call with the same clocks returns true
+            bool compare_vts_async(const std::vector<vc::vclock> &clocks, int64_t &small_idx, std::function<void()> ready);
+            // hits include orders found in the cache shared by all oracles, see kronos_batcher
+            void get_cache_stats(kronos_cache_stats &stats);
+            // sum over all oracles of this process, each oracle publishes every KRONOS_STATS_INTERVAL lookups
+            // and on destruction, so oracles of running threads lag by less than that
+            static void get_process_cache_stats(kronos_cache_stats &stats);
             int64_t compare_two_vts(const vc::vclock &clk1, const vc::vclock &clk2);
             bool clock_creat_before_del_after(const vc::vclock &req_vclock, const vc::vclock &creat_time, const vc::vclock &del_time);
             bool assign_vt_order(const std::vector<vc::vclock> &before, const vc::vclock &after);
+            // order before[i] ahead of after[i] for all i, all or nothing
+            bool assign_vt_order(const std::vector<vc::vclock> &before, const std::vector<vc::vclock> &after);
 
         public:
             // no Kronos for these calls, pure vector clock comparison which may be indecisive
@@ -578,7 +578,7 @@ hyper_stub_base :: recreate_node(const hyperdex_client_attribute *cl_attr, db::e
     n.base.update_creat_time(create_clk);
 
     // out edges
-    unpack_buffer<db::element::edge*>(cl_attr[idx[2]].value, cl_attr[idx[2]].value_sz, n.out_edges);
+    unpack_buffer(cl_attr[idx[2]].value, cl_attr[idx[2]].value_sz, n.out_edges);
     // last update clock
     unpack_buffer(cl_attr[idx[4]].value, cl_attr[idx[4]].value_sz, n.last_upd_clk);
     // restore clock
@@ -627,7 +627,7 @@ hyper_stub_base :: prepare_node(hyperdex_client_attribute *cl_attr,
     cl_attr[1].datatype = graph_dtypes[1];
 
     // out edges
-    prepare_buffer<db::element::edge*>(n.out_edges, out_edges_buf);
+    prepare_buffer(n.out_edges, out_edges_buf);
     cl_attr[2].attr = graph_attrs[2];
     cl_attr[2].value = (const char*)out_edges_buf->data();
     cl_attr[2].value_sz = out_edges_buf->size();
@@ -676,6 +676,8 @@ bool
 hyper_stub_base :: put_nodes(std::unordered_map<node_handle_t, db::element::node*> &nodes)
 {
     int num_nodes = nodes.size();
+    std::vector<node_handle_t> handles; // keys point in to this, do not resize
+    handles.reserve(num_nodes);
     std::vector<hyper_tx_func> funcs(num_nodes, &hyperdex_client_xact_put);
     std::vector<const char*> spaces(num_nodes, graph_space);
     std::vector<const char*> keys(num_nodes);
@@ -693,8 +695,9 @@ hyper_stub_base :: put_nodes(std::unordered_map<node_handle_t, db::element::node
     int i = 0;
     for (auto &p: nodes) {
         attrs[i] = attrs_to_add + NUM_GRAPH_ATTRS*i;
-        keys[i] = p.first.c_str();
-        key_szs[i] = p.first.size();
+        handles.emplace_back(p.second->get_handle());
+        keys[i] = handles.back().c_str();
+        key_szs[i] = handles.back().size();
 
         prepare_node(attrs[i], *p.second, creat_clk_buf[i], props_buf[i], out_edges_buf[i], last_clk_buf[i], restore_clk_buf[i]);
 
@@ -709,9 +712,11 @@ hyper_stub_base :: put_nodes(std::unordered_map<node_handle_t, db::element::node
 }
 
 bool
-hyper_stub_base :: put_nodes_bulk(std::unordered_map<node_handle_t, db::element::node*> &nodes)
+hyper_stub_base :: put_nodes_bulk(std::unordered_map<uint64_t, db::element::node*> &nodes)
 {
     int num_nodes = nodes.size();
+    std::vector<node_handle_t> handles; // keys point in to this, do not resize
+    handles.reserve(num_nodes);
     std::vector<hyper_func> funcs(num_nodes, &hyperdex_client_put);
     std::vector<const char*> spaces(num_nodes, graph_space);
     std::vector<const char*> keys(num_nodes);
@@ -729,8 +734,9 @@ hyper_stub_base :: put_nodes_bulk(std::unordered_map<node_handle_t, db::element:
     int i = 0;
     for (auto &p: nodes) {
         attrs[i] = attrs_to_add + NUM_GRAPH_ATTRS*i;
-        keys[i] = p.first.c_str();
-        key_szs[i] = p.first.size();
+        handles.emplace_back(p.second->get_handle());
+        keys[i] = handles.back().c_str();
+        key_szs[i] = handles.back().size();
 
         prepare_node(attrs[i], *p.second, creat_clk_buf[i], props_buf[i], out_edges_buf[i], last_clk_buf[i], restore_clk_buf[i]);
 
@@ -750,6 +756,194 @@ hyper_stub_base :: del_node(const node_handle_t &handle)
     del(graph_space, handle.c_str(), handle.size());
 }
 
+void
+hyper_stub_base :: prepare_out_edge(hyperdex_client_map_attribute *map_attr,
+    const edge_handle_t &handle,
+    db::element::edge *e,
+    std::unique_ptr<e::buffer> &edge_buf)
+{
+    // same key/value encoding as the out_edges map in prepare_node
+    prepare_buffer(e, edge_buf);
+    map_attr->attr = graph_attrs[2];
+    map_attr->map_key = handle.c_str();
+    map_attr->map_key_sz = handle.size();
+    map_attr->map_key_datatype = HYPERDATATYPE_STRING;
+    map_attr->value = (const char*)edge_buf->data();
+    map_attr->value_sz = edge_buf->size();
+    map_attr->value_datatype = HYPERDATATYPE_STRING;
+}
+
+void
+hyper_stub_base :: prepare_property(hyperdex_client_map_attribute *map_attr,
+    const std::string &key,
+    db::element::property &prop,
+    std::unique_ptr<e::buffer> &prop_buf)
+{
+    // same key/value encoding as the properties map in prepare_node
+    prepare_buffer(prop, prop_buf);
+    map_attr->attr = graph_attrs[1];
+    map_attr->map_key = key.c_str();
+    map_attr->map_key_sz = key.size();
+    map_attr->map_key_datatype = HYPERDATATYPE_STRING;
+    map_attr->value = (const char*)prop_buf->data();
+    map_attr->value_sz = prop_buf->size();
+    map_attr->value_datatype = HYPERDATATYPE_STRING;
+}
+
+bool
+hyper_stub_base :: add_out_edge(db::element::node &n, db::element::edge *e)
+{
+    hyperdex_client_map_attribute map_attr;
+    std::unique_ptr<e::buffer> edge_buf;
+    edge_handle_t e_handle = e->get_handle();
+    prepare_out_edge(&map_attr, e_handle, e, edge_buf);
+
+    node_handle_t handle = n.get_handle();
+    return map_call(&hyperdex_client_xact_map_add, graph_space, handle.c_str(), handle.size(), &map_attr, 1);
+}
+
+bool
+hyper_stub_base :: remove_out_edge(db::element::node &n, db::element::edge *e)
+{
+    hyperdex_client_attribute cl_attr;
+    edge_handle_t e_handle = e->get_handle();
+    cl_attr.attr = graph_attrs[2];
+    cl_attr.value = e_handle.c_str();
+    cl_attr.value_sz = e_handle.size();
+    cl_attr.datatype = HYPERDATATYPE_STRING;
+
+    node_handle_t handle = n.get_handle();
+    return call(&hyperdex_client_xact_map_remove, graph_space, handle.c_str(), handle.size(), &cl_attr, 1);
+}
+
+// persist only the parts of each node that were changed by the tx
+// properties and out-edges are updated per map key, so the cost is proportional to the size of the delta and not the node
+// all deltas to a node are folded together first, so that each node gets at most one put, one map add, and one map remove
+bool
+hyper_stub_base :: put_node_deltas(std::unordered_map<node_handle_t, db::element::node*> &nodes,
+    std::unordered_map<node_handle_t, node_delta> &deltas)
+{
+    uint64_t num_nodes = deltas.size();
+    uint64_t num_adds = 0;
+    uint64_t num_removes = 0;
+    for (const auto &p: deltas) {
+        db::element::node *n = nodes.at(p.first);
+        num_adds += p.second.props.size();
+        for (const edge_handle_t &e: p.second.out_edges) {
+            if (n->out_edges.contains(e)) {
+                num_adds++;
+            } else {
+                num_removes++;
+            }
+        }
+    }
+
+    // restore clock puts and out-edge removals
+    std::vector<hyper_tx_func> funcs;
+    std::vector<const char*> spaces;
+    std::vector<const char*> keys;
+    std::vector<size_t> key_szs;
+    std::vector<hyperdex_client_attribute*> attrs;
+    std::vector<size_t> num_attrs;
+    // property and out-edge additions
+    std::vector<hyper_map_tx_func> map_funcs;
+    std::vector<const char*> map_spaces;
+    std::vector<const char*> map_keys;
+    std::vector<size_t> map_key_szs;
+    std::vector<hyperdex_client_map_attribute*> map_attrs;
+    std::vector<size_t> map_num_attrs;
+
+    std::vector<std::unique_ptr<e::buffer>> restore_clk_buf(num_nodes);
+    std::vector<std::unique_ptr<e::buffer>> add_buf(num_adds);
+
+    hyperdex_client_attribute *clk_attrs = (hyperdex_client_attribute*)malloc(num_nodes * sizeof(hyperdex_client_attribute));
+    hyperdex_client_attribute *remove_attrs = (hyperdex_client_attribute*)malloc(num_removes * sizeof(hyperdex_client_attribute));
+    hyperdex_client_map_attribute *add_attrs = (hyperdex_client_map_attribute*)malloc(num_adds * sizeof(hyperdex_client_map_attribute));
+
+    uint64_t i = 0;
+    uint64_t add_idx = 0;
+    uint64_t remove_idx = 0;
+    for (auto &p: deltas) {
+        db::element::node *n = nodes.at(p.first);
+        const char *key = p.first.c_str();
+        size_t key_sz = p.first.size();
+
+        // restore clock
+        assert(n->restore_clk.size() == ClkSz);
+        prepare_buffer(n->restore_clk, restore_clk_buf[i]);
+        clk_attrs[i].attr = graph_attrs[5];
+        clk_attrs[i].value = (const char*)restore_clk_buf[i]->data();
+        clk_attrs[i].value_sz = restore_clk_buf[i]->size();
+        clk_attrs[i].datatype = graph_dtypes[5];
+
+        funcs.emplace_back(&hyperdex_client_xact_put);
+        spaces.emplace_back(graph_space);
+        keys.emplace_back(key);
+        key_szs.emplace_back(key_sz);
+        attrs.emplace_back(clk_attrs + i);
+        num_attrs.emplace_back(1);
+
+        uint64_t add_start = add_idx;
+        uint64_t remove_start = remove_idx;
+
+        for (const std::string &prop_key: p.second.props) {
+            prepare_property(add_attrs + add_idx, prop_key, n->base.properties.at(prop_key), add_buf[add_idx]);
+            add_idx++;
+        }
+
+        for (const edge_handle_t &e: p.second.out_edges) {
+            db::element::edge *out_edge = n->out_edges.find(e);
+            if (out_edge != NULL) {
+                prepare_out_edge(add_attrs + add_idx, e, out_edge, add_buf[add_idx]);
+                add_idx++;
+            } else {
+                remove_attrs[remove_idx].attr = graph_attrs[2];
+                remove_attrs[remove_idx].value = e.c_str();
+                remove_attrs[remove_idx].value_sz = e.size();
+                remove_attrs[remove_idx].datatype = HYPERDATATYPE_STRING;
+                remove_idx++;
+            }
+        }
+
+        if (add_idx > add_start) {
+            map_funcs.emplace_back(&hyperdex_client_xact_map_add);
+            map_spaces.emplace_back(graph_space);
+            map_keys.emplace_back(key);
+            map_key_szs.emplace_back(key_sz);
+            map_attrs.emplace_back(add_attrs + add_start);
+            map_num_attrs.emplace_back(add_idx - add_start);
+        }
+
+        if (remove_idx > remove_start) {
+            funcs.emplace_back(&hyperdex_client_xact_map_remove);
+            spaces.emplace_back(graph_space);
+            keys.emplace_back(key);
+            key_szs.emplace_back(key_sz);
+            attrs.emplace_back(remove_attrs + remove_start);
+            num_attrs.emplace_back(remove_idx - remove_start);
+        }
+
+        i++;
+    }
+    assert(add_idx == num_adds);
+    assert(remove_idx == num_removes);
+
+    bool success = multiple_call(funcs,
+        spaces,
+        keys, key_szs,
+        attrs, num_attrs,
+        map_funcs,
+        map_spaces,
+        map_keys, map_key_szs,
+        map_attrs, map_num_attrs);
+
+    free(clk_attrs);
+    free(remove_attrs);
+    free(add_attrs);
+
+    return success;
+}
+
 /*
 void
 hyper_stub_base :: update_creat_time(db::element::node &n)
@@ -781,40 +975,6 @@ hyper_stub_base :: update_properties(db::element::node &n)
     call(&hyperdex_client_xact_put, graph_space, handle.c_str(), handle.size(), &cl_attr, 1);
 }
 
-void
-hyper_stub_base :: add_out_edge(db::element::node &n, db::element::edge *e)
-{
-    hyperdex_client_map_attribute map_attr;
-    std::unique_ptr<e::buffer> key_buf, val_buf;
-    prepare_buffer(e->get_handle(), key_buf);
-    prepare_buffer(e, val_buf);
-    map_attr.attr = graph_attrs[3];
-    map_attr.map_key = (const char*)key_buf->data();
-    map_attr.map_key_sz = key_buf->size();
-    map_attr.map_key_datatype = HYPERDATATYPE_STRING;
-    map_attr.value = (const char*)val_buf->data();
-    map_attr.value_sz = val_buf->size();
-    map_attr.value_datatype = HYPERDATATYPE_STRING;
-
-    node_handle_t handle = n.get_handle();
-    map_call(&hyperdex_client_xact_put, graph_space, handle.c_str(), handle.size(), &map_attr, 1);
-}
-
-void
-hyper_stub_base :: remove_out_edge(db::element::node &n, db::element::edge *e)
-{
-    hyperdex_client_attribute cl_attr;
-    std::unique_ptr<e::buffer> key_buf;
-    prepare_buffer(e->get_handle(), key_buf);
-    cl_attr.attr = graph_attrs[3];
-    cl_attr.value = (const char*)key_buf->data();
-    cl_attr.value_sz = key_buf->size();
-    cl_attr.datatype = HYPERDATATYPE_STRING;
-
-    node_handle_t handle = n.get_handle();
-    call(&hyperdex_client_xact_map_remove, graph_space, handle.c_str(), handle.size(), &cl_attr, 1);
-}
-
 void
 hyper_stub_base :: add_in_nbr(const node_handle_t &n_hndl, const node_handle_t &nbr)
 {
@@ -1135,6 +1295,64 @@ hyper_stub_base :: del_nmap(std::unordered_set<node_handle_t> &toDel)
     return multiple_del(spaces, keys, key_szs);
 }
 
+// store the out-edges as a HYPERDATATYPE_MAP_STRING_STRING from edge handle to edge
+// same encoding as prepare_buffer for an unordered_map<edge_handle_t, edge*>
+void
+hyper_stub_base :: prepare_buffer(const db::element::edge_table &edges, std::unique_ptr<e::buffer> &buf)
+{
+    uint64_t buf_sz = 0;
+    std::vector<std::pair<edge_handle_t, const db::element::edge*>> sorted;
+    sorted.reserve(edges.size());
+
+    for (const db::element::edge &e: edges) {
+        sorted.emplace_back(e.get_handle(), &e);
+    }
+    std::sort(sorted.begin(), sorted.end()); // edge handles are unique
+
+    std::vector<uint32_t> val_sz(sorted.size(), UINT32_MAX);
+    for (uint64_t i = 0; i < sorted.size(); i++) {
+        val_sz[i] = message::size(*sorted[i].second);
+        buf_sz += sizeof(uint32_t) // map key encoding sz
+                + sorted[i].first.size()
+                + sizeof(uint32_t) // map val encoding sz
+                + val_sz[i]; // map val encoding
+    }
+
+    buf.reset(e::buffer::create(buf_sz));
+    e::buffer::packer packer = buf->pack();
+
+    for (uint64_t i = 0; i < sorted.size(); i++) {
+        pack_uint32(packer, sorted[i].first.size());
+        pack_string(packer, sorted[i].first);
+
+        pack_uint32(packer, val_sz[i]);
+        message::pack_buffer(packer, *sorted[i].second);
+    }
+}
+
+// unpack the HYPERDATATYPE_MAP_STRING_STRING in to the edge table
+void
+hyper_stub_base :: unpack_buffer(const char *buf, uint64_t buf_sz, db::element::edge_table &edges)
+{
+    std::unique_ptr<e::buffer> ebuf(e::buffer::create(buf, buf_sz));
+    e::unpacker unpacker = ebuf->unpack_from(0);
+    std::string key;
+    uint32_t sz;
+
+    while (!unpacker.empty()) {
+        key.erase();
+
+        unpack_uint32(unpacker, sz);
+        unpack_string(unpacker, key, sz);
+
+        unpack_uint32(unpacker, sz);
+        db::element::edge e;
+        message::unpack_buffer(unpacker, e);
+        assert(e.get_handle() == key);
+        edges.add(std::move(e));
+    }
+}
+
 void
 hyper_stub_base :: pack_uint64(e::buffer::packer &pkr, uint64_t num)
 {
@@ -38,6 +38,14 @@ enum persist_node_state
     MOVING
 };
 
+// parts of a node changed by a single tx
+// persisted as per-key map updates instead of rewriting the whole node
+struct node_delta
+{
+    std::unordered_set<std::string> props; // property keys set by the tx
+    std::unordered_set<edge_handle_t> out_edges; // out-edges created, modified, or deleted by the tx
+};
+
 class hyper_stub_base
 {
     protected:
@@ -128,12 +136,14 @@ class hyper_stub_base
         bool get_node(db::element::node &n);
         //bool put_node(db::element::node &n);
         bool put_nodes(std::unordered_map<node_handle_t, db::element::node*> &nodes);
-        bool put_nodes_bulk(std::unordered_map<node_handle_t, db::element::node*> &nodes);
+        bool put_nodes_bulk(std::unordered_map<uint64_t, db::element::node*> &nodes);
+        bool put_node_deltas(std::unordered_map<node_handle_t, db::element::node*> &nodes,
+            std::unordered_map<node_handle_t, node_delta> &deltas);
         void del_node(const node_handle_t &h);
         void update_creat_time(db::element::node &n);
         void update_properties(db::element::node &n);
-        void add_out_edge(db::element::node &n, db::element::edge *e);
-        void remove_out_edge(db::element::node &n, db::element::edge *e);
+        bool add_out_edge(db::element::node &n, db::element::edge *e);
+        bool remove_out_edge(db::element::node &n, db::element::edge *e);
         void add_in_nbr(const node_handle_t &node, const node_handle_t &nbr);
         void remove_in_nbr(const node_handle_t &n_hndl, const node_handle_t &nbr);
         bool recreate_node(const hyperdex_client_attribute *cl_attr, db::element::node &n);
@@ -154,6 +164,8 @@ class hyper_stub_base
         template <typename T> void unpack_buffer(const char *buf, uint64_t buf_sz, T &t);
         template <typename T> void prepare_buffer(const std::unordered_map<std::string, T> &map, std::unique_ptr<e::buffer> &buf);
         template <typename T> void unpack_buffer(const char *buf, uint64_t buf_sz, std::unordered_map<std::string, T> &map);
+        void prepare_buffer(const db::element::edge_table &edges, std::unique_ptr<e::buffer> &buf);
+        void unpack_buffer(const char *buf, uint64_t buf_sz, db::element::edge_table &edges);
 
     private:
         void prepare_node(hyperdex_client_attribute *attr,
@@ -163,6 +175,14 @@ class hyper_stub_base
             std::unique_ptr<e::buffer>&,
             std::unique_ptr<e::buffer>&,
             std::unique_ptr<e::buffer>&);
+        void prepare_out_edge(hyperdex_client_map_attribute *map_attr,
+            const edge_handle_t &handle,
+            db::element::edge *e,
+            std::unique_ptr<e::buffer> &edge_buf);
+        void prepare_property(hyperdex_client_map_attribute *map_attr,
+            const std::string &key,
+            db::element::property &prop,
+            std::unique_ptr<e::buffer> &prop_buf);
         void pack_uint64(e::buffer::packer &packer, uint64_t num);
         void unpack_uint64(e::unpacker &unpacker, uint64_t &num);
         void pack_uint32(e::buffer::packer &packer, uint32_t num);
@@ -0,0 +1,200 @@
+/*
+ * ===============================================================
+ *    Description:  Implementation of Kronos request batching.
+ *
+ *        Created:  2014-10-16 11:41:52
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#include <thread>
+
+#define weaver_debug_
+#include "common/weaver_constants.h"
+#include "common/config_constants.h"
+#include "common/kronos_batcher.h"
+
+using order::kronos_query;
+using order::kronos_query_ptr;
+using order::kronos_batcher;
+
+kronos_batcher :: kronos_batcher()
+    : kronos_cl(chronos_client_create(KronosIpaddr, KronosPort))
+    , pending_cond(&pending_mtx)
+{ }
+
+kronos_batcher*
+kronos_batcher :: create()
+{
+    kronos_batcher *batcher = new kronos_batcher();
+    std::thread t(batch_loop, batcher);
+    t.detach();
+    return batcher;
+}
+
+// never destroyed, batch thread runs for the lifetime of the process
+kronos_batcher&
+kronos_batcher :: get()
+{
+    static kronos_batcher *batcher = create();
+    return *batcher;
+}
+
+std::future<void>
+kronos_batcher :: submit(kronos_query_ptr query)
+{
+    assert(query->lhs.size() == query->rhs.size());
+    std::future<void> fut = query->done.get_future();
+
+    pending_mtx.lock();
+    pending.emplace_back(std::move(query));
+    pending_mtx.unlock();
+    pending_cond.signal();
+
+    return fut;
+}
+
+int
+kronos_batcher :: compare_cached(const vc::vclock_t &clk1, const vc::vclock_t &clk2)
+{
+    cache_mtx.lock();
+    int cmp = cache.compare(clk1, clk2);
+    cache_mtx.unlock();
+    return cmp;
+}
+
+void
+kronos_batcher :: get_cache_stats(kronos_cache_stats &stats)
+{
+    cache_mtx.lock();
+    cache.get_stats(stats);
+    cache_mtx.unlock();
+}
+
+// fill wp with clocks lhs and rhs, clock values are stored in vals
+static void
+fill_pair(weaver_pair &wp, uint64_t *vals, const vc::vclock &lhs, const vc::vclock &rhs, uint32_t flags)
+{
+    wp.lhs = vals;
+    wp.rhs = vals + ClkSz;
+    for (uint64_t k = 0; k < ClkSz; k++) {
+        wp.lhs[k] = lhs.clock[k];
+        wp.rhs[k] = rhs.clock[k];
+    }
+    wp.lhs_id = lhs.vt_id;
+    wp.rhs_id = rhs.vt_id;
+    wp.flags = flags;
+    wp.order = CHRONOS_HAPPENS_BEFORE;
+}
+
+// all pairs of all soft queries in one Kronos call
+void
+kronos_batcher :: run_soft(std::vector<kronos_query_ptr> &batch)
+{
+    uint64_t num_pairs = 0;
+    for (kronos_query_ptr &q: batch) {
+        num_pairs += q->lhs.size();
+    }
+    if (num_pairs == 0) {
+        return;
+    }
+
+    std::vector<weaver_pair> wpair(num_pairs);
+    std::vector<uint64_t> vals(num_pairs * 2 * ClkSz);
+    uint64_t p = 0;
+    for (kronos_query_ptr &q: batch) {
+        for (uint64_t i = 0; i < q->lhs.size(); i++, p++) {
+            fill_pair(wpair[p], &vals[p * 2 * ClkSz], q->lhs[i], q->rhs[i], CHRONOS_SOFT_FAIL);
+        }
+    }
+
+    chronos_returncode status;
+    ssize_t cret;
+    int64_t ret = kronos_cl->weaver_order(&wpair[0], num_pairs, &status, &cret);
+    ret = kronos_cl->wait(ret, 100000, &status);
+
+    p = 0;
+    cache_mtx.lock();
+    for (kronos_query_ptr &q: batch) {
+        q->order.resize(q->lhs.size());
+        for (uint64_t i = 0; i < q->lhs.size(); i++, p++) {
+            chronos_cmp order = wpair[p].order;
+            assert((order == CHRONOS_HAPPENS_BEFORE) || (order == CHRONOS_HAPPENS_AFTER));
+            q->order[i] = order;
+            if (order == CHRONOS_HAPPENS_BEFORE) {
+                cache.add(q->lhs[i].clock, q->rhs[i].clock);
+            } else {
+                cache.add(q->rhs[i].clock, q->lhs[i].clock);
+            }
+        }
+        q->success = true;
+    }
+    cache_mtx.unlock();
+}
+
+void
+kronos_batcher :: run_hard(kronos_query &query)
+{
+    uint64_t num_pairs = query.lhs.size();
+    std::vector<weaver_pair> wpair(num_pairs);
+    std::vector<uint64_t> vals(num_pairs * 2 * ClkSz);
+    for (uint64_t i = 0; i < num_pairs; i++) {
+        fill_pair(wpair[i], &vals[i * 2 * ClkSz], query.lhs[i], query.rhs[i], 0);
+    }
+
+    chronos_returncode status;
+    ssize_t cret;
+    int64_t ret = kronos_cl->weaver_order(&wpair[0], num_pairs, &status, &cret);
+    ret = kronos_cl->wait(ret, 100000, &status);
+
+    query.order.resize(num_pairs);
+    query.success = true;
+    for (uint64_t i = 0; i < num_pairs; i++) {
+        query.order[i] = wpair[i].order;
+        if (wpair[i].order != CHRONOS_HAPPENS_BEFORE) {
+            query.success = false;
+        }
+    }
+}
+
+// body of the batch thread, never returns
+void
+kronos_batcher :: batch_loop(kronos_batcher *batcher)
+{
+    std::vector<kronos_query_ptr> batch, soft;
+
+    while (true) {
+        batcher->pending_mtx.lock();
+        while (batcher->pending.empty()) {
+            batcher->pending_cond.wait();
+        }
+        batch.swap(batcher->pending);
+        batcher->pending_mtx.unlock();
+
+        soft.clear();
+        for (kronos_query_ptr &q: batch) {
+            if (q->soft) {
+                soft.emplace_back(q);
+            } else if (!q->lhs.empty()) {
+                batcher->run_hard(*q);
+            } else {
+                q->success = true;
+            }
+        }
+        batcher->run_soft(soft);
+
+        for (kronos_query_ptr &q: batch) {
+            if (q->callback) {
+                q->callback();
+            }
+            q->done.set_value();
+        }
+        batch.clear();
+    }
+}
+
+#undef weaver_debug_
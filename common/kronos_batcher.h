@@ -0,0 +1,83 @@
+/*
+ * ===============================================================
+ *    Description:  Batches Kronos ordering requests from all
+ *                  threads of a process into a single call per
+ *                  round trip.
+ *
+ *        Created:  2014-10-16 11:08:37
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#ifndef weaver_common_kronos_batcher_h_
+#define weaver_common_kronos_batcher_h_
+
+#include <memory>
+#include <vector>
+#include <future>
+#include <functional>
+#include <po6/threads/mutex.h>
+#include <po6/threads/cond.h>
+
+#include "common/vclock.h"
+#include "common/event_order.h"
+#include "chronos/chronos.h"
+
+namespace order
+{
+    // a group of clock pairs to be ordered by Kronos, pair i is (lhs[i], rhs[i])
+    // soft queries return existing order of each pair, or create one with lhs before rhs
+    // hard queries create lhs before rhs for all pairs, or fail as a whole
+    struct kronos_query
+    {
+        std::vector<vc::vclock> lhs, rhs;
+        bool soft;
+        std::vector<chronos_cmp> order; // filled in by batcher
+        bool success; // hard queries: true if all pairs were ordered lhs before rhs
+        std::function<void()> callback; // optional, called on batcher thread after order is filled in
+        std::promise<void> done;
+
+        kronos_query(bool s) : soft(s), success(false) { }
+    };
+
+    typedef std::shared_ptr<kronos_query> kronos_query_ptr;
+
+    // single batcher per process, use kronos_batcher::get()
+    // a dedicated thread takes all queries submitted while the previous Kronos call was in flight,
+    // and sends all soft pairs in one chronos_weaver_order call
+    // hard queries are all-or-nothing, so each goes in its own call in the same round
+    // results of soft queries are added to a cache shared by all oracles of the process
+    class kronos_batcher
+    {
+        private:
+            std::unique_ptr<chronos_client> kronos_cl;
+            po6::threads::mutex pending_mtx;
+            po6::threads::cond pending_cond;
+            std::vector<kronos_query_ptr> pending; // protected by pending_mtx
+            po6::threads::mutex cache_mtx;
+            kronos_cache cache; // protected by cache_mtx
+
+            kronos_batcher();
+            kronos_batcher(const kronos_batcher&);
+            kronos_batcher& operator=(const kronos_batcher&);
+
+            static kronos_batcher* create();
+            static void batch_loop(kronos_batcher *batcher);
+            void run_soft(std::vector<kronos_query_ptr> &batch);
+            void run_hard(kronos_query &query);
+
+        public:
+            static kronos_batcher& get();
+
+            std::future<void> submit(kronos_query_ptr query);
+            // return the index (0 or 1) of smaller clock if order known, -1 otherwise
+            int compare_cached(const vc::vclock_t &clk1, const vc::vclock_t &clk2);
+            void get_cache_stats(kronos_cache_stats &stats);
+    };
+}
+
+#endif
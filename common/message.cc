@@ -15,6 +15,8 @@
 #define weaver_debug_
 #include "common/weaver_constants.h"
 #include "common/message.h"
+#include "node_prog/bsp_program.h"
+#include "node_prog/bidir_reach_program.h"
 
 const char*
 message :: to_string(const msg_type &t)
@@ -44,8 +46,12 @@ message :: to_string(const msg_type &t)
             return "PERMANENTLY_DELETED_NODE";
         case NODE_PROG:
             return "NODE_PROG";
+        case NODE_PROG_BATCH:
+            return "NODE_PROG_BATCH";
         case NODE_PROG_RETURN:
             return "NODE_PROG_RETURN";
+        case NODE_PROG_CANCEL:
+            return "NODE_PROG_CANCEL";
         case NODE_PROG_FAIL:
             return "NODE_PROG_FAIL";
         case NODE_CONTEXT_FETCH:
@@ -56,6 +62,26 @@ message :: to_string(const msg_type &t)
             return "CACHE_UPDATE";
         case CACHE_UPDATE_ACK:
             return "CACHE_UPDATE_ACK";
+        case CLIENT_BSP_REQ:
+            return "CLIENT_BSP_REQ";
+        case BSP_STEP:
+            return "BSP_STEP";
+        case BSP_MSGS:
+            return "BSP_MSGS";
+        case BSP_STEP_DONE:
+            return "BSP_STEP_DONE";
+        case BSP_FINISH:
+            return "BSP_FINISH";
+        case BSP_RETURN:
+            return "BSP_RETURN";
+        case CLIENT_BIDIR_REACH_REQ:
+            return "CLIENT_BIDIR_REACH_REQ";
+        case BIDIR_REACH_STEP:
+            return "BIDIR_REACH_STEP";
+        case BIDIR_REACH_STEP_DONE:
+            return "BIDIR_REACH_STEP_DONE";
+        case BIDIR_REACH_RETURN:
+            return "BIDIR_REACH_RETURN";
         case MIGRATE_SEND_NODE:
             return "MIGRATE_SEND_NODE";
         case MIGRATED_NBR_UPDATE:
@@ -64,6 +90,10 @@ message :: to_string(const msg_type &t)
             return "MIGRATED_NBR_ACK";
         case MIGRATION_TOKEN:
             return "MIGRATION_TOKEN";
+        case NODE_LOC_UPDATE:
+            return "NODE_LOC_UPDATE";
+        case NODE_LOC_UPDATE_ACK:
+            return "NODE_LOC_UPDATE_ACK";
         case CLIENT_NODE_COUNT:
             return "CLIENT_NODE_COUNT";
         case NODE_COUNT_REPLY:
@@ -127,6 +157,30 @@ message :: size(const node_prog::Node_State_Base &t)
     return t.size();
 }
 
+uint64_t
+message :: size(const node_prog::bsp_params &t)
+{
+    return t.size();
+}
+
+uint64_t
+message :: size(const node_prog::bsp_msg &t)
+{
+    return t.size();
+}
+
+uint64_t
+message :: size(const node_prog::bsp_stats &t)
+{
+    return t.size();
+}
+
+uint64_t
+message :: size(const node_prog::bidir_reach_params &t)
+{
+    return t.size();
+}
+
 uint64_t
 message :: size(const node_prog::Cache_Value_Base &t)
 {
@@ -187,6 +241,14 @@ message :: size(const std::string &t)
     return t.size() + sizeof(uint32_t);
 }
 
+// same wire format as std::vector<uint64_t>
+uint64_t
+message :: size(const vc::vclock_t &t)
+{
+    return sizeof(uint32_t)
+        + t.size() * sizeof(uint64_t);
+}
+
 uint64_t
 message :: size(const vc::vclock &t)
 {
@@ -253,8 +315,14 @@ message :: size(const transaction::pending_tx &t)
         + size(t.qts)
         + size(t.shard_write);
     if (t.type == transaction::UPDATE) {
+        // nop is optional for write txs, piggybacked if shard is due a nop
+        bool has_nop = (t.nop != nullptr);
         sz = sz + size(t.writes)
-            + size(t.sender);
+            + size(t.sender)
+            + size(has_nop);
+        if (has_nop) {
+            sz += size(t.nop);
+        }
     } else {
         sz = sz + size(t.nop);
     }
@@ -282,6 +350,30 @@ message :: pack_buffer(e::buffer::packer &packer, const node_prog::Node_State_Ba
     t.pack(packer);
 }
 
+void
+message :: pack_buffer(e::buffer::packer &packer, const node_prog::bsp_params &t)
+{
+    t.pack(packer);
+}
+
+void
+message :: pack_buffer(e::buffer::packer &packer, const node_prog::bsp_msg &t)
+{
+    t.pack(packer);
+}
+
+void
+message :: pack_buffer(e::buffer::packer &packer, const node_prog::bsp_stats &t)
+{
+    t.pack(packer);
+}
+
+void
+message :: pack_buffer(e::buffer::packer &packer, const node_prog::bidir_reach_params &t)
+{
+    t.pack(packer);
+}
+
 void
 message :: pack_buffer(e::buffer::packer &packer, const node_prog::Cache_Value_Base *&t)
 {
@@ -402,6 +494,16 @@ message :: pack_buffer(e::buffer::packer &packer, const std::string &t)
     pack_string(packer, t, strlen);
 }
 
+void
+message :: pack_buffer(e::buffer::packer &packer, const vc::vclock_t &t)
+{
+    uint32_t num_elems = t.size();
+    pack_buffer(packer, num_elems);
+    for (uint64_t c: t) {
+        pack_buffer(packer, c);
+    }
+}
+
 void
 message :: pack_buffer(e::buffer::packer &packer, const vc::vclock &t)
 {
@@ -468,8 +570,13 @@ message :: pack_buffer(e::buffer::packer &packer, const transaction::pending_tx
     pack_buffer(packer, t.qts);
     pack_buffer(packer, t.shard_write);
     if (t.type == transaction::UPDATE) {
+        bool has_nop = (t.nop != nullptr);
         pack_buffer(packer, t.writes);
         pack_buffer(packer, t.sender);
+        pack_buffer(packer, has_nop);
+        if (has_nop) {
+            pack_buffer(packer, t.nop);
+        }
     } else {
         pack_buffer(packer, t.nop);
     }
@@ -506,6 +613,30 @@ message :: unpack_buffer(e::unpacker &unpacker, node_prog::Cache_Value_Base &t)
     t.unpack(unpacker);
 }
 
+void
+message :: unpack_buffer(e::unpacker &unpacker, node_prog::bsp_params &t)
+{
+    t.unpack(unpacker);
+}
+
+void
+message :: unpack_buffer(e::unpacker &unpacker, node_prog::bsp_msg &t)
+{
+    t.unpack(unpacker);
+}
+
+void
+message :: unpack_buffer(e::unpacker &unpacker, node_prog::bsp_stats &t)
+{
+    t.unpack(unpacker);
+}
+
+void
+message :: unpack_buffer(e::unpacker &unpacker, node_prog::bidir_reach_params &t)
+{
+    t.unpack(unpacker);
+}
+
 void
 message :: unpack_buffer(e::unpacker &unpacker, enum msg_type &t)
 {
@@ -620,6 +751,21 @@ message :: unpack_buffer(e::unpacker &unpacker, std::string &t)
     unpack_string(unpacker, t, strlen);
 }
 
+void
+message :: unpack_buffer(e::unpacker &unpacker, vc::vclock_t &t)
+{
+    assert(t.size() == 0);
+    uint32_t elements_left;
+    unpack_buffer(unpacker, elements_left);
+    assert(elements_left <= MAX_CLK_SZ);
+
+    t.resize(elements_left);
+
+    for (uint32_t i = 0; i < elements_left; i++) {
+        unpack_buffer(unpacker, t[i]);
+    }
+}
+
 void
 message :: unpack_buffer(e::unpacker &unpacker, vc::vclock &t)
 {
@@ -691,8 +837,13 @@ message :: unpack_buffer(e::unpacker &unpacker, transaction::pending_tx &t)
     unpack_buffer(unpacker, t.qts);
     unpack_buffer(unpacker, t.shard_write);
     if (t.type == transaction::UPDATE) {
+        bool has_nop;
         unpack_buffer(unpacker, t.writes);
         unpack_buffer(unpacker, t.sender);
+        unpack_buffer(unpacker, has_nop);
+        if (has_nop) {
+            unpack_buffer(unpacker, t.nop);
+        }
     } else {
         unpack_buffer(unpacker, t.nop);
     }
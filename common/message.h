@@ -40,13 +40,19 @@ namespace db
         class element;
         class node;
         class edge;
+        class edge_table;
     }
+    struct node_prog_states;
 }
 
 namespace node_prog
 {
     struct edge_cache_context;
     struct node_cache_context;
+    class bsp_params;
+    class bsp_msg;
+    class bsp_stats;
+    class bidir_reach_params;
 }
 
 namespace message
@@ -68,17 +74,33 @@ namespace message
         PERMANENTLY_DELETED_NODE,
         // node program messages
         NODE_PROG,
+        NODE_PROG_BATCH,
         NODE_PROG_RETURN,
+        NODE_PROG_CANCEL,
         NODE_PROG_FAIL,
         NODE_CONTEXT_FETCH,
         NODE_CONTEXT_REPLY,
         CACHE_UPDATE,
         CACHE_UPDATE_ACK,
+        // bulk synchronous analytics
+        CLIENT_BSP_REQ,
+        BSP_STEP,
+        BSP_MSGS,
+        BSP_STEP_DONE,
+        BSP_FINISH,
+        BSP_RETURN,
+        // bidirectional reachability
+        CLIENT_BIDIR_REACH_REQ,
+        BIDIR_REACH_STEP,
+        BIDIR_REACH_STEP_DONE,
+        BIDIR_REACH_RETURN,
         // migration messages
         MIGRATE_SEND_NODE,
         MIGRATED_NBR_UPDATE,
         MIGRATED_NBR_ACK,
         MIGRATION_TOKEN,
+        NODE_LOC_UPDATE,
+        NODE_LOC_UPDATE_ACK,
         CLIENT_NODE_COUNT,
         NODE_COUNT_REPLY,
         // ft messages
@@ -126,6 +148,10 @@ namespace message
     uint64_t size(const node_prog::Node_Parameters_Base &t);
     uint64_t size(const node_prog::Node_State_Base &t);
     uint64_t size(const node_prog::Cache_Value_Base &t);
+    uint64_t size(const node_prog::bsp_params &t);
+    uint64_t size(const node_prog::bsp_msg &t);
+    uint64_t size(const node_prog::bsp_stats &t);
+    uint64_t size(const node_prog::bidir_reach_params &t);
     uint64_t size(const bool&);
     uint64_t size(const char&);
     uint64_t size(const uint16_t&);
@@ -135,6 +161,7 @@ namespace message
     uint64_t size(const int&);
     uint64_t size(const double&);
     uint64_t size(const std::string &t);
+    uint64_t size(const vc::vclock_t &t);
     uint64_t size(const vc::vclock &t);
     uint64_t size(const node_prog::property &t);
     uint64_t size(const db::element::property &t);
@@ -157,11 +184,17 @@ namespace message
     uint64_t size(const db::element::element &t);
     uint64_t size(const db::element::edge &t);
     uint64_t size(const db::element::edge* const &t);
+    uint64_t size(const db::element::edge_table &t);
     uint64_t size(const db::element::node &t);
+    uint64_t size(const db::node_prog_states &t);
 
     void pack_buffer(e::buffer::packer &packer, const node_prog::Node_Parameters_Base &t);
     void pack_buffer(e::buffer::packer &packer, const node_prog::Node_State_Base &t);
     void pack_buffer(e::buffer::packer &packer, const node_prog::Cache_Value_Base *&t);
+    void pack_buffer(e::buffer::packer &packer, const node_prog::bsp_params &t);
+    void pack_buffer(e::buffer::packer &packer, const node_prog::bsp_msg &t);
+    void pack_buffer(e::buffer::packer &packer, const node_prog::bsp_stats &t);
+    void pack_buffer(e::buffer::packer &packer, const node_prog::bidir_reach_params &t);
     void pack_buffer(e::buffer::packer &packer, const enum msg_type &t);    
     void pack_buffer(e::buffer::packer &packer, const enum node_prog::prog_type &t);
     void pack_buffer(e::buffer::packer &packer, const enum transaction::update_type &t);
@@ -176,6 +209,7 @@ namespace message
     void pack_buffer(e::buffer::packer &packer, const double &t);
     void pack_string(e::buffer::packer &packer, const std::string &t, const uint32_t sz);
     void pack_buffer(e::buffer::packer &packer, const std::string &t);
+    void pack_buffer(e::buffer::packer &packer, const vc::vclock_t &t);
     void pack_buffer(e::buffer::packer &packer, const vc::vclock &t);
     void pack_buffer(e::buffer::packer &packer, const node_prog::property &t);
     void pack_buffer(e::buffer::packer &packer, const db::element::property &t);
@@ -198,11 +232,17 @@ namespace message
     void pack_buffer(e::buffer::packer &packer, const db::element::element &t);
     void pack_buffer(e::buffer::packer &packer, const db::element::edge &t);
     void pack_buffer(e::buffer::packer &packer, const db::element::edge* const &t);
+    void pack_buffer(e::buffer::packer &packer, const db::element::edge_table &t);
     void pack_buffer(e::buffer::packer &packer, const db::element::node &t);
+    void pack_buffer(e::buffer::packer &packer, const db::node_prog_states &t);
 
     void unpack_buffer(e::unpacker &unpacker, node_prog::Node_Parameters_Base &t);
     void unpack_buffer(e::unpacker &unpacker, node_prog::Node_State_Base &t);
     void unpack_buffer(e::unpacker &unpacker, node_prog::Cache_Value_Base &t);
+    void unpack_buffer(e::unpacker &unpacker, node_prog::bsp_params &t);
+    void unpack_buffer(e::unpacker &unpacker, node_prog::bsp_msg &t);
+    void unpack_buffer(e::unpacker &unpacker, node_prog::bsp_stats &t);
+    void unpack_buffer(e::unpacker &unpacker, node_prog::bidir_reach_params &t);
     void unpack_buffer(e::unpacker &unpacker, enum msg_type &t);
     void unpack_buffer(e::unpacker &unpacker, enum node_prog::prog_type &t);
     void unpack_buffer(e::unpacker &unpacker, enum transaction::update_type &t);
@@ -217,6 +257,7 @@ namespace message
     void unpack_buffer(e::unpacker &unpacker, double &t);
     void unpack_string(e::unpacker &unpacker, std::string &t, const uint32_t sz);
     void unpack_buffer(e::unpacker &unpacker, std::string &t);
+    void unpack_buffer(e::unpacker &unpacker, vc::vclock_t &t);
     void unpack_buffer(e::unpacker &unpacker, vc::vclock &t);
     void unpack_buffer(e::unpacker &unpacker, node_prog::property &t);
     void unpack_buffer(e::unpacker &unpacker, db::element::property &t);
@@ -239,7 +280,9 @@ namespace message
     void unpack_buffer(e::unpacker &unpacker, db::element::element &t);
     void unpack_buffer(e::unpacker &unpacker, db::element::edge &t);
     void unpack_buffer(e::unpacker &unpacker, db::element::edge *&t);
+    void unpack_buffer(e::unpacker &unpacker, db::element::edge_table &t);
     void unpack_buffer(e::unpacker &unpacker, db::element::node &t);
+    void unpack_buffer(e::unpacker &unpacker, db::node_prog_states &t);
 
     // size templates
 
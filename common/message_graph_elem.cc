@@ -15,6 +15,7 @@
 #include "common/vclock.h"
 #include "db/node.h"
 #include "db/edge.h"
+#include "db/prog_state_arena.h"
 #include "db/property.h"
 #include "node_prog/property.h"
 #include "node_prog/node_prog_type.h"
@@ -60,12 +61,24 @@ message :: size(const db::element::edge* const &t)
     return size(*t);
 }
 
+// same encoding as an unordered_map from edge handle to edge*
+uint64_t
+message :: size(const db::element::edge_table &t)
+{
+    uint64_t sz = sizeof(uint32_t);
+    for (const db::element::edge &e: t) {
+        sz += size(e.get_handle()) + size(e);
+    }
+    return sz;
+}
+
 uint64_t
 message :: size(const db::element::node &t)
 {
     uint64_t sz = 0;
     sz += size(t.base);
     sz += size(t.out_edges);
+    sz += size(t.last_upd_clk);
     sz += size(t.update_count);
 #ifdef WEAVER_CLDG
     sz += size(t.msg_count);
@@ -74,10 +87,15 @@ message :: size(const db::element::node &t)
     sz += size(t.msg_count);
 #endif
     sz += size(t.already_migr);
-    sz += size(t.prog_states);;
     return sz;
 }
 
+uint64_t
+message :: size(const db::node_prog_states &t)
+{
+    return size(t.states);
+}
+
 // packing methods
 void message :: pack_buffer(e::buffer::packer &packer, const db::element::element &t)
 {
@@ -104,11 +122,24 @@ void message :: pack_buffer(e::buffer::packer &packer, const db::element::edge*
     pack_buffer(packer, *t);
 }
 
+void
+message :: pack_buffer(e::buffer::packer &packer, const db::element::edge_table &t)
+{
+    assert(t.size() <= UINT32_MAX);
+    uint32_t num_edges = t.size();
+    pack_buffer(packer, num_edges);
+    for (const db::element::edge &e: t) {
+        pack_buffer(packer, e.get_handle());
+        pack_buffer(packer, e);
+    }
+}
+
 void
 message :: pack_buffer(e::buffer::packer &packer, const db::element::node &t)
 {
     pack_buffer(packer, t.base);
     pack_buffer(packer, t.out_edges);
+    pack_buffer(packer, t.last_upd_clk);
     pack_buffer(packer, t.update_count);
 #ifdef WEAVER_CLDG
     pack_buffer(packer, t.msg_count);
@@ -117,7 +148,12 @@ message :: pack_buffer(e::buffer::packer &packer, const db::element::node &t)
     pack_buffer(packer, t.msg_count);
 #endif
     pack_buffer(packer, t.already_migr);
-    pack_buffer(packer, t.prog_states);
+}
+
+void
+message :: pack_buffer(e::buffer::packer &packer, const db::node_prog_states &t)
+{
+    pack_buffer(packer, t.states);
 }
 
 // unpacking methods
@@ -163,6 +199,24 @@ message :: unpack_buffer(e::unpacker &unpacker, db::element::edge *&t)
     unpack_buffer(unpacker, *t);
 }
 
+void
+message :: unpack_buffer(e::unpacker &unpacker, db::element::edge_table &t)
+{
+    assert(t.empty());
+    uint32_t elements_left;
+    unpack_buffer(unpacker, elements_left);
+
+    t.reserve(elements_left);
+    edge_handle_t handle;
+    while (elements_left > 0) {
+        db::element::edge e;
+        unpack_buffer(unpacker, handle);
+        unpack_buffer(unpacker, e);
+        t.add(std::move(e));
+        elements_left--;
+    }
+}
+
 template <typename T>
 std::shared_ptr<node_prog::Node_State_Base>
 unpack_single_node_state(e::unpacker &unpacker)
@@ -177,6 +231,7 @@ message :: unpack_buffer(e::unpacker &unpacker, db::element::node &t)
 {
     unpack_buffer(unpacker, t.base);
     unpack_buffer(unpacker, t.out_edges);
+    unpack_buffer(unpacker, t.last_upd_clk);
     unpack_buffer(unpacker, t.update_count);
 #ifdef WEAVER_CLDG
     unpack_buffer(unpacker, t.msg_count);
@@ -185,11 +240,14 @@ message :: unpack_buffer(e::unpacker &unpacker, db::element::node &t)
     unpack_buffer(unpacker, t.msg_count);
 #endif
     unpack_buffer(unpacker, t.already_migr);
+}
 
-    // unpack node prog state
+void
+message :: unpack_buffer(e::unpacker &unpacker, db::node_prog_states &t)
+{
     // need to unroll because we have to first unpack into particular state type, and then upcast and save as base type
     uint32_t num_prog_types = node_prog::END;
-    assert(t.prog_states.size() == num_prog_types);
+    assert(t.states.size() == num_prog_types);
 
     uint32_t num_unpacked_maps;
     unpack_buffer(unpacker, num_unpacked_maps);
@@ -198,7 +256,7 @@ message :: unpack_buffer(e::unpacker &unpacker, db::element::node &t)
     uint64_t key;
     std::shared_ptr<node_prog::Node_State_Base> val;
     for (int i = 0; i < node_prog::END; i++) {
-        db::element::node::id_to_state_t &state_map = t.prog_states[i];
+        db::id_to_state_t &state_map = t.states[i];
         assert(state_map.size() == 0);
 
         uint32_t elements_left;
@@ -18,7 +18,7 @@ using vc::vclock;
 
 vclock :: vclock(uint64_t vtid, uint64_t clk_init)
     : vt_id(vtid)
-    , clock(std::vector<uint64_t>(ClkSz, clk_init))
+    , clock(ClkSz, clk_init)
 {
     assert(vt_id < NumVts || vt_id == UINT64_MAX);
 }
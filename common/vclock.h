@@ -16,17 +16,71 @@
 #ifndef weaver_common_vclock_h_
 #define weaver_common_vclock_h_
 
+#include <stdint.h>
 #include <vector>
 #include <algorithm>
+#include <functional>
 #include <assert.h>
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
 
 #include "common/utils.h"
 
+#define MAX_CLK_SZ 8 // max ClkSz, so at most MAX_CLK_SZ-1 vector timestampers, multiple of 4 for simd compare
+
 namespace vc
 {
-    typedef std::vector<uint64_t> vclock_t;
+    // vector of ClkSz counters stored inline, no heap allocation
+    // supports the subset of std::vector used for clocks, and packs to the same wire format
+    // entries past size() are always zero, so comparisons run over the whole fixed width array
+    class vclock_t
+    {
+        private:
+            uint64_t sz;
+            uint64_t entries[MAX_CLK_SZ];
+
+        public:
+            typedef uint64_t* iterator;
+            typedef const uint64_t* const_iterator;
+
+            vclock_t();
+            vclock_t(uint64_t num_entries, uint64_t init);
+
+            uint64_t size() const { return sz; }
+            bool empty() const { return sz == 0; }
+            uint64_t& operator[](uint64_t idx) { return entries[idx]; }
+            const uint64_t& operator[](uint64_t idx) const { return entries[idx]; }
+            uint64_t& at(uint64_t idx) { assert(idx < sz); return entries[idx]; }
+            const uint64_t& at(uint64_t idx) const { assert(idx < sz); return entries[idx]; }
+            iterator begin() { return entries; }
+            iterator end() { return entries + sz; }
+            const_iterator begin() const { return entries; }
+            const_iterator end() const { return entries + sz; }
+            uint64_t* data() { return entries; }
+            const uint64_t* data() const { return entries; }
+            void push_back(uint64_t val);
+            void resize(uint64_t num_entries);
+            void clear() { resize(0); }
+
+            bool operator==(const vclock_t &rhs) const;
+            bool operator!=(const vclock_t &rhs) const { return !(*this == rhs); }
+    };
+
     typedef std::vector<uint64_t> qtimestamp_t;
-    
+
+    enum clock_diff_bits
+    {
+        CLK_LT = 1, // some entry of the first clock is smaller
+        CLK_GT = 2 // some entry of the first clock is larger
+    };
+
+    inline int clock_diff(const vclock_t &clk1, const vclock_t &clk2);
+    inline int compare_clocks(const vclock_t &clk1, const vclock_t &clk2);
+    inline bool happens_before(const vclock_t &clk1, const vclock_t &clk2);
+    inline bool concurrent(const vclock_t &clk1, const vclock_t &clk2);
+
+
     class vclock
     {
         public:
@@ -45,6 +99,147 @@ namespace vc
             bool operator==(const vclock &rhs) const;
             bool operator!=(const vclock &rhs) const;
     };
+
+    inline
+    vclock_t :: vclock_t()
+        : sz(0)
+    {
+        std::fill(entries, entries + MAX_CLK_SZ, 0);
+    }
+
+    inline
+    vclock_t :: vclock_t(uint64_t num_entries, uint64_t init)
+        : sz(num_entries)
+    {
+        assert(sz <= MAX_CLK_SZ);
+        std::fill(entries, entries + sz, init);
+        std::fill(entries + sz, entries + MAX_CLK_SZ, 0);
+    }
+
+    inline void
+    vclock_t :: push_back(uint64_t val)
+    {
+        assert(sz < MAX_CLK_SZ);
+        entries[sz++] = val;
+    }
+
+    inline void
+    vclock_t :: resize(uint64_t num_entries)
+    {
+        assert(num_entries <= MAX_CLK_SZ);
+        if (num_entries < sz) {
+            std::fill(entries + num_entries, entries + sz, 0);
+        }
+        sz = num_entries;
+    }
+
+    inline bool
+    vclock_t :: operator==(const vclock_t &rhs) const
+    {
+        return sz == rhs.sz && clock_diff(*this, rhs) == 0;
+    }
+
+    // compare all entries at once, returns CLK_LT and CLK_GT bits
+    // entries are unsigned, simd compares are signed, so flip the sign bit first
+    // the kernel is picked by the target flags of the build, e.g. CXXFLAGS=-march=native
+    inline int
+    clock_diff(const vclock_t &clk1, const vclock_t &clk2)
+    {
+        static_assert(MAX_CLK_SZ % 4 == 0, "clock width must be a multiple of 4 for simd compare");
+        const uint64_t *c1 = clk1.data();
+        const uint64_t *c2 = clk2.data();
+#if defined(__AVX2__)
+        const __m256i sign = _mm256_set1_epi64x((long long)0x8000000000000000ULL);
+        __m256i lt = _mm256_setzero_si256();
+        __m256i gt = _mm256_setzero_si256();
+        for (uint64_t i = 0; i < MAX_CLK_SZ; i += 4) {
+            __m256i a = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(c1 + i)), sign);
+            __m256i b = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(c2 + i)), sign);
+            lt = _mm256_or_si256(lt, _mm256_cmpgt_epi64(b, a));
+            gt = _mm256_or_si256(gt, _mm256_cmpgt_epi64(a, b));
+        }
+        return (_mm256_testz_si256(lt, lt)? 0 : CLK_LT) | (_mm256_testz_si256(gt, gt)? 0 : CLK_GT);
+#elif defined(__SSE4_2__)
+        const __m128i sign = _mm_set1_epi64x((long long)0x8000000000000000ULL);
+        __m128i lt = _mm_setzero_si128();
+        __m128i gt = _mm_setzero_si128();
+        for (uint64_t i = 0; i < MAX_CLK_SZ; i += 2) {
+            __m128i a = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(c1 + i)), sign);
+            __m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(c2 + i)), sign);
+            lt = _mm_or_si128(lt, _mm_cmpgt_epi64(b, a));
+            gt = _mm_or_si128(gt, _mm_cmpgt_epi64(a, b));
+        }
+        return (_mm_testz_si128(lt, lt)? 0 : CLK_LT) | (_mm_testz_si128(gt, gt)? 0 : CLK_GT);
+#else
+        int diff = 0;
+        for (uint64_t i = 0; i < MAX_CLK_SZ; i++) {
+            if (c1[i] < c2[i]) {
+                diff |= CLK_LT;
+            } else if (c1[i] > c2[i]) {
+                diff |= CLK_GT;
+            }
+        }
+        return diff;
+#endif
+    }
+
+    // return the smaller of the two clocks
+    // return -1 if clocks cannot be compared
+    // return 2 if clocks are identical
+    inline int
+    compare_clocks(const vclock_t &clk1, const vclock_t &clk2)
+    {
+        // check epoch number
+        if (clk1[0] < clk2[0]) {
+            return 0;
+        } else if (clk1[0] > clk2[0]) {
+            return 1;
+        }
+
+        // same epoch number, compare each entry in vector
+        switch (clock_diff(clk1, clk2)) {
+            case 0:
+                return 2;
+            case CLK_LT:
+                return 0;
+            case CLK_GT:
+                return 1;
+            default:
+                return -1;
+        }
+    }
+
+    inline bool
+    happens_before(const vclock_t &clk1, const vclock_t &clk2)
+    {
+        return compare_clocks(clk1, clk2) == 0;
+    }
+
+    inline bool
+    concurrent(const vclock_t &clk1, const vclock_t &clk2)
+    {
+        return compare_clocks(clk1, clk2) == -1;
+    }
+}
+
+namespace std
+{
+    template <>
+    struct hash<vc::vclock_t>
+    {
+        public:
+            size_t operator()(const vc::vclock_t &v) const throw()
+            {
+                if (v.empty()) {
+                    return hash<uint64_t>()(0);
+                }
+                size_t val = hash<uint64_t>()(v[0]);
+                for (size_t i = 1; i < v.size(); i++) {
+                    val ^= hash<uint64_t>()(v[i]) + 0x9e3779b9 + (val<<6) + (val>>2);
+                }
+                return val;
+            }
+    };
 }
 
 #endif
@@ -37,4 +37,9 @@
 #define GIGA (1000000000ULL)
 #define MEGA (1000000UL)
 
+// Kronos decision cache, see common/event_order.h
+#define KRONOS_CACHE_CLOCKS 4096 // clocks per cache
+#define KRONOS_CACHE_SUCCESSORS 8 // orders kept per clock
+#define KRONOS_STATS_INTERVAL 1024 // cache lookups between publishing an oracle's counters to the process totals
+
 #endif
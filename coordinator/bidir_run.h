@@ -0,0 +1,40 @@
+/*
+ * ===============================================================
+ *    Description:  Bidirectional reachability request coordinated
+ *                  by a timestamper, see
+ *                  node_prog/bidir_reach_program.h.
+ *
+ *        Created:  2014-10-16 22:31:06
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#ifndef weaver_coordinator_bidir_run_h_
+#define weaver_coordinator_bidir_run_h_
+
+#include <memory>
+
+#include "common/vclock.h"
+#include "node_prog/bidir_reach_program.h"
+#include "coordinator/current_prog.h"
+
+namespace coordinator
+{
+    struct bidir_run
+    {
+        uint64_t client;
+        current_prog *cp;
+        node_prog::bidir_reach_params params;
+        vc::vclock vclk;
+        uint64_t shards_left; // shards yet to reply for current level
+        node_prog::bidir_reach_search search;
+
+        bidir_run() : client(UINT64_MAX), cp(NULL), shards_left(0) { }
+    };
+}
+
+#endif
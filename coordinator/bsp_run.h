@@ -0,0 +1,47 @@
+/*
+ * ===============================================================
+ *    Description:  Bulk synchronous analytics job coordinated by
+ *                  a timestamper, see node_prog/bsp_program.h.
+ *
+ *        Created:  2014-10-16 21:03:17
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#ifndef weaver_coordinator_bsp_run_h_
+#define weaver_coordinator_bsp_run_h_
+
+#include <memory>
+#include <vector>
+
+#include "common/types.h"
+#include "common/vclock.h"
+#include "node_prog/bsp_program.h"
+#include "coordinator/current_prog.h"
+
+namespace coordinator
+{
+    // the timestamper is the master of the job: it starts each superstep at all shards,
+    // collects per shard stats, and decides when the job has converged
+    struct bsp_run
+    {
+        uint64_t client;
+        current_prog *cp;
+        node_prog::bsp_params params;
+        vc::vclock vclk;
+        uint64_t step;
+        uint64_t shards_left; // shards yet to reply for current superstep, or with results
+        node_prog::bsp_stats totals; // of current superstep, over shards that have replied
+        uint64_t num_vertices; // counted in superstep 0
+        std::vector<std::pair<node_handle_t, double>> ranks;
+        std::vector<std::pair<node_handle_t, uint64_t>> labels;
+
+        bsp_run() : client(UINT64_MAX), cp(NULL), step(0), shards_left(0), num_vertices(0) { }
+    };
+}
+
+#endif
@@ -23,29 +23,41 @@ using coordinator::hyper_stub;
 
 hyper_stub :: hyper_stub()
     : vt_id(UINT64_MAX)
+    , node_locs(NULL)
 { }
 
 void
-hyper_stub :: init(uint64_t vtid)
+hyper_stub :: init(uint64_t vtid, loc_cache *locs)
 {
     vt_id = vtid;
+    node_locs = locs;
 }
 
+// cached locations, only cache misses are read from Hyperdex
+// stale location of a migrated node is fine, old shard forwards node progs to the new location
 std::unordered_map<node_handle_t, uint64_t>
 hyper_stub :: get_mappings(std::unordered_set<node_handle_t> &get_set)
 {
     std::unordered_map<node_handle_t, uint64_t> ret;
+    std::unordered_set<node_handle_t> missing;
+    uint64_t loc_version = node_locs->lookup(get_set, ret, missing);
 
-    if (get_set.size() == 1) {
-        node_handle_t h = *get_set.begin();
+    std::unordered_map<node_handle_t, uint64_t> read_map;
+    if (missing.size() == 1) {
+        node_handle_t h = *missing.begin();
         uint64_t loc = get_nmap(h);
         if (loc != UINT64_MAX) {
-            ret.emplace(h, loc);
-        } else {
-            ret.clear();
+            read_map.emplace(h, loc);
         }
-    } else if (!get_set.empty()) {
-        ret = get_nmap(get_set, false);
+    } else if (!missing.empty()) {
+        read_map = get_nmap(missing, false);
+    }
+
+    if (read_map.size() != missing.size()) {
+        ret.clear();
+    } else if (!read_map.empty()) {
+        node_locs->insert(read_map, loc_version);
+        ret.insert(read_map.begin(), read_map.end());
     }
 
     return ret;
@@ -55,20 +67,18 @@ void
 hyper_stub :: clean_up(std::unordered_map<node_handle_t, db::element::node*> &nodes)
 {
     for (auto &p: nodes) {
-        for (auto &e: p.second->out_edges) {
-            delete e.second;
-        }
         p.second->out_edges.clear();
         delete p.second;
     }
     nodes.clear();
 }
 
+// write a group of txs which touch disjoint sets of nodes in a single Hyperdex transaction
+// ready = false if the transaction aborted or node clocks could not be ordered before tx timestamps,
+// caller retries with higher timestamps
+// error = true if some warp operation failed, for a group of more than one tx the failed tx is not known
 void
-hyper_stub :: do_tx(std::unordered_set<node_handle_t> &get_set,
-    std::unordered_set<node_handle_t> &del_set,
-    std::unordered_map<node_handle_t, uint64_t> &put_map,
-    std::shared_ptr<transaction::pending_tx> tx,
+hyper_stub :: do_tx(tx_group_t &group,
     bool &ready,
     bool &error,
     order::oracle *time_oracle)
@@ -83,11 +93,33 @@ hyper_stub :: do_tx(std::unordered_set<node_handle_t> &get_set,
     error = false;
 
     std::unordered_map<node_handle_t, db::element::node*> nodes;
+    std::unordered_set<node_handle_t> get_set, del_set;
+    std::unordered_map<node_handle_t, uint64_t> put_map;
+    for (std::shared_ptr<group_tx> g: group) {
+        get_set.insert(g->get_set.begin(), g->get_set.end());
+        del_set.insert(g->del_set.begin(), g->del_set.end());
+        put_map.insert(g->put_map.begin(), g->put_map.end());
+    }
+
     begin_tx();
 
-    std::unordered_map<node_handle_t, uint64_t> get_map = get_nmap(get_set, true);
-    if (get_map.size() != get_set.size()) {
-        ERROR_FAIL;
+    // node locations from cache, only cache misses are read from Hyperdex
+    // shard notifies VT on node migration and waits for ack before moving the node,
+    // txs with a stale location are ordered before the move, see migrate_node_step1
+    // existence and creation of cached nodes are checked against get_node below
+    std::unordered_map<node_handle_t, uint64_t> get_map;
+    std::unordered_map<node_handle_t, cached_loc> cached;
+    std::unordered_set<node_handle_t> missing;
+    uint64_t loc_version = node_locs->lookup(get_set, cached, missing);
+    for (const auto &p: cached) {
+        get_map.emplace(p.first, p.second.loc);
+    }
+    if (!missing.empty()) {
+        std::unordered_map<node_handle_t, uint64_t> read_map = get_nmap(missing, true);
+        if (read_map.size() != missing.size()) {
+            ERROR_FAIL;
+        }
+        get_map.insert(read_map.begin(), read_map.end());
     }
 
     if (!put_nmap_if_not_exist(put_map)) {
@@ -103,34 +135,73 @@ hyper_stub :: do_tx(std::unordered_set<node_handle_t> &get_set,
         if (put_map.find(h) != put_map.end()) {
             ERROR_FAIL;
         }
-        nodes[h] = new db::element::node(h, dummy_clk, &dummy_mtx);
+        nodes[h] = new db::element::node(h, dummy_clk);
         if (!get_node(*nodes[h])) {
             ERROR_FAIL;
         }
     }
     for (const node_handle_t &h: del_set) {
-        nodes[h] = new db::element::node(h, dummy_clk, &dummy_mtx);
+        nodes[h] = new db::element::node(h, dummy_clk);
         if (!get_node(*nodes[h])) {
             ERROR_FAIL;
         }
     }
 
-    // last upd clk check
-    std::vector<vc::vclock> before;
+    // a cached location belongs to an earlier node with the same handle if that node was deleted
+    // and re-created through another VT, re-read these locations in this transaction
+    std::unordered_set<node_handle_t> stale;
+    for (const auto &p: cached) {
+        if (!p.second.same_node(nodes[p.first]->base.get_creat_time())) {
+            stale.emplace(p.first);
+        }
+    }
+    if (!stale.empty()) {
+        std::unordered_map<node_handle_t, uint64_t> read_map = get_nmap(stale, true);
+        if (read_map.size() != stale.size()) {
+            ERROR_FAIL;
+        }
+        for (const auto &p: read_map) {
+            get_map[p.first] = p.second;
+        }
+        missing.insert(stale.begin(), stale.end());
+    }
+    if (!missing.empty()) {
+        std::unordered_map<node_handle_t, cached_loc> read_locs;
+        for (const node_handle_t &h: missing) {
+            read_locs.emplace(h, cached_loc(get_map[h], nodes[h]->base.get_creat_time()));
+        }
+        node_locs->insert(read_locs, loc_version);
+    }
+
+    // last upd clk check, for each tx in a single Kronos call
+    std::vector<vc::vclock> before, after;
     before.reserve(nodes.size());
-    for (const auto &p: nodes) {
-        before.emplace_back(p.second->last_upd_clk);
+    after.reserve(nodes.size());
+    for (std::shared_ptr<group_tx> g: group) {
+        for (const node_handle_t &h: g->get_set) {
+            before.emplace_back(nodes[h]->last_upd_clk);
+            after.emplace_back(g->tx->timestamp);
+        }
+        for (const node_handle_t &h: g->del_set) {
+            if (g->get_set.find(h) == g->get_set.end()) {
+                before.emplace_back(nodes[h]->last_upd_clk);
+                after.emplace_back(g->tx->timestamp);
+            }
+        }
     }
-    if (!time_oracle->assign_vt_order(before, tx->timestamp)) {
+    if (!time_oracle->assign_vt_order(before, after)) {
         // will retry with higher timestamp
         abort_tx();
+        clean_up(nodes);
         return;
     }
 
-    for (const auto &p: put_map) {
-        nodes[p.first] = new db::element::node(p.first, tx->timestamp, &dummy_mtx);
-        nodes[p.first]->last_upd_clk = tx->timestamp;
-        nodes[p.first]->restore_clk = tx->timestamp.clock;
+    for (std::shared_ptr<group_tx> g: group) {
+        for (const auto &p: g->put_map) {
+            nodes[p.first] = new db::element::node(p.first, g->tx->timestamp);
+            nodes[p.first]->last_upd_clk = g->tx->timestamp;
+            nodes[p.first]->restore_clk = g->tx->timestamp.clock;
+        }
     }
 
 #define CHECK_LOC(loc, handle) \
@@ -152,95 +223,130 @@ hyper_stub :: do_tx(std::unordered_set<node_handle_t> &get_set,
 
     auto node_iter = nodes.end();
     db::element::node *n = nullptr;
+    db::element::edge *e = nullptr;
     auto loc_iter = get_map.end();
-
-    for (std::shared_ptr<transaction::pending_update> upd: tx->writes) {
-        switch (upd->type) {
-            case transaction::NODE_CREATE_REQ:
-                break;
-
-            case transaction::EDGE_CREATE_REQ:
-                CHECK_LOC(upd->loc1, upd->handle1);
-                CHECK_LOC(upd->loc2, upd->handle2);
-                GET_NODE(upd->handle1);
-                if (n->out_edges.find(upd->handle) != n->out_edges.end()) {
-                    ERROR_FAIL;
-                }
-                n->add_edge(new db::element::edge(upd->handle, tx->timestamp, upd->loc2, upd->handle2));
-                break;
-
-            case transaction::NODE_DELETE_REQ:
-                CHECK_LOC(upd->loc1, upd->handle1);
-                break;
-
-            case transaction::NODE_SET_PROPERTY:
-                CHECK_LOC(upd->loc1, upd->handle1);
-                GET_NODE(upd->handle1);
-                n->base.properties[*upd->key] = db::element::property(*upd->key, *upd->value, tx->timestamp);
-                break;
-
-            case transaction::EDGE_DELETE_REQ:
-                CHECK_LOC(upd->loc1, upd->handle2);
-                GET_NODE(upd->handle2);
-                if (n->out_edges.find(upd->handle1) == n->out_edges.end()) {
-                    ERROR_FAIL;
-                }
-                n->out_edges.erase(upd->handle1);
-                break;
-
-            case transaction::EDGE_SET_PROPERTY:
-                CHECK_LOC(upd->loc1, upd->handle2);
-                GET_NODE(upd->handle2);
-                if (n->out_edges.find(upd->handle1) == n->out_edges.end()) {
-                    ERROR_FAIL;
-                }
-                n->out_edges[upd->handle1]->base.properties[*upd->key] = db::element::property(*upd->key, *upd->value, tx->timestamp);
-                break;
-
-            default:
-                WDEBUG << "bad upd type" << std::endl;
-        }
-        uint64_t idx = upd->loc1-ShardIdIncr;
-        if (tx->shard_write.size() < idx+1) {
-            tx->shard_write.resize(idx+1, false);
-        }
-        tx->shard_write[idx] = true;
-
-        if (n != nullptr) {
-            assert(n->restore_clk.size() == ClkSz);
-            n->restore_clk[vt_id+1] = tx->timestamp.get_clock();
+    // per-node changes, so that existing nodes are not rewritten in full
+    std::unordered_map<node_handle_t, node_delta> deltas;
+
+    for (std::shared_ptr<group_tx> g: group) {
+        std::shared_ptr<transaction::pending_tx> tx = g->tx;
+
+        for (std::shared_ptr<transaction::pending_update> upd: tx->writes) {
+            switch (upd->type) {
+                case transaction::NODE_CREATE_REQ:
+                    break;
+
+                case transaction::EDGE_CREATE_REQ:
+                    CHECK_LOC(upd->loc1, upd->handle1);
+                    CHECK_LOC(upd->loc2, upd->handle2);
+                    GET_NODE(upd->handle1);
+                    if (n->out_edges.emplace(upd->handle, tx->timestamp, upd->loc2, upd->handle2) == NULL) {
+                        ERROR_FAIL;
+                    }
+                    deltas[upd->handle1].out_edges.emplace(upd->handle);
+                    break;
+
+                case transaction::NODE_DELETE_REQ:
+                    CHECK_LOC(upd->loc1, upd->handle1);
+                    break;
+
+                case transaction::NODE_SET_PROPERTY:
+                    CHECK_LOC(upd->loc1, upd->handle1);
+                    GET_NODE(upd->handle1);
+                    n->base.properties[*upd->key] = db::element::property(*upd->key, *upd->value, tx->timestamp);
+                    deltas[upd->handle1].props.emplace(*upd->key);
+                    break;
+
+                case transaction::EDGE_DELETE_REQ:
+                    CHECK_LOC(upd->loc1, upd->handle2);
+                    GET_NODE(upd->handle2);
+                    if (!n->out_edges.erase(upd->handle1)) {
+                        ERROR_FAIL;
+                    }
+                    deltas[upd->handle2].out_edges.emplace(upd->handle1);
+                    break;
+
+                case transaction::EDGE_SET_PROPERTY:
+                    CHECK_LOC(upd->loc1, upd->handle2);
+                    GET_NODE(upd->handle2);
+                    e = n->out_edges.find(upd->handle1);
+                    if (e == NULL) {
+                        ERROR_FAIL;
+                    }
+                    e->base.properties[*upd->key] = db::element::property(*upd->key, *upd->value, tx->timestamp);
+                    deltas[upd->handle2].out_edges.emplace(upd->handle1);
+                    break;
+
+                default:
+                    WDEBUG << "bad upd type" << std::endl;
+            }
+            uint64_t idx = upd->loc1-ShardIdIncr;
+            if (tx->shard_write.size() < idx+1) {
+                tx->shard_write.resize(idx+1, false);
+            }
+            tx->shard_write[idx] = true;
+
+            if (n != nullptr) {
+                assert(n->restore_clk.size() == ClkSz);
+                n->restore_clk[vt_id+1] = tx->timestamp.get_clock();
+            }
+
+            n = nullptr;
         }
-
-        n = nullptr;
     }
 
 #undef CHECK_LOC
 #undef GET_NODE
 
-    put_nodes(nodes);
+    // new nodes are written in full, existing nodes only get the deltas
+    std::unordered_map<node_handle_t, db::element::node*> new_nodes;
+    for (const auto &p: put_map) {
+        new_nodes[p.first] = nodes[p.first];
+        deltas.erase(p.first);
+    }
+    for (const node_handle_t &h: del_set) {
+        deltas.erase(h);
+    }
+
+    if (!new_nodes.empty() && !put_nodes(new_nodes)) {
+        ERROR_FAIL;
+    }
+    if (!deltas.empty() && !put_node_deltas(nodes, deltas)) {
+        ERROR_FAIL;
+    }
 
     for (const node_handle_t &h: del_set) {
         del_node(h);
     }
 
-    hyperdex_client_attribute attr[NUM_TX_ATTRS];
-    attr[0].attr = tx_attrs[0];
-    attr[0].value = (const char*)&vt_id;
-    attr[0].value_sz = sizeof(int64_t);
-    attr[0].datatype = tx_dtypes[0];
+    for (std::shared_ptr<group_tx> g: group) {
+        std::shared_ptr<transaction::pending_tx> tx = g->tx;
 
-    uint64_t buf_sz = message::size(*tx);
-    std::unique_ptr<e::buffer> buf(e::buffer::create(buf_sz));
-    e::buffer::packer packer = buf->pack_at(0);
-    message::pack_buffer(packer, *tx);
+        hyperdex_client_attribute attr[NUM_TX_ATTRS];
+        attr[0].attr = tx_attrs[0];
+        attr[0].value = (const char*)&vt_id;
+        attr[0].value_sz = sizeof(int64_t);
+        attr[0].datatype = tx_dtypes[0];
 
-    attr[1].attr = tx_attrs[1];
-    attr[1].value = (const char*)buf->data();
-    attr[1].value_sz = buf->size();
-    attr[1].datatype = tx_dtypes[1];
+        uint64_t buf_sz = message::size(*tx);
+        std::unique_ptr<e::buffer> buf(e::buffer::create(buf_sz));
+        e::buffer::packer packer = buf->pack_at(0);
+        message::pack_buffer(packer, *tx);
 
-    if (!call(&hyperdex_client_xact_put, tx_space, (const char*)&tx->id, sizeof(int64_t), attr, NUM_TX_ATTRS)) {
-        ERROR_FAIL;
+        attr[1].attr = tx_attrs[1];
+        attr[1].value = (const char*)buf->data();
+        attr[1].value_sz = buf->size();
+        attr[1].datatype = tx_dtypes[1];
+
+        if (!call(&hyperdex_client_xact_put, tx_space, (const char*)&tx->id, sizeof(int64_t), attr, NUM_TX_ATTRS)) {
+            ERROR_FAIL;
+        }
+    }
+
+    // new nodes are cached with their creation tx
+    std::unordered_map<node_handle_t, cached_loc> created_locs;
+    for (const auto &p: put_map) {
+        created_locs.emplace(p.first, cached_loc(p.second, nodes[p.first]->base.get_creat_time()));
     }
 
     hyperdex_client_returncode commit_status = HYPERDEX_CLIENT_GARBAGE;
@@ -250,6 +356,8 @@ hyper_stub :: do_tx(std::unordered_set<node_handle_t> &get_set,
         case HYPERDEX_CLIENT_SUCCESS:
             ready = true;
             assert(!error);
+            node_locs->insert(created_locs, loc_version);
+            node_locs->remove(del_set);
             break;
 
         case HYPERDEX_CLIENT_ABORTED:
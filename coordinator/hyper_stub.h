@@ -16,24 +16,33 @@
 
 #include "common/event_order.h"
 #include "common/hyper_stub_base.h"
+#include "coordinator/loc_cache.h"
 
 namespace coordinator
 {
+    // client tx along with node mappings it gets, puts, and deletes
+    // txs in a group commit touch disjoint sets of nodes
+    struct group_tx
+    {
+        std::shared_ptr<transaction::pending_tx> tx;
+        std::unordered_set<node_handle_t> get_set, del_set;
+        std::unordered_map<node_handle_t, uint64_t> put_map;
+    };
+
+    using tx_group_t = std::vector<std::shared_ptr<group_tx>>;
+
     class hyper_stub : private hyper_stub_base
     {
         private:
             uint64_t vt_id;
-            po6::threads::mutex dummy_mtx;
             vc::vclock dummy_clk;
+            loc_cache *node_locs; // shared by all hyper stubs of the VT
 
         public:
             hyper_stub();
-            void init(uint64_t vt_id);
+            void init(uint64_t vt_id, loc_cache *locs);
             std::unordered_map<node_handle_t, uint64_t> get_mappings(std::unordered_set<node_handle_t> &get_set);
-            void do_tx(std::unordered_set<node_handle_t> &get_set,
-                std::unordered_set<node_handle_t> &del_set,
-                std::unordered_map<node_handle_t, uint64_t> &loc_map,
-                std::shared_ptr<transaction::pending_tx> tx,
+            void do_tx(tx_group_t &group,
                 bool &ready,
                 bool &error,
                 order::oracle *time_oracle);
@@ -0,0 +1,221 @@
+/*
+ * ===============================================================
+ *    Description:  Cache of node locations at the vector
+ *                  timestamper, kept up to date by migration and
+ *                  deletion notifications from shards.
+ *
+ *        Created:  2014-10-16 16:12:40
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#ifndef weaver_coordinator_loc_cache_h_
+#define weaver_coordinator_loc_cache_h_
+
+#include <unordered_map>
+#include <unordered_set>
+#include <po6/threads/mutex.h>
+
+#include "common/types.h"
+#include "common/vclock.h"
+#include "coordinator/vt_constants.h"
+
+namespace coordinator
+{
+    // cached location of a node, with the tx which created the node if known
+    // a node deleted and re-created through another VT gets a new creation tx, so a location
+    // cached for the earlier node is detected when checked against the node read from Hyperdex
+    struct cached_loc
+    {
+        uint64_t loc;
+        uint64_t creat_vt, creat_epoch, creat_clk; // creat_vt is UINT64_MAX if not known
+
+        cached_loc() : loc(UINT64_MAX), creat_vt(UINT64_MAX), creat_epoch(0), creat_clk(0) { }
+        cached_loc(uint64_t l) : loc(l), creat_vt(UINT64_MAX), creat_epoch(0), creat_clk(0) { }
+        cached_loc(uint64_t l, const vc::vclock &creat_time)
+            : loc(l)
+            , creat_vt(creat_time.vt_id)
+            , creat_epoch(creat_time.get_epoch())
+            , creat_clk(creat_time.get_clock())
+        { }
+
+        // false if the creation tx is not known
+        bool same_node(const vc::vclock &creat_time) const
+        {
+            return creat_vt != UINT64_MAX
+                && creat_vt == creat_time.vt_id
+                && creat_epoch == creat_time.get_epoch()
+                && creat_clk == creat_time.get_clock();
+        }
+    };
+
+    // node locations shared by all threads of a VT
+    // locations change only on migration and deletion, the shard notifies each VT, see update()
+    // a node re-created at another shard before the deletion notification arrives is caught by
+    // the creation check in hyper_stub::do_tx
+    // a location read from Hyperdex is added only if no notification arrived since the read began,
+    // for which callers pass in the version returned by lookup() before the read
+    class loc_cache
+    {
+        private:
+            po6::threads::mutex mtx;
+            std::unordered_map<node_handle_t, cached_loc> locs;
+            uint64_t version; // incremented on each notification
+            uint64_t hits, misses, updates;
+
+            void insert_nonlocking(const node_handle_t &handle, const cached_loc &loc);
+
+        public:
+            loc_cache();
+
+            // fills found with cached locations of handles, and missing with the rest
+            uint64_t lookup(const std::unordered_set<node_handle_t> &handles,
+                std::unordered_map<node_handle_t, uint64_t> &found,
+                std::unordered_set<node_handle_t> &missing);
+            // same, with the creation tx of each node, for txs which check it against Hyperdex
+            uint64_t lookup(const std::unordered_set<node_handle_t> &handles,
+                std::unordered_map<node_handle_t, cached_loc> &found,
+                std::unordered_set<node_handle_t> &missing);
+            // locations read from Hyperdex or assigned to new nodes
+            void insert(const std::unordered_map<node_handle_t, uint64_t> &new_locs, uint64_t read_version);
+            void insert(const std::unordered_map<node_handle_t, cached_loc> &new_locs, uint64_t read_version);
+            // nodes deleted by this VT
+            void remove(const std::unordered_set<node_handle_t> &handles);
+            // notification from shard, loc is UINT64_MAX if node was deleted
+            void update(const node_handle_t &handle, uint64_t loc);
+            void get_stats(uint64_t &num_hits, uint64_t &num_misses, uint64_t &num_updates);
+    };
+
+    inline
+    loc_cache :: loc_cache()
+        : version(0)
+        , hits(0)
+        , misses(0)
+        , updates(0)
+    { }
+
+    inline void
+    loc_cache :: insert_nonlocking(const node_handle_t &handle, const cached_loc &loc)
+    {
+        if (locs.size() >= VT_LOC_CACHE_MAX && locs.find(handle) == locs.end()) {
+            locs.erase(locs.begin());
+        }
+        locs[handle] = loc;
+    }
+
+    inline uint64_t
+    loc_cache :: lookup(const std::unordered_set<node_handle_t> &handles,
+        std::unordered_map<node_handle_t, uint64_t> &found,
+        std::unordered_set<node_handle_t> &missing)
+    {
+        mtx.lock();
+        for (const node_handle_t &h: handles) {
+            auto iter = locs.find(h);
+            if (iter == locs.end()) {
+                missing.emplace(h);
+                misses++;
+            } else {
+                found.emplace(h, iter->second.loc);
+                hits++;
+            }
+        }
+        uint64_t ret = version;
+        mtx.unlock();
+
+        return ret;
+    }
+
+    inline uint64_t
+    loc_cache :: lookup(const std::unordered_set<node_handle_t> &handles,
+        std::unordered_map<node_handle_t, cached_loc> &found,
+        std::unordered_set<node_handle_t> &missing)
+    {
+        mtx.lock();
+        for (const node_handle_t &h: handles) {
+            auto iter = locs.find(h);
+            if (iter == locs.end()) {
+                missing.emplace(h);
+                misses++;
+            } else {
+                found.emplace(h, iter->second);
+                hits++;
+            }
+        }
+        uint64_t ret = version;
+        mtx.unlock();
+
+        return ret;
+    }
+
+    inline void
+    loc_cache :: insert(const std::unordered_map<node_handle_t, uint64_t> &new_locs, uint64_t read_version)
+    {
+        mtx.lock();
+        // some node may have moved since the read, skip all
+        if (read_version == version) {
+            for (const auto &p: new_locs) {
+                insert_nonlocking(p.first, cached_loc(p.second));
+            }
+        }
+        mtx.unlock();
+    }
+
+    inline void
+    loc_cache :: insert(const std::unordered_map<node_handle_t, cached_loc> &new_locs, uint64_t read_version)
+    {
+        mtx.lock();
+        // some node may have moved since the read, skip all
+        if (read_version == version) {
+            for (const auto &p: new_locs) {
+                insert_nonlocking(p.first, p.second);
+            }
+        }
+        mtx.unlock();
+    }
+
+    inline void
+    loc_cache :: remove(const std::unordered_set<node_handle_t> &handles)
+    {
+        mtx.lock();
+        for (const node_handle_t &h: handles) {
+            locs.erase(h);
+        }
+        mtx.unlock();
+    }
+
+    inline void
+    loc_cache :: update(const node_handle_t &handle, uint64_t loc)
+    {
+        mtx.lock();
+        version++;
+        updates++;
+        if (loc == UINT64_MAX) {
+            locs.erase(handle);
+        } else {
+            auto iter = locs.find(handle);
+            if (iter == locs.end()) {
+                insert_nonlocking(handle, cached_loc(loc));
+            } else {
+                // same node, moved
+                iter->second.loc = loc;
+            }
+        }
+        mtx.unlock();
+    }
+
+    inline void
+    loc_cache :: get_stats(uint64_t &num_hits, uint64_t &num_misses, uint64_t &num_updates)
+    {
+        mtx.lock();
+        num_hits = hits;
+        num_misses = misses;
+        num_updates = updates;
+        mtx.unlock();
+    }
+}
+
+#endif
@@ -16,6 +16,7 @@
 #include <thread>
 #include <vector>
 #include <deque>
+#include <algorithm>
 #include <stdlib.h>
 #include <signal.h>
 #include <sys/time.h>
@@ -23,12 +24,16 @@
 
 #define weaver_debug_
 #include "common/vclock.h"
+#include "common/clock.h"
 #include "common/transaction.h"
 #include "common/event_order.h"
+#include "common/kronos_batcher.h"
 #include "common/config_constants.h"
 #include "common/bool_vector.h"
 #include "node_prog/node_prog_type.h"
 #include "node_prog/node_program.h"
+#include "node_prog/bsp_program.h"
+#include "node_prog/bidir_reach_program.h"
 #include "coordinator/timestamper.h"
 
 DECLARE_CONFIG_CONSTANTS;
@@ -48,9 +53,23 @@ void
 end_program(int signum)
 {
     std::cerr << "Ending program, signum = " << signum << std::endl;
-    vts->clk_rw_mtx.wrlock();
-    WDEBUG << "num vclk updates " << vts->clk_updates << std::endl;
-    vts->clk_rw_mtx.unlock();
+    WDEBUG << "num vclk updates " << vts->vclk.get_updates() << std::endl;
+    uint64_t loc_hits, loc_misses, loc_updates;
+    vts->node_locs.get_stats(loc_hits, loc_misses, loc_updates);
+    WDEBUG << "node loc cache hits " << loc_hits << ", misses " << loc_misses << ", updates from shards " << loc_updates << std::endl;
+    vts->group_mtx.lock();
+    WDEBUG << "group commits " << vts->group_commits << ", txs " << vts->group_txs << std::endl;
+    vts->group_mtx.unlock();
+    vts->periodic_update_mutex.lock();
+    WDEBUG << "nops sent " << vts->nops_sent << ", piggybacked on txs " << vts->nops_suppressed << std::endl;
+    vts->periodic_update_mutex.unlock();
+    order::kronos_cache_stats kstats;
+    order::oracle::get_process_cache_stats(kstats);
+    WDEBUG << "kronos oracle caches: hits " << kstats.hits << ", misses " << kstats.misses
+           << ", evictions " << kstats.evictions << std::endl;
+    order::kronos_batcher::get().get_cache_stats(kstats);
+    WDEBUG << "kronos shared cache: hits " << kstats.hits << ", misses " << kstats.misses
+           << ", evictions " << kstats.evictions << std::endl;
 
 #ifdef weaver_benchmark_
     WDEBUG << "max outstanding prog cnt = " << vts->max_outstanding_cnt << std::endl;
@@ -68,23 +87,190 @@ end_program(int signum)
     }
 }
 
-void
-prepare_tx(std::shared_ptr<transaction::pending_tx> tx, coordinator::hyper_stub *hstub, order::oracle *time_oracle)
+// shard of node created by this tx, or of existing node in the VT loc cache, UINT64_MAX if unknown
+static uint64_t
+known_loc(const node_handle_t &handle,
+    const std::unordered_map<node_handle_t, uint64_t> &put_map,
+    const std::unordered_map<node_handle_t, uint64_t> &cached)
 {
-    //tx->id = vts->generate_req_id();
+    auto iter = put_map.find(handle);
+    if (iter != put_map.end()) {
+        return iter->second;
+    }
+    iter = cached.find(handle);
+    if (iter != cached.end()) {
+        return iter->second;
+    }
+    return UINT64_MAX;
+}
 
-    std::unordered_set<node_handle_t> get_set;
-    std::unordered_set<node_handle_t> del_set;
-    std::unordered_map<node_handle_t, uint64_t> put_map;
+// linear deterministic greedy: arg max over shards of #nbrs on shard * (1 - shard node count / capacity)
+// ties go to the shard with fewer nodes, UINT64_MAX if no nbr has a known shard
+static uint64_t
+ldg_loc(const std::vector<node_handle_t> &nbrs,
+    const std::unordered_map<node_handle_t, uint64_t> &put_map,
+    const std::unordered_map<node_handle_t, uint64_t> &cached,
+    const std::vector<uint64_t> &node_count)
+{
+    uint64_t num_shards = node_count.size();
+    std::vector<double> score(num_shards, 0);
+    bool nbr_found = false;
+    for (const node_handle_t &nbr: nbrs) {
+        uint64_t loc = known_loc(nbr, put_map, cached);
+        if (loc != UINT64_MAX && loc - ShardIdIncr < num_shards) {
+            score[loc - ShardIdIncr] += 1;
+            nbr_found = true;
+        }
+    }
+    if (!nbr_found) {
+        return UINT64_MAX;
+    }
+
+    double total_count = 0;
+    for (uint64_t c: node_count) {
+        total_count += c;
+    }
+    double shard_cap = 1.1 * (total_count + 1) / num_shards;
+
+    uint64_t best = 0;
+    for (uint64_t i = 0; i < num_shards; i++) {
+        score[i] *= (1 - node_count[i] / shard_cap);
+        if (score[i] > score[best]
+         || (score[i] == score[best] && node_count[i] < node_count[best])) {
+            best = i;
+        }
+    }
+
+    return best + ShardIdIncr;
+}
+
+// choose shard for each node created by tx, according to node_placement in weaver.yaml
+// nodes which the policy cannot place go round robin
+// existing nodes count only if their location is cached, they are not read from Hyperdex for placement
+static void
+place_nodes(const transaction::tx_list_t &writes, std::unordered_map<node_handle_t, uint64_t> &put_map)
+{
+    if (NodePlacement == PLACEMENT_ROUND_ROBIN) {
+        for (const std::shared_ptr<transaction::pending_update> &upd: writes) {
+            if (upd->type == transaction::NODE_CREATE_REQ) {
+                put_map.emplace(upd->handle, vts->generate_loc());
+            }
+        }
+        return;
+    }
+
+    std::vector<node_handle_t> created;
+    std::unordered_set<node_handle_t> created_set;
+    std::unordered_map<node_handle_t, std::vector<node_handle_t>> nbrs; // endpoints of edges created by this tx
+    std::unordered_map<node_handle_t, const std::string*> key_vals;
+
+    for (const std::shared_ptr<transaction::pending_update> &upd: writes) {
+        switch (upd->type) {
+            case transaction::NODE_CREATE_REQ:
+                if (created_set.emplace(upd->handle).second) {
+                    created.emplace_back(upd->handle);
+                }
+                break;
+
+            case transaction::EDGE_CREATE_REQ:
+                nbrs[upd->handle1].emplace_back(upd->handle2);
+                nbrs[upd->handle2].emplace_back(upd->handle1);
+                break;
+
+            case transaction::NODE_SET_PROPERTY:
+                if (NodePlacement == PLACEMENT_PARTITION_KEY && *upd->key == PartitionKey) {
+                    key_vals[upd->handle1] = upd->value.get();
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    std::unordered_map<node_handle_t, uint64_t> cached;
+    if (NodePlacement != PLACEMENT_PARTITION_KEY) {
+        std::unordered_set<node_handle_t> existing, missing;
+        for (const auto &p: nbrs) {
+            if (created_set.find(p.first) == created_set.end()) {
+                existing.emplace(p.first);
+            }
+        }
+        if (!existing.empty()) {
+            vts->node_locs.lookup(existing, cached, missing);
+        }
+    }
+
+    uint64_t num_shards = get_num_shards();
+    std::vector<uint64_t> node_count;
+    if (NodePlacement == PLACEMENT_LDG) {
+        vts->periodic_update_mutex.lock();
+        node_count = vts->shard_node_count;
+        vts->periodic_update_mutex.unlock();
+        node_count.resize(num_shards, 0);
+    }
+
+    for (const node_handle_t &handle: created) {
+        uint64_t loc = UINT64_MAX;
+        auto nbr_iter = nbrs.find(handle);
+
+        switch (NodePlacement) {
+            case PLACEMENT_EDGE:
+                if (nbr_iter != nbrs.end()) {
+                    for (const node_handle_t &nbr: nbr_iter->second) {
+                        loc = known_loc(nbr, put_map, cached);
+                        if (loc != UINT64_MAX) {
+                            break;
+                        }
+                    }
+                }
+                break;
+
+            case PLACEMENT_PARTITION_KEY: {
+                auto key_iter = key_vals.find(handle);
+                if (key_iter != key_vals.end()) {
+                    loc = std::hash<std::string>()(*key_iter->second) % num_shards + ShardIdIncr;
+                }
+                break;
+            }
+
+            case PLACEMENT_LDG:
+                if (nbr_iter != nbrs.end()) {
+                    loc = ldg_loc(nbr_iter->second, put_map, cached, node_count);
+                }
+                break;
+
+            default:
+                break;
+        }
+
+        if (loc == UINT64_MAX) {
+            loc = vts->generate_loc();
+        }
+        put_map.emplace(handle, loc);
+        if (NodePlacement == PLACEMENT_LDG && loc - ShardIdIncr < num_shards) {
+            node_count[loc - ShardIdIncr]++;
+        }
+    }
+}
+
+// node mappings which tx gets, puts, and deletes, and shard placement for new nodes
+void
+prepare_mappings(coordinator::group_tx &g)
+{
+    std::shared_ptr<transaction::pending_tx> tx = g.tx;
+    std::unordered_set<node_handle_t> &get_set = g.get_set;
+    std::unordered_set<node_handle_t> &del_set = g.del_set;
+    std::unordered_map<node_handle_t, uint64_t> &put_map = g.put_map;
     std::unordered_map<node_handle_t, uint64_t>::iterator find_iter; 
 
+    place_nodes(tx->writes, put_map);
+
     for (std::shared_ptr<transaction::pending_update> upd: tx->writes) {
         switch (upd->type) {
 
             case transaction::NODE_CREATE_REQ:
-                // randomly assign shard for this node
-                upd->loc1 = vts->generate_loc(); // node will be placed on this shard
-                put_map.emplace(upd->handle, upd->loc1);
+                upd->loc1 = put_map.at(upd->handle); // node will be placed on this shard
                 break;
 
             case transaction::EDGE_CREATE_REQ:
@@ -131,46 +317,143 @@ prepare_tx(std::shared_ptr<transaction::pending_tx> tx, coordinator::hyper_stub
                 WDEBUG << "bad type" << std::endl;
         }
     }
+}
+
+// true if g touches a node in touched, adds nodes touched by g to touched
+bool
+group_conflict(const coordinator::group_tx &g, std::unordered_set<node_handle_t> &touched)
+{
+    bool conflict = false;
+    for (const node_handle_t &h: g.get_set) {
+        conflict = conflict || (touched.find(h) != touched.end());
+    }
+    for (const node_handle_t &h: g.del_set) {
+        conflict = conflict || (touched.find(h) != touched.end());
+    }
+    for (const auto &p: g.put_map) {
+        conflict = conflict || (touched.find(p.first) != touched.end());
+    }
 
-    uint64_t sender = tx->sender;
+    touched.insert(g.get_set.begin(), g.get_set.end());
+    touched.insert(g.del_set.begin(), g.del_set.end());
+    for (const auto &p: g.put_map) {
+        touched.emplace(p.first);
+    }
+
+    return conflict;
+}
+
+// assign consecutive timestamps to txs in group and write them to Hyperdex in a single transaction
+// on abort the group is split in halves and each half is retried
+// on error each tx is retried alone, so that only the txs which fail are aborted
+void
+commit_group(coordinator::tx_group_t &group, coordinator::hyper_stub *hstub, order::oracle *time_oracle)
+{
     bool ready = false;
     bool error = false;
 
     while (!ready && !error) {
-        vts->clk_rw_mtx.wrlock();
-        vts->vclk.increment_clock();
-        vts->out_queue_counter++;
-        tx->timestamp = vts->vclk;
-        tx->vt_seq = vts->out_queue_counter;
-        vts->clk_rw_mtx.unlock();
-
-        // write tx in warp
+        for (std::shared_ptr<coordinator::group_tx> g: group) {
+            vts->next_clock(g->tx->timestamp);
+            g->tx->vt_seq = g->tx->timestamp.get_clock();
+        }
+
+        // write txs in warp
         // gets/puts/dels node mappings
         // sets error if any warp operation returns error
-        // sets upd->loc for each upd in tx
+        // sets upd->loc for each upd in each tx
         // sets tx->shard_write bool_vector (shard_write[i] = true iff there is a tx component at shard i)
-        hstub->do_tx(get_set, del_set, put_map, tx, ready, error, time_oracle);
+        hstub->do_tx(group, ready, error, time_oracle);
 
         assert(!(ready && error)); // can't be ready after some error
 
-        std::shared_ptr<transaction::pending_tx> to_enq;
-        if (!ready || error) {
-            to_enq = tx->copy_fail_transaction();
-        } else {
-            to_enq = tx;
+        for (std::shared_ptr<coordinator::group_tx> g: group) {
+            std::shared_ptr<transaction::pending_tx> to_enq;
+            if (!ready || error) {
+                to_enq = g->tx->copy_fail_transaction();
+            } else {
+                to_enq = g->tx;
+            }
+            vts->enqueue_tx(to_enq);
+        }
+
+        if (!ready && group.size() > 1) {
+            if (error) {
+                for (std::shared_ptr<coordinator::group_tx> g: group) {
+                    coordinator::tx_group_t single(1, g);
+                    commit_group(single, hstub, time_oracle);
+                }
+            } else {
+                uint64_t half = group.size() / 2;
+                coordinator::tx_group_t first(group.begin(), group.begin() + half);
+                coordinator::tx_group_t second(group.begin() + half, group.end());
+                commit_group(first, hstub, time_oracle);
+                commit_group(second, hstub, time_oracle);
+            }
+            return;
         }
-        vts->enqueue_tx(to_enq);
     }
 
     message::message msg;
-    if (error) {
-        // fail tx
-        msg.prepare_message(message::CLIENT_TX_ABORT);
-    } else {
-        msg.prepare_message(message::CLIENT_TX_SUCCESS);
+    for (std::shared_ptr<coordinator::group_tx> g: group) {
+        if (error) {
+            // fail tx
+            msg.prepare_message(message::CLIENT_TX_ABORT);
+        } else {
+            msg.prepare_message(message::CLIENT_TX_SUCCESS);
+        }
+        vts->comm.send_to_client(g->tx->sender, msg.buf);
     }
-    vts->comm.send_to_client(sender, msg.buf);
-    vts->tx_queue_loop();
+}
+
+// group commit: txs which arrive while a group is being written to Hyperdex are written together in the next group
+// the first thread which finds no group in progress commits groups until no txs are pending, other threads return
+// a tx which touches a node touched by an earlier pending tx waits for a later group
+void
+prepare_tx(std::shared_ptr<transaction::pending_tx> tx, coordinator::hyper_stub *hstub, order::oracle *time_oracle)
+{
+    std::shared_ptr<coordinator::group_tx> g = std::make_shared<coordinator::group_tx>();
+    g->tx = tx;
+    prepare_mappings(*g);
+
+    vts->group_mtx.lock();
+    vts->group_pending.emplace_back(g);
+    if (vts->group_in_progress) {
+        vts->group_mtx.unlock();
+        return;
+    }
+    vts->group_in_progress = true;
+
+    while (!vts->group_pending.empty()) {
+        coordinator::tx_group_t group;
+        std::deque<std::shared_ptr<coordinator::group_tx>> deferred;
+        std::unordered_set<node_handle_t> touched;
+
+        while (!vts->group_pending.empty() && group.size() < VT_GROUP_COMMIT_MAX_TXS) {
+            std::shared_ptr<coordinator::group_tx> next = vts->group_pending.front();
+            vts->group_pending.pop_front();
+            if (group_conflict(*next, touched)) {
+                deferred.emplace_back(next);
+            } else {
+                group.emplace_back(next);
+            }
+        }
+        while (!deferred.empty()) {
+            vts->group_pending.emplace_front(deferred.back());
+            deferred.pop_back();
+        }
+        vts->group_commits++;
+        vts->group_txs += group.size();
+        vts->group_mtx.unlock();
+
+        commit_group(group, hstub, time_oracle);
+        vts->tx_queue_loop();
+
+        vts->group_mtx.lock();
+    }
+
+    vts->group_in_progress = false;
+    vts->group_mtx.unlock();
 }
 
 // if all replies have been received, ack to client
@@ -196,70 +479,67 @@ end_tx(uint64_t tx_id, uint64_t shard_id, coordinator::hyper_stub *hstub)
 }
 
 // single dedicated thread which wakes up after given timeout, sends updates, and sleeps
+// nops are piggybacked on txs when possible, see timestamper::piggyback_nop
+// a shard which is due a nop gets a standalone nop only if it did not get a tx for nop_delay nanosecs
+// nop_delay doubles while the link stays idle, so idle shards are woken up less often
 void
 nop_function()
 {
     timespec sleep_time;
     int sleep_ret;
     int sleep_flags = 0;
-    std::vector<uint64_t> del_done_reqs;
     std::shared_ptr<transaction::pending_tx> tx = nullptr;
-    uint64_t num_shards;
+    std::vector<bool> idle_shards;
+    wclock::weaver_timer timer;
+    uint64_t num_shards, now, due, sleep_nanos;
 
-    sleep_time.tv_sec  = VT_TIMEOUT_NANO / NANO;
-    sleep_time.tv_nsec = VT_TIMEOUT_NANO % NANO;
+    sleep_nanos = VT_TIMEOUT_NANO;
 
     while (true) {
+        sleep_time.tv_sec  = sleep_nanos / NANO;
+        sleep_time.tv_nsec = sleep_nanos % NANO;
         sleep_ret = clock_nanosleep(CLOCK_REALTIME, sleep_flags, &sleep_time, NULL);
         assert((sleep_ret == 0 || sleep_ret == EINTR) && "error in clock_nanosleep");
 
         vts->periodic_update_mutex.lock();
 
         num_shards = get_num_shards();
+        now = timer.get_time_elapsed();
+        sleep_nanos = VT_NOP_MAX_NANO;
+        idle_shards.assign(num_shards, false);
+        bool send_nop = false;
+
+        for (uint64_t i = 0; i < num_shards; i++) {
+            if (!vts->to_nop[i]) {
+                // waiting for ack, the nop after that is due nop_delay after the ack at the earliest
+                sleep_nanos = std::min(sleep_nanos, vts->nop_delay[i]);
+                continue;
+            }
 
-        // send nops and state cleanup info to shards
-        if (weaver_util::any(vts->to_nop)) {
+            due = vts->nop_ready_time[i] + vts->nop_delay[i];
+            if (now >= due) {
+                idle_shards[i] = true;
+                send_nop = true;
+                vts->nop_delay[i] = std::min(2*vts->nop_delay[i], (uint64_t)VT_NOP_MAX_NANO);
+                sleep_nanos = std::min(sleep_nanos, vts->nop_delay[i]);
+            } else {
+                sleep_nanos = std::min(sleep_nanos, due - now);
+            }
+        }
+        sleep_nanos = std::max(sleep_nanos, (uint64_t)VT_TIMEOUT_NANO);
+
+        // send nops and state cleanup info to idle shards
+        if (send_nop) {
             tx = std::make_shared<transaction::pending_tx>(transaction::NOP);
             tx->nop = std::make_shared<transaction::nop_data>();
 
             tx->id = vts->generate_req_id();
-            vts->clk_rw_mtx.wrlock();
-            vts->vclk.increment_clock();
-            vts->out_queue_counter++;
-            tx->timestamp = vts->vclk;
-            tx->vt_seq = vts->out_queue_counter;
-            tx->shard_write = vts->to_nop;
-            vts->clk_rw_mtx.unlock();
-
-            del_done_reqs.clear();
-            vts->tx_prog_mutex.lock();
-            tx->nop->max_done_id = vts->max_done_id;
-            tx->nop->max_done_clk = *vts->max_done_clk;
-            tx->nop->outstanding_progs = vts->pend_progs.size();
-            tx->nop->shard_node_count = vts->shard_node_count;
-            for (auto &x: vts->done_reqs) {
-                // x.first = node prog type
-                // x.second = unordered_map <req_id -> vector<bool>(NumShards)>
-                for (auto &reply: x.second) {
-                    // reply.first = req_id
-                    // reply.second = vector<bool>(NumShards)
-                    for (uint64_t shard_id = 0; shard_id < num_shards; shard_id++) {
-                        if (vts->to_nop[shard_id] && (reply.second.size() > shard_id) && !reply.second[shard_id]) {
-                            reply.second[shard_id] = true;
-                            tx->nop->done_reqs[shard_id].emplace_back(std::make_pair(reply.first, x.first));
-                        }
-                    }
-                    if (weaver_util::all(reply.second)) {
-                        del_done_reqs.emplace_back(reply.first);
-                    }
-                }
-                for (auto &del: del_done_reqs) {
-                    x.second.erase(del);
-                }
-            }
-            vts->tx_prog_mutex.unlock();
+            vts->next_clock(tx->timestamp);
+            tx->vt_seq = tx->timestamp.get_clock();
+            tx->shard_write = idle_shards;
 
-            weaver_util::reset_all(vts->to_nop);
+            vts->fill_nop(idle_shards, *tx->nop);
+            vts->nops_sent += weaver_util::count(idle_shards);
         }
 
         vts->periodic_update_mutex.unlock();
@@ -317,9 +597,7 @@ clk_update_function()
         }
 
         // update vclock at other timestampers
-        vts->clk_rw_mtx.rdlock();
-        vclk.clock = vts->vclk.clock;
-        vts->clk_rw_mtx.unlock();
+        vts->vclk.get(vclk);
         for (uint64_t i = 0; i < NumVts; i++) {
             if (i == vt_id || vts_state[i] != server::AVAILABLE) {
                 continue;
@@ -380,11 +658,12 @@ void node_prog :: particular_node_program<ParamsType, NodeStateType, CacheValueT
         initial_batches[loc_map[p.first]].emplace_back(p);
     }
 
-    vts->clk_rw_mtx.wrlock();
-    vts->vclk.increment_clock();
-    vc::vclock req_timestamp = vts->vclk;
+    // node prog timestamp takes a seq, which is not used for any tx
+    vc::vclock req_timestamp;
+    vts->next_clock(req_timestamp);
     assert(req_timestamp.clock.size() == ClkSz);
-    vts->clk_rw_mtx.unlock();
+    vts->out_queue.skip(req_timestamp.get_epoch(), req_timestamp.get_clock());
+    vts->tx_queue_loop();
 
     vts->tx_prog_mutex.lock();
     uint64_t req_id = vts->generate_req_id();
@@ -396,7 +675,7 @@ void node_prog :: particular_node_program<ParamsType, NodeStateType, CacheValueT
 
     message::message msg_to_send;
     for (auto &batch_pair: initial_batches) {
-        msg_to_send.prepare_message(message::NODE_PROG, pType, vt_id, req_timestamp, req_id, cp_int, batch_pair.second);
+        msg_to_send.prepare_message(message::NODE_PROG, pType, vt_id, req_timestamp, req_id, cp_int, vt_id, batch_pair.second);
         vts->comm.send(batch_pair.first, msg_to_send.buf);
     }
 
@@ -448,6 +727,276 @@ node_prog_done(uint64_t req_id, current_prog *cp)
     return true;
 }
 
+// start a bulk synchronous job at all shards, graph is read at the timestamp of this request
+void
+start_bsp(std::unique_ptr<message::message> msg, uint64_t client)
+{
+    node_prog::bsp_params params;
+    msg->unpack_message(message::CLIENT_BSP_REQ, params);
+
+    vts->restore_mtx.lock();
+    bool restoring = (vts->restore_status > 0);
+    vts->restore_mtx.unlock();
+    if (restoring) {
+        // backup timestamper is not ready, client has to retry
+        uint64_t zero = 0;
+        std::vector<std::pair<node_handle_t, double>> ranks;
+        std::vector<std::pair<node_handle_t, uint64_t>> labels;
+        msg->prepare_message(message::BSP_RETURN, zero, ranks, labels);
+        vts->comm.send_to_client(client, msg->buf);
+        return;
+    }
+
+    vc::vclock req_timestamp;
+    vts->next_clock(req_timestamp);
+    assert(req_timestamp.clock.size() == ClkSz);
+    vts->out_queue.skip(req_timestamp.get_epoch(), req_timestamp.get_clock());
+    vts->tx_queue_loop();
+
+    // registered like a node prog, so that permanent deletion waits for this job
+    vts->tx_prog_mutex.lock();
+    uint64_t req_id = vts->generate_req_id();
+    current_prog *cp = new current_prog(req_id, client, req_timestamp.clock);
+    vts->pend_progs.emplace_back(cp);
+    vts->outstanding_progs.emplace(req_id);
+    vts->tx_prog_mutex.unlock();
+
+    uint64_t num_shards = get_num_shards();
+    vts->bsp_mtx.lock();
+    coordinator::bsp_run &run = vts->bsp_runs[req_id];
+    run.client = client;
+    run.cp = cp;
+    run.params = params;
+    run.vclk = req_timestamp;
+    run.step = 0;
+    run.shards_left = num_shards;
+    vts->bsp_mtx.unlock();
+
+    uint64_t step = 0;
+    node_prog::bsp_stats totals;
+    message::message msg_to_send;
+    for (uint64_t sid = ShardIdIncr; sid < ShardIdIncr + num_shards; sid++) {
+        msg_to_send.prepare_message(message::BSP_STEP, req_id, vt_id, req_timestamp, params, step, totals);
+        vts->comm.send(sid, msg_to_send.buf);
+    }
+}
+
+// superstep done at a shard, start next superstep or finish job once all shards are done
+void
+bsp_step_done(std::unique_ptr<message::message> msg)
+{
+    uint64_t req_id, step;
+    node_prog::bsp_stats stats;
+    msg->unpack_message(message::BSP_STEP_DONE, req_id, step, stats);
+
+    uint64_t num_shards = get_num_shards();
+    bool finish = false;
+    bool next = false;
+    node_prog::bsp_stats totals;
+    node_prog::bsp_params params;
+    vc::vclock vclk;
+
+    vts->bsp_mtx.lock();
+    auto iter = vts->bsp_runs.find(req_id);
+    assert(iter != vts->bsp_runs.end());
+    coordinator::bsp_run &run = iter->second;
+    assert(run.step == step);
+    run.totals.add(stats);
+    if (--run.shards_left == 0) {
+        if (step == 0) {
+            run.num_vertices = run.totals.num_vertices;
+        }
+        totals = run.totals;
+        totals.num_vertices = run.num_vertices;
+        params = run.params;
+        vclk = run.vclk;
+
+        finish = node_prog::bsp_converged(run.params, step, totals);
+        next = !finish;
+        run.step++;
+        run.shards_left = num_shards;
+        run.totals = node_prog::bsp_stats();
+    }
+    vts->bsp_mtx.unlock();
+
+    if (!finish && !next) {
+        return;
+    }
+    message::message msg_to_send;
+    uint64_t next_step = step + 1;
+    for (uint64_t sid = ShardIdIncr; sid < ShardIdIncr + num_shards; sid++) {
+        if (finish) {
+            msg_to_send.prepare_message(message::BSP_FINISH, req_id);
+        } else {
+            msg_to_send.prepare_message(message::BSP_STEP, req_id, vt_id, vclk, params, next_step, totals);
+        }
+        vts->comm.send(sid, msg_to_send.buf);
+    }
+}
+
+// vertex values from a shard, reply to client once all shards have sent theirs
+void
+bsp_return(std::unique_ptr<message::message> msg)
+{
+    uint64_t req_id;
+    std::vector<std::pair<node_handle_t, double>> ranks;
+    std::vector<std::pair<node_handle_t, uint64_t>> labels;
+    msg->unpack_message(message::BSP_RETURN, req_id, ranks, labels);
+
+    coordinator::bsp_run run;
+    bool done = false;
+
+    vts->bsp_mtx.lock();
+    auto iter = vts->bsp_runs.find(req_id);
+    assert(iter != vts->bsp_runs.end());
+    coordinator::bsp_run &cur = iter->second;
+    cur.ranks.insert(cur.ranks.end(), ranks.begin(), ranks.end());
+    cur.labels.insert(cur.labels.end(), labels.begin(), labels.end());
+    if (--cur.shards_left == 0) {
+        run = std::move(cur);
+        vts->bsp_runs.erase(iter);
+        done = true;
+    }
+    vts->bsp_mtx.unlock();
+
+    if (done) {
+        vts->tx_prog_mutex.lock();
+        node_prog_done(req_id, run.cp);
+        vts->tx_prog_mutex.unlock();
+
+        msg->prepare_message(message::BSP_RETURN, req_id, run.ranks, run.labels);
+        vts->comm.send_to_client(run.client, msg->buf);
+    }
+}
+
+// send current level of a bidirectional reachability search to shards
+// caution: need to hold vts->bidir_mtx
+uint64_t
+send_bidir_level(uint64_t req_id, coordinator::bidir_run &run)
+{
+    run.search.start_level();
+    const std::vector<db::element::remote_node> &frontier = run.search.get_frontier();
+    bool backward = (run.search.dir == node_prog::BIDIR_BACKWARD);
+    message::message msg;
+
+    if (backward) {
+        // in-edges of a node are stored at the shards of its in-nbrs
+        std::vector<node_handle_t> handles;
+        handles.reserve(frontier.size());
+        for (const db::element::remote_node &rn: frontier) {
+            handles.emplace_back(rn.handle);
+        }
+        uint64_t num_shards = get_num_shards();
+        for (uint64_t sid = ShardIdIncr; sid < ShardIdIncr + num_shards; sid++) {
+            msg.prepare_message(message::BIDIR_REACH_STEP, req_id, vt_id, run.vclk, backward, run.params.edge_props, handles);
+            vts->comm.send(sid, msg.buf);
+        }
+        return num_shards;
+    } else {
+        std::unordered_map<uint64_t, std::vector<node_handle_t>> batches;
+        for (const db::element::remote_node &rn: frontier) {
+            batches[rn.loc].emplace_back(rn.handle);
+        }
+        for (auto &p: batches) {
+            msg.prepare_message(message::BIDIR_REACH_STEP, req_id, vt_id, run.vclk, backward, run.params.edge_props, p.second);
+            vts->comm.send(p.first, msg.buf);
+        }
+        return batches.size();
+    }
+}
+
+// reply to client and retire request
+void
+end_bidir_reach(uint64_t req_id, coordinator::bidir_run &run)
+{
+    if (run.cp != NULL) {
+        vts->tx_prog_mutex.lock();
+        node_prog_done(req_id, run.cp);
+        vts->tx_prog_mutex.unlock();
+    }
+
+    run.params.reachable = run.search.reachable;
+    run.params.levels = run.search.levels;
+    message::message msg;
+    msg.prepare_message(message::BIDIR_REACH_RETURN, run.params);
+    vts->comm.send_to_client(run.client, msg.buf);
+}
+
+// start a bidirectional reachability search, visited sets and frontiers of both directions are kept here
+void
+start_bidir_reach(std::unique_ptr<message::message> msg, uint64_t client, coordinator::hyper_stub *hstub)
+{
+    coordinator::bidir_run run;
+    run.client = client;
+    msg->unpack_message(message::CLIENT_BIDIR_REACH_REQ, run.params);
+
+    std::unordered_set<node_handle_t> get_set {run.params.src, run.params.dst};
+    std::unordered_map<node_handle_t, uint64_t> loc_map = hstub->get_mappings(get_set);
+    if (loc_map.size() != get_set.size()) {
+        WDEBUG << "bad node handles in bidirectional reachability request" << std::endl;
+        end_bidir_reach(0, run);
+        return;
+    }
+
+    run.search.init(db::element::remote_node(loc_map[run.params.src], run.params.src),
+        db::element::remote_node(loc_map[run.params.dst], run.params.dst));
+    if (run.search.done) {
+        end_bidir_reach(0, run);
+        return;
+    }
+
+    vts->next_clock(run.vclk);
+    assert(run.vclk.clock.size() == ClkSz);
+    vts->out_queue.skip(run.vclk.get_epoch(), run.vclk.get_clock());
+    vts->tx_queue_loop();
+
+    // registered like a node prog, so that permanent deletion waits for this request
+    vts->tx_prog_mutex.lock();
+    uint64_t req_id = vts->generate_req_id();
+    run.cp = new current_prog(req_id, client, run.vclk.clock);
+    vts->pend_progs.emplace_back(run.cp);
+    vts->outstanding_progs.emplace(req_id);
+    vts->tx_prog_mutex.unlock();
+
+    vts->bidir_mtx.lock();
+    coordinator::bidir_run &cur = vts->bidir_runs[req_id];
+    cur = std::move(run);
+    cur.shards_left = send_bidir_level(req_id, cur);
+    vts->bidir_mtx.unlock();
+}
+
+// nbrs found by a shard, start next level once all shards are done with this one
+void
+bidir_reach_step_done(std::unique_ptr<message::message> msg)
+{
+    uint64_t req_id;
+    std::vector<db::element::remote_node> found;
+    msg->unpack_message(message::BIDIR_REACH_STEP_DONE, req_id, found);
+
+    coordinator::bidir_run run;
+    bool done = false;
+
+    vts->bidir_mtx.lock();
+    auto iter = vts->bidir_runs.find(req_id);
+    assert(iter != vts->bidir_runs.end());
+    coordinator::bidir_run &cur = iter->second;
+    cur.search.add_found(found);
+    if (--cur.shards_left == 0) {
+        if (cur.search.end_level()) {
+            run = std::move(cur);
+            vts->bidir_runs.erase(iter);
+            done = true;
+        } else {
+            cur.shards_left = send_bidir_level(req_id, cur);
+        }
+    }
+    vts->bidir_mtx.unlock();
+
+    if (done) {
+        end_bidir_reach(req_id, run);
+    }
+}
+
 void
 server_loop(int thread_id)
 {
@@ -483,10 +1032,7 @@ server_loop(int thread_id)
                 case message::VT_CLOCK_UPDATE: {
                     vc::vclock rec_clk;
                     msg->unpack_message(message::VT_CLOCK_UPDATE, rec_clk);
-                    vts->clk_rw_mtx.wrlock();
-                    vts->clk_updates++;
-                    vts->vclk.update_clock(rec_clk);
-                    vts->clk_rw_mtx.unlock();
+                    vts->vclk.update(rec_clk);
                     break;
                 }
 
@@ -506,11 +1052,25 @@ server_loop(int thread_id)
                         vts->shard_node_count[sid] = shard_node_count;
                         vts->to_nop[sid] = true;
                         vts->nop_ack_qts[sid] = nop_qts;
+                        vts->nop_ready_time[sid] = wclock::weaver_timer().get_time_elapsed();
                     }
                     vts->periodic_update_mutex.unlock();
                     break;
                 }
 
+                case message::NODE_LOC_UPDATE: {
+                    uint64_t sender, loc;
+                    node_handle_t handle;
+                    msg->unpack_message(message::NODE_LOC_UPDATE, sender, handle, loc);
+                    vts->node_locs.update(handle, loc);
+                    if (loc != UINT64_MAX) {
+                        // node migration waits for this ack
+                        msg->prepare_message(message::NODE_LOC_UPDATE_ACK, vt_id);
+                        vts->comm.send(sender, msg->buf);
+                    }
+                    break;
+                }
+
                 case message::CLIENT_NODE_COUNT: {
                     vts->periodic_update_mutex.lock();
                     msg->prepare_message(message::NODE_COUNT_REPLY, vts->shard_node_count);
@@ -586,6 +1146,28 @@ server_loop(int thread_id)
                     break;
                 }
 
+                // bulk synchronous analytics
+                case message::CLIENT_BSP_REQ:
+                    start_bsp(std::move(msg), client_sender);
+                    break;
+
+                case message::BSP_STEP_DONE:
+                    bsp_step_done(std::move(msg));
+                    break;
+
+                case message::BSP_RETURN:
+                    bsp_return(std::move(msg));
+                    break;
+
+                // bidirectional reachability
+                case message::CLIENT_BIDIR_REACH_REQ:
+                    start_bidir_reach(std::move(msg), client_sender, hstub);
+                    break;
+
+                case message::BIDIR_REACH_STEP_DONE:
+                    bidir_reach_step_done(std::move(msg));
+                    break;
+
                 case message::RESTORE_DONE: {
                     vts->restore_mtx.lock();
                     assert(vts->restore_status > 0);
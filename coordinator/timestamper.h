@@ -18,6 +18,7 @@
 #define weaver_coordinator_timestamper_h_
 
 #include <vector>
+#include <deque>
 #include <unordered_map>
 #include <po6/threads/mutex.h>
 #include <po6/threads/rwlock.h>
@@ -32,25 +33,15 @@
 #include "common/server_manager_link_wrapper.h"
 #include "coordinator/vt_constants.h"
 #include "coordinator/current_prog.h"
+#include "coordinator/bsp_run.h"
+#include "coordinator/bidir_run.h"
 #include "coordinator/blocked_prog.h"
 #include "coordinator/hyper_stub.h"
+#include "coordinator/vt_clock.h"
+#include "coordinator/tx_sequencer.h"
 
 namespace coordinator
 {
-    class greater_tx_ptr
-    {
-        public:
-            bool operator() (const std::shared_ptr<const transaction::pending_tx> lhs, const std::shared_ptr<const transaction::pending_tx> rhs)
-            {
-                if (lhs->timestamp.get_epoch() == rhs->timestamp.get_epoch()) {
-                    return lhs->vt_seq > rhs->vt_seq;
-                } else {
-                    return lhs->timestamp.get_epoch() > rhs->timestamp.get_epoch();
-                }
-            }
-    };
-
-    using tx_queue_t = std::priority_queue<std::shared_ptr<transaction::pending_tx>, std::vector<std::shared_ptr<transaction::pending_tx>>, greater_tx_ptr>;
     using prog_queue_t = std::unique_ptr<std::vector<blocked_prog>>;
     using prog_reply_t = std::unordered_map<uint64_t, std::vector<bool>>;
 
@@ -69,6 +60,7 @@ namespace coordinator
 
             // Hyperdex stub
             std::vector<hyper_stub*> hstub, hstub_uninit;
+            loc_cache node_locs;
 
             // time oracle
             std::vector<order::oracle*> time_oracles, time_oracles_uninit;
@@ -85,14 +77,21 @@ namespace coordinator
 
         public:
             // consistency
-            vc::vclock vclk; // vector clock
-            vc::qtimestamp_t qts; // queue timestamp
-            uint64_t clock_update_acks, clk_updates;
+            vt_clock vclk; // vector clock, own entry is also the tx seq number
+            vc::qtimestamp_t qts; // queue timestamp, written by releasing thread of out_queue, and on reconfigure
+            uint64_t clock_update_acks;
             std::vector<bool> to_nop;
             std::vector<uint64_t> nop_ack_qts;
+            std::vector<uint64_t> nop_ready_time; // time at which to_nop was set, nanosecs
+            std::vector<uint64_t> nop_delay; // wait for a tx to piggyback on before sending standalone nop
+            uint64_t nops_sent, nops_suppressed; // standalone and piggybacked nops, per shard
 
             // transactions
             std::unordered_map<uint64_t, std::shared_ptr<transaction::pending_tx>> outstanding_tx;
+            // group commit of client txs to Hyperdex, protected by group_mtx
+            std::deque<std::shared_ptr<group_tx>> group_pending;
+            bool group_in_progress;
+            uint64_t group_commits, group_txs;
 
             // prog cleanup and permanent deletion
             std::unordered_set<uint64_t> outstanding_progs; // for multiple returns and ft
@@ -102,6 +101,14 @@ namespace coordinator
             std::unique_ptr<vc::vclock_t> max_done_clk; // permanent deletion
             std::unordered_map<node_prog::prog_type, prog_reply_t> done_reqs; // prog state cleanup
 
+            // bulk synchronous analytics, req id -> job
+            po6::threads::mutex bsp_mtx;
+            std::unordered_map<uint64_t, bsp_run> bsp_runs;
+
+            // bidirectional reachability, req id -> search
+            po6::threads::mutex bidir_mtx;
+            std::unordered_map<uint64_t, bidir_run> bidir_runs;
+
             // mutexes
         public:
             po6::threads::mutex clk_mutex // vclock and queue timestamp
@@ -111,7 +118,7 @@ namespace coordinator
                     , graph_load_mutex
                     , config_mutex
                     , exit_mutex
-                    , tx_out_queue_mtx;
+                    , group_mtx;
             po6::threads::rwlock clk_rw_mtx;
 
             // initial graph loading
@@ -123,9 +130,7 @@ namespace coordinator
             std::vector<uint64_t> shard_node_count;
 
             // fault tolerance
-            std::pair<uint64_t, uint64_t> out_queue_clk; // (epoch num, out clk)
-            uint64_t out_queue_counter;
-            tx_queue_t tx_out_queue;
+            tx_sequencer out_queue;
             prog_queue_t prog_queue;
             po6::threads::mutex restore_mtx;
             uint16_t restore_status;
@@ -141,12 +146,14 @@ namespace coordinator
             void update_members_new_config();
             uint64_t generate_req_id();
             uint64_t generate_loc();
+            void next_clock(vc::vclock &clk);
             void enqueue_tx(std::shared_ptr<transaction::pending_tx> tx);
-            bool process_tx_queue(std::shared_ptr<transaction::pending_tx> &tx_ptr, std::vector<std::shared_ptr<transaction::pending_tx>> &factored_tx);
             void factor_tx(std::shared_ptr<transaction::pending_tx> tx, std::vector<std::shared_ptr<transaction::pending_tx>> &factored_tx);
             void tx_queue_loop();
+            void fill_nop(const std::vector<bool> &shards, transaction::nop_data &nop);
+            std::shared_ptr<transaction::nop_data> shard_nop(const transaction::nop_data &nop, uint64_t shard_idx);
+            void piggyback_nop(std::shared_ptr<transaction::pending_tx> tx, std::vector<std::shared_ptr<transaction::pending_tx>> &factored_tx);
             void process_pend_progs();
-            void reset_out_queue_clk(uint64_t epoch);
 
 #ifdef weaver_benchmark_
         public:
@@ -172,20 +179,23 @@ namespace coordinator
         , shifted_id(UINT64_MAX)
         , reqid_gen(0)
         , loc_gen(0)
-        , vclk(UINT64_MAX, 0)
         , qts(NumShards, 0)
         , clock_update_acks(NumVts-1)
-        , clk_updates(0)
         , to_nop(NumShards, true)
         , nop_ack_qts(NumShards, 0)
+        , nop_ready_time(NumShards, 0)
+        , nop_delay(NumShards, VT_TIMEOUT_NANO)
+        , nops_sent(0)
+        , nops_suppressed(0)
+        , group_in_progress(false)
+        , group_commits(0)
+        , group_txs(0)
         , prog_done_cnt(0)
         , max_done_id(0)
         , max_done_clk(new vc::vclock_t(ClkSz, 0))
         , load_count(0)
         , max_load_time(0)
         , shard_node_count(NumShards, 0)
-        , out_queue_clk(std::make_pair(0,1))
-        , out_queue_counter(0)
         , prog_queue(new std::vector<blocked_prog>())
         , restore_status(0)
         , to_exit(false)
@@ -214,11 +224,11 @@ namespace coordinator
         vt_id = vtid;
         weaver_id = weaverid;
         shifted_id = weaver_id << (64-ID_BITS);
-        vclk.vt_id = vt_id;
+        vclk.init(vt_id);
 
         hstub = std::move(hstub_uninit);
         for (hyper_stub *hs: hstub) {
-            hs->init(vt_id);
+            hs->init(vt_id, &node_locs);
         }
         time_oracles = std::move(time_oracles_uninit);
     }
@@ -287,6 +297,8 @@ namespace coordinator
         periodic_update_mutex.lock();
         to_nop.resize(num_shards, true);
         nop_ack_qts.resize(num_shards, 0);
+        nop_ready_time.resize(num_shards, 0);
+        nop_delay.resize(num_shards, VT_TIMEOUT_NANO);
         shard_node_count.resize(num_shards, 0);
         std::fill(max_done_clk->begin(), max_done_clk->end(), 0);
         max_done_clk->at(0) = config.version(); 
@@ -315,17 +327,15 @@ namespace coordinator
         std::shared_ptr<transaction::pending_tx> epoch_tx;
         if (direct_reset_out_queue_clk) {
             // out_queue is empty
-            reset_out_queue_clk(config.version());
-            vclk.new_epoch(config.version());
+            out_queue.reset(config.version());
+            vclk.new_epoch(config.version(), NULL);
         } else {
             // restart vclock with new epoch number from configuration
-            vclk.increment_clock();
-            out_queue_counter++;
+            // epoch change tx takes the seq after all txs of the old epoch
             epoch_tx = std::make_shared<transaction::pending_tx>(transaction::EPOCH_CHANGE);
-            epoch_tx->timestamp = vclk;
-            epoch_tx->vt_seq = out_queue_counter;
+            vclk.new_epoch(config.version(), &epoch_tx->timestamp);
+            epoch_tx->vt_seq = epoch_tx->timestamp.get_clock();
             epoch_tx->new_epoch = config.version();
-            vclk.new_epoch(config.version());
         }
 
 #ifdef weaver_benchmark_
@@ -373,6 +383,8 @@ namespace coordinator
                     qts[shard_id] = 0;
                     to_nop[shard_id] = true;
                     nop_ack_qts[shard_id] = 0;
+                    nop_ready_time[shard_id] = 0;
+                    nop_delay[shard_id] = VT_TIMEOUT_NANO;
                 }
             } else if (srv.type == server::VT) {
                 server::state_t prv_state = prev_config.get_state(srv.id);
@@ -471,71 +483,19 @@ namespace coordinator
         return new_loc;
     }
 
+    // seqs consumed by failed attempts are skipped in the out queue
     inline void
-    timestamper :: enqueue_tx(std::shared_ptr<transaction::pending_tx> tx)
+    timestamper :: next_clock(vc::vclock &clk)
     {
-        uint64_t seq = tx->vt_seq;
-        uint64_t epoch = tx->timestamp.get_epoch();
-        bool done = false;
-
-        tx_out_queue_mtx.lock();
-
-        if (tx_out_queue.empty()
-         && epoch == out_queue_clk.first
-         && seq == out_queue_clk.second) {
-            if (tx->type == transaction::FAIL) {
-                out_queue_clk.second++;
-                done = true;
-            } else if (tx->type == transaction::EPOCH_CHANGE) {
-                reset_out_queue_clk(tx->new_epoch);
-                done = true;
-            }
-        }
-
-        if (!done) {
-            tx_out_queue.emplace(tx);
+        while (!vclk.next(clk)) {
+            out_queue.skip(clk.get_epoch(), clk.get_clock());
         }
-
-        tx_out_queue_mtx.unlock();
     }
 
-    // return list of tx components, factored per shard
-    // return true if this call did pop off out queue
-    inline bool
-    timestamper :: process_tx_queue(std::shared_ptr<transaction::pending_tx> &tx_ptr, std::vector<std::shared_ptr<transaction::pending_tx>> &factored_tx)
+    inline void
+    timestamper :: enqueue_tx(std::shared_ptr<transaction::pending_tx> tx)
     {
-        tx_ptr = nullptr;
-        bool ret = false;
-
-        tx_out_queue_mtx.lock();
-
-        if (!tx_out_queue.empty()) {
-            std::shared_ptr<transaction::pending_tx> top = tx_out_queue.top();
-            uint64_t this_clk = top->vt_seq;
-            uint64_t this_epoch = top->timestamp.get_epoch();
-
-            if (this_epoch == out_queue_clk.first && this_clk == out_queue_clk.second) {
-                tx_out_queue.pop();
-                ret = true;
-
-                if (top->type == transaction::EPOCH_CHANGE) {
-                    reset_out_queue_clk(top->new_epoch);
-                } else {
-                    out_queue_clk.second++;
-                    if (top->type != transaction::FAIL) {
-                        tx_ptr = top;
-                    }
-                }
-            }
-        }
-
-        if (tx_ptr != nullptr) {
-            factor_tx(tx_ptr, factored_tx);
-        }
-
-        tx_out_queue_mtx.unlock();
-
-        return ret;
+        out_queue.publish(tx);
     }
 
     inline void
@@ -561,13 +521,7 @@ namespace coordinator
                 std::shared_ptr<transaction::pending_tx> this_tx = factored_tx[i];
                 if (tx->shard_write[i]) {
                     this_tx->qts = ++qts[i];
-                    this_tx->nop = std::make_shared<transaction::nop_data>();
-                    std::shared_ptr<transaction::nop_data> this_nop = this_tx->nop;
-                    this_nop->max_done_id = nop->max_done_id;
-                    this_nop->max_done_clk = nop->max_done_clk;
-                    this_nop->outstanding_progs = nop->outstanding_progs;
-                    this_nop->done_reqs[i] = nop->done_reqs[i];
-                    this_nop->shard_node_count = nop->shard_node_count;
+                    this_tx->nop = shard_nop(*nop, i);
                 }
             }
         } else {
@@ -594,37 +548,151 @@ namespace coordinator
             restore_mtx.unlock();
         }
 
-        while (true) {
+        std::vector<std::shared_ptr<transaction::pending_tx>> batch;
+        std::vector<std::vector<std::shared_ptr<transaction::pending_tx>>> factored_batch;
+        message::message msg;
+
+        // if some other thread is releasing txs, it will also release the tx published by this thread
+        while (out_queue.try_begin()) {
+            // qts are assigned in seq order, sends need not be
             std::shared_ptr<transaction::pending_tx> tx;
-            std::vector<std::shared_ptr<transaction::pending_tx>> factored_tx;
-            if (!process_tx_queue(tx, factored_tx)) {
-                assert(tx == nullptr);
+            while (out_queue.pop(tx)) {
+                if (tx != nullptr) {
+                    batch.emplace_back(tx);
+                    factored_batch.emplace_back();
+                    factor_tx(tx, factored_batch.back());
+                }
+            }
+            out_queue.end();
+
+            for (uint64_t b = 0; b < batch.size(); b++) {
+                tx = batch[b];
+                std::vector<std::shared_ptr<transaction::pending_tx>> &factored_tx = factored_batch[b];
+                assert(tx->type != transaction::FAIL && tx->type != transaction::EPOCH_CHANGE);
+
+                // tx succeeded, send to shards
+                uint64_t num_shards = tx->shard_write.size();
+                bool nop = (tx->type == transaction::NOP);
+
+                if (!nop) {
+                    tx_prog_mutex.lock();
+                    outstanding_tx.emplace(tx->id, tx);
+                    tx_prog_mutex.unlock();
+
+                    piggyback_nop(tx, factored_tx);
+                }
+
+                // send tx batches
+                for (uint64_t i = 0; i < num_shards; i++) {
+                    if (tx->shard_write[i]) {
+                        msg.prepare_message(message::TX_INIT, vt_id, factored_tx[i]->timestamp, factored_tx[i]->qts, *factored_tx[i]);
+                        comm.send(i+ShardIdIncr, msg.buf);
+                    }
+                }
+            }
+            batch.clear();
+            factored_batch.clear();
+
+            // a tx published between the last pop and end() found this thread releasing
+            if (!out_queue.ready()) {
                 break;
-            } else if (tx == nullptr) {
-                continue;
             }
+        }
+    }
+
+    // fill nop with state cleanup info, done reqs only for shards which are set in shards
+    // clears to_nop for these shards
+    // caution: assume caller holds periodic_update_mutex
+    inline void
+    timestamper :: fill_nop(const std::vector<bool> &shards, transaction::nop_data &nop)
+    {
+        uint64_t num_shards = shards.size();
+        std::vector<uint64_t> del_done_reqs;
+
+        tx_prog_mutex.lock();
+        nop.max_done_id = max_done_id;
+        nop.max_done_clk = *max_done_clk;
+        nop.outstanding_progs = pend_progs.size();
+        nop.shard_node_count = shard_node_count;
+        for (auto &x: done_reqs) {
+            // x.first = node prog type
+            // x.second = unordered_map <req_id -> vector<bool>(NumShards)>
+            for (auto &reply: x.second) {
+                // reply.first = req_id
+                // reply.second = vector<bool>(NumShards)
+                for (uint64_t shard_id = 0; shard_id < num_shards; shard_id++) {
+                    if (shards[shard_id] && (reply.second.size() > shard_id) && !reply.second[shard_id]) {
+                        reply.second[shard_id] = true;
+                        nop.done_reqs[shard_id].emplace_back(std::make_pair(reply.first, x.first));
+                    }
+                }
+                if (weaver_util::all(reply.second)) {
+                    del_done_reqs.emplace_back(reply.first);
+                }
+            }
+            for (auto &del: del_done_reqs) {
+                x.second.erase(del);
+            }
+            del_done_reqs.clear();
+        }
+        tx_prog_mutex.unlock();
 
-            assert(tx->type != transaction::FAIL && tx->type != transaction::EPOCH_CHANGE);
+        for (uint64_t i = 0; i < num_shards; i++) {
+            if (shards[i]) {
+                to_nop[i] = false;
+            }
+        }
+    }
+
+    // copy of nop to be sent to a single shard
+    inline std::shared_ptr<transaction::nop_data>
+    timestamper :: shard_nop(const transaction::nop_data &nop, uint64_t shard_idx)
+    {
+        std::shared_ptr<transaction::nop_data> this_nop = std::make_shared<transaction::nop_data>();
+        this_nop->max_done_id = nop.max_done_id;
+        this_nop->max_done_clk = nop.max_done_clk;
+        this_nop->outstanding_progs = nop.outstanding_progs;
+        auto iter = nop.done_reqs.find(shard_idx);
+        if (iter != nop.done_reqs.end()) {
+            this_nop->done_reqs[shard_idx] = iter->second;
+        } else {
+            this_nop->done_reqs[shard_idx];
+        }
+        this_nop->shard_node_count = nop.shard_node_count;
+        return this_nop;
+    }
 
-            // tx succeeded, send to shards
-            uint64_t num_shards = tx->shard_write.size();
-            bool nop = (tx->type == transaction::NOP);
+    // attach nop to components of write tx which go to shards that are due a nop
+    // these shards do not need a standalone nop from nop_function
+    inline void
+    timestamper :: piggyback_nop(std::shared_ptr<transaction::pending_tx> tx, std::vector<std::shared_ptr<transaction::pending_tx>> &factored_tx)
+    {
+        periodic_update_mutex.lock();
 
-            if (!nop) {
-                tx_prog_mutex.lock();
-                outstanding_tx.emplace(tx->id, tx);
-                tx_prog_mutex.unlock();
+        uint64_t num_shards = std::min(tx->shard_write.size(), to_nop.size());
+        std::vector<bool> shards(to_nop.size(), false);
+        bool piggyback = false;
+        for (uint64_t i = 0; i < num_shards; i++) {
+            if (tx->shard_write[i] && to_nop[i]) {
+                shards[i] = true;
+                piggyback = true;
             }
+        }
 
-            // send tx batches
-            message::message msg;
+        if (piggyback) {
+            transaction::nop_data nop;
+            fill_nop(shards, nop);
             for (uint64_t i = 0; i < num_shards; i++) {
-                if (tx->shard_write[i]) {
-                    msg.prepare_message(message::TX_INIT, vt_id, factored_tx[i]->timestamp, factored_tx[i]->qts, *factored_tx[i]);
-                    comm.send(i+ShardIdIncr, msg.buf);
+                if (shards[i]) {
+                    factored_tx[i]->nop = shard_nop(nop, i);
+                    // link is busy, next standalone nop only after a short idle period
+                    nop_delay[i] = VT_TIMEOUT_NANO;
+                    nops_suppressed++;
                 }
             }
         }
+
+        periodic_update_mutex.unlock();
     }
 
     bool
@@ -664,14 +732,6 @@ namespace coordinator
             done_progs.erase(done_progs.begin(), done_iter);
         }
     }
-
-    // assuming hold out_queue_mtx
-    inline void
-    timestamper :: reset_out_queue_clk(uint64_t epoch)
-    {
-        out_queue_clk = std::make_pair(epoch, 1);
-        out_queue_counter = 0;
-    }
 }
 
 #endif
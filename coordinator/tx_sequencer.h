@@ -0,0 +1,232 @@
+/*
+ * ===============================================================
+ *    Description:  Out queue of the timestamper, which releases
+ *                  txs to shards in vt_seq order.
+ *
+ *        Created:  2014-10-16 17:38:09
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#ifndef weaver_coordinator_tx_sequencer_h_
+#define weaver_coordinator_tx_sequencer_h_
+
+#include <queue>
+#include <atomic>
+#include <memory>
+#include <po6/threads/mutex.h>
+
+#include "common/transaction.h"
+#include "coordinator/vt_constants.h"
+
+namespace coordinator
+{
+    class greater_tx_ptr
+    {
+        public:
+            bool operator() (const std::shared_ptr<const transaction::pending_tx> lhs, const std::shared_ptr<const transaction::pending_tx> rhs)
+            {
+                if (lhs->timestamp.get_epoch() == rhs->timestamp.get_epoch()) {
+                    return lhs->vt_seq > rhs->vt_seq;
+                } else {
+                    return lhs->timestamp.get_epoch() > rhs->timestamp.get_epoch();
+                }
+            }
+    };
+
+    using tx_queue_t = std::priority_queue<std::shared_ptr<transaction::pending_tx>, std::vector<std::shared_ptr<transaction::pending_tx>>, greater_tx_ptr>;
+
+    // every seq of an epoch is published exactly once, either as a tx or as a skip
+    // a tx goes into slot vt_seq % VT_SEQ_SLOTS without a lock,
+    // or to the overflow queue if that slot still holds a later seq which is waiting for this one
+    // one thread at a time releases txs in order, others just publish and return, see try_begin()
+    class tx_sequencer
+    {
+        private:
+            enum slot_state
+            {
+                EMPTY,
+                BUSY, // publisher is filling the slot
+                FULL
+            };
+
+            struct slot
+            {
+                std::atomic<uint32_t> state;
+                std::atomic<uint64_t> epoch, seq;
+                std::shared_ptr<transaction::pending_tx> tx; // nullptr for skipped seq
+
+                slot() : state(EMPTY), epoch(0), seq(0) { }
+            };
+
+            slot slots[VT_SEQ_SLOTS];
+            std::atomic<uint64_t> out_epoch, out_seq; // next seq to release, changed only by releasing thread
+            std::atomic<bool> releasing;
+            po6::threads::mutex overflow_mtx;
+            tx_queue_t overflow; // protected by overflow_mtx
+            std::atomic<uint64_t> overflow_size;
+
+            void put(uint64_t epoch, uint64_t seq, std::shared_ptr<transaction::pending_tx> tx);
+            bool find_next(bool take, std::shared_ptr<transaction::pending_tx> &tx);
+
+        public:
+            tx_sequencer();
+
+            void publish(std::shared_ptr<transaction::pending_tx> tx);
+            // seq used for something other than a tx, e.g. node prog timestamp
+            void skip(uint64_t epoch, uint64_t seq);
+
+            // become the releasing thread, false if some other thread is releasing
+            bool try_begin();
+            void end();
+            // caution: caller must be the releasing thread
+            // false if next seq is not yet published
+            // else tx is next tx, or nullptr for a skipped seq, failed tx or epoch change
+            bool pop(std::shared_ptr<transaction::pending_tx> &tx);
+            // true if next seq is published, caller need not be the releasing thread
+            // call after end(), to not miss a tx published while this thread was releasing
+            bool ready();
+            // restart at seq 1 of epoch, when there are no outstanding txs
+            void reset(uint64_t epoch);
+    };
+
+    inline
+    tx_sequencer :: tx_sequencer()
+        : out_epoch(0)
+        , out_seq(1)
+        , releasing(false)
+        , overflow_size(0)
+    { }
+
+    inline void
+    tx_sequencer :: put(uint64_t epoch, uint64_t seq, std::shared_ptr<transaction::pending_tx> tx)
+    {
+        slot &s = slots[seq % VT_SEQ_SLOTS];
+        uint32_t expected = EMPTY;
+        if (s.state.compare_exchange_strong(expected, BUSY)) {
+            s.epoch = epoch;
+            s.seq = seq;
+            s.tx = std::move(tx);
+            s.state = FULL;
+        } else {
+            if (tx == nullptr) {
+                tx = std::make_shared<transaction::pending_tx>(transaction::FAIL);
+                tx->timestamp.clock = vc::vclock_t(1, epoch);
+                tx->vt_seq = seq;
+            }
+            overflow_mtx.lock();
+            overflow.emplace(tx);
+            overflow_size++;
+            overflow_mtx.unlock();
+        }
+    }
+
+    inline void
+    tx_sequencer :: publish(std::shared_ptr<transaction::pending_tx> tx)
+    {
+        uint64_t epoch = tx->timestamp.get_epoch();
+        uint64_t seq = tx->vt_seq;
+        put(epoch, seq, std::move(tx));
+    }
+
+    inline void
+    tx_sequencer :: skip(uint64_t epoch, uint64_t seq)
+    {
+        put(epoch, seq, nullptr);
+    }
+
+    inline bool
+    tx_sequencer :: try_begin()
+    {
+        bool expected = false;
+        return releasing.compare_exchange_strong(expected, true);
+    }
+
+    inline void
+    tx_sequencer :: end()
+    {
+        releasing = false;
+    }
+
+    // look for next seq in its slot and then in overflow queue, remove it if take is true
+    inline bool
+    tx_sequencer :: find_next(bool take, std::shared_ptr<transaction::pending_tx> &tx)
+    {
+        uint64_t epoch = out_epoch;
+        uint64_t seq = out_seq;
+
+        slot &s = slots[seq % VT_SEQ_SLOTS];
+        if (s.state == FULL && s.epoch == epoch && s.seq == seq) {
+            if (take) {
+                tx = std::move(s.tx);
+                s.state = EMPTY;
+            }
+            return true;
+        }
+
+        bool found = false;
+        if (overflow_size > 0) {
+            overflow_mtx.lock();
+            if (!overflow.empty()) {
+                std::shared_ptr<transaction::pending_tx> top = overflow.top();
+                if (top->timestamp.get_epoch() == epoch && top->vt_seq == seq) {
+                    found = true;
+                    if (take) {
+                        overflow.pop();
+                        overflow_size--;
+                        tx = std::move(top);
+                    }
+                }
+            }
+            overflow_mtx.unlock();
+        }
+
+        return found;
+    }
+
+    inline bool
+    tx_sequencer :: pop(std::shared_ptr<transaction::pending_tx> &tx)
+    {
+        tx = nullptr;
+        if (!find_next(true, tx)) {
+            return false;
+        }
+
+        if (tx != nullptr && tx->type == transaction::EPOCH_CHANGE) {
+            out_epoch = tx->new_epoch;
+            out_seq = 1;
+            tx = nullptr;
+        } else {
+            out_seq++;
+            if (tx != nullptr && tx->type == transaction::FAIL) {
+                tx = nullptr;
+            }
+        }
+
+        return true;
+    }
+
+    inline bool
+    tx_sequencer :: ready()
+    {
+        std::shared_ptr<transaction::pending_tx> dummy;
+        return find_next(false, dummy);
+    }
+
+    inline void
+    tx_sequencer :: reset(uint64_t epoch)
+    {
+        while (!try_begin()) {
+            // wait for releasing thread, which has nothing left to release
+        }
+        out_epoch = epoch;
+        out_seq = 1;
+        end();
+    }
+}
+
+#endif
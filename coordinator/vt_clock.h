@@ -0,0 +1,192 @@
+/*
+ * ===============================================================
+ *    Description:  Vector clock of a timestamper, incremented by
+ *                  all VT threads without a lock.
+ *
+ *        Created:  2014-10-16 17:05:21
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#ifndef weaver_coordinator_vt_clock_h_
+#define weaver_coordinator_vt_clock_h_
+
+#include <atomic>
+#include <po6/threads/mutex.h>
+
+#include "common/vclock.h"
+#include "common/config_constants.h"
+#include "coordinator/vt_constants.h"
+
+namespace coordinator
+{
+    // own entry and epoch number are packed in a single word, so each timestamp is a single fetch_add
+    // the own entry doubles as the tx sequence number of the out queue, see tx_sequencer
+    // entries of other VTs change only on clock gossip and epoch change, these writers are serialized
+    // and make gen odd while they write, readers retry or fail if gen changed during their snapshot
+    class vt_clock
+    {
+        private:
+            uint64_t vt_id;
+            std::atomic<uint64_t> own; // (epoch << VT_CLK_COUNTER_BITS) | own entry
+            std::atomic<uint64_t> entries[MAX_CLK_SZ]; // own entry unused
+            std::atomic<uint64_t> gen;
+            po6::threads::mutex write_mtx;
+            uint64_t updates; // protected by write_mtx
+
+            static uint64_t pack(uint64_t epoch, uint64_t counter);
+            static uint64_t get_epoch(uint64_t packed) { return packed >> VT_CLK_COUNTER_BITS; }
+            static uint64_t get_counter(uint64_t packed) { return packed & ((1ULL << VT_CLK_COUNTER_BITS) - 1); }
+            uint64_t snapshot(vc::vclock &clk);
+            void fill_own(vc::vclock &clk, uint64_t packed);
+
+        public:
+            vt_clock();
+            void init(uint64_t vt_id);
+
+            // increment own entry and return the new clock
+            // false if a writer raced with this call, then only epoch and own entry of clk are valid,
+            // and the caller has to skip this seq in the out queue
+            bool next(vc::vclock &clk);
+            // current clock without increment
+            void get(vc::vclock &clk);
+            // clock gossip from another VT
+            void update(const vc::vclock &other);
+            // restart clock with new epoch number
+            // if last is not NULL, it is set to a last timestamp in the old epoch, for the epoch change tx
+            void new_epoch(uint64_t epoch, vc::vclock *last);
+            uint64_t get_updates();
+    };
+
+    inline
+    vt_clock :: vt_clock()
+        : vt_id(UINT64_MAX)
+        , own(0)
+        , gen(0)
+        , updates(0)
+    {
+        for (uint64_t i = 0; i < MAX_CLK_SZ; i++) {
+            entries[i] = 0;
+        }
+    }
+
+    inline void
+    vt_clock :: init(uint64_t vtid)
+    {
+        vt_id = vtid;
+    }
+
+    inline uint64_t
+    vt_clock :: pack(uint64_t epoch, uint64_t counter)
+    {
+        assert(epoch < (1ULL << (64 - VT_CLK_COUNTER_BITS)));
+        assert(counter < (1ULL << VT_CLK_COUNTER_BITS));
+        return (epoch << VT_CLK_COUNTER_BITS) | counter;
+    }
+
+    // returns gen at the start of the snapshot, always even
+    inline uint64_t
+    vt_clock :: snapshot(vc::vclock &clk)
+    {
+        uint64_t g;
+        while ((g = gen.load()) & 1) {
+            // writer holds only for a few stores
+        }
+
+        clk.vt_id = vt_id;
+        clk.clock = vc::vclock_t(ClkSz, 0);
+        for (uint64_t i = 0; i < ClkSz; i++) {
+            clk.clock[i] = entries[i].load();
+        }
+        return g;
+    }
+
+    inline void
+    vt_clock :: fill_own(vc::vclock &clk, uint64_t packed)
+    {
+        clk.clock[0] = get_epoch(packed);
+        clk.clock[vt_id+1] = get_counter(packed);
+    }
+
+    inline bool
+    vt_clock :: next(vc::vclock &clk)
+    {
+        uint64_t g = snapshot(clk);
+        uint64_t packed = own.fetch_add(1) + 1;
+        assert(get_counter(packed) != 0); // counter overflow into epoch bits
+        fill_own(clk, packed);
+        return gen.load() == g;
+    }
+
+    inline void
+    vt_clock :: get(vc::vclock &clk)
+    {
+        uint64_t g, packed;
+        do {
+            g = snapshot(clk);
+            packed = own.load();
+        } while (gen.load() != g);
+        fill_own(clk, packed);
+    }
+
+    inline void
+    vt_clock :: update(const vc::vclock &other)
+    {
+        uint64_t vtid = other.vt_id;
+        assert(vtid < NumVts && vtid != vt_id);
+
+        write_mtx.lock();
+        updates++;
+        if (entries[0].load() == other.clock[0] && entries[vtid+1].load() < other.clock[vtid+1]) {
+            gen++;
+            entries[vtid+1] = other.clock[vtid+1];
+            gen++;
+        }
+        write_mtx.unlock();
+    }
+
+    inline void
+    vt_clock :: new_epoch(uint64_t epoch, vc::vclock *last)
+    {
+        write_mtx.lock();
+        gen++;
+
+        // claim the seq following all timestamps of the old epoch, racing next() calls retry the CAS
+        uint64_t old = own.load();
+        uint64_t next_epoch = pack(epoch, 0);
+        while (!own.compare_exchange_weak(old, next_epoch)) { }
+        assert(get_epoch(old) < epoch);
+
+        if (last != NULL) {
+            last->vt_id = vt_id;
+            last->clock = vc::vclock_t(ClkSz, 0);
+            for (uint64_t i = 0; i < ClkSz; i++) {
+                last->clock[i] = entries[i].load();
+            }
+            fill_own(*last, old + 1);
+        }
+
+        for (uint64_t i = 1; i < MAX_CLK_SZ; i++) {
+            entries[i] = 0;
+        }
+        entries[0] = epoch;
+
+        gen++;
+        write_mtx.unlock();
+    }
+
+    inline uint64_t
+    vt_clock :: get_updates()
+    {
+        write_mtx.lock();
+        uint64_t ret = updates;
+        write_mtx.unlock();
+        return ret;
+    }
+}
+
+#endif
@@ -15,7 +15,15 @@
 #define weaver_coordinator_vt_constants_h_
 
 #define VT_TIMEOUT_NANO 1000 // number of nanoseconds between successive nops
+// nops to a shard are piggybacked on txs to that shard, a standalone nop is sent only if the link is idle
+// the idle delay before a standalone nop doubles while the link stays idle, up to VT_NOP_MAX_NANO
+#define VT_NOP_MAX_NANO 64000
 #define VT_CLK_TIMEOUT_NANO 1000000 // number of nanoseconds between vt gossip
 #define NUM_VT_THREADS 8
+#define VT_GROUP_COMMIT_MAX_TXS 64 // max client txs written to Hyperdex in a single transaction
+#define VT_LOC_CACHE_MAX (1 << 22) // max node locations cached at a VT, see coordinator/loc_cache.h
+// clock and tx sequence assignment, see coordinator/vt_clock.h and coordinator/tx_sequencer.h
+#define VT_CLK_COUNTER_BITS 48 // own clock entry packed with epoch number in a single word
+#define VT_SEQ_SLOTS 4096 // txs which can wait for an earlier seq in the out queue without taking a lock
 
 #endif
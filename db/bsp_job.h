@@ -0,0 +1,149 @@
+/*
+ * ===============================================================
+ *    Description:  State of a bulk synchronous analytics job at a
+ *                  shard, see node_prog/bsp_program.h.
+ *
+ *        Created:  2014-10-16 20:14:05
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#ifndef weaver_db_bsp_job_h_
+#define weaver_db_bsp_job_h_
+
+#include <memory>
+#include <unordered_map>
+#include <po6/threads/mutex.h>
+
+#include "common/types.h"
+#include "common/vclock.h"
+#include "node_prog/bsp_program.h"
+#include "db/shard_constants.h"
+
+namespace db
+{
+    // vertices are partitioned like the node map, by handle stripe
+    // in a superstep, a stripe is run by a single thread, other threads only add to the inbox
+    struct bsp_stripe
+    {
+        std::unordered_map<uint64_t, node_prog::bsp_vertex> vertices; // handle id -> vertex
+        po6::threads::mutex inbox_mtx;
+        std::unordered_map<uint64_t, node_prog::bsp_msg> inbox[2]; // by parity of the superstep that reads it
+    };
+
+    // a superstep starts when the timestamper has asked for it, and messages sent to this shard
+    // in the previous superstep have arrived from every other shard
+    // messages from shards that are already done with superstep s can arrive while this shard
+    // still runs s, they go to the other inbox
+    class bsp_job
+    {
+        public:
+            uint64_t req_id;
+            uint64_t vt_id;
+            std::shared_ptr<vc::vclock> snapshot; // graph is read at this clock in superstep 0
+            node_prog::bsp_params params;
+            bsp_stripe stripes[NUM_HANDLE_STRIPES];
+
+        private:
+            po6::threads::mutex mtx;
+            uint64_t requested_step; // UINT64_MAX if none
+            node_prog::bsp_stats requested_totals;
+            uint64_t msgs_received[2]; // BSP_MSGS from other shards, by parity of the superstep that reads them
+            bool running;
+
+        public:
+            bsp_job(uint64_t req_id);
+
+            // record superstep asked for by the timestamper
+            void request(uint64_t step, const node_prog::bsp_stats &totals);
+            // record messages from another shard for the given superstep
+            void add_msgs(uint64_t step, std::unordered_map<uint64_t, node_prog::bsp_msg> &msgs);
+            void add_msg(uint64_t step, uint64_t handle_id, const node_prog::bsp_msg &msg);
+            void count_msgs(uint64_t step);
+            // true if caller should run a superstep now, which it must follow with end_step()
+            bool try_start(uint64_t num_shards, uint64_t &step, node_prog::bsp_stats &totals);
+            void end_step();
+    };
+
+    inline
+    bsp_job :: bsp_job(uint64_t rid)
+        : req_id(rid)
+        , vt_id(UINT64_MAX)
+        , requested_step(UINT64_MAX)
+        , running(false)
+    {
+        msgs_received[0] = 0;
+        msgs_received[1] = 0;
+    }
+
+    inline void
+    bsp_job :: request(uint64_t step, const node_prog::bsp_stats &totals)
+    {
+        mtx.lock();
+        assert(requested_step == UINT64_MAX);
+        requested_step = step;
+        requested_totals = totals;
+        mtx.unlock();
+    }
+
+    inline void
+    bsp_job :: add_msg(uint64_t step, uint64_t handle_id, const node_prog::bsp_msg &msg)
+    {
+        bsp_stripe &stripe = stripes[handle_id & (NUM_HANDLE_STRIPES-1)];
+        stripe.inbox_mtx.lock();
+        stripe.inbox[step % 2][handle_id].combine(msg);
+        stripe.inbox_mtx.unlock();
+    }
+
+    inline void
+    bsp_job :: add_msgs(uint64_t step, std::unordered_map<uint64_t, node_prog::bsp_msg> &msgs)
+    {
+        for (auto &p: msgs) {
+            add_msg(step, p.first, p.second);
+        }
+    }
+
+    inline void
+    bsp_job :: count_msgs(uint64_t step)
+    {
+        mtx.lock();
+        msgs_received[step % 2]++;
+        mtx.unlock();
+    }
+
+    inline bool
+    bsp_job :: try_start(uint64_t num_shards, uint64_t &step, node_prog::bsp_stats &totals)
+    {
+        bool start = false;
+
+        mtx.lock();
+        if (!running
+         && requested_step != UINT64_MAX
+         && (requested_step == 0 || msgs_received[requested_step % 2] == num_shards-1)) {
+            start = true;
+            running = true;
+            step = requested_step;
+            totals = requested_totals;
+            msgs_received[step % 2] = 0;
+            requested_step = UINT64_MAX;
+        }
+        mtx.unlock();
+
+        return start;
+    }
+
+    inline void
+    bsp_job :: end_step()
+    {
+        mtx.lock();
+        assert(running);
+        running = false;
+        mtx.unlock();
+    }
+}
+
+#endif
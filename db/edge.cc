@@ -20,6 +20,7 @@ using db::element::remote_node;
 // empty constructor for unpacking
 edge :: edge()
     : base()
+    , nbr_id(UINT64_MAX)
 #ifdef WEAVER_CLDG
     , msg_count(0)
 #endif
@@ -32,6 +33,7 @@ edge :: edge()
 edge :: edge(const edge_handle_t &handle, vc::vclock &vclk, uint64_t remote_loc, const node_handle_t &remote_handle)
     : base(handle, vclk)
     , nbr(remote_loc, remote_handle)
+    , nbr_id(UINT64_MAX)
 #ifdef WEAVER_CLDG
     , msg_count(0)
 #endif
@@ -44,6 +46,7 @@ edge :: edge(const edge_handle_t &handle, vc::vclock &vclk, uint64_t remote_loc,
 edge :: edge(const edge_handle_t &handle, vc::vclock &vclk, remote_node &rn)
     : base(handle, vclk)
     , nbr(rn)
+    , nbr_id(UINT64_MAX)
 #ifdef WEAVER_CLDG
     , msg_count(0)
 #endif
@@ -35,10 +35,16 @@ namespace element
             edge(const edge_handle_t &handle, vc::vclock &vclk, uint64_t remote_loc, const node_handle_t &remote_handle);
             edge(const edge_handle_t &handle, vc::vclock &vclk, remote_node &rn);
             ~edge() { }
+            // edges are moved around within a node's edge_table
+            edge(const edge&) = default;
+            edge(edge&&) = default;
+            edge& operator=(const edge&) = default;
+            edge& operator=(edge&&) = default;
 
         public:
             element base;
             remote_node nbr; // out-neighbor for this edge
+            uint64_t nbr_id; // id of nbr.handle in the shard handle table, holds a reference there; not packed
 #ifdef WEAVER_CLDG
             uint32_t msg_count; // number of messages sent on this link
 #endif
@@ -0,0 +1,140 @@
+/*
+ * ===============================================================
+ *    Description:  Contiguous storage for the out-edges of a node.
+ *
+ *        Created:  2014-10-10 15:02:37
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#ifndef weaver_db_element_edge_table_h_
+#define weaver_db_element_edge_table_h_
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+#include <unordered_map>
+
+#include "db/mem_pool.h"
+#include "db/edge.h"
+
+namespace db
+{
+namespace element
+{
+    // edges are stored by value in a single array, so scanning all out-edges of a node
+    // is a linear walk instead of pointer chasing through hash buckets and separately allocated edges
+    // a side index maps edge handle to slot, for the less frequent lookups by handle
+    // the array is served from the slab pool, and accounted as edge memory
+    // caution: adding or removing an edge may move other edges, do not hold edge pointers across updates
+    class edge_table
+    {
+        private:
+            typedef std::vector<edge, pool_allocator<edge, EDGE_MEM>> slot_vector;
+            slot_vector slots;
+            std::unordered_map<edge_handle_t, uint32_t> index; // edge handle -> slot
+
+        public:
+            typedef slot_vector::iterator iterator;
+            typedef slot_vector::const_iterator const_iterator;
+
+            iterator begin() { return slots.begin(); }
+            iterator end() { return slots.end(); }
+            const_iterator begin() const { return slots.begin(); }
+            const_iterator end() const { return slots.end(); }
+            uint64_t size() const { return slots.size(); }
+            bool empty() const { return slots.empty(); }
+            void reserve(uint64_t sz);
+            void clear();
+
+            template <typename... Args> edge* emplace(Args&&... args);
+            edge* add(edge &&e);
+            edge* find(const edge_handle_t &handle);
+            const edge* find(const edge_handle_t &handle) const;
+            bool contains(const edge_handle_t &handle) const { return index.find(handle) != index.end(); }
+            bool erase(const edge_handle_t &handle);
+    };
+
+    inline void
+    edge_table :: reserve(uint64_t sz)
+    {
+        slots.reserve(sz);
+        index.reserve(sz);
+    }
+
+    inline void
+    edge_table :: clear()
+    {
+        slots.clear();
+        index.clear();
+    }
+
+    // construct edge in place, returns NULL if edge with the same handle already exists
+    template <typename... Args>
+    inline edge*
+    edge_table :: emplace(Args&&... args)
+    {
+        slots.emplace_back(std::forward<Args>(args)...);
+        edge &e = slots.back();
+        if (!index.emplace(e.get_handle(), slots.size()-1).second) {
+            slots.pop_back();
+            return NULL;
+        }
+        return &e;
+    }
+
+    // returns NULL if edge with the same handle already exists
+    inline edge*
+    edge_table :: add(edge &&e)
+    {
+        return emplace(std::move(e));
+    }
+
+    inline edge*
+    edge_table :: find(const edge_handle_t &handle)
+    {
+        auto iter = index.find(handle);
+        if (iter == index.end()) {
+            return NULL;
+        }
+        return &slots[iter->second];
+    }
+
+    inline const edge*
+    edge_table :: find(const edge_handle_t &handle) const
+    {
+        auto iter = index.find(handle);
+        if (iter == index.end()) {
+            return NULL;
+        }
+        return &slots[iter->second];
+    }
+
+    // move last edge in to the freed slot, so that slots stay contiguous
+    inline bool
+    edge_table :: erase(const edge_handle_t &handle)
+    {
+        auto iter = index.find(handle);
+        if (iter == index.end()) {
+            return false;
+        }
+        uint32_t slot = iter->second;
+        index.erase(iter);
+
+        uint32_t last = slots.size() - 1;
+        if (slot != last) {
+            slots[slot] = std::move(slots[last]);
+            index[slots[slot].get_handle()] = slot;
+        }
+        slots.pop_back();
+
+        return true;
+    }
+}
+}
+
+#endif
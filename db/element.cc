@@ -17,11 +17,13 @@
 using db::element::element;
 using db::element::property;
 
+thread_local std::shared_ptr<vc::vclock> element::view_time;
+thread_local order::oracle* element::time_oracle = nullptr;
+
 element :: element(const std::string &_handle, vc::vclock &vclk)
     : handle(_handle)
     , creat_time(vclk)
     , del_time(UINT64_MAX, UINT64_MAX)
-    , time_oracle(nullptr)
 { }
 
 void
@@ -61,8 +63,15 @@ element :: has_property(const std::string &key, const std::string &value)
         const vc::vclock& vclk_creat = prop.get_creat_time();
         const vc::vclock& vclk_del = prop.get_del_time();
         int64_t cmp1 = time_oracle->compare_two_vts(*view_time, vclk_creat);
+        if (cmp1 < 1) {
+            return false;
+        }
+        // live property is always deleted after the view
+        if (!prop.is_deleted()) {
+            return true;
+        }
         int64_t cmp2 = time_oracle->compare_two_vts(*view_time, vclk_del);
-        if (cmp1 >= 1 && cmp2 == 0) {
+        if (cmp2 == 0) {
             return true;
         }
     }
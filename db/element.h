@@ -42,8 +42,10 @@ namespace element
 
         public:
             std::unordered_map<std::string, property> properties;
-            std::shared_ptr<vc::vclock> view_time;
-            order::oracle *time_oracle;
+            // view of the node program running on this thread
+            // thread local so that many programs can read an element concurrently
+            static thread_local std::shared_ptr<vc::vclock> view_time;
+            static thread_local order::oracle *time_oracle;
 
         public:
             void add_property(const property &prop);
@@ -57,6 +59,7 @@ namespace element
             const std::unordered_map<std::string, property>* get_props() const;
             void update_del_time(vc::vclock &del_time);
             const vc::vclock& get_del_time() const;
+            bool is_deleted() const { return del_time.vt_id != UINT64_MAX; }
             void update_creat_time(vc::vclock &creat_time);
             const vc::vclock& get_creat_time() const;
             void set_handle(const std::string &handle);
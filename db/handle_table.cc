@@ -0,0 +1,122 @@
+/*
+ * ===============================================================
+ *    Description:  Implementation of shard handle interning.
+ *
+ *        Created:  2014-10-13 11:58:12
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#include <assert.h>
+
+#define weaver_debug_
+#include "common/weaver_constants.h"
+#include "db/handle_table.h"
+
+using db::handle_table;
+
+// return id for handle, assign a new one if handle not interned
+// takes a reference on the id, which the caller must release
+uint64_t
+handle_table :: intern(const node_handle_t &handle)
+{
+    uint64_t hash = hash_node_handle(handle);
+    uint64_t stripe_idx = hash & (NUM_HANDLE_STRIPES-1);
+    handle_stripe &stripe = stripes[stripe_idx];
+    uint64_t idx = UINT64_MAX;
+
+    stripe.lock.wrlock();
+    auto range = stripe.ids.equal_range(hash);
+    for (auto iter = range.first; iter != range.second; iter++) {
+        if (stripe.handles[iter->second] == handle) {
+            idx = iter->second;
+            break;
+        }
+    }
+    if (idx == UINT64_MAX) {
+        if (stripe.free_idx.empty()) {
+            idx = stripe.handles.size();
+            stripe.handles.emplace_back(handle);
+            stripe.refs.emplace_back(1);
+        } else {
+            idx = stripe.free_idx.back();
+            stripe.free_idx.pop_back();
+            stripe.handles[idx] = handle;
+            stripe.refs[idx] = 1;
+        }
+        stripe.ids.emplace(hash, idx);
+    } else {
+        stripe.refs[idx]++;
+    }
+    stripe.lock.unlock();
+
+    return (idx << HANDLE_STRIPE_BITS) | stripe_idx;
+}
+
+// drop a reference taken by intern, free the id when none remain
+void
+handle_table :: release(uint64_t id)
+{
+    handle_stripe &stripe = stripes[id & (NUM_HANDLE_STRIPES-1)];
+    uint64_t idx = id >> HANDLE_STRIPE_BITS;
+
+    stripe.lock.wrlock();
+    assert(idx < stripe.refs.size());
+    assert(stripe.refs[idx] > 0);
+    if (--stripe.refs[idx] == 0) {
+        auto range = stripe.ids.equal_range(hash_node_handle(stripe.handles[idx]));
+        for (auto iter = range.first; iter != range.second; iter++) {
+            if (iter->second == idx) {
+                stripe.ids.erase(iter);
+                break;
+            }
+        }
+        node_handle_t().swap(stripe.handles[idx]);
+        stripe.free_idx.emplace_back(idx);
+    }
+    stripe.lock.unlock();
+}
+
+// return false if handle is not interned on this shard
+// does not take a reference
+bool
+handle_table :: lookup(const node_handle_t &handle, uint64_t &id)
+{
+    uint64_t hash = hash_node_handle(handle);
+    uint64_t stripe_idx = hash & (NUM_HANDLE_STRIPES-1);
+    handle_stripe &stripe = stripes[stripe_idx];
+    bool found = false;
+
+    stripe.lock.rdlock();
+    auto range = stripe.ids.equal_range(hash);
+    for (auto iter = range.first; iter != range.second; iter++) {
+        if (stripe.handles[iter->second] == handle) {
+            id = (iter->second << HANDLE_STRIPE_BITS) | stripe_idx;
+            found = true;
+            break;
+        }
+    }
+    stripe.lock.unlock();
+
+    return found;
+}
+
+// materialize the handle string for an id returned by intern
+// empty if the id has been freed
+node_handle_t
+handle_table :: get_handle(uint64_t id)
+{
+    handle_stripe &stripe = stripes[id & (NUM_HANDLE_STRIPES-1)];
+    uint64_t idx = id >> HANDLE_STRIPE_BITS;
+
+    stripe.lock.rdlock();
+    assert(idx < stripe.handles.size());
+    node_handle_t handle = stripe.handles[idx];
+    stripe.lock.unlock();
+
+    return handle;
+}
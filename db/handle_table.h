@@ -0,0 +1,58 @@
+/*
+ * ===============================================================
+ *    Description:  Shard-local interning of node handles to dense
+ *                  64-bit ids.
+ *
+ *        Created:  2014-10-13 11:26:50
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#ifndef weaver_db_handle_table_h_
+#define weaver_db_handle_table_h_
+
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <po6/threads/rwlock.h>
+
+#include "common/types.h"
+#include "db/shard_constants.h"
+
+namespace db
+{
+    struct handle_stripe
+    {
+        po6::threads::rwlock lock; // lookups share, intern and release are exclusive
+        std::unordered_multimap<uint64_t, uint64_t> ids; // hash of handle -> index in handles
+        std::deque<node_handle_t> handles; // index -> handle
+        std::deque<uint64_t> refs; // index -> number of references held on the id
+        std::vector<uint64_t> free_idx; // released indices, reused by intern
+    };
+
+    // maps each node handle seen by this shard to an id, so that shard structures are keyed by
+    // 8-byte integers instead of strings
+    // handles are striped by hash, and id = (index within stripe << HANDLE_STRIPE_BITS) | stripe,
+    // so the stripe can be read off the id, and the node map (db/node_map.h) indexes nodes by it directly
+    // the handle string is hashed once per lookup, stripe maps are keyed by the hash value
+    // each intern takes a reference on the id, held by a node at this shard or by an out-edge pointing at the handle
+    // an id whose last reference is released is freed and may later be assigned to a different handle,
+    // so holders of a bare id (node program state, bsp jobs) must not outlive the node it names
+    class handle_table
+    {
+        private:
+            handle_stripe stripes[NUM_HANDLE_STRIPES];
+
+        public:
+            uint64_t intern(const node_handle_t &handle);
+            void release(uint64_t id);
+            bool lookup(const node_handle_t &handle, uint64_t &id);
+            node_handle_t get_handle(uint64_t id);
+    };
+}
+
+#endif
@@ -15,18 +15,20 @@
 #include "common/weaver_constants.h"
 #include "common/config_constants.h"
 #include "db/shard_constants.h"
+#include "db/mem_pool.h"
 #include "db/hyper_stub.h"
 
 using db::hyper_stub;
+using db::mem_pool;
 
 hyper_stub :: hyper_stub(uint64_t sid)
     : shard_id(sid)
 { }
 
 void
-hyper_stub :: restore_backup(std::unordered_map<node_handle_t, element::node*> *nodes,
-    std::unordered_map<node_handle_t, std::unordered_set<node_handle_t>> &edge_map,
-    po6::threads::mutex *shard_mutexes)
+hyper_stub :: restore_backup(node_map &nodes,
+    std::unordered_map<uint64_t, std::unordered_set<uint64_t>> &edge_map,
+    handle_table &handles)
 {
     const hyperdex_client_attribute *cl_attr;
     size_t num_attrs;
@@ -118,46 +120,48 @@ hyper_stub :: restore_backup(std::unordered_map<node_handle_t, element::node*> *
 
     vc::vclock dummy_clock;
     element::node *n;
-    uint64_t map_idx;
     for (uint64_t i = 0; i < node_list.size(); i++) {
         assert(attr_sz_array[i] == NUM_GRAPH_ATTRS);
 
         const node_handle_t &node_handle = node_list[i];
-        map_idx = hash_node_handle(node_handle) % NUM_NODE_MAPS;
-        n = new element::node(node_handle, dummy_clock, shard_mutexes+map_idx);
+        uint64_t handle_id = handles.intern(node_handle);
+        n = mem_pool::get().create<element::node>(NODE_MEM, node_handle, dummy_clock);
+        n->handle_id = handle_id;
 
         recreate_node(cl_attr_array[i], *n);
 
         // edge map
-        for (const auto &p: n->out_edges) {
-            edge_map[p.second->nbr.handle].emplace(node_handle);
+        for (element::edge &e: n->out_edges) {
+            e.nbr_id = handles.intern(e.nbr.handle);
+            edge_map[e.nbr_id].emplace(handle_id);
         }
 
         // node map
-        auto &node_map = nodes[map_idx];
-        assert(node_map.find(node_handle) == node_map.end());
-        node_map.emplace(node_handle, n);
+        bool success = nodes.insert(handle_id, n);
+        assert(success);
+        UNUSED(success);
 
         hyperdex_client_destroy_attrs(cl_attr_array[i], attr_sz_array[i]);
     }
 }
 
 void
-hyper_stub :: bulk_load(int tid, std::unordered_map<node_handle_t, element::node*> *nodes_arr)
+hyper_stub :: bulk_load(int tid, node_map *nodes)
 {
-    assert(NUM_NODE_MAPS % NUM_SHARD_THREADS == 0);
+    assert(NUM_HANDLE_STRIPES % NUM_SHARD_THREADS == 0);
     std::vector<node_handle_t> node_handles;
 
-    for (; tid < NUM_NODE_MAPS; tid += NUM_SHARD_THREADS) {
-        std::unordered_map<node_handle_t, element::node*> &node_map = nodes_arr[tid];
-        node_handles.reserve(node_handles.size() + node_map.size());
-        for (auto &p: node_map) {
+    for (; tid < NUM_HANDLE_STRIPES; tid += NUM_SHARD_THREADS) {
+        std::unordered_map<uint64_t, element::node*> stripe_nodes;
+        nodes->get_stripe(tid, stripe_nodes);
+        node_handles.reserve(node_handles.size() + stripe_nodes.size());
+        for (auto &p: stripe_nodes) {
             // TODO change when single space for mapping and graph data
             //put_mapping(p.first, shard_id);
             //put_node(*p.second);
-            node_handles.emplace_back(p.first);
+            node_handles.emplace_back(p.second->get_handle());
         }
-        put_nodes_bulk(node_map);
+        put_nodes_bulk(stripe_nodes);
     }
 
     WDEBUG << "put nmap " << node_handles.size() << std::endl;
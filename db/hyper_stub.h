@@ -20,6 +20,8 @@
 #include "common/vclock.h"
 #include "db/node.h"
 #include "db/edge.h"
+#include "db/handle_table.h"
+#include "db/node_map.h"
 
 namespace db
 {
@@ -36,11 +38,11 @@ namespace db
 
         public:
             hyper_stub(uint64_t sid);
-            void restore_backup(std::unordered_map<node_handle_t, element::node*> *nodes,
-                std::unordered_map<node_handle_t, std::unordered_set<node_handle_t>> &edge_map,
-                po6::threads::mutex *shard_mutexes);
+            void restore_backup(node_map &nodes,
+                std::unordered_map<uint64_t, std::unordered_set<uint64_t>> &edge_map,
+                handle_table &handles);
             // bulk loading
-            void bulk_load(int tid, std::unordered_map<node_handle_t, element::node*> *nodes);
+            void bulk_load(int tid, node_map *nodes);
             // migration
             bool update_mapping(const node_handle_t &handle, uint64_t loc);
     };
@@ -0,0 +1,202 @@
+/*
+ * ===============================================================
+ *    Description:  Implementation of graph element slab pools.
+ *
+ *        Created:  2014-10-14 10:47:05
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#define weaver_debug_
+#include <stdlib.h>
+#include <assert.h>
+#include "common/weaver_constants.h"
+#include "db/mem_pool.h"
+
+using db::mem_pool;
+
+thread_local db::slab_cache mem_pool::cache;
+
+// return size class for an allocation of sz bytes, NUM_SLAB_CLASSES if too large for slabs
+static inline uint64_t
+size_class(uint64_t sz)
+{
+    uint64_t cls = 0;
+    uint64_t slot = SLAB_MIN_SLOT;
+    while (slot < sz && cls < NUM_SLAB_CLASSES) {
+        slot <<= 1;
+        cls++;
+    }
+    return cls;
+}
+
+mem_pool :: mem_pool()
+{
+    for (uint64_t i = 0; i < NUM_SLAB_CLASSES; i++) {
+        classes[i].slot_size = ((uint64_t)SLAB_MIN_SLOT) << i;
+        classes[i].free_list = NULL;
+        classes[i].free_count = 0;
+        classes[i].total_slots = 0;
+    }
+    for (int i = 0; i < NUM_MEM_TYPES; i++) {
+        live[i] = 0;
+    }
+}
+
+// never destroyed, element containers may be freed during static destruction
+mem_pool&
+mem_pool :: get()
+{
+    static mem_pool *pool = new mem_pool();
+    return *pool;
+}
+
+// move SLAB_CACHE_SLOTS free slots from shared list to this thread's cache, carving a new slab if required
+void
+mem_pool :: refill(uint64_t cls)
+{
+    slab_class &sc = classes[cls];
+
+    sc.mtx.lock();
+    if (sc.free_count < SLAB_CACHE_SLOTS) {
+        uint64_t slab_sz = SLAB_BYTES;
+        if (slab_sz < sc.slot_size * SLAB_CACHE_SLOTS) {
+            slab_sz = sc.slot_size * SLAB_CACHE_SLOTS;
+        }
+        uint64_t num_slots = slab_sz / sc.slot_size;
+        char *slab = (char*)malloc(slab_sz);
+        assert(slab != NULL);
+        sc.slabs.emplace_back(slab);
+        for (uint64_t i = 0; i < num_slots; i++) {
+            void *slot = slab + i*sc.slot_size;
+            *(void**)slot = sc.free_list;
+            sc.free_list = slot;
+        }
+        sc.free_count += num_slots;
+        sc.total_slots += num_slots;
+    }
+
+    for (uint64_t i = 0; i < SLAB_CACHE_SLOTS; i++) {
+        void *slot = sc.free_list;
+        sc.free_list = *(void**)slot;
+        *(void**)slot = cache.head[cls];
+        cache.head[cls] = slot;
+    }
+    sc.free_count -= SLAB_CACHE_SLOTS;
+    cache.count[cls] += SLAB_CACHE_SLOTS;
+    sc.mtx.unlock();
+
+    flush_stats();
+}
+
+// return SLAB_CACHE_SLOTS free slots from this thread's cache to shared list
+void
+mem_pool :: spill(uint64_t cls)
+{
+    slab_class &sc = classes[cls];
+
+    sc.mtx.lock();
+    for (uint64_t i = 0; i < SLAB_CACHE_SLOTS; i++) {
+        void *slot = cache.head[cls];
+        cache.head[cls] = *(void**)slot;
+        *(void**)slot = sc.free_list;
+        sc.free_list = slot;
+    }
+    sc.free_count += SLAB_CACHE_SLOTS;
+    cache.count[cls] -= SLAB_CACHE_SLOTS;
+    sc.mtx.unlock();
+
+    flush_stats();
+}
+
+// fold this thread's accounting into pool totals
+void
+mem_pool :: flush_stats()
+{
+    stats_mtx.lock();
+    for (int i = 0; i < NUM_MEM_TYPES; i++) {
+        live[i] += cache.live[i];
+        cache.live[i] = 0;
+    }
+    stats_mtx.unlock();
+}
+
+void*
+mem_pool :: alloc(uint64_t sz, mem_type type)
+{
+    uint64_t cls = size_class(sz);
+    if (cls == NUM_SLAB_CLASSES) {
+        cache.live[type] += sz;
+        flush_stats();
+        void *ptr = malloc(sz);
+        assert(ptr != NULL);
+        return ptr;
+    }
+
+    if (cache.count[cls] == 0) {
+        refill(cls);
+    }
+    void *slot = cache.head[cls];
+    cache.head[cls] = *(void**)slot;
+    cache.count[cls]--;
+    cache.live[type] += classes[cls].slot_size;
+
+    return slot;
+}
+
+// sz must be the size passed to alloc
+// slot may be freed by a thread other than the one which allocated it
+void
+mem_pool :: free(void *ptr, uint64_t sz, mem_type type)
+{
+    if (ptr == NULL) {
+        return;
+    }
+
+    uint64_t cls = size_class(sz);
+    if (cls == NUM_SLAB_CLASSES) {
+        cache.live[type] -= sz;
+        flush_stats();
+        ::free(ptr);
+        return;
+    }
+
+    *(void**)ptr = cache.head[cls];
+    cache.head[cls] = ptr;
+    cache.count[cls]++;
+    cache.live[type] -= classes[cls].slot_size;
+
+    if (cache.count[cls] > 2*SLAB_CACHE_SLOTS) {
+        spill(cls);
+    }
+}
+
+uint64_t
+mem_pool :: live_bytes(mem_type type)
+{
+    stats_mtx.lock();
+    int64_t bytes = live[type];
+    stats_mtx.unlock();
+
+    return bytes < 0? 0 : bytes;
+}
+
+// memory held in slabs, including free slots
+uint64_t
+mem_pool :: reserved_bytes()
+{
+    uint64_t bytes = 0;
+    for (uint64_t i = 0; i < NUM_SLAB_CLASSES; i++) {
+        classes[i].mtx.lock();
+        bytes += classes[i].total_slots * classes[i].slot_size;
+        classes[i].mtx.unlock();
+    }
+
+    return bytes;
+}
+
+#undef weaver_debug_
@@ -0,0 +1,150 @@
+/*
+ * ===============================================================
+ *    Description:  Size-class slab pools for graph elements, with
+ *                  thread-local free slot caches and per-type
+ *                  memory accounting.
+ *
+ *        Created:  2014-10-14 10:12:31
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#ifndef weaver_db_mem_pool_h_
+#define weaver_db_mem_pool_h_
+
+#include <stdint.h>
+#include <cstddef>
+#include <new>
+#include <limits>
+#include <vector>
+#include <utility>
+#include <po6/threads/mutex.h>
+
+#include "db/shard_constants.h"
+
+namespace db
+{
+    enum mem_type
+    {
+        NODE_MEM = 0,
+        EDGE_MEM,
+        NUM_MEM_TYPES
+    };
+
+    // free slots of a single size class, carved out of slabs which are never returned to the OS
+    struct slab_class
+    {
+        po6::threads::mutex mtx;
+        uint64_t slot_size;
+        void *free_list; // singly linked through the first word of each free slot
+        uint64_t free_count;
+        uint64_t total_slots;
+        std::vector<char*> slabs;
+    };
+
+    // per-thread free slots, and memory accounting not yet folded into the pool totals
+    struct slab_cache
+    {
+        void *head[NUM_SLAB_CLASSES];
+        uint64_t count[NUM_SLAB_CLASSES];
+        int64_t live[NUM_MEM_TYPES];
+    };
+
+    // allocations up to SLAB_MAX_SLOT bytes are rounded up to a power of two size class and served from slabs
+    // each thread keeps up to 2*SLAB_CACHE_SLOTS free slots per class and touches the class mutex only
+    // to refill or spill SLAB_CACHE_SLOTS slots at a time, so a freed slot is usually reused by the same thread
+    // larger allocations go to malloc
+    // there is a single pool per process, use mem_pool::get()
+    class mem_pool
+    {
+        private:
+            slab_class classes[NUM_SLAB_CLASSES];
+            po6::threads::mutex stats_mtx;
+            int64_t live[NUM_MEM_TYPES]; // protected by stats_mtx
+            static thread_local slab_cache cache;
+
+            mem_pool();
+            mem_pool(const mem_pool&);
+            mem_pool& operator=(const mem_pool&);
+
+            void refill(uint64_t cls);
+            void spill(uint64_t cls);
+            void flush_stats();
+
+        public:
+            static mem_pool& get();
+
+            void* alloc(uint64_t sz, mem_type type);
+            void free(void *ptr, uint64_t sz, mem_type type);
+            template <typename T, typename... Args> T* create(mem_type type, Args&&... args);
+            template <typename T> void destroy(T *obj, mem_type type);
+
+            // live bytes lag behind by at most the allocations since each thread last refilled or spilled its cache
+            uint64_t live_bytes(mem_type type);
+            uint64_t reserved_bytes();
+    };
+
+    template <typename T, typename... Args>
+    inline T*
+    mem_pool :: create(mem_type type, Args&&... args)
+    {
+        void *ptr = alloc(sizeof(T), type);
+        return new (ptr) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    inline void
+    mem_pool :: destroy(T *obj, mem_type type)
+    {
+        obj->~T();
+        free(obj, sizeof(T), type);
+    }
+
+    // stl allocator which serves containers of graph elements from the process mem_pool
+    template <typename T, mem_type M>
+    class pool_allocator
+    {
+        public:
+            typedef T value_type;
+            typedef T* pointer;
+            typedef const T* const_pointer;
+            typedef T& reference;
+            typedef const T& const_reference;
+            typedef std::size_t size_type;
+            typedef std::ptrdiff_t difference_type;
+
+            template <typename U> struct rebind { typedef pool_allocator<U, M> other; };
+
+            pool_allocator() { }
+            template <typename U> pool_allocator(const pool_allocator<U, M>&) { }
+
+            T* allocate(std::size_t n) { return (T*)mem_pool::get().alloc(n * sizeof(T), M); }
+            void deallocate(T *ptr, std::size_t n) { mem_pool::get().free(ptr, n * sizeof(T), M); }
+            std::size_t max_size() const { return std::numeric_limits<std::size_t>::max() / sizeof(T); }
+
+            template <typename U, typename... Args>
+            void construct(U *ptr, Args&&... args) { new ((void*)ptr) U(std::forward<Args>(args)...); }
+            template <typename U>
+            void destroy(U *ptr) { ptr->~U(); }
+    };
+
+    template <typename T, typename U, mem_type M>
+    inline bool
+    operator==(const pool_allocator<T, M>&, const pool_allocator<U, M>&)
+    {
+        return true;
+    }
+
+    template <typename T, typename U, mem_type M>
+    inline bool
+    operator!=(const pool_allocator<T, M>&, const pool_allocator<U, M>&)
+    {
+        return false;
+    }
+}
+
+#endif
@@ -0,0 +1,200 @@
+/*
+ * ===============================================================
+ *    Description:  Implementation of shard outgoing node program
+ *                  message coalescer.
+ *
+ *        Created:  2014-10-06 11:48:31
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#define weaver_debug_
+#include "common/weaver_constants.h"
+#include "common/message.h"
+#include "common/clock.h"
+#include "db/shard_constants.h"
+#include "db/msg_coalescer.h"
+
+using db::coalesced_batch;
+using db::msg_coalescer;
+
+msg_coalescer :: msg_coalescer(common::comm_wrapper &c)
+    : comm(c)
+    , busy_workers(0)
+{ }
+
+// set once at startup, before worker threads send messages
+void
+msg_coalescer :: set_done_check(std::function<bool(uint64_t)> check)
+{
+    req_done = check;
+}
+
+// drop messages of requests which finished while the messages were waiting in a batch
+void
+msg_coalescer :: drop_done(std::vector<std::string> &msgs, std::vector<uint64_t> &req_ids)
+{
+    if (req_done) {
+        uint64_t kept = 0;
+        for (uint64_t i = 0; i < msgs.size(); i++) {
+            if (!req_done(req_ids[i])) {
+                if (kept != i) {
+                    msgs[kept].swap(msgs[i]);
+                }
+                kept++;
+            }
+        }
+        msgs.resize(kept);
+    }
+    req_ids.clear();
+}
+
+// batches are never removed from the map, so the returned pointer stays valid
+coalesced_batch*
+msg_coalescer :: get_batch(uint64_t dest)
+{
+    batches_mtx.lock();
+    std::unique_ptr<coalesced_batch> &batch = batches[dest];
+    if (!batch) {
+        batch.reset(new coalesced_batch());
+    }
+    coalesced_batch *ret = batch.get();
+    batches_mtx.unlock();
+
+    return ret;
+}
+
+std::vector<coalesced_batch*>
+msg_coalescer :: all_batches(std::vector<uint64_t> &dests)
+{
+    std::vector<coalesced_batch*> ret;
+
+    batches_mtx.lock();
+    ret.reserve(batches.size());
+    dests.reserve(batches.size());
+    for (auto &p: batches) {
+        dests.emplace_back(p.first);
+        ret.emplace_back(p.second.get());
+    }
+    batches_mtx.unlock();
+
+    return ret;
+}
+
+// send without holding the batch lock
+// a single message goes out as is, without the batch wrapper
+void
+msg_coalescer :: send_batch(uint64_t dest, std::vector<std::string> &msgs)
+{
+    message::message msg;
+    if (msgs.size() == 1) {
+        const std::string &m = msgs.front();
+        msg.buf.reset(e::buffer::create(BUSYBEE_HEADER_SIZE + m.size()));
+        msg.buf->pack_at(BUSYBEE_HEADER_SIZE).copy(e::slice(m.data(), m.size()));
+    } else {
+        msg.prepare_message(message::NODE_PROG_BATCH, msgs);
+    }
+    comm.send(dest, msg.buf);
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+void
+msg_coalescer :: send(uint64_t dest, uint64_t req_id, std::auto_ptr<e::buffer> msg)
+{
+    coalesced_batch *batch = get_batch(dest);
+    std::vector<std::string> to_send;
+    std::vector<uint64_t> to_send_ids;
+
+    batch->mtx.lock();
+    if (batch->msgs.empty()) {
+        wclock::weaver_timer timer;
+        batch->first_enq_time = timer.get_time_elapsed();
+    }
+    batch->msgs.emplace_back((const char*)msg->data() + BUSYBEE_HEADER_SIZE, msg->size() - BUSYBEE_HEADER_SIZE);
+    batch->req_ids.emplace_back(req_id);
+    batch->bytes += msg->size();
+    if (batch->msgs.size() >= NODE_PROG_COALESCE_MSGS || batch->bytes >= NODE_PROG_COALESCE_BYTES) {
+        to_send.swap(batch->msgs);
+        to_send_ids.swap(batch->req_ids);
+        batch->bytes = 0;
+    }
+    batch->mtx.unlock();
+
+    drop_done(to_send, to_send_ids);
+    if (!to_send.empty()) {
+        send_batch(dest, to_send);
+    }
+}
+#pragma GCC diagnostic pop
+
+void
+msg_coalescer :: flush(bool expired_only)
+{
+    std::vector<uint64_t> dests;
+    std::vector<coalesced_batch*> to_check = all_batches(dests);
+    std::vector<std::string> to_send;
+    std::vector<uint64_t> to_send_ids;
+    wclock::weaver_timer timer;
+    uint64_t now = timer.get_time_elapsed();
+
+    for (uint64_t i = 0; i < to_check.size(); i++) {
+        coalesced_batch *batch = to_check[i];
+
+        batch->mtx.lock();
+        if (!batch->msgs.empty()
+         && (!expired_only || (now - batch->first_enq_time) >= NODE_PROG_COALESCE_TIMEOUT_MICRO*1000)) {
+            to_send.swap(batch->msgs);
+            to_send_ids.swap(batch->req_ids);
+            batch->bytes = 0;
+        }
+        batch->mtx.unlock();
+
+        drop_done(to_send, to_send_ids);
+        if (!to_send.empty()) {
+            send_batch(dests[i], to_send);
+            to_send.clear();
+        }
+    }
+}
+
+// send batches whose oldest message has waited for longer than the timeout
+void
+msg_coalescer :: flush_expired()
+{
+    flush(true);
+}
+
+void
+msg_coalescer :: flush_all()
+{
+    flush(false);
+}
+
+// worker threads call worker_busy when they start processing a received message,
+// and worker_idle when they are done and about to wait for the next one
+void
+msg_coalescer :: worker_busy()
+{
+    busy_mtx.lock();
+    busy_workers++;
+    busy_mtx.unlock();
+}
+
+void
+msg_coalescer :: worker_idle()
+{
+    busy_mtx.lock();
+    assert(busy_workers > 0);
+    bool last = (--busy_workers == 0);
+    busy_mtx.unlock();
+
+    if (last) {
+        // no other worker is generating messages, do not hold back the pending ones
+        flush_all();
+    }
+}
@@ -0,0 +1,80 @@
+/*
+ * ===============================================================
+ *    Description:  Coalesce outgoing node program messages from
+ *                  all worker threads and requests, per
+ *                  destination shard.
+ *
+ *        Created:  2014-10-06 11:20:14
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#ifndef weaver_db_msg_coalescer_h_
+#define weaver_db_msg_coalescer_h_
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <po6/threads/mutex.h>
+
+#include "common/comm_wrapper.h"
+
+namespace db
+{
+    // pending node program messages for a single destination shard
+    struct coalesced_batch
+    {
+        po6::threads::mutex mtx;
+        std::vector<std::string> msgs; // packed NODE_PROG messages, without busybee header
+        std::vector<uint64_t> req_ids; // node prog request of each message
+        uint64_t bytes;
+        uint64_t first_enq_time; // time at which oldest message in this batch was enqueued
+
+        coalesced_batch() : bytes(0), first_enq_time(0) { }
+    };
+
+    // merges NODE_PROG messages from concurrent requests into a single NODE_PROG_BATCH send
+    // a batch is sent when it is large enough, when its oldest message has waited long enough,
+    // or when the last busy worker thread goes idle so that there is nothing more to wait for
+    class msg_coalescer
+    {
+        private:
+            common::comm_wrapper &comm;
+            std::unordered_map<uint64_t, std::unique_ptr<coalesced_batch>> batches; // shard id -> batch
+            po6::threads::mutex batches_mtx; // protects the map, not the individual batches
+            uint64_t busy_workers;
+            po6::threads::mutex busy_mtx;
+            std::function<bool(uint64_t)> req_done; // true if node prog request has finished, its hops need not be sent
+
+        private:
+            void drop_done(std::vector<std::string> &msgs, std::vector<uint64_t> &req_ids);
+            coalesced_batch* get_batch(uint64_t dest);
+            std::vector<coalesced_batch*> all_batches(std::vector<uint64_t> &dests);
+            void send_batch(uint64_t dest, std::vector<std::string> &msgs);
+            void flush(bool expired_only);
+
+        public:
+            msg_coalescer(common::comm_wrapper &comm);
+            void set_done_check(std::function<bool(uint64_t)> check);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+            void send(uint64_t dest, uint64_t req_id, std::auto_ptr<e::buffer> msg);
+#pragma GCC diagnostic pop
+            void flush_expired();
+            void flush_all();
+            void worker_busy();
+            void worker_idle();
+
+            // delete standard copy onstructors
+            msg_coalescer(const msg_coalescer&) = delete;
+            msg_coalescer& operator=(msg_coalescer const&) = delete;
+    };
+}
+
+#endif
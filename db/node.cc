@@ -23,14 +23,21 @@ using db::element::remote_node;
 using db::element::edge;
 using db::element::node;
 
-node :: node(const node_handle_t &_handle, vc::vclock &vclk, po6::threads::mutex *mtx)
+void (*node::in_nbr_lookup)(uint64_t, std::vector<remote_node>&) = NULL;
+
+node :: node(const node_handle_t &_handle, vc::vclock &vclk)
     : base(_handle, vclk)
+    , handle_id(UINT64_MAX)
     , state(mode::NASCENT)
-    , cv(mtx)
-    , migr_cv(mtx)
+    , cv(&mtx)
+    , migr_cv(&mtx)
     , in_use(true)
     , waiters(0)
+    , readers(0)
+    , shared_waiters(0)
+    , excl_waiters(0)
     , permanently_deleted(false)
+    , removed(false)
     , last_perm_deletion(nullptr)
     , new_loc(UINT64_MAX)
     , update_count(1)
@@ -39,30 +46,30 @@ node :: node(const node_handle_t &_handle, vc::vclock &vclk, po6::threads::mutex
     , already_migr(false)
     , dependent_del(0)
     , cache(MaxCacheEntries)
-{
-    int num_prog_types = node_prog::END;
-    prog_states.resize(num_prog_types);
-}
+{ }
 
 node :: ~node()
 {
     assert(out_edges.empty());
 }
 
-void
-node :: add_edge(edge *e)
-{
-    out_edges.emplace(e->get_handle(), e);
-}
-
 node_prog::edge_list
 node :: get_edges()
 {
     assert(base.view_time != nullptr);
     assert(base.time_oracle != nullptr);
-    return node_prog::edge_list(out_edges, base.view_time, base.time_oracle);
+    return node_prog::edge_list(out_edges, last_upd_clk, base.view_time, base.time_oracle);
 };
 
+std::vector<remote_node>
+node :: get_local_in_nbrs()
+{
+    assert(in_nbr_lookup != NULL);
+    std::vector<remote_node> in_nbrs;
+    in_nbr_lookup(handle_id, in_nbrs);
+    return in_nbrs;
+}
+
 node_prog::prop_list
 node :: get_properties()
 {
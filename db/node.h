@@ -30,6 +30,7 @@
 #include "db/cache_entry.h"
 #include "db/element.h"
 #include "db/edge.h"
+#include "db/edge_table.h"
 #include "db/shard_constants.h"
 
 namespace message
@@ -44,7 +45,7 @@ namespace element
     class node : public node_prog::node
     {
         public:
-            node(const node_handle_t &handle, vc::vclock &vclk, po6::threads::mutex *mtx);
+            node(const node_handle_t &handle, vc::vclock &vclk);
             ~node();
 
         public:
@@ -57,14 +58,20 @@ namespace element
 
         public:
             element base;
+            uint64_t handle_id; // id of handle in the shard handle table
             enum mode state;
-            std::unordered_map<edge_handle_t, edge*> out_edges;
+            edge_table out_edges;
+            po6::threads::mutex mtx; // protects the locking state below
             po6::threads::cond cv; // for locking node
             po6::threads::cond migr_cv; // make reads/writes wait while node is being migrated
             std::deque<std::pair<uint64_t, uint64_t>> tx_queue; // queued txs, identified by <vt_id, queue timestamp> tuple
             bool in_use;
             uint32_t waiters; // count of number of waiters
+            uint32_t readers; // count of threads holding the node in shared mode
+            uint32_t shared_waiters; // count of waiters for shared mode
+            uint32_t excl_waiters; // count of waiters for exclusive mode, new readers wait for these
             bool permanently_deleted;
+            bool removed; // erased from shard node map, freed once no thread can be reading it
             std::unique_ptr<vc::vclock> last_perm_deletion; // vclock of last edge/property permanently deleted at this node
 
             // for migration
@@ -91,18 +98,17 @@ namespace element
                 std::shared_ptr<std::vector<remote_node>> watch_set,
                 cache_key_t key);
 
-            // node program state
-            typedef std::unordered_map<uint64_t, std::shared_ptr<node_prog::Node_State_Base>> id_to_state_t;
-            typedef std::vector<id_to_state_t> prog_state_t;
-            prog_state_t prog_states;
+            // in-nbrs are kept by the shard in its in-edge map, set once at shard startup
+            static void (*in_nbr_lookup)(uint64_t handle_id, std::vector<remote_node> &in_nbrs);
 
             // fault tolerance
+            // also lets node progs skip visibility checks when all writes to this node precede the request
             vc::vclock last_upd_clk;
             vc::vclock_t restore_clk;
 
         public:
-            void add_edge(edge *e);
             node_prog::edge_list get_edges();
+            std::vector<remote_node> get_local_in_nbrs();
             node_prog::prop_list get_properties();
             bool has_property(std::pair<std::string, std::string> &p);
             bool has_all_properties(std::vector<std::pair<std::string, std::string>> &props);
@@ -0,0 +1,83 @@
+/*
+ * ===============================================================
+ *    Description:  Exclusive and shared holding of a node, on the
+ *                  lock state kept in each node.  Used by the
+ *                  shard acquire and release methods.
+ *
+ *        Created:  2014-10-17 12:02:18
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#ifndef weaver_db_node_lock_h_
+#define weaver_db_node_lock_h_
+
+#include <assert.h>
+
+namespace db
+{
+    // Node is any type with the lock state of db::element::node:
+    // mtx, cv on mtx, in_use, and the waiters, readers, shared_waiters and excl_waiters counts
+    // caution: all of these assume holding n->mtx
+
+    // wait till no thread holds the node, new readers wait while this thread waits
+    template <typename Node>
+    inline void
+    wait_exclusive(Node *n)
+    {
+        n->waiters++;
+        n->excl_waiters++;
+        while (n->in_use || n->readers > 0) {
+            n->cv.wait();
+        }
+        n->excl_waiters--;
+        n->waiters--;
+    }
+
+    // wait till no thread holds or waits to hold the node exclusively, then join the readers
+    template <typename Node>
+    inline void
+    wait_shared(Node *n)
+    {
+        n->waiters++;
+        n->shared_waiters++;
+        while (n->in_use || n->excl_waiters > 0) {
+            n->cv.wait();
+        }
+        n->shared_waiters--;
+        n->waiters--;
+        n->readers++;
+    }
+
+    // return true if this was the last reader, in which case waiting threads need to be woken
+    template <typename Node>
+    inline bool
+    leave_shared(Node *n)
+    {
+        assert(n->readers > 0);
+        return --n->readers == 0;
+    }
+
+    // wake threads waiting for the node, if any, and return true if there were any
+    template <typename Node>
+    inline bool
+    wake_waiters(Node *n)
+    {
+        if (n->waiters == 0) {
+            return false;
+        }
+        if (n->shared_waiters > 0) {
+            // all waiting readers may be able to proceed together
+            n->cv.broadcast();
+        } else {
+            n->cv.signal();
+        }
+        return true;
+    }
+}
+
+#endif
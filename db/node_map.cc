@@ -0,0 +1,187 @@
+/*
+ * ===============================================================
+ *    Description:  Implementation of lock-free shard node map.
+ *
+ *        Created:  2014-10-15 15:02:17
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#define weaver_debug_
+#include <assert.h>
+#include "common/weaver_constants.h"
+#include "db/node_map.h"
+
+using db::element::node;
+using db::node_slot;
+using db::node_map;
+
+// single node map per process, a thread registers its epoch slot on first use
+thread_local db::epoch_slot *node_map::my_epoch = NULL;
+
+node_map :: node_map()
+    : global_epoch(1)
+{
+    for (uint64_t i = 0; i < NUM_HANDLE_STRIPES; i++) {
+        for (uint64_t k = 0; k < NODE_MAP_CHUNKS; k++) {
+            stripes[i].chunks[k].store(NULL);
+        }
+    }
+}
+
+node_map :: ~node_map()
+{
+    for (uint64_t i = 0; i < NUM_HANDLE_STRIPES; i++) {
+        for (uint64_t k = 0; k < NODE_MAP_CHUNKS; k++) {
+            delete[] stripes[i].chunks[k].load();
+        }
+    }
+}
+
+// return slot for handle id, NULL if chunk not allocated and create is false
+node_slot*
+node_map :: get_slot(uint64_t handle_id, bool create)
+{
+    uint64_t stripe = handle_id & (NUM_HANDLE_STRIPES-1);
+    uint64_t idx = (handle_id >> HANDLE_STRIPE_BITS) + NODE_MAP_MIN_CHUNK;
+    uint64_t k = (63 - __builtin_clzll(idx)) - NODE_MAP_MIN_CHUNK_BITS;
+    uint64_t chunk_sz = ((uint64_t)NODE_MAP_MIN_CHUNK) << k;
+    assert(k < NODE_MAP_CHUNKS);
+
+    std::atomic<node_slot*> &chunk_ptr = stripes[stripe].chunks[k];
+    node_slot *chunk = chunk_ptr.load(std::memory_order_acquire);
+    if (chunk == NULL) {
+        if (!create) {
+            return NULL;
+        }
+        node_slot *new_chunk = new node_slot[chunk_sz];
+        for (uint64_t i = 0; i < chunk_sz; i++) {
+            new_chunk[i].store(NULL, std::memory_order_relaxed);
+        }
+        if (chunk_ptr.compare_exchange_strong(chunk, new_chunk)) {
+            chunk = new_chunk;
+        } else {
+            // another thread allocated this chunk, chunk now points to it
+            delete[] new_chunk;
+        }
+    }
+
+    return chunk + (idx - chunk_sz);
+}
+
+void
+node_map :: enter()
+{
+    if (my_epoch == NULL) {
+        my_epoch = new epoch_slot();
+        my_epoch->active.store(0);
+        epoch_mtx.lock();
+        epoch_slots.emplace_back(my_epoch);
+        epoch_mtx.unlock();
+    }
+    // seq_cst store, so that erasures after this point are seen by the finds that follow
+    my_epoch->active.store(global_epoch.load());
+}
+
+void
+node_map :: exit()
+{
+    my_epoch->active.store(0, std::memory_order_release);
+}
+
+node*
+node_map :: find(uint64_t handle_id)
+{
+    node_slot *slot = get_slot(handle_id, false);
+    if (slot == NULL) {
+        return NULL;
+    }
+    return slot->load();
+}
+
+// return false if a node with this id is already in the map
+bool
+node_map :: insert(uint64_t handle_id, node *n)
+{
+    node_slot *slot = get_slot(handle_id, true);
+    node *expected = NULL;
+    return slot->compare_exchange_strong(expected, n);
+}
+
+void
+node_map :: erase(uint64_t handle_id)
+{
+    node_slot *slot = get_slot(handle_id, false);
+    assert(slot != NULL);
+    slot->store(NULL);
+}
+
+// n must have been erased from the map
+// appends to reclaimed the nodes, possibly including n, which no thread can still be reading
+// nodes retired while some thread is in a read section are returned by a later call
+void
+node_map :: retire(node *n, std::vector<node*> &reclaimed)
+{
+    epoch_mtx.lock();
+    retired.emplace_back(global_epoch.fetch_add(1), n);
+
+    uint64_t min_active = UINT64_MAX;
+    for (epoch_slot *es: epoch_slots) {
+        uint64_t e = es->active.load();
+        if (e != 0 && e < min_active) {
+            min_active = e;
+        }
+    }
+    while (!retired.empty() && retired.front().first < min_active) {
+        reclaimed.emplace_back(retired.front().second);
+        retired.pop_front();
+    }
+    epoch_mtx.unlock();
+}
+
+// copy out all nodes in a stripe
+// caution: assume no concurrent erasures, e.g. during bulk load
+void
+node_map :: get_stripe(uint64_t stripe, std::unordered_map<uint64_t, node*> &nodes)
+{
+    for (uint64_t k = 0; k < NODE_MAP_CHUNKS; k++) {
+        node_slot *chunk = stripes[stripe].chunks[k].load();
+        if (chunk == NULL) {
+            continue;
+        }
+        uint64_t chunk_sz = ((uint64_t)NODE_MAP_MIN_CHUNK) << k;
+        for (uint64_t i = 0; i < chunk_sz; i++) {
+            node *n = chunk[i].load();
+            if (n != NULL) {
+                uint64_t idx = chunk_sz + i - NODE_MAP_MIN_CHUNK;
+                nodes.emplace((idx << HANDLE_STRIPE_BITS) | stripe, n);
+            }
+        }
+    }
+}
+
+// handle ids of all nodes in a stripe, nodes themselves are not touched
+// a node erased concurrently may or may not be included
+void
+node_map :: get_stripe_ids(uint64_t stripe, std::vector<uint64_t> &handle_ids)
+{
+    for (uint64_t k = 0; k < NODE_MAP_CHUNKS; k++) {
+        node_slot *chunk = stripes[stripe].chunks[k].load();
+        if (chunk == NULL) {
+            continue;
+        }
+        uint64_t chunk_sz = ((uint64_t)NODE_MAP_MIN_CHUNK) << k;
+        for (uint64_t i = 0; i < chunk_sz; i++) {
+            if (chunk[i].load() != NULL) {
+                uint64_t idx = chunk_sz + i - NODE_MAP_MIN_CHUNK;
+                handle_ids.emplace_back((idx << HANDLE_STRIPE_BITS) | stripe);
+            }
+        }
+    }
+}
+
+#undef weaver_debug_
@@ -0,0 +1,78 @@
+/*
+ * ===============================================================
+ *    Description:  Lock-free map from node handle id to node,
+ *                  with epoch based reclamation of erased nodes.
+ *
+ *        Created:  2014-10-15 14:20:43
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#ifndef weaver_db_node_map_h_
+#define weaver_db_node_map_h_
+
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <po6/threads/mutex.h>
+
+#include "db/shard_constants.h"
+#include "db/node.h"
+
+namespace db
+{
+    typedef std::atomic<element::node*> node_slot;
+
+    // chunk k of a stripe holds NODE_MAP_MIN_CHUNK << k slots
+    // chunks are allocated on first use and never freed, so a reader never sees a table move
+    struct node_map_stripe
+    {
+        std::atomic<node_slot*> chunks[NODE_MAP_CHUNKS];
+    };
+
+    // epoch announced by a thread while it may hold a node pointer read from the map, 0 when quiescent
+    struct epoch_slot
+    {
+        std::atomic<uint64_t> active;
+    };
+
+    // handle ids are (index << HANDLE_STRIPE_BITS) | stripe, see db/handle_table.h, so a node is found
+    // by direct indexing into its stripe without hashing or locking
+    // erased nodes are retired, and handed back for freeing only after every thread which was inside
+    // a read section at the time of erasure has left it
+    class node_map
+    {
+        private:
+            node_map_stripe stripes[NUM_HANDLE_STRIPES];
+
+            std::atomic<uint64_t> global_epoch;
+            po6::threads::mutex epoch_mtx;
+            std::vector<epoch_slot*> epoch_slots; // protected by epoch_mtx
+            std::deque<std::pair<uint64_t, element::node*>> retired; // retire epoch, node, protected by epoch_mtx
+            static thread_local epoch_slot *my_epoch;
+
+            node_slot* get_slot(uint64_t handle_id, bool create);
+
+        public:
+            node_map();
+            ~node_map();
+
+            // find must be called inside a read section
+            void enter();
+            void exit();
+            element::node* find(uint64_t handle_id);
+
+            bool insert(uint64_t handle_id, element::node *n);
+            void erase(uint64_t handle_id);
+            void retire(element::node *n, std::vector<element::node*> &reclaimed);
+            void get_stripe(uint64_t stripe, std::unordered_map<uint64_t, element::node*> &nodes);
+            void get_stripe_ids(uint64_t stripe, std::vector<uint64_t> &handle_ids);
+    };
+}
+
+#endif
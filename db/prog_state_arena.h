@@ -0,0 +1,262 @@
+/*
+ * ===============================================================
+ *    Description:  Node program state of all requests running at
+ *                  a shard, grouped by request so that all state
+ *                  of a request is dropped at once when it ends.
+ *
+ *        Created:  2014-10-16 19:08:52
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#ifndef weaver_db_prog_state_arena_h_
+#define weaver_db_prog_state_arena_h_
+
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <po6/threads/mutex.h>
+
+#include "node_prog/node_prog_type.h"
+#include "node_prog/base_classes.h"
+#include "db/shard_constants.h"
+
+namespace db
+{
+    typedef std::unordered_map<uint64_t, std::shared_ptr<node_prog::Node_State_Base>> id_to_state_t;
+    typedef std::shared_ptr<std::atomic<bool>> done_flag_t;
+
+    // state of a single node for all requests, indexed by prog type and then request id
+    // sent along with the node on migration
+    struct node_prog_states
+    {
+        std::vector<id_to_state_t> states;
+
+        node_prog_states() : states(node_prog::END) { }
+    };
+
+    // state of a single request at all nodes of this shard
+    struct request_states
+    {
+        node_prog::prog_type type;
+        id_to_state_t nodes; // node handle id -> state
+        done_flag_t done; // set when request finishes
+        std::unordered_set<uint64_t> peers; // shards this request was forwarded to or received from
+
+        request_states() : type(node_prog::END), done(std::make_shared<std::atomic<bool>>(false)) { }
+    };
+
+    struct prog_state_stripe
+    {
+        po6::threads::mutex mtx;
+        std::unordered_map<uint64_t, request_states> reqs;
+        std::unordered_set<uint64_t> done; // request ids that have finished
+    };
+
+    // requests are striped by id, the stripe lock is held only to find or insert a state pointer
+    // the state object itself is protected by the node, which the shard holds while the node prog runs
+    // finished requests are remembered, so that a node prog thread racing with the end of its request
+    // does not insert state that would never be freed
+    class prog_state_arena
+    {
+        private:
+            prog_state_stripe stripes[NUM_PROG_STATE_STRIPES];
+            done_flag_t finished; // always set, returned for requests that have already finished
+
+            prog_state_stripe& get_stripe(uint64_t req_id) { return stripes[req_id % NUM_PROG_STATE_STRIPES]; }
+
+        public:
+            prog_state_arena();
+
+            // NULL if this request has no state at this node
+            std::shared_ptr<node_prog::Node_State_Base> find(uint64_t req_id, uint64_t node_id);
+            // returns state already present for this request at this node, else inserts and returns state
+            // state of a finished request is returned but not saved
+            std::shared_ptr<node_prog::Node_State_Base> insert(uint64_t req_id,
+                node_prog::prog_type type,
+                uint64_t node_id,
+                std::shared_ptr<node_prog::Node_State_Base> state);
+            // drop all state of this request, without touching the nodes
+            // returns true if the request was not done before, in which case its peers are moved out
+            bool done_request(uint64_t req_id, std::unordered_set<uint64_t> *peers=NULL);
+            // remember a shard which this request was forwarded to or received from, for cancellation
+            // returns false if the request has already finished
+            bool add_peer(uint64_t req_id, uint64_t shard);
+            bool is_done(uint64_t req_id);
+            // flag which is set when this request finishes, node prog threads check it per node without a lock
+            done_flag_t get_done_flag(uint64_t req_id);
+            // drop state of all requests, on promotion of a backup shard
+            void clear();
+
+            // migration
+            void extract_node(uint64_t node_id, node_prog_states &node_states);
+            void insert_node(uint64_t node_id, node_prog_states &node_states);
+    };
+
+    inline
+    prog_state_arena :: prog_state_arena()
+        : finished(std::make_shared<std::atomic<bool>>(true))
+    { }
+
+    inline std::shared_ptr<node_prog::Node_State_Base>
+    prog_state_arena :: find(uint64_t req_id, uint64_t node_id)
+    {
+        std::shared_ptr<node_prog::Node_State_Base> state;
+        prog_state_stripe &stripe = get_stripe(req_id);
+
+        stripe.mtx.lock();
+        auto req_iter = stripe.reqs.find(req_id);
+        if (req_iter != stripe.reqs.end()) {
+            auto state_iter = req_iter->second.nodes.find(node_id);
+            if (state_iter != req_iter->second.nodes.end()) {
+                state = state_iter->second;
+            }
+        }
+        stripe.mtx.unlock();
+
+        return state;
+    }
+
+    inline std::shared_ptr<node_prog::Node_State_Base>
+    prog_state_arena :: insert(uint64_t req_id,
+        node_prog::prog_type type,
+        uint64_t node_id,
+        std::shared_ptr<node_prog::Node_State_Base> state)
+    {
+        prog_state_stripe &stripe = get_stripe(req_id);
+
+        stripe.mtx.lock();
+        if (stripe.done.find(req_id) == stripe.done.end()) {
+            request_states &req = stripe.reqs[req_id];
+            req.type = type;
+            auto state_iter = req.nodes.find(node_id);
+            if (state_iter == req.nodes.end()) {
+                req.nodes.emplace(node_id, state);
+            } else {
+                // another reader of this node got here first
+                state = state_iter->second;
+            }
+        }
+        stripe.mtx.unlock();
+
+        return state;
+    }
+
+    inline bool
+    prog_state_arena :: done_request(uint64_t req_id, std::unordered_set<uint64_t> *peers)
+    {
+        prog_state_stripe &stripe = get_stripe(req_id);
+        request_states to_delete;
+
+        stripe.mtx.lock();
+        bool first = stripe.done.emplace(req_id).second;
+        auto req_iter = stripe.reqs.find(req_id);
+        if (req_iter != stripe.reqs.end()) {
+            req_iter->second.done->store(true);
+            to_delete = std::move(req_iter->second);
+            stripe.reqs.erase(req_iter);
+        }
+        stripe.mtx.unlock();
+
+        if (first && peers != NULL) {
+            *peers = std::move(to_delete.peers);
+        }
+
+        // states freed here, outside stripe lock
+        return first;
+    }
+
+    inline bool
+    prog_state_arena :: add_peer(uint64_t req_id, uint64_t shard)
+    {
+        prog_state_stripe &stripe = get_stripe(req_id);
+
+        stripe.mtx.lock();
+        bool running = (stripe.done.find(req_id) == stripe.done.end());
+        if (running) {
+            stripe.reqs[req_id].peers.emplace(shard);
+        }
+        stripe.mtx.unlock();
+
+        return running;
+    }
+
+    inline bool
+    prog_state_arena :: is_done(uint64_t req_id)
+    {
+        prog_state_stripe &stripe = get_stripe(req_id);
+
+        stripe.mtx.lock();
+        bool done = (stripe.done.find(req_id) != stripe.done.end());
+        stripe.mtx.unlock();
+
+        return done;
+    }
+
+    inline done_flag_t
+    prog_state_arena :: get_done_flag(uint64_t req_id)
+    {
+        prog_state_stripe &stripe = get_stripe(req_id);
+        done_flag_t flag;
+
+        stripe.mtx.lock();
+        if (stripe.done.find(req_id) != stripe.done.end()) {
+            flag = finished;
+        } else {
+            flag = stripe.reqs[req_id].done;
+        }
+        stripe.mtx.unlock();
+
+        return flag;
+    }
+
+    inline void
+    prog_state_arena :: clear()
+    {
+        for (uint64_t i = 0; i < NUM_PROG_STATE_STRIPES; i++) {
+            std::unordered_map<uint64_t, request_states> to_delete;
+
+            stripes[i].mtx.lock();
+            to_delete = std::move(stripes[i].reqs);
+            stripes[i].reqs.clear();
+            stripes[i].mtx.unlock();
+        }
+    }
+
+    // caution: scans all requests, only for migration
+    inline void
+    prog_state_arena :: extract_node(uint64_t node_id, node_prog_states &node_states)
+    {
+        for (uint64_t i = 0; i < NUM_PROG_STATE_STRIPES; i++) {
+            prog_state_stripe &stripe = stripes[i];
+
+            stripe.mtx.lock();
+            for (auto &p: stripe.reqs) {
+                auto state_iter = p.second.nodes.find(node_id);
+                if (state_iter != p.second.nodes.end()) {
+                    node_states.states[(int)p.second.type].emplace(p.first, std::move(state_iter->second));
+                    p.second.nodes.erase(state_iter);
+                }
+            }
+            stripe.mtx.unlock();
+        }
+    }
+
+    inline void
+    prog_state_arena :: insert_node(uint64_t node_id, node_prog_states &node_states)
+    {
+        for (int type = 0; type < node_prog::END; type++) {
+            for (auto &p: node_states.states[type]) {
+                insert(p.first, (node_prog::prog_type)type, node_id, std::move(p.second));
+            }
+        }
+    }
+}
+
+#endif
@@ -42,6 +42,7 @@ namespace element
             const vc::vclock& get_creat_time() const;
             const vc::vclock& get_del_time() const;
             void update_del_time(vc::vclock&);
+            bool is_deleted() const { return del_time.vt_id != UINT64_MAX; }
     };
 
     class property_key_hasher
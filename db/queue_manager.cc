@@ -24,46 +24,116 @@ using db::queue_manager;
 using db::queued_request;
 
 queue_manager :: queue_manager()
-    : rd_queues(NumVts, pqueue_t())
-    , wr_queues(NumVts, pqueue_t())
-    , last_clocks(NumVts, vc::vclock_t(ClkSz, 0))
-    , qts(NumVts, 0)
-    , min_epoch(NumVts, 0)
+    : version(1)
+    , idle_version(0)
+    , kronos_pending(false)
 {
-    last_clocks_ptr.reserve(last_clocks.size());
-    for (size_t i = 0; i < last_clocks.size(); i++) {
-        last_clocks_ptr.emplace_back(&last_clocks[i]);
+    queues.reserve(NumVts);
+    for (uint64_t i = 0; i < NumVts; i++) {
+        queues.emplace_back(new vt_queue());
+        queues.back()->last_clock = vc::vclock_t(ClkSz, 0);
+        queues.back()->qts = 0;
+        queues.back()->min_epoch = 0;
+    }
+}
+
+// always in vt order, so that concurrent callers do not deadlock
+void
+queue_manager :: lock_all()
+{
+    for (uint64_t i = 0; i < NumVts; i++) {
+        queues[i]->mtx.lock();
+    }
+}
+
+void
+queue_manager :: unlock_all()
+{
+    for (uint64_t i = 0; i < NumVts; i++) {
+        queues[i]->mtx.unlock();
+    }
+}
+
+// called after a change which may make a queued request runnable
+void
+queue_manager :: bump_version()
+{
+    version.fetch_add(1);
+}
+
+// cb is called when a queued request may have become runnable without any new request or
+// timestamp update, i.e. when Kronos returns the order of write queue heads
+// must be set before requests are queued
+void
+queue_manager :: set_ready_callback(std::function<void()> cb)
+{
+    ready_callback = std::move(cb);
+}
+
+// called on Kronos batcher thread, order of write queue heads is now cached
+void
+queue_manager :: kronos_done()
+{
+    lock_all();
+    kronos_pending = false;
+    unlock_all();
+
+    bump_version();
+    if (ready_callback) {
+        ready_callback();
+    }
+}
+
+// snapshot of last completed tx clock for each vt
+// clocks only move forward, so a stale snapshot can delay a read but never run it too early
+void
+queue_manager :: get_last_clocks(std::vector<vc::vclock_t> &last_clocks)
+{
+    last_clocks.clear();
+    last_clocks.reserve(NumVts);
+    for (uint64_t i = 0; i < NumVts; i++) {
+        vt_queue &vq = *queues[i];
+        vq.mtx.lock();
+        last_clocks.emplace_back(vq.last_clock);
+        vq.mtx.unlock();
     }
 }
 
 void
 queue_manager :: enqueue_read_request(uint64_t vt_id, queued_request *t)
 {
-    queue_mutex.lock();
-    rd_queues[vt_id].push(t);
-    queue_mutex.unlock();
+    vt_queue &vq = *queues[vt_id];
+    vq.mtx.lock();
+    vq.rd_queue.push(t);
+    vq.mtx.unlock();
+
+    bump_version();
 }
 
 // check if the read request received in thread loop can be executed without waiting
 bool
 queue_manager :: check_rd_request(vc::vclock_t &clk)
 {
-    queue_mutex.lock();
-    bool check = check_rd_req_nonlocking(clk);
-    queue_mutex.unlock();
-    return check;
+    std::vector<vc::vclock_t> last_clocks;
+    get_last_clocks(last_clocks);
+    return check_rd_req_nonlocking(clk, last_clocks);
 }
 
 void
 queue_manager :: enqueue_write_request(uint64_t vt_id, queued_request *t)
 {
-    queue_mutex.lock();
-
-    if (t->vclock.clock[0] >= min_epoch[vt_id]) {
-        wr_queues[vt_id].push(t);
+    vt_queue &vq = *queues[vt_id];
+    vq.mtx.lock();
+    bool queued = false;
+    if (t->vclock.clock[0] >= vq.min_epoch) {
+        vq.wr_queue.push(t);
+        queued = true;
     }
+    vq.mtx.unlock();
 
-    queue_mutex.unlock();
+    if (queued) {
+        bump_version();
+    }
 }
 
 // check if write request received in thread loop can be executed without waiting
@@ -72,7 +142,7 @@ enum queue_order
 queue_manager :: check_wr_request(vc::vclock &vclk, uint64_t qt)
 {
     enum queue_order ret = FUTURE;
-    queue_mutex.lock();
+    lock_all();
     enum queue_order cur_order = check_wr_queues_timestamps(vclk.vt_id, qt);
     assert(cur_order != PAST);
 
@@ -88,7 +158,7 @@ queue_manager :: check_wr_request(vc::vclock &vclk, uint64_t qt)
                 if (i == vclk.vt_id) {
                     continue;
                 } else {
-                    others.emplace_back(&wr_queues[i].top()->vclock.clock);
+                    others.emplace_back(&queues[i]->wr_queue.top()->vclock.clock);
                 }
             }
             if (order::oracle::happens_before_no_kronos(vclk.clock, others)) {
@@ -100,55 +170,67 @@ queue_manager :: check_wr_request(vc::vclock &vclk, uint64_t qt)
     } else {
         ret = FUTURE;
     }
-    queue_mutex.unlock();
+    unlock_all();
     return ret;
 }
 
 // check all read and write queues
-// execute a single queued request which can be run now, and return true
-// else return false
-bool
-queue_manager :: exec_queued_request(order::oracle *time_oracle)
+// remove and return a single queued request which can be run now, else return NULL
+// returns without taking any lock if nothing changed since the last scan which found no runnable request
+// queue timestamp is incremented by the thread which runs a tx, upon enqueueing this tx on node queue,
+// so the next write from the same vt does not become runnable before then
+queued_request*
+queue_manager :: get_queued_request()
 {
-    queue_mutex.lock(); // prevent more jobs from being added
+    uint64_t start_version = version.load();
+    if (start_version == idle_version.load(std::memory_order_relaxed)) {
+        return NULL;
+    }
+
     queued_request *req = get_rw_req();
-    queue_mutex.unlock();
     if (req == NULL) {
-        return false;
+        // changes after start_version bumped version, so they will be seen by the next scan
+        idle_version.store(start_version, std::memory_order_relaxed);
     }
-    req->arg->time_oracle = time_oracle;
-    (*req->func)(req->arg);
-    // queue timestamp is incremented by the thread, upon enqueueing this tx on node queue
-    // when to increment qts depends on the tx components
-    delete req;
-    return true;
+    return req;
 }
 
 // increment queue timestamp for a tx which has been ordered
 void
 queue_manager :: increment_qts(uint64_t vt_id, uint64_t incr)
 {
-    queue_mutex.lock();
-    qts[vt_id] += incr;
-    queue_mutex.unlock();
+    vt_queue &vq = *queues[vt_id];
+    vq.mtx.lock();
+    vq.qts += incr;
+    vq.mtx.unlock();
+
+    bump_version();
 }
 
 // record the vclk for last completed write tx
 void
 queue_manager :: record_completed_tx(vc::vclock &tx_clk)
 {
-    queue_mutex.lock();
-    vc::vclock_t &last_clk = last_clocks[tx_clk.vt_id];
+    vt_queue &vq = *queues[tx_clk.vt_id];
+    vq.mtx.lock();
+    vc::vclock_t &last_clk = vq.last_clock;
     vc::vclock_t &this_clk = tx_clk.clock;
     if (order::oracle::happens_before_no_kronos(last_clk, this_clk)) {
         last_clk = this_clk;
     }
-    queue_mutex.unlock();
+    vq.mtx.unlock();
+
+    bump_version();
 }
 
 bool
-queue_manager :: check_rd_req_nonlocking(vc::vclock_t &clk)
+queue_manager :: check_rd_req_nonlocking(vc::vclock_t &clk, std::vector<vc::vclock_t> &last_clocks)
 {
+    std::vector<vc::vclock_t*> last_clocks_ptr;
+    last_clocks_ptr.reserve(last_clocks.size());
+    for (vc::vclock_t &c: last_clocks) {
+        last_clocks_ptr.emplace_back(&c);
+    }
     // no kronos call
     return order::oracle::happens_before_no_kronos(clk, last_clocks_ptr);
 }
@@ -156,38 +238,43 @@ queue_manager :: check_rd_req_nonlocking(vc::vclock_t &clk)
 queued_request*
 queue_manager :: get_rd_req()
 {
-    queued_request *req;
-    for (uint64_t vt_id = 0; vt_id < NumVts; vt_id++) {
-        pqueue_t &pq = rd_queues[vt_id];
+    std::vector<vc::vclock_t> last_clocks;
+    get_last_clocks(last_clocks);
+
+    queued_request *req = NULL;
+    for (uint64_t vt_id = 0; vt_id < NumVts && req == NULL; vt_id++) {
+        vt_queue &vq = *queues[vt_id];
+        vq.mtx.lock();
+        pqueue_t &pq = vq.rd_queue;
         // execute read request after all write queues have processed write which happens after this read
-        if (!pq.empty()) {
+        if (!pq.empty() && check_rd_req_nonlocking(pq.top()->vclock.clock, last_clocks)) {
             req = pq.top();
-            if (check_rd_req_nonlocking(req->vclock.clock)) {
-                pq.pop();
-                return req;
-            }
+            pq.pop();
         }
+        vq.mtx.unlock();
     }
-    return NULL;
+    return req;
 }
 
+// caller must hold all vt mutexes
 enum queue_order
 queue_manager :: check_wr_queues_timestamps(uint64_t vt_id, uint64_t qt)
 {
     // check each write queue ready to go
     for (uint64_t i = 0; i < NumVts; i++) {
+        vt_queue &vq = *queues[i];
         if (vt_id == i) {
-            assert(qt > qts[i]);
-            if (qt > (qts[i]+1)) {
+            assert(qt > vq.qts);
+            if (qt > (vq.qts+1)) {
                 return FUTURE;
             }
         } else {
-            pqueue_t &pq = wr_queues[i];
+            pqueue_t &pq = vq.wr_queue;
             if (pq.empty()) { // can't go on if one of the pq's is empty
                 return FUTURE;
             } else {
                 // check for correct ordering of queue timestamp (which is priority for thread)
-                if ((qts[i] + 1) != pq.top()->priority) {
+                if ((vq.qts + 1) != pq.top()->priority) {
                     return FUTURE;
                 }
             }
@@ -199,9 +286,11 @@ queue_manager :: check_wr_queues_timestamps(uint64_t vt_id, uint64_t qt)
 queued_request*
 queue_manager :: get_wr_req()
 {
+    lock_all();
     enum queue_order queue_status = check_wr_queues_timestamps(UINT64_MAX, UINT64_MAX);
     assert(queue_status != PAST);
     if (queue_status == FUTURE) {
+        unlock_all();
         return NULL;
     }
 
@@ -210,17 +299,31 @@ queue_manager :: get_wr_req()
     if (NumVts == 1) {
         exec_vt_id = 0; // only one timestamper
     } else {
+        if (kronos_pending) {
+            unlock_all();
+            return NULL;
+        }
+
         // compare timestamps, may call Kronos
+        // do not wait for Kronos while holding the queues, retry once the order is cached
         std::vector<vc::vclock> timestamps;
         timestamps.reserve(NumVts);
         for (uint64_t vt_id = 0; vt_id < NumVts; vt_id++) {
-            timestamps.emplace_back(wr_queues[vt_id].top()->vclock);
+            timestamps.emplace_back(queues[vt_id]->wr_queue.top()->vclock);
             assert(timestamps.back().clock.size() == ClkSz);
         }
-        exec_vt_id = time_oracle.compare_vts(timestamps);
+        int64_t small_idx;
+        if (!time_oracle.compare_vts_async(timestamps, small_idx, std::bind(&queue_manager::kronos_done, this))) {
+            kronos_pending = true;
+            unlock_all();
+            return NULL;
+        }
+        exec_vt_id = small_idx;
     }
-    queued_request *req = wr_queues[exec_vt_id].top();
-    wr_queues[exec_vt_id].pop();
+    pqueue_t &pq = queues[exec_vt_id]->wr_queue;
+    queued_request *req = pq.top();
+    pq.pop();
+    unlock_all();
     return req;
 }
 
@@ -238,26 +341,33 @@ queue_manager :: get_rw_req()
 void
 queue_manager :: reset(uint64_t dead_vt, uint64_t new_epoch)
 {
-    queue_mutex.lock();
+    vt_queue &vq = *queues[dead_vt];
+    vq.mtx.lock();
 
-    assert(new_epoch > min_epoch[dead_vt]);
-    min_epoch[dead_vt] = new_epoch;
+    assert(new_epoch > vq.min_epoch);
+    vq.min_epoch = new_epoch;
 
-    qts[dead_vt] = 0;
-    last_clocks[dead_vt] = vc::vclock_t(ClkSz, 0);
-    last_clocks_ptr[dead_vt] = &last_clocks[dead_vt];
+    vq.qts = 0;
+    vq.last_clock = vc::vclock_t(ClkSz, 0);
 
-    pqueue_t &dead_queue = wr_queues[dead_vt];
+    pqueue_t &dead_queue = vq.wr_queue;
     while (!dead_queue.empty()
-        && dead_queue.top()->vclock.clock[0] < min_epoch[dead_vt]) {
+        && dead_queue.top()->vclock.clock[0] < vq.min_epoch) {
         dead_queue.pop();
     }
 
-    queue_mutex.unlock();
+    vq.mtx.unlock();
+
+    bump_version();
 }
 
 void
 queue_manager :: clear_queued_reads()
 {
-    rd_queues = std::vector<pqueue_t>(NumVts, pqueue_t());
+    for (uint64_t i = 0; i < NumVts; i++) {
+        vt_queue &vq = *queues[i];
+        vq.mtx.lock();
+        vq.rd_queue = pqueue_t();
+        vq.mtx.unlock();
+    }
 }
@@ -18,6 +18,9 @@
 
 #include <queue>
 #include <thread>
+#include <atomic>
+#include <memory>
+#include <functional>
 #include <po6/threads/mutex.h>
 
 #include "db/queued_request.h"
@@ -35,32 +38,52 @@ namespace db
     // each shard server has one such priority queue for each vector timestamper
     typedef std::priority_queue<queued_request*, std::vector<queued_request*>, work_thread_compare> pqueue_t;
 
+    // queues and ordering state of a single vector timestamper
+    struct vt_queue
+    {
+        po6::threads::mutex mtx;
+        pqueue_t rd_queue;
+        pqueue_t wr_queue;
+        vc::vclock_t last_clock; // last transaction vclock pulled off queue for this vector timestamper
+        uint64_t qts; // queue timestamp
+        uint64_t min_epoch;
+    };
+
+    // each vector timestamper has its own queues and mutex, so enqueues and timestamp updates from
+    // different timestampers do not contend
+    // deciding which write runs next needs a consistent view of all write queues, and takes all mutexes in vt order
+    // every change which may make a queued request runnable bumps version; a scan which finds nothing runnable
+    // publishes the version it started at as idle_version, so workers skip the scan until something changes
     class queue_manager
     {
         private:
-            std::vector<pqueue_t> rd_queues;
-            std::vector<pqueue_t> wr_queues;
-            std::vector<vc::vclock_t> last_clocks; // records last transaction vclock pulled of queue for each vector timestamper
-            std::vector<vc::vclock_t*> last_clocks_ptr; // vector of previous vector's entry's pointers
-            vc::qtimestamp_t qts; // queue timestamps
-            std::vector<uint64_t> min_epoch;
-            po6::threads::mutex queue_mutex;
+            std::vector<std::unique_ptr<vt_queue>> queues;
+            std::atomic<uint64_t> version;
+            std::atomic<uint64_t> idle_version;
             order::oracle time_oracle;
+            bool kronos_pending; // write queue heads are waiting on Kronos, protected by all vt mutexes
+            std::function<void()> ready_callback;
 
         private:
+            void lock_all();
+            void unlock_all();
+            void bump_version();
+            void kronos_done();
+            void get_last_clocks(std::vector<vc::vclock_t> &last_clocks);
             queued_request* get_rd_req();
             queued_request* get_wr_req();
             queued_request* get_rw_req();
-            bool check_rd_req_nonlocking(vc::vclock_t &clk);
+            bool check_rd_req_nonlocking(vc::vclock_t &clk, std::vector<vc::vclock_t> &last_clocks);
             enum queue_order check_wr_queues_timestamps(uint64_t vt_id, uint64_t qt);
 
         public:
             queue_manager();
+            void set_ready_callback(std::function<void()> cb);
             void enqueue_read_request(uint64_t vt_id, queued_request*);
             bool check_rd_request(vc::vclock_t &clk);
             void enqueue_write_request(uint64_t vt_id, queued_request*);
             enum queue_order check_wr_request(vc::vclock &vclk, uint64_t qt);
-            bool exec_queued_request(order::oracle *time_oracle);
+            queued_request* get_queued_request();
             void increment_qts(uint64_t vt_id, uint64_t incr);
             void record_completed_tx(vc::vclock &tx_clk);
             void reset(uint64_t dead_vt, uint64_t epoch);
@@ -18,17 +18,19 @@
 
 #include "common/vclock.h"
 #include "db/message_wrapper.h"
+#include "db/work_pool.h"
 
 namespace db
 {
     class queued_request
     {
         public:
-            queued_request(uint64_t prio, vc::vclock vclk, void (*f)(message_wrapper*), message_wrapper *a)
+            queued_request(uint64_t prio, vc::vclock vclk, void (*f)(message_wrapper*), message_wrapper *a, task_class c)
                 : priority(prio)
                 , vclock(vclk)
                 , func(f)
                 , arg(a)
+                , cls(c)
             { }
 
         public:
@@ -36,6 +38,7 @@ namespace db
             vc::vclock vclock;
             void (*func)(message_wrapper*);
             message_wrapper *arg;
+            task_class cls; // exec_pool class the request is submitted with once it can run
     };
 
     // for work queues
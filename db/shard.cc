@@ -13,6 +13,7 @@
  */
 
 #include <deque>
+#include <algorithm>
 #include <fstream>
 #include <string>
 #include <random>
@@ -24,6 +25,7 @@
 #define weaver_debug_
 #include "common/weaver_constants.h"
 #include "common/event_order.h"
+#include "common/kronos_batcher.h"
 #include "common/clock.h"
 #include "db/shard.h"
 #include "db/nop_data.h"
@@ -33,6 +35,7 @@
 #include "node_prog/node_prog_type.h"
 #include "node_prog/node_program.h"
 #include "node_prog/base_classes.h"
+#include "node_prog/bsp_program.h"
 
 DECLARE_CONFIG_CONSTANTS;
 
@@ -50,6 +53,38 @@ void migrate_node_step3();
 void migration_begin();
 void migration_wrapper();
 void migration_end();
+void submit_request(void (*f)(db::message_wrapper*), db::message_wrapper *request, db::task_class cls);
+void schedule_drain();
+db::task_class node_prog_class(node_prog::prog_type pType);
+void apply_nop(uint64_t vt_id, uint64_t qts, std::shared_ptr<transaction::nop_data> nop_arg, order::oracle *time_oracle);
+
+void
+log_pool_stats(const char *stage, db::work_pool &pool)
+{
+    static const char *class_names[db::NUM_TASK_CLASSES] = {"control", "read", "bulk"};
+    db::pool_stats stats;
+    pool.get_stats(stats);
+    for (int c = 0; c < db::NUM_TASK_CLASSES; c++) {
+        uint64_t tasks = stats.tasks[c] == 0? 1 : stats.tasks[c];
+        WDEBUG << stage << " stage, " << class_names[c] << " tasks " << stats.tasks[c]
+               << ", depth " << stats.depth[c] << ", max depth " << stats.max_depth[c]
+               << ", avg wait nanos " << (stats.wait_nanos[c] / tasks)
+               << ", avg run nanos " << (stats.run_nanos[c] / tasks) << std::endl;
+    }
+}
+
+// oracle counters are summed over all worker threads, the shared cache is the one in kronos_batcher
+void
+log_kronos_cache_stats()
+{
+    order::kronos_cache_stats stats;
+    order::oracle::get_process_cache_stats(stats);
+    WDEBUG << "kronos oracle caches: hits " << stats.hits << ", misses " << stats.misses
+           << ", evictions " << stats.evictions << std::endl;
+    order::kronos_batcher::get().get_cache_stats(stats);
+    WDEBUG << "kronos shared cache: hits " << stats.hits << ", misses " << stats.misses
+           << ", evictions " << stats.evictions << std::endl;
+}
 
 void
 end_program(int param)
@@ -58,6 +93,15 @@ end_program(int param)
     WDEBUG << "watch_set lookups originated from this shard " << S->watch_set_lookups << std::endl;
     WDEBUG << "watch_set nops originated from this shard " << S->watch_set_nops << std::endl;
     WDEBUG << "watch set piggybacks on this shard " << S->watch_set_piggybacks << std::endl;
+    WDEBUG << "live node bytes " << S->elem_pool.live_bytes(db::NODE_MEM)
+           << ", live edge bytes " << S->elem_pool.live_bytes(db::EDGE_MEM)
+           << ", slab bytes reserved " << S->elem_pool.reserved_bytes() << std::endl;
+    uint64_t io_msgs = S->io_msgs.load();
+    WDEBUG << "io stage: msgs " << io_msgs
+           << ", avg classify nanos " << (io_msgs == 0? 0 : S->io_nanos.load() / io_msgs) << std::endl;
+    log_pool_stats("exec", S->exec_pool);
+    log_pool_stats("frontier", S->frontier_pool);
+    log_kronos_cache_stats();
     if (param == SIGINT) {
         // TODO proper shutdown
         //S->exit_mutex.lock();
@@ -504,27 +548,23 @@ unpack_tx_request(db::message_wrapper *request)
 
     apply_writes(vt_id, vclk, qts, tx);
 
+    // vt piggybacks nop on tx if this shard was due a nop
+    if (tx.nop != nullptr) {
+        apply_nop(vt_id, qts, tx.nop, request->time_oracle);
+    }
+
     delete request;
 }
 
-// process nop
+// process nop info from a vt, either standalone nop or piggybacked on a tx
 // migration-related checks, and possibly initiating migration
-inline void
-nop(db::message_wrapper *request)
+// caution: tx which carried the nop must have been recorded as completed
+void
+apply_nop(uint64_t vt_id, uint64_t qts, std::shared_ptr<transaction::nop_data> nop_arg, order::oracle *time_oracle)
 {
-    uint64_t vt_id;
-    vc::vclock vclk;
-    uint64_t qts;
-    transaction::pending_tx tx(transaction::NOP);
-    request->msg->unpack_message(message::TX_INIT, vt_id, vclk, qts, tx);
-
     message::message msg;
-    std::shared_ptr<transaction::nop_data> nop_arg = tx.nop;
     bool check_move_migr, check_init_migr, check_migr_step3;
 
-    // increment qts
-    S->increment_qts(vt_id, 1);
-
     // note done progs for state clean up
     assert(nop_arg->done_reqs.size() == 1);
     auto done_req_iter = nop_arg->done_reqs.begin();
@@ -538,7 +578,10 @@ nop(db::message_wrapper *request)
     check_move_migr = true;
     check_init_migr = false;
     if (S->current_migr) {
-        S->nop_count.at(vt_id)++;
+        // count only nops after vt stopped using old location of migrating node
+        if (S->migr_loc_acks[vt_id]) {
+            S->nop_count.at(vt_id)++;
+        }
         for (uint64_t &x: S->nop_count) {
             check_move_migr = check_move_migr && (x == 2);
         }
@@ -588,17 +631,9 @@ nop(db::message_wrapper *request)
     S->migration_mutex.unlock();
 
     // initiate permanent deletion
-    S->permanent_delete_loop(vt_id, nop_arg->outstanding_progs != 0, request->time_oracle);
-
-    // record clock; reads go through
-    S->record_completed_tx(tx.timestamp);
+    S->permanent_delete_loop(vt_id, nop_arg->outstanding_progs != 0, time_oracle);
 
     // ack to VT
-    //std::cerr << "nop ack, qts = " << qts << ", vclk " << vclk.vt_id << " : ";
-    //for (uint64_t c: vclk.clock) {
-    //    std::cerr << c << " ";
-    //}
-    //std::cerr << std::endl;
     msg.prepare_message(message::VT_NOP_ACK, shard_id, qts, cur_node_count);
     S->comm.send(vt_id, msg.buf);
 
@@ -610,42 +645,30 @@ nop(db::message_wrapper *request)
     } else if (check_migr_step3) {
         migrate_node_step3();
     }
-
-    delete request;
 }
 
-node_prog::Node_State_Base*
-get_state_if_exists(db::element::node &node, uint64_t req_id, node_prog::prog_type ptype)
+// process standalone nop
+inline void
+nop(db::message_wrapper *request)
 {
-    auto &state_map = node.prog_states[(int)ptype];
-    std::shared_ptr<node_prog::Node_State_Base> toRet;
-    auto state_iter = state_map.find(req_id);
-    if (state_iter != state_map.end()) {
-        return state_iter->second.get();
-    } 
-    return NULL;
-}
+    uint64_t vt_id;
+    vc::vclock vclk;
+    uint64_t qts;
+    transaction::pending_tx tx(transaction::NOP);
+    request->msg->unpack_message(message::TX_INIT, vt_id, vclk, qts, tx);
 
-// assumes holding node lock
-template <typename NodeStateType>
-NodeStateType& get_or_create_state(node_prog::prog_type ptype,
-    uint64_t req_id,
-    db::element::node *node,
-    std::vector<node_handle_t> *nodes_that_created_state)
-{
-    auto &state_map = node->prog_states[(int)ptype];
-    auto state_iter = state_map.find(req_id);
-    if (state_iter != state_map.end()) {
-        return dynamic_cast<NodeStateType &>(*(state_iter->second));
-    } else {
-        NodeStateType *ptr = new NodeStateType();
-        state_map[req_id] = std::unique_ptr<node_prog::Node_State_Base>(ptr);
-        assert(nodes_that_created_state != NULL);
-        nodes_that_created_state->emplace_back(node->get_handle());
-        return *ptr;
-    }
+    // increment qts
+    S->increment_qts(vt_id, 1);
+
+    // record clock; reads go through
+    S->record_completed_tx(tx.timestamp);
+
+    apply_nop(vt_id, qts, tx.nop, request->time_oracle);
+
+    delete request;
 }
 
+
 // vector pointers can be null if we don't want to fill that vector
 inline void
 fill_changed_properties(std::unordered_map<std::string, db::element::property> &props,
@@ -721,9 +744,8 @@ fetch_node_cache_contexts(uint64_t loc,
                     temp_props_deleted.clear();
                 }
                 // now check for any edge changes
-                for (auto &iter: node->out_edges) {
-                    db::element::edge* e = iter.second;
-                    assert(e != NULL);
+                for (db::element::edge &out_edge: node->out_edges) {
+                    db::element::edge *e = &out_edge;
 
                     bool del_after_cached = (time_oracle->compare_two_vts(time_cached, e->base.get_del_time()) == 0);
                     bool creat_after_cached = (time_oracle->compare_two_vts(time_cached, e->base.get_creat_time()) == 0);
@@ -837,7 +859,7 @@ inline bool cache_lookup(db::element::node*& node_to_check,
         std::shared_ptr<vc::vclock> time_cached(entry.clk);
         std::shared_ptr<std::vector<db::element::remote_node>> watch_set = entry.watch_set;
 
-        auto state = get_state_if_exists(*node_to_check, np.req_id, np.prog_type_recvd);
+        auto state = S->prog_states.find(np.req_id, node_to_check->handle_id);
         if (state != NULL && state->contexts_found.find(np.req_id) != state->contexts_found.end()) {
             np.cache_value.reset(new node_prog::cache_response<CacheValueType>(node_to_check->cache, cache_key, cval, watch_set));
 #ifdef weaver_debug_
@@ -926,6 +948,388 @@ inline bool cache_lookup(db::element::node*& node_to_check,
     } 
 }
 
+inline void
+release_prog_node(db::element::node *n, bool read_only)
+{
+    if (read_only) {
+        S->release_node_shared(n);
+    } else {
+        S->release_node(n);
+    }
+}
+
+// node is being migrated here, but not yet completed
+template <typename ParamsType, typename NodeStateType, typename CacheValueType>
+inline void
+defer_node_prog(node_prog::node_prog_running_state<ParamsType, NodeStateType, CacheValueType> &np,
+    std::pair<node_handle_t, ParamsType> &id_params)
+{
+    const node_handle_t &node_handle = id_params.first;
+    std::vector<std::pair<node_handle_t, ParamsType>> buf_node_params;
+    buf_node_params.emplace_back(id_params);
+    std::unique_ptr<message::message> m(new message::message());
+    m->prepare_message(message::NODE_PROG, np.prog_type_recvd, np.vt_id, np.req_vclock, np.req_id, np.vt_prog_ptr, shard_id, buf_node_params);
+    S->migration_mutex.lock();
+    if (S->deferred_reads.find(node_handle) == S->deferred_reads.end()) {
+        S->deferred_reads.emplace(node_handle, std::vector<std::unique_ptr<message::message>>());
+    }
+    S->deferred_reads[node_handle].emplace_back(std::move(m));
+    WDEBUG << "Buffering read for node " << node_handle << std::endl;
+    S->migration_mutex.unlock();
+}
+
+// node has moved to new_loc, forward node program
+template <typename ParamsType, typename NodeStateType, typename CacheValueType>
+inline void
+forward_node_prog(node_prog::node_prog_running_state<ParamsType, NodeStateType, CacheValueType> &np,
+    std::pair<node_handle_t, ParamsType> &id_params,
+    uint64_t new_loc)
+{
+    if (!S->prog_states.add_peer(np.req_id, new_loc)) {
+        return; // request finished meanwhile
+    }
+    std::vector<std::pair<node_handle_t, ParamsType>> fwd_node_params;
+    fwd_node_params.emplace_back(id_params);
+    std::unique_ptr<message::message> m(new message::message());
+    m->prepare_message(message::NODE_PROG, np.prog_type_recvd, np.vt_id, np.req_vclock, np.req_id, np.vt_prog_ptr, shard_id, fwd_node_params);
+    S->comm.send(new_loc, m->buf);
+}
+
+// cancel request at the shards it was forwarded to or received from, except the shard the cancel came from
+// each of them passes the cancel on to its own peers, so that it reaches all shards which the request visited
+inline void
+send_prog_cancels(uint64_t req_id, const std::unordered_set<uint64_t> &peers, uint64_t from)
+{
+    message::message msg;
+    for (uint64_t sid: peers) {
+        if (sid != from && sid != shard_id) {
+            msg.prepare_message(message::NODE_PROG_CANCEL, req_id, shard_id);
+            S->comm.send(sid, msg.buf);
+        }
+    }
+}
+
+// mark request as done and send result back to vector timestamper that issued request
+template <typename ParamsType, typename NodeStateType, typename CacheValueType>
+inline void
+return_node_prog(node_prog::node_prog_running_state<ParamsType, NodeStateType, CacheValueType> &np,
+    ParamsType &ret_params)
+{
+    // mark request as done, and cancel right away at the shards it was sent to or received from, if any
+    // no-ops from coordinator also mark the request done at other shards, in case a cancel is lost
+    std::unordered_set<uint64_t> peers;
+    S->prog_states.done_request(np.req_id, &peers);
+    std::unique_ptr<message::message> m(new message::message());
+    m->prepare_message(message::NODE_PROG_RETURN, np.prog_type_recvd, np.req_id, np.vt_prog_ptr, ret_params);
+    S->comm.send(np.vt_id, m->buf);
+
+    send_prog_cancels(np.req_id, peers, shard_id);
+}
+
+// batch the node programs generated at node_handle for onward propagation
+// local hops go in local_next, remote hops in batched_node_progs
+// returns false if the program returned to the coordinator, in which case ret_params is the value to send back
+template <typename ParamsType, typename NodeStateType, typename CacheValueType>
+inline bool
+route_next_node_progs(const node_handle_t &node_handle,
+    node_prog::node_prog_running_state<ParamsType, NodeStateType, CacheValueType> &np,
+    std::pair<node_prog::search_type, std::vector<std::pair<db::element::remote_node, ParamsType>>> &next_node_params,
+    std::deque<std::pair<node_handle_t, ParamsType>> &local_next,
+    std::unordered_map<uint64_t, std::deque<std::pair<node_handle_t, ParamsType>>> &batched_node_progs,
+    ParamsType *&ret_params)
+{
+#ifdef WEAVER_CLDG
+    std::unordered_map<node_handle_t, uint32_t> agg_msg_count;
+#else
+    UNUSED(node_handle);
+#endif
+    bool returned = false;
+    uint64_t num_shards = get_num_shards();
+    for (std::pair<db::element::remote_node, ParamsType> &res : next_node_params.second) {
+        db::element::remote_node& rn = res.first; 
+        assert(rn.loc < num_shards + ShardIdIncr);
+        if (rn == db::element::coordinator || rn.loc == np.vt_id) {
+            ret_params = &res.second;
+            returned = true;
+            break; // can only send one message back
+        } else {
+            std::deque<std::pair<node_handle_t, ParamsType>> &next_deque = (rn.loc == S->shard_id) ? local_next : batched_node_progs[rn.loc]; // TODO this is dumb just have a single data structure later
+            if (next_node_params.first == node_prog::search_type::DEPTH_FIRST) {
+                next_deque.emplace_front(rn.handle, std::move(res.second));
+            } else { // BREADTH_FIRST
+                next_deque.emplace_back(rn.handle, std::move(res.second));
+            }
+#ifdef WEAVER_CLDG
+            agg_msg_count[node_handle]++;
+#endif
+        }
+    }
+#ifdef WEAVER_CLDG
+    S->msg_count_mutex.lock();
+    for (auto &p: agg_msg_count) {
+        S->agg_msg_count[p.first] += p.second;
+    }
+    S->msg_count_mutex.unlock();
+#endif
+
+    return !returned;
+}
+
+// send batched node progs for each shard which has at least min_size of them
+template <typename ParamsType, typename NodeStateType, typename CacheValueType>
+inline void
+send_batched_node_progs(node_prog::node_prog_running_state<ParamsType, NodeStateType, CacheValueType> &np,
+    std::unordered_map<uint64_t, std::deque<std::pair<node_handle_t, ParamsType>>> &batched_node_progs,
+    uint64_t min_size)
+{
+    message::message out_msg;
+    uint64_t num_shards = get_num_shards();
+    for (auto &loc_progs_pair : batched_node_progs) {
+        if (!loc_progs_pair.second.empty() && loc_progs_pair.second.size() >= min_size) {
+            assert(loc_progs_pair.first != S->shard_id && loc_progs_pair.first < num_shards + ShardIdIncr);
+            if (!S->prog_states.add_peer(np.req_id, loc_progs_pair.first)) {
+                // request finished meanwhile
+                loc_progs_pair.second.clear();
+                continue;
+            }
+            out_msg.prepare_message(message::NODE_PROG, np.prog_type_recvd, np.vt_id, np.req_vclock, np.req_id, np.vt_prog_ptr, shard_id, loc_progs_pair.second);
+            S->coalescer.send(loc_progs_pair.first, np.req_id, out_msg.buf);
+            loc_progs_pair.second.clear();
+        }
+    }
+}
+
+// state shared by all chunks of a single parallel frontier expansion
+// chunk outputs are kept separate and merged in frontier order by the thread that started the expansion
+template <typename ParamsType>
+struct frontier_job
+{
+    typedef std::deque<std::pair<node_handle_t, ParamsType>> prog_deque;
+
+    std::vector<std::pair<node_handle_t, ParamsType>> frontier;
+    uint64_t num_chunks;
+    std::vector<prog_deque> local_next;
+    std::vector<std::unordered_map<uint64_t, prog_deque>> batched_node_progs;
+    db::done_flag_t req_done;
+
+    po6::threads::mutex mtx;
+    po6::threads::cond done_cond;
+    uint64_t next_chunk; // protected by mtx
+    uint64_t chunks_done; // protected by mtx
+    bool done_request; // protected by mtx
+    bool depth_first; // protected by mtx
+
+    frontier_job(prog_deque &start_node_params, db::done_flag_t &done_flag)
+        : frontier(std::make_move_iterator(start_node_params.begin()), std::make_move_iterator(start_node_params.end()))
+        , num_chunks((frontier.size() + FRONTIER_CHUNK_SIZE - 1) / FRONTIER_CHUNK_SIZE)
+        , local_next(num_chunks)
+        , batched_node_progs(num_chunks)
+        , req_done(done_flag)
+        , done_cond(&mtx)
+        , next_chunk(0)
+        , chunks_done(0)
+        , done_request(false)
+        , depth_first(false)
+    { }
+
+    bool is_done()
+    {
+        mtx.lock();
+        bool done = done_request;
+        mtx.unlock();
+        return done;
+    }
+
+    // returns true if this call marked the request done
+    bool mark_done()
+    {
+        mtx.lock();
+        bool first = !done_request;
+        done_request = true;
+        mtx.unlock();
+        return first;
+    }
+
+    // delete standard copy onstructors
+    frontier_job(const frontier_job&) = delete;
+    frontier_job& operator=(frontier_job const&) = delete;
+};
+
+// run node program on a single chunk of the frontier
+// same as the sequential loop in node_prog_loop, except that there are no cache lookups
+template <typename ParamsType, typename NodeStateType, typename CacheValueType>
+void
+expand_frontier_chunk(typename node_prog::node_function_type<ParamsType, NodeStateType, CacheValueType>::value_type func,
+    node_prog::node_prog_running_state<ParamsType, NodeStateType, CacheValueType> &np,
+    frontier_job<ParamsType> &job,
+    uint64_t chunk,
+    bool read_only,
+    order::oracle *time_oracle)
+{
+    db::element::remote_node this_node(S->shard_id, "");
+    bool depth_first = false;
+
+    uint64_t begin = chunk * FRONTIER_CHUNK_SIZE;
+    uint64_t end = std::min(begin + FRONTIER_CHUNK_SIZE, (uint64_t)job.frontier.size());
+    for (uint64_t i = begin; i < end && !job.is_done(); i++) {
+        auto &id_params = job.frontier[i];
+        const node_handle_t &node_handle = id_params.first;
+        this_node.handle = node_handle;
+        db::element::node *node = read_only? S->acquire_node_shared(node_handle) : S->acquire_node(node_handle);
+        if (node == NULL || time_oracle->compare_two_vts(node->base.get_del_time(), *np.req_vclock)==0) {
+            if (node != NULL) {
+                release_prog_node(node, read_only);
+            } else {
+                defer_node_prog(np, id_params);
+            }
+            continue;
+        } else if (node->state == db::element::node::mode::MOVED) {
+            uint64_t new_loc = node->new_loc;
+            release_prog_node(node, read_only);
+            forward_node_prog(np, id_params, new_loc);
+            continue;
+        }
+        assert(node->state == db::element::node::mode::STABLE);
+
+        if (job.req_done->load()) {
+            job.mark_done();
+            release_prog_node(node, read_only);
+            break;
+        }
+
+        node_prog::node_prog_context<NodeStateType, CacheValueType> ctx(*node,
+            S->prog_states,
+            np.req_id,
+            np.prog_type_recvd,
+            node->handle_id,
+            MaxCacheEntries? &np.req_vclock : NULL);
+
+        node->base.view_time = np.req_vclock; 
+        node->base.time_oracle = time_oracle;
+        auto next_node_params = func(*node, this_node,
+                id_params.second,
+                ctx,
+                (node_prog::cache_response<CacheValueType>*) NULL);
+        node->base.view_time = nullptr; 
+        node->base.time_oracle = nullptr;
+        release_prog_node(node, read_only);
+
+        depth_first = depth_first || (next_node_params.first == node_prog::search_type::DEPTH_FIRST);
+        ParamsType *ret_params = NULL;
+        if (!route_next_node_progs(node_handle, np, next_node_params, job.local_next[chunk], job.batched_node_progs[chunk], ret_params)) {
+            if (job.mark_done()) {
+                return_node_prog(np, *ret_params);
+            }
+            break;
+        }
+    }
+
+    if (depth_first) {
+        job.mtx.lock();
+        job.depth_first = true;
+        job.mtx.unlock();
+    }
+}
+
+// claim and expand chunks until there are none left
+// the job pointer keeps the job alive for pool tasks which start after all chunks have finished;
+// such tasks do not claim a chunk and never touch np, which may no longer exist
+template <typename ParamsType, typename NodeStateType, typename CacheValueType>
+void
+run_frontier_chunks(typename node_prog::node_function_type<ParamsType, NodeStateType, CacheValueType>::value_type func,
+    node_prog::node_prog_running_state<ParamsType, NodeStateType, CacheValueType> &np,
+    std::shared_ptr<frontier_job<ParamsType>> job,
+    bool read_only,
+    order::oracle *time_oracle)
+{
+    while (true) {
+        job->mtx.lock();
+        uint64_t chunk = job->next_chunk++;
+        job->mtx.unlock();
+
+        if (chunk >= job->num_chunks) {
+            break;
+        }
+
+        expand_frontier_chunk(func, np, *job, chunk, read_only, time_oracle);
+
+        job->mtx.lock();
+        if (++job->chunks_done == job->num_chunks) {
+            job->done_cond.signal();
+        }
+        job->mtx.unlock();
+    }
+}
+
+// cache lookups may defer a node until context is fetched from other shards, so those stay sequential
+template <typename ParamsType, typename NodeStateType, typename CacheValueType>
+inline bool
+can_expand_frontier_parallel(node_prog::node_prog_running_state<ParamsType, NodeStateType, CacheValueType> &np,
+    bool breadth_first)
+{
+    if (!breadth_first
+     || np.start_node_params.size() < FRONTIER_PARALLEL_MIN
+     || S->frontier_pool.num_threads() == 0) {
+        return false;
+    }
+    if (MaxCacheEntries) {
+        for (auto &id_params: np.start_node_params) {
+            if (id_params.second.search_cache()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// expand the entire local frontier in parallel, in chunks executed by this thread and the shard work pool
+// next local frontier replaces np.start_node_params, remote hops are merged in to the given structure
+// returns true if request is done
+template <typename ParamsType, typename NodeStateType, typename CacheValueType>
+inline bool
+expand_frontier_parallel(typename node_prog::node_function_type<ParamsType, NodeStateType, CacheValueType>::value_type func,
+    node_prog::node_prog_running_state<ParamsType, NodeStateType, CacheValueType> &np,
+    std::unordered_map<uint64_t, std::deque<std::pair<node_handle_t, ParamsType>>> &batched_node_progs,
+    db::done_flag_t &req_done,
+    bool &breadth_first,
+    bool read_only,
+    order::oracle *time_oracle)
+{
+    std::shared_ptr<frontier_job<ParamsType>> job(new frontier_job<ParamsType>(np.start_node_params, req_done));
+    np.start_node_params.clear();
+
+    using namespace std::placeholders;
+    uint64_t num_helpers = std::min(S->frontier_pool.num_threads(), job->num_chunks - 1);
+    for (uint64_t i = 0; i < num_helpers; i++) {
+        S->frontier_pool.submit(std::bind(run_frontier_chunks<ParamsType, NodeStateType, CacheValueType>,
+            func, std::ref(np), job, read_only, _1));
+    }
+
+    // this thread also expands chunks, so the request makes progress even if the pool is busy
+    run_frontier_chunks(func, np, job, read_only, time_oracle);
+
+    job->mtx.lock();
+    while (job->chunks_done < job->num_chunks) {
+        job->done_cond.wait();
+    }
+    job->mtx.unlock();
+
+    for (uint64_t c = 0; c < job->num_chunks; c++) {
+        for (auto &id_params: job->local_next[c]) {
+            np.start_node_params.emplace_back(std::move(id_params));
+        }
+        for (auto &loc_progs_pair: job->batched_node_progs[c]) {
+            auto &batch = batched_node_progs[loc_progs_pair.first];
+            for (auto &id_params: loc_progs_pair.second) {
+                batch.emplace_back(std::move(id_params));
+            }
+        }
+    }
+
+    breadth_first = !job->depth_first;
+    return job->done_request;
+}
+
 template <typename ParamsType, typename NodeStateType, typename CacheValueType>
 inline void node_prog_loop(typename node_prog::node_function_type<ParamsType, NodeStateType, CacheValueType>::value_type func,
         node_prog::node_prog_running_state<ParamsType, NodeStateType, CacheValueType> &np,
@@ -933,54 +1337,45 @@ inline void node_prog_loop(typename node_prog::node_function_type<ParamsType, No
 {
     assert(time_oracle != nullptr);
 
-    message::message out_msg;
     // these are the node programs that will be propagated onwards
     std::unordered_map<uint64_t, std::deque<std::pair<node_handle_t, ParamsType>>> batched_node_progs;
-    // node state function
-    std::function<NodeStateType&()> node_state_getter;
-    std::function<void(std::shared_ptr<CacheValueType>,
-                       std::shared_ptr<std::vector<db::element::remote_node>>,
-                       cache_key_t)> add_cache_func;
 
-    std::vector<node_handle_t> nodes_that_created_state;
+    // set by NODE_PROG_CANCEL or NOP once the request has finished at some shard, checked per node
+    db::done_flag_t req_done = S->prog_states.get_done_flag(np.req_id);
 
     node_handle_t node_handle;
     bool done_request = false;
     db::element::remote_node this_node(S->shard_id, "");
+    bool read_only = node_prog::is_read_only(np.prog_type_recvd);
+    bool breadth_first = false; // search type returned by last node visited
 
     while (!done_request && !np.start_node_params.empty()) {
+        if (can_expand_frontier_parallel(np, breadth_first)) {
+            done_request = expand_frontier_parallel(func, np, batched_node_progs, req_done,
+                breadth_first, read_only, time_oracle);
+            if (!done_request && !req_done->load()) {
+                send_batched_node_progs(np, batched_node_progs, BATCH_MSG_SIZE);
+            }
+            continue;
+        }
+
         auto &id_params = np.start_node_params.front();
         node_handle = id_params.first;
         ParamsType &params = id_params.second;
         this_node.handle = node_handle;
-        db::element::node *node = S->acquire_node(node_handle);
+        db::element::node *node = read_only? S->acquire_node_shared(node_handle) : S->acquire_node(node_handle);
         if (node == NULL || time_oracle->compare_two_vts(node->base.get_del_time(), *np.req_vclock)==0) {
             if (node != NULL) {
-                S->release_node(node);
+                release_prog_node(node, read_only);
             } else {
-                // node is being migrated here, but not yet completed
-                std::vector<std::pair<node_handle_t, ParamsType>> buf_node_params;
-                buf_node_params.emplace_back(id_params);
-                std::unique_ptr<message::message> m(new message::message());
-                m->prepare_message(message::NODE_PROG, np.prog_type_recvd, np.vt_id, np.req_vclock, np.req_id, np.vt_prog_ptr, buf_node_params);
-                S->migration_mutex.lock();
-                if (S->deferred_reads.find(node_handle) == S->deferred_reads.end()) {
-                    S->deferred_reads.emplace(node_handle, std::vector<std::unique_ptr<message::message>>());
-                }
-                S->deferred_reads[node_handle].emplace_back(std::move(m));
-                WDEBUG << "Buffering read for node " << node_handle << std::endl;
-                S->migration_mutex.unlock();
+                defer_node_prog(np, id_params);
             }
             np.start_node_params.pop_front(); // pop off this one
         } else if (node->state == db::element::node::mode::MOVED) {
             // queueing/forwarding node program
-            std::vector<std::pair<node_handle_t, ParamsType>> fwd_node_params;
-            fwd_node_params.emplace_back(id_params);
-            std::unique_ptr<message::message> m(new message::message());
-            m->prepare_message(message::NODE_PROG, np.prog_type_recvd, np.vt_id, np.req_vclock, np.req_id, np.vt_prog_ptr, fwd_node_params);
             uint64_t new_loc = node->new_loc;
-            S->release_node(node);
-            S->comm.send(new_loc, m->buf);
+            release_prog_node(node, read_only);
+            forward_node_prog(np, id_params, new_loc);
             np.start_node_params.pop_front(); // pop off this one
         } else { // node does exist
             assert(node->state == db::element::node::mode::STABLE);
@@ -992,14 +1387,15 @@ inline void node_prog_loop(typename node_prog::node_function_type<ParamsType, No
                 }
                 */
 #endif
-            if (S->check_done_request(np.req_id, *np.req_vclock)) {
+            if (req_done->load()) {
                 done_request = true;
-                S->release_node(node);
+                release_prog_node(node, read_only);
                 break;
             }
 
             if (MaxCacheEntries) {
                 if (params.search_cache() && !np.cache_value) {
+                    assert(!read_only);
                     // cache value not already found, lookup in cache
                     bool run_prog_now = cache_lookup<ParamsType, NodeStateType, CacheValueType>(node, params.cache_key(), np, id_params, time_oracle);
                     if (!run_prog_now) { 
@@ -1008,15 +1404,14 @@ inline void node_prog_loop(typename node_prog::node_function_type<ParamsType, No
                         continue;
                     }
                 }
-
-                using namespace std::placeholders;
-                add_cache_func = std::bind(&db::element::node::add_cache_value, // function pointer
-                    node, // reference to object whose member-function is invoked
-                    np.req_vclock, // first argument of the function
-                    _1, _2, _3); // 1 is cache value, 2 is watch set, 3 is key
             }
 
-            node_state_getter = std::bind(get_or_create_state<NodeStateType>, np.prog_type_recvd, np.req_id, node, &nodes_that_created_state); 
+            node_prog::node_prog_context<NodeStateType, CacheValueType> ctx(*node,
+                S->prog_states,
+                np.req_id,
+                np.prog_type_recvd,
+                node->handle_id,
+                MaxCacheEntries? &np.req_vclock : NULL);
 
             node->base.view_time = np.req_vclock; 
             node->base.time_oracle = time_oracle;
@@ -1025,11 +1420,11 @@ inline void node_prog_loop(typename node_prog::node_function_type<ParamsType, No
             // call node program
             auto next_node_params = func(*node, this_node,
                     params, // actual parameters for this node program
-                    node_state_getter, add_cache_func,
+                    ctx,
                     (node_prog::cache_response<CacheValueType>*) np.cache_value.get());
             if (MaxCacheEntries) {
                 if (np.cache_value) {
-                    auto state = get_state_if_exists(*node, np.req_id, np.prog_type_recvd);
+                    auto state = S->prog_states.find(np.req_id, node->handle_id);
                     if (state) {
                         state->contexts_found.insert(np.req_id);
                     }
@@ -1038,75 +1433,29 @@ inline void node_prog_loop(typename node_prog::node_function_type<ParamsType, No
             }
             node->base.view_time = nullptr; 
             node->base.time_oracle = nullptr;
-            S->release_node(node);
+            release_prog_node(node, read_only);
             np.start_node_params.pop_front(); // pop off this one before potentially add new front
 
+            breadth_first = (next_node_params.first == node_prog::search_type::BREADTH_FIRST);
+
             // batch the newly generated node programs for onward propagation
-#ifdef WEAVER_CLDG
-            std::unordered_map<node_handle_t, uint32_t> agg_msg_count;
-#endif
-            uint64_t num_shards = get_num_shards();
-            for (std::pair<db::element::remote_node, ParamsType> &res : next_node_params.second) {
-                db::element::remote_node& rn = res.first; 
-                assert(rn.loc < num_shards + ShardIdIncr);
-                if (rn == db::element::coordinator || rn.loc == np.vt_id) {
-                    // mark requests as done, will be done for other shards by no-ops from coordinator
-                    std::vector<std::pair<uint64_t, node_prog::prog_type>> completed_request {std::make_pair(np.req_id, np.prog_type_recvd)};
-                    S->add_done_requests(completed_request);
-                    done_request = true;
-                    // signal to send back to vector timestamper that issued request
-                    std::unique_ptr<message::message> m(new message::message());
-                    m->prepare_message(message::NODE_PROG_RETURN, np.prog_type_recvd, np.req_id, np.vt_prog_ptr, res.second);
-                    S->comm.send(np.vt_id, m->buf);
-                    break; // can only send one message back
-                } else {
-                    std::deque<std::pair<node_handle_t, ParamsType>> &next_deque = (rn.loc == S->shard_id) ? np.start_node_params : batched_node_progs[rn.loc]; // TODO this is dumb just have a single data structure later
-                    if (next_node_params.first == node_prog::search_type::DEPTH_FIRST) {
-                        next_deque.emplace_front(rn.handle, std::move(res.second));
-                    } else { // BREADTH_FIRST
-                        next_deque.emplace_back(rn.handle, std::move(res.second));
-                    }
-#ifdef WEAVER_CLDG
-                    agg_msg_count[node_handle]++;
-#endif
-                }
-            }
-#ifdef WEAVER_CLDG
-            S->msg_count_mutex.lock();
-            for (auto &p: agg_msg_count) {
-                S->agg_msg_count[p.first] += p.second;
+            ParamsType *ret_params = NULL;
+            if (!route_next_node_progs(node_handle, np, next_node_params, np.start_node_params, batched_node_progs, ret_params)) {
+                return_node_prog(np, *ret_params);
+                done_request = true;
             }
-            S->msg_count_mutex.unlock();
-#endif
         }
-        uint64_t num_shards = get_num_shards();
-        assert(batched_node_progs.size() < num_shards);
-        for (auto &loc_progs_pair : batched_node_progs) {
-            assert(loc_progs_pair.first != shard_id && loc_progs_pair.first < num_shards + ShardIdIncr);
-            if (loc_progs_pair.second.size() > BATCH_MSG_SIZE) {
-                out_msg.prepare_message(message::NODE_PROG, np.prog_type_recvd, np.vt_id, np.req_vclock, np.req_id, np.vt_prog_ptr, loc_progs_pair.second);
-                S->comm.send(loc_progs_pair.first, out_msg.buf);
-                loc_progs_pair.second.clear();
-            }
+        assert(batched_node_progs.size() < get_num_shards());
+        if (!done_request && !req_done->load()) {
+            send_batched_node_progs(np, batched_node_progs, BATCH_MSG_SIZE);
         }
         if (MaxCacheEntries) {
             assert(np.cache_value == false); // unique ptr is not assigned
         }
     }
-    uint64_t num_shards = get_num_shards();
-    if (!done_request) {
-        for (auto &loc_progs_pair : batched_node_progs) {
-            if (!loc_progs_pair.second.empty()) {
-                assert(loc_progs_pair.first != shard_id && loc_progs_pair.first < num_shards + ShardIdIncr);
-                out_msg.prepare_message(message::NODE_PROG, np.prog_type_recvd, np.vt_id, np.req_vclock, np.req_id, np.vt_prog_ptr, loc_progs_pair.second);
-                S->comm.send(loc_progs_pair.first, out_msg.buf);
-                loc_progs_pair.second.clear();
-            }
-        }
-    }
-
-    if (!nodes_that_created_state.empty()) {
-        S->mark_nodes_using_state(np.req_id, nodes_that_created_state);
+    // hops of a request which finished elsewhere meanwhile are dropped with the batches
+    if (!done_request && !req_done->load()) {
+        send_batched_node_progs(np, batched_node_progs, 1);
     }
 }
 
@@ -1121,6 +1470,45 @@ unpack_node_program(db::message_wrapper *request)
     delete request;
 }
 
+// exec node program now if it is ready, else enqueue for future execution
+void
+recv_node_program(std::unique_ptr<message::message> msg)
+{
+    node_prog::prog_type pType;
+    uint64_t vt_id, req_id;
+    vc::vclock vclk;
+
+    msg->unpack_partial_message(message::NODE_PROG, pType, vt_id, vclk, req_id);
+    assert(vclk.clock.size() == ClkSz);
+
+    // drop hops of cancelled request before they are queued
+    if (S->prog_states.is_done(req_id)) {
+        return;
+    }
+
+    db::message_wrapper *mwrap = new db::message_wrapper(message::NODE_PROG, std::move(msg));
+    if (S->qm.check_rd_request(vclk.clock)) {
+        submit_request(unpack_node_program, mwrap, node_prog_class(pType));
+    } else {
+        db::queued_request *qreq = new db::queued_request(req_id, vclk, unpack_node_program, mwrap, node_prog_class(pType));
+        S->qm.enqueue_read_request(vt_id, qreq);
+        schedule_drain();
+    }
+}
+
+// request finished at some other shard, pass the cancel on the first time it arrives
+void
+unpack_prog_cancel(db::message_wrapper *request)
+{
+    uint64_t req_id, from;
+    request->msg->unpack_message(message::NODE_PROG_CANCEL, req_id, from);
+    std::unordered_set<uint64_t> peers;
+    if (S->prog_states.done_request(req_id, &peers)) {
+        send_prog_cancels(req_id, peers, from);
+    }
+    delete request;
+}
+
 void
 unpack_context_reply(db::message_wrapper *request)
 {
@@ -1190,10 +1578,11 @@ void
 node_prog :: particular_node_program<ParamsType, NodeStateType, CacheValueType> :: unpack_and_run_db(std::unique_ptr<message::message> msg, order::oracle *time_oracle)
 {
     node_prog::node_prog_running_state<ParamsType, NodeStateType, CacheValueType> np;
+    uint64_t prev_loc; // shard or vt which sent these hops
 
     // unpack the node program
     try {
-        msg->unpack_message(message::NODE_PROG, np.prog_type_recvd, np.vt_id, np.req_vclock, np.req_id, np.vt_prog_ptr, np.start_node_params);
+        msg->unpack_message(message::NODE_PROG, np.prog_type_recvd, np.vt_id, np.req_vclock, np.req_id, np.vt_prog_ptr, prev_loc, np.start_node_params);
         assert(np.req_vclock->clock.size() == ClkSz);
     } catch (std::bad_alloc& ba) {
         WDEBUG << "bad_alloc caught " << ba.what() << std::endl;
@@ -1212,6 +1601,10 @@ node_prog :: particular_node_program<ParamsType, NodeStateType, CacheValueType>
     if (S->check_done_request(np.req_id, *np.req_vclock)) {
         return; // done request
     }
+    // a cancel from here has to reach the shard which sent these hops
+    if (prev_loc >= ShardIdIncr && prev_loc != shard_id && !S->prog_states.add_peer(np.req_id, prev_loc)) {
+        return; // finished meanwhile
+    }
 
     assert(!np.cache_value); // a cache value should not be allocated yet
     node_prog_loop<ParamsType, NodeStateType, CacheValueType>(enclosed_node_prog_func, np, time_oracle);
@@ -1223,37 +1616,43 @@ node_prog :: particular_node_program<ParamsType, NodeStateType, CacheValueType>
 { }
 
 // delete all in-edges for a permanently deleted node
-inline void
+void
 update_deleted_node(const node_handle_t &node_handle)
 {
-    std::unordered_set<node_handle_t> nbrs;
+    std::unordered_set<uint64_t> nbrs;
     db::element::node *n;
     db::element::edge *e;
+    uint64_t handle_id;
+    if (!S->handles.lookup(node_handle, handle_id)) {
+        return; // no local in-neighbors
+    }
     S->edge_map_mutex.lock();
-    if (S->edge_map.find(node_handle) != S->edge_map.end()) {
-        nbrs = std::move(S->edge_map[node_handle]);
-        S->edge_map.erase(node_handle);
+    if (S->edge_map.find(handle_id) != S->edge_map.end()) {
+        nbrs = std::move(S->edge_map[handle_id]);
+        S->edge_map.erase(handle_id);
     }
     S->edge_map_mutex.unlock();
 
     std::vector<edge_handle_t> to_del;
     bool found;
-    for (const node_handle_t &nbr: nbrs) {
+    for (uint64_t nbr: nbrs) {
         n = S->acquire_node(nbr);
         to_del.clear();
         found = false;
-        for (auto &x: n->out_edges) {
-            e = x.second;
+        for (db::element::edge &x: n->out_edges) {
+            e = &x;
             if (e->nbr.handle == node_handle) {
-                delete e;
-                to_del.emplace_back(x.first);
+                // deleted edges are erased by their own permanent deletion
+                if (!e->base.is_deleted()) {
+                    to_del.emplace_back(e->get_handle());
+                }
                 found = true;
             }
         }
         assert(found);
         UNUSED(found);
         for (const edge_handle_t &del_edge: to_del) {
-            n->out_edges.erase(del_edge);
+            S->erase_out_edge(n, del_edge);
         }
         S->release_node(n);
     }
@@ -1323,14 +1722,8 @@ migrate_node_step1(db::element::node *n,
 
     // updating edge map
     S->edge_map_mutex.lock();
-    for (auto &e: n->out_edges) {
-        const node_handle_t &node = e.second->nbr.handle;
-        assert(S->edge_map.find(node) != S->edge_map.end());
-        auto &node_set = S->edge_map[node];
-        node_set.erase(S->migr_node);
-        if (node_set.empty()) {
-            S->edge_map.erase(node);
-        }
+    for (db::element::edge &e: n->out_edges) {
+        S->erase_in_nbr(e.nbr_id, n->handle_id);
     }
     S->edge_map_mutex.unlock();
 
@@ -1345,8 +1738,18 @@ migrate_node_step1(db::element::node *n,
     for (uint64_t &x: S->nop_count) {
         x = 0;
     }
+    weaver_util::reset_all(S->migr_loc_acks);
     S->migration_mutex.unlock();
 
+    // VTs may have cached the old location of this node
+    // a tx which uses the old location gets its timestamp before the VT acks,
+    // hence it is ordered before the second nop counted after the ack
+    message::message msg;
+    for (uint64_t vt = 0; vt < NumVts; vt++) {
+        msg.prepare_message(message::NODE_LOC_UPDATE, shard_id, S->migr_node, migr_loc);
+        S->comm.send(vt, msg.buf);
+    }
+
     return true;
 }
 
@@ -1355,6 +1758,7 @@ void
 migrate_node_step2_req()
 {
     db::element::node *n;
+    db::node_prog_states node_states;
     message::message msg;
 
     S->migration_mutex.lock();
@@ -1367,7 +1771,8 @@ migrate_node_step2_req()
 
     n = S->acquire_node(S->migr_node);
     assert(n != NULL);
-    msg.prepare_message(message::MIGRATE_SEND_NODE, S->migr_node, shard_id, *n);
+    S->prog_states.extract_node(n->handle_id, node_states);
+    msg.prepare_message(message::MIGRATE_SEND_NODE, S->migr_node, shard_id, *n, node_states);
     S->release_node(n);
     S->comm.send(S->migr_shard, msg.buf);
 }
@@ -1382,13 +1787,14 @@ migrate_node_step2_resp(std::unique_ptr<message::message> msg, order::oracle *ti
     uint64_t from_loc;
     node_handle_t node_handle;
     db::element::node *n;
+    db::node_prog_states node_states;
 
     // create a new node, unpack the message
     vc::vclock dummy_clock;
     msg->unpack_partial_message(message::MIGRATE_SEND_NODE, node_handle);
     n = S->create_node(node_handle, dummy_clock, true); // node will be acquired on return
     try {
-        msg->unpack_message(message::MIGRATE_SEND_NODE, node_handle, from_loc, *n);
+        msg->unpack_message(message::MIGRATE_SEND_NODE, node_handle, from_loc, *n, node_states);
     } catch (std::bad_alloc& ba) {
         WDEBUG << "bad_alloc caught " << ba.what() << std::endl;
         return;
@@ -1396,9 +1802,9 @@ migrate_node_step2_resp(std::unique_ptr<message::message> msg, order::oracle *ti
 
     // updating edge map
     S->edge_map_mutex.lock();
-    for (auto &e: n->out_edges) {
-        const node_handle_t &node = e.second->nbr.handle;
-        S->edge_map[node].emplace(node_handle);
+    for (db::element::edge &e: n->out_edges) {
+        e.nbr_id = S->handles.intern(e.nbr.handle);
+        S->edge_map[e.nbr_id].emplace(n->handle_id);
     }
     S->edge_map_mutex.unlock();
 
@@ -1437,21 +1843,12 @@ migrate_node_step2_resp(std::unique_ptr<message::message> msg, order::oracle *ti
     }
     n->state = db::element::node::mode::STABLE;
 
-    std::vector<uint64_t> prog_state_reqs;
-    for (auto &state_map: n->prog_states) {
-        for (auto &state: state_map) {
-            prog_state_reqs.emplace_back(state.first);
-        }
-    }
+    // state of finished requests is dropped here
+    S->prog_states.insert_node(n->handle_id, node_states);
 
     // release node for new reads and writes
     S->release_node(n);
 
-    std::vector<node_handle_t> this_node_vec(1, node_handle);
-    for (uint64_t req_id: prog_state_reqs) {
-        S->mark_nodes_using_state(req_id, this_node_vec);
-    }
-
     // move deferred reads to local for releasing migration_mutex
     std::vector<std::unique_ptr<message::message>> deferred_reads;
     if (S->deferred_reads.find(node_handle) != S->deferred_reads.end()) {
@@ -1543,8 +1940,8 @@ cldg_migration_wrapper(std::vector<uint64_t> &shard_node_count, uint64_t migr_nu
         db::element::edge *e;
         // get aggregate msg counts per shard
         //std::vector<uint64_t> msg_count(NumShards, 0);
-        for (auto &e_iter: n->out_edges) {
-            e = e_iter.second;
+        for (db::element::edge &e_iter: n->out_edges) {
+            e = &e_iter;
             //msg_count[e->nbr.loc - ShardIdIncr] += e->msg_count;
             n->msg_count[e->nbr.loc - ShardIdIncr] += e->msg_count;
         }
@@ -1578,7 +1975,7 @@ ldg_migration_wrapper(std::vector<uint64_t> &shard_node_count, uint64_t migr_num
     bool no_migr = true;
     while (S->ldg_iter != S->ldg_nodes.end()) {
         db::element::node *n;
-        const node_handle_t &migr_node = *S->ldg_iter;
+        uint64_t migr_node = *S->ldg_iter;
         S->ldg_iter++;
         n = S->acquire_node(migr_node);
 
@@ -1589,8 +1986,8 @@ ldg_migration_wrapper(std::vector<uint64_t> &shard_node_count, uint64_t migr_num
 
         // regular LDG
         db::element::edge *e;
-        for (auto &e_iter: n->out_edges) {
-            e = e_iter.second;
+        for (db::element::edge &e_iter: n->out_edges) {
+            e = &e_iter;
             n->migr_score[e->nbr.loc - ShardIdIncr] += 1;
         }
         for (uint64_t j = 0; j < migr_num_shards; j++) {
@@ -1650,7 +2047,8 @@ migration_begin()
     auto agg_msg_count = std::move(S->agg_msg_count);
     S->msg_count_mutex.unlock();
     std::vector<std::pair<node_handle_t, uint32_t>> sorted_nodes;
-    for (const node_handle_t &n: S->ldg_nodes) {
+    for (uint64_t id: S->ldg_nodes) {
+        node_handle_t n = S->handles.get_handle(id);
         if (agg_msg_count.find(n) != agg_msg_count.end()) {
             sorted_nodes.emplace_back(std::make_pair(n, agg_msg_count[n]));
         } else {
@@ -1664,7 +2062,8 @@ migration_begin()
 
 #ifdef WEAVER_NEW_CLDG
     uint64_t mcnt;
-    for (const node_handle_t &nid: S->ldg_nodes) {
+    for (uint64_t id: S->ldg_nodes) {
+        node_handle_t nid = S->handles.get_handle(id);
         mcnt = 0;
         db::element::node *n = S->acquire_node(nid);
         for (uint64_t cnt: n->msg_count) {
@@ -1700,7 +2099,475 @@ migration_end()
     S->comm.send(next_shard, msg.buf);
 }
 
+// bulk synchronous analytics, see node_prog/bsp_program.h
+// the timestamper asks for each superstep, and shards exchange combined vertex messages directly
+// caution: nodes which migrate while a job is running are not followed, messages to them are lost
+
+typedef std::unordered_map<node_handle_t, node_prog::bsp_msg> bsp_outbox; // dest node -> combined message
+
+// state shared by all chunks of a single superstep at this shard
+struct bsp_superstep
+{
+    std::shared_ptr<db::bsp_job> job;
+    uint64_t step;
+    node_prog::bsp_stats prev_totals;
+    uint64_t num_chunks;
+    std::vector<node_prog::bsp_stats> stats; // per chunk
+    std::vector<std::unordered_map<uint64_t, bsp_outbox>> outboxes; // per chunk, dest shard -> messages
+
+    po6::threads::mutex mtx;
+    po6::threads::cond done_cond;
+    uint64_t next_chunk; // protected by mtx
+    uint64_t chunks_done; // protected by mtx
+
+    bsp_superstep(std::shared_ptr<db::bsp_job> &j, uint64_t s, node_prog::bsp_stats &totals)
+        : job(j)
+        , step(s)
+        , prev_totals(totals)
+        , num_chunks((NUM_HANDLE_STRIPES + BSP_STRIPES_PER_CHUNK - 1) / BSP_STRIPES_PER_CHUNK)
+        , stats(num_chunks)
+        , outboxes(num_chunks)
+        , done_cond(&mtx)
+        , next_chunk(0)
+        , chunks_done(0)
+    { }
+
+    // delete standard copy onstructors
+    bsp_superstep(const bsp_superstep&) = delete;
+    bsp_superstep& operator=(bsp_superstep const&) = delete;
+};
+
+// create vertices for nodes in stripe visible at the job snapshot, with their visible out-nbrs
+void
+bsp_load_stripe(db::bsp_job &job, uint64_t stripe_idx, order::oracle *time_oracle)
+{
+    std::vector<uint64_t> handle_ids;
+    S->nodes.get_stripe_ids(stripe_idx, handle_ids);
+    db::bsp_stripe &stripe = job.stripes[stripe_idx];
+
+    for (uint64_t handle_id: handle_ids) {
+        db::element::node *node = S->acquire_node_shared(handle_id);
+        if (node == NULL) {
+            continue;
+        }
+        if (node->state != db::element::node::mode::STABLE
+         || !time_oracle->clock_creat_before_del_after(*job.snapshot, node->base.get_creat_time(), node->base.get_del_time())) {
+            S->release_node_shared(node);
+            continue;
+        }
+
+        node_prog::bsp_vertex &v = stripe.vertices[handle_id];
+        v.id = (shard_id << 48) | handle_id;
+        node->base.view_time = job.snapshot;
+        node->base.time_oracle = time_oracle;
+        for (node_prog::edge &e: node->get_edges()) {
+            v.out_nbrs.emplace_back(e.get_neighbor());
+        }
+        node->base.view_time = nullptr;
+        node->base.time_oracle = nullptr;
+        S->release_node_shared(node);
+    }
+}
+
+// messages to local vertices go straight to the inbox of the next superstep
+inline void
+bsp_route_msg(bsp_superstep &ss, uint64_t chunk, const db::element::remote_node &nbr, const node_prog::bsp_msg &out)
+{
+    if (nbr.loc == shard_id) {
+        uint64_t handle_id;
+        if (S->handles.lookup(nbr.handle, handle_id)) {
+            ss.job->add_msg(ss.step+1, handle_id, out);
+        }
+    } else {
+        ss.outboxes[chunk][nbr.loc][nbr.handle].combine(out);
+    }
+}
+
+// run superstep on all vertices in a chunk of stripes
+void
+bsp_run_chunk(bsp_superstep &ss, uint64_t chunk, order::oracle *time_oracle)
+{
+    db::bsp_job &job = *ss.job;
+    uint64_t parity = ss.step % 2;
+    bool undirected = node_prog::bsp_undirected(job.params.algorithm);
+
+    uint64_t begin = chunk * BSP_STRIPES_PER_CHUNK;
+    uint64_t end = std::min(begin + BSP_STRIPES_PER_CHUNK, (uint64_t)NUM_HANDLE_STRIPES);
+    for (uint64_t s = begin; s < end; s++) {
+        db::bsp_stripe &stripe = job.stripes[s];
+        if (ss.step == 0) {
+            bsp_load_stripe(job, s, time_oracle);
+        }
+
+        // messages for this superstep have all arrived, other threads only add to the other inbox
+        std::unordered_map<uint64_t, node_prog::bsp_msg> inbox;
+        stripe.inbox_mtx.lock();
+        inbox = std::move(stripe.inbox[parity]);
+        stripe.inbox[parity].clear();
+        stripe.inbox_mtx.unlock();
+
+        for (auto &p: stripe.vertices) {
+            node_prog::bsp_vertex &v = p.second;
+            auto msg_iter = inbox.find(p.first);
+            const node_prog::bsp_msg *msg = (msg_iter == inbox.end())? NULL : &msg_iter->second;
+
+            if (ss.step == 1 && undirected && msg != NULL) {
+                v.in_nbrs = msg->senders;
+            }
+
+            node_prog::bsp_send send = node_prog::bsp_compute(job.params, ss.step, ss.prev_totals, v, msg, ss.stats[chunk]);
+            if (send == node_prog::BSP_SEND_NONE) {
+                continue;
+            }
+
+            node_prog::bsp_msg out;
+            node_prog::bsp_outgoing(job.params, v, out);
+            if (ss.step == 0 && undirected) {
+                out.senders.emplace_back(shard_id, S->handles.get_handle(p.first));
+            }
+            for (const db::element::remote_node &nbr: v.out_nbrs) {
+                bsp_route_msg(ss, chunk, nbr, out);
+            }
+            if (send == node_prog::BSP_SEND_ALL) {
+                for (const db::element::remote_node &nbr: v.in_nbrs) {
+                    bsp_route_msg(ss, chunk, nbr, out);
+                }
+            }
+        }
+    }
+}
+
+// claim and run chunks until there are none left, same as run_frontier_chunks
+void
+bsp_run_chunks(std::shared_ptr<bsp_superstep> ss, order::oracle *time_oracle)
+{
+    while (true) {
+        ss->mtx.lock();
+        uint64_t chunk = ss->next_chunk++;
+        ss->mtx.unlock();
+
+        if (chunk >= ss->num_chunks) {
+            break;
+        }
+
+        bsp_run_chunk(*ss, chunk, time_oracle);
+
+        ss->mtx.lock();
+        if (++ss->chunks_done == ss->num_chunks) {
+            ss->done_cond.signal();
+        }
+        ss->mtx.unlock();
+    }
+}
+
+// run supersteps of this job for as long as they are ready
+// chunks run on this thread and the frontier pool, so a superstep makes progress even if the pool is busy
+void
+bsp_run_supersteps(std::shared_ptr<db::bsp_job> job, order::oracle *time_oracle)
+{
+    uint64_t num_shards = get_num_shards();
+    uint64_t step;
+    node_prog::bsp_stats totals;
+
+    while (job->try_start(num_shards, step, totals)) {
+        std::shared_ptr<bsp_superstep> ss(new bsp_superstep(job, step, totals));
+
+        using namespace std::placeholders;
+        uint64_t num_helpers = std::min(S->frontier_pool.num_threads(), ss->num_chunks - 1);
+        for (uint64_t i = 0; i < num_helpers; i++) {
+            S->frontier_pool.submit(std::bind(bsp_run_chunks, ss, _1));
+        }
+        bsp_run_chunks(ss, time_oracle);
+
+        ss->mtx.lock();
+        while (ss->chunks_done < ss->num_chunks) {
+            ss->done_cond.wait();
+        }
+        ss->mtx.unlock();
+
+        node_prog::bsp_stats step_stats;
+        std::unordered_map<uint64_t, bsp_outbox> outbox;
+        for (uint64_t c = 0; c < ss->num_chunks; c++) {
+            step_stats.add(ss->stats[c]);
+            for (auto &shard_msgs: ss->outboxes[c]) {
+                bsp_outbox &dest = outbox[shard_msgs.first];
+                for (auto &p: shard_msgs.second) {
+                    dest[p.first].combine(p.second);
+                }
+            }
+        }
+
+        // every other shard waits for a message from this shard, even if there is nothing to send
+        message::message msg;
+        for (uint64_t sid = ShardIdIncr; sid < ShardIdIncr + num_shards; sid++) {
+            if (sid != shard_id) {
+                msg.prepare_message(message::BSP_MSGS, job->req_id, step+1, outbox[sid]);
+                S->comm.send(sid, msg.buf);
+            }
+        }
+
+        // next superstep cannot be asked for before this reply, so no superstep is missed
+        job->end_step();
+        msg.prepare_message(message::BSP_STEP_DONE, job->req_id, step, step_stats);
+        S->comm.send(job->vt_id, msg.buf);
+    }
+}
+
+void
+unpack_bsp_step(db::message_wrapper *request)
+{
+    uint64_t req_id, vt_id, step;
+    vc::vclock vclk;
+    node_prog::bsp_params params;
+    node_prog::bsp_stats totals;
+    request->msg->unpack_message(message::BSP_STEP, req_id, vt_id, vclk, params, step, totals);
+
+    std::shared_ptr<db::bsp_job> job = S->get_bsp_job(req_id);
+    if (job != nullptr) {
+        if (step == 0) {
+            job->vt_id = vt_id;
+            job->snapshot = std::make_shared<vc::vclock>(vclk);
+            job->params = params;
+        }
+        job->request(step, totals);
+        bsp_run_supersteps(job, request->time_oracle);
+    }
+
+    delete request;
+}
+
+void
+unpack_bsp_msgs(db::message_wrapper *request)
+{
+    uint64_t req_id, step;
+    std::unordered_map<node_handle_t, node_prog::bsp_msg> msgs;
+    request->msg->unpack_message(message::BSP_MSGS, req_id, step, msgs);
+
+    std::shared_ptr<db::bsp_job> job = S->get_bsp_job(req_id);
+    if (job != nullptr) {
+        for (auto &p: msgs) {
+            uint64_t handle_id;
+            if (S->handles.lookup(p.first, handle_id)) {
+                job->add_msg(step, handle_id, p.second);
+            }
+        }
+        job->count_msgs(step);
+        bsp_run_supersteps(job, request->time_oracle);
+    }
+
+    delete request;
+}
+
+// job converged, send vertex values back to timestamper
+void
+unpack_bsp_finish(db::message_wrapper *request)
+{
+    uint64_t req_id;
+    request->msg->unpack_message(message::BSP_FINISH, req_id);
+
+    std::shared_ptr<db::bsp_job> job = S->remove_bsp_job(req_id);
+    if (job != nullptr) {
+        std::vector<std::pair<node_handle_t, double>> ranks;
+        std::vector<std::pair<node_handle_t, uint64_t>> labels;
+        for (uint64_t s = 0; s < NUM_HANDLE_STRIPES; s++) {
+            for (auto &p: job->stripes[s].vertices) {
+                if (job->params.algorithm == node_prog::BSP_PAGERANK) {
+                    ranks.emplace_back(S->handles.get_handle(p.first), p.second.rank);
+                } else {
+                    labels.emplace_back(S->handles.get_handle(p.first), p.second.label);
+                }
+            }
+        }
+
+        message::message msg;
+        msg.prepare_message(message::BSP_RETURN, req_id, ranks, labels);
+        S->comm.send(job->vt_id, msg.buf);
+    }
+
+    delete request;
+}
+
+// in-nbrs at this shard, for node_prog::node::get_local_in_nbrs
+void
+lookup_in_nbrs(uint64_t handle_id, std::vector<db::element::remote_node> &in_nbrs)
+{
+    std::vector<uint64_t> in_nbr_ids;
+    S->get_in_nbr_ids(handle_id, in_nbr_ids);
+    for (uint64_t id: in_nbr_ids) {
+        in_nbrs.emplace_back(shard_id, S->handles.get_handle(id));
+    }
+}
+
+// bidirectional reachability, see node_prog/bidir_reach_program.h
+// caution: frontier nodes which are being migrated are skipped
+
+inline bool
+bidir_visible(db::element::node *node, std::shared_ptr<vc::vclock> &vclk, order::oracle *time_oracle)
+{
+    return node->state == db::element::node::mode::STABLE
+        && time_oracle->clock_creat_before_del_after(*vclk, node->base.get_creat_time(), node->base.get_del_time());
+}
+
+// out-nbrs of frontier nodes at this shard
+void
+bidir_expand_forward(std::vector<node_handle_t> &frontier,
+    std::vector<std::pair<std::string, std::string>> &edge_props,
+    std::shared_ptr<vc::vclock> &vclk,
+    std::vector<db::element::remote_node> &found,
+    order::oracle *time_oracle)
+{
+    for (const node_handle_t &handle: frontier) {
+        db::element::node *node = S->acquire_node_shared(handle);
+        if (node == NULL) {
+            continue;
+        }
+        if (bidir_visible(node, vclk, time_oracle)) {
+            node->base.view_time = vclk;
+            node->base.time_oracle = time_oracle;
+            for (node_prog::edge &e: node->get_edges()) {
+                if (e.has_all_properties(edge_props)) {
+                    found.emplace_back(e.get_neighbor());
+                }
+            }
+            node->base.view_time = nullptr;
+            node->base.time_oracle = nullptr;
+        }
+        S->release_node_shared(node);
+    }
+}
+
+// in-nbrs at this shard of frontier nodes at any shard
+// in-edge map is not versioned, so each in-nbr is checked for an out-edge to the frontier node at the request clock
+void
+bidir_expand_backward(std::vector<node_handle_t> &frontier,
+    std::vector<std::pair<std::string, std::string>> &edge_props,
+    std::shared_ptr<vc::vclock> &vclk,
+    std::vector<db::element::remote_node> &found,
+    order::oracle *time_oracle)
+{
+    for (const node_handle_t &handle: frontier) {
+        uint64_t handle_id;
+        if (!S->handles.lookup(handle, handle_id)) {
+            continue;
+        }
+        std::vector<uint64_t> in_nbr_ids;
+        S->get_in_nbr_ids(handle_id, in_nbr_ids);
+
+        for (uint64_t in_nbr_id: in_nbr_ids) {
+            db::element::node *node = S->acquire_node_shared(in_nbr_id);
+            if (node == NULL) {
+                continue;
+            }
+            if (bidir_visible(node, vclk, time_oracle)) {
+                node->base.view_time = vclk;
+                node->base.time_oracle = time_oracle;
+                for (node_prog::edge &e: node->get_edges()) {
+                    if (e.get_neighbor().handle == handle && e.has_all_properties(edge_props)) {
+                        found.emplace_back(shard_id, node->get_handle());
+                        break;
+                    }
+                }
+                node->base.view_time = nullptr;
+                node->base.time_oracle = nullptr;
+            }
+            S->release_node_shared(node);
+        }
+    }
+}
+
+// expand one level of the search at this shard, and send the nbrs found to the timestamper
+void
+unpack_bidir_reach_step(db::message_wrapper *request)
+{
+    uint64_t req_id, vt_id;
+    vc::vclock vclk;
+    bool backward;
+    std::vector<std::pair<std::string, std::string>> edge_props;
+    std::vector<node_handle_t> frontier;
+    request->msg->unpack_message(message::BIDIR_REACH_STEP, req_id, vt_id, vclk, backward, edge_props, frontier);
+
+    std::shared_ptr<vc::vclock> req_vclock = std::make_shared<vc::vclock>(vclk);
+    std::vector<db::element::remote_node> found;
+    if (backward) {
+        bidir_expand_backward(frontier, edge_props, req_vclock, found, request->time_oracle);
+    } else {
+        bidir_expand_forward(frontier, edge_props, req_vclock, found, request->time_oracle);
+    }
+
+    message::message msg;
+    msg.prepare_message(message::BIDIR_REACH_STEP_DONE, req_id, found);
+    S->comm.send(vt_id, msg.buf);
+
+    delete request;
+}
+
+void
+unpack_deleted_node(db::message_wrapper *request)
+{
+    node_handle_t node;
+    request->msg->unpack_message(message::PERMANENTLY_DELETED_NODE, node);
+    update_deleted_node(node);
+    delete request;
+}
+
+// move queued requests which are now runnable to exec_pool, each in the class it was queued with
+void
+submit_queued_requests()
+{
+    db::queued_request *req;
+    while ((req = S->qm.get_queued_request()) != NULL) {
+        submit_request(req->func, req->arg, req->cls);
+        delete req;
+    }
+}
+
+// run a request on an exec_pool thread, then hand off any queued requests which are now runnable
+void
+exec_request(void (*f)(db::message_wrapper*), db::message_wrapper *request, order::oracle *time_oracle)
+{
+    S->coalescer.worker_busy();
+    request->time_oracle = time_oracle;
+    f(request);
+    // queue timestamps may have moved forward
+    submit_queued_requests();
+    // flushes coalesced node prog messages if this was the last busy thread
+    S->coalescer.worker_idle();
+}
+
+void
+submit_request(void (*f)(db::message_wrapper*), db::message_wrapper *request, db::task_class cls)
+{
+    using namespace std::placeholders;
+    S->exec_pool.submit(std::bind(exec_request, f, request, _1), cls);
+}
+
+void
+drain_queued_requests(order::oracle*)
+{
+    // cleared before draining, so that requests enqueued from now on schedule another drain
+    S->drain_scheduled.store(false);
+    submit_queued_requests();
+}
+
+// called by io threads after changing qm, at most one drain task is pending at any time
+// a drain only dispatches requests, so it runs as a short control task
+void
+schedule_drain()
+{
+    if (!S->drain_scheduled.exchange(true)) {
+        S->exec_pool.submit(drain_queued_requests, db::CONTROL_TASK);
+    }
+}
+
+db::task_class
+node_prog_class(node_prog::prog_type pType)
+{
+    return node_prog::is_bulk(pType)? db::BULK_TASK : db::READ_TASK;
+}
+
 // server msg recv loop for the shard server
+// io threads only decode and classify messages: requests which can run now are handed off to
+// exec_pool, requests which have to wait go on qm, and only small control messages are handled inline
 void
 recv_loop(uint64_t thread_id)
 {
@@ -1716,7 +2583,8 @@ recv_loop(uint64_t thread_id)
     uint64_t tx_id;
     busybee_returncode bb_code;
     enum db::queue_order tx_order;
-    order::oracle *time_oracle = S->time_oracles[thread_id];
+    wclock::weaver_timer timer;
+    uint64_t start;
 
     while (true) {
 
@@ -1724,143 +2592,228 @@ recv_loop(uint64_t thread_id)
         rec_msg.reset(new message::message());
         bb_code = S->comm.recv(&rec_msg->buf);
 
-        if (bb_code != BUSYBEE_SUCCESS && bb_code != BUSYBEE_TIMEOUT) {
+        if (bb_code != BUSYBEE_SUCCESS) {
             continue;
         }
 
-        if (bb_code == BUSYBEE_SUCCESS) {
-            // exec or enqueue this request
-            auto unpacker = rec_msg->buf->unpack_from(BUSYBEE_HEADER_SIZE);
-            unpack_buffer(unpacker, mtype);
-            rec_msg->change_type(mtype);
-            vclk.clock.clear();
+        start = timer.get_time_elapsed();
 
-            switch (mtype) {
-                case message::TX_INIT: {
-                    rec_msg->unpack_partial_message(message::TX_INIT, vt_id, vclk, qts, txtype, tx_id);
-                    assert(vclk.clock.size() == ClkSz);
-                    assert(txtype != transaction::FAIL);
+        // exec or enqueue this request
+        auto unpacker = rec_msg->buf->unpack_from(BUSYBEE_HEADER_SIZE);
+        unpack_buffer(unpacker, mtype);
+        rec_msg->change_type(mtype);
+        vclk.clock.clear();
 
-                    if (S->check_done_tx(tx_id)) {
-                        // tx already executed, this must have been resent because of vt failure
-                        S->increment_qts(vt_id, 1);
+        switch (mtype) {
+            case message::TX_INIT: {
+                rec_msg->unpack_partial_message(message::TX_INIT, vt_id, vclk, qts, txtype, tx_id);
+                assert(vclk.clock.size() == ClkSz);
+                assert(txtype != transaction::FAIL);
 
-                        message::message conf_msg;
-                        conf_msg.prepare_message(message::TX_DONE, tx_id, shard_id);
-                        S->comm.send(vt_id, conf_msg.buf);
-                    } else {
-                        mwrap = new db::message_wrapper(mtype, std::move(rec_msg));
-                        tx_order = S->qm.check_wr_request(vclk, qts);
-                        assert(tx_order == db::PRESENT || tx_order == db::FUTURE);
-
-                        if (txtype == transaction::UPDATE) {
-                            // write tx
-                            if (tx_order == db::PRESENT) {
-                                mwrap->time_oracle = time_oracle;
-                                unpack_tx_request(mwrap);
-                            } else {
-                                // enqueue for future execution
-                                qreq = new db::queued_request(qts, vclk, unpack_tx_request, mwrap);
-                                S->qm.enqueue_write_request(vt_id, qreq);
-                            }
+                if (S->check_done_tx(tx_id)) {
+                    // tx already executed, this must have been resent because of vt failure
+                    S->increment_qts(vt_id, 1);
+                    schedule_drain();
+
+                    message::message conf_msg;
+                    conf_msg.prepare_message(message::TX_DONE, tx_id, shard_id);
+                    S->comm.send(vt_id, conf_msg.buf);
+                } else {
+                    mwrap = new db::message_wrapper(mtype, std::move(rec_msg));
+                    tx_order = S->qm.check_wr_request(vclk, qts);
+                    assert(tx_order == db::PRESENT || tx_order == db::FUTURE);
+
+                    if (txtype == transaction::UPDATE) {
+                        // write tx
+                        if (tx_order == db::PRESENT) {
+                            submit_request(unpack_tx_request, mwrap, db::CONTROL_TASK);
                         } else {
-                            // nop
-                            assert(tx_order != db::PAST);
-                            // nop goes through queues for both PRESENT and FUTURE
-                            qreq = new db::queued_request(qts, vclk, nop, mwrap);
+                            // enqueue for future execution
+                            qreq = new db::queued_request(qts, vclk, unpack_tx_request, mwrap, db::CONTROL_TASK);
                             S->qm.enqueue_write_request(vt_id, qreq);
+                            schedule_drain();
                         }
+                    } else {
+                        // nop
+                        assert(tx_order != db::PAST);
+                        // nop goes through queues for both PRESENT and FUTURE
+                        qreq = new db::queued_request(qts, vclk, nop, mwrap, db::CONTROL_TASK);
+                        S->qm.enqueue_write_request(vt_id, qreq);
+                        schedule_drain();
                     }
-                    break;
                 }
+                break;
+            }
 
-                case message::NODE_PROG: {
-                    rec_msg->unpack_partial_message(message::NODE_PROG, pType, vt_id, vclk, req_id);
-                    assert(vclk.clock.size() == ClkSz);
+            case message::NODE_PROG:
+                recv_node_program(std::move(rec_msg));
+                break;
 
-                    mwrap = new db::message_wrapper(mtype, std::move(rec_msg));
-                    if (S->qm.check_rd_request(vclk.clock)) {
-                        mwrap->time_oracle = time_oracle;
-                        unpack_node_program(mwrap);
-                    } else {
-                        qreq = new db::queued_request(req_id, vclk, unpack_node_program, mwrap);
-                        S->qm.enqueue_read_request(vt_id, qreq);
-                    }
-                    break;
+            case message::NODE_PROG_BATCH: {
+                std::vector<std::string> batch;
+                rec_msg->unpack_message(message::NODE_PROG_BATCH, batch);
+                for (const std::string &m: batch) {
+                    std::unique_ptr<message::message> prog_msg(new message::message(message::NODE_PROG));
+                    prog_msg->buf.reset(e::buffer::create(BUSYBEE_HEADER_SIZE + m.size()));
+                    prog_msg->buf->pack_at(BUSYBEE_HEADER_SIZE).copy(e::slice(m.data(), m.size()));
+                    recv_node_program(std::move(prog_msg));
                 }
+                break;
+            }
 
-                case message::NODE_CONTEXT_FETCH:
-                case message::NODE_CONTEXT_REPLY: {
-                    void (*f)(db::message_wrapper*);
-                    if (mtype == message::NODE_CONTEXT_FETCH) {
-                        f = unpack_and_fetch_context;
-                    } else { // NODE_CONTEXT_REPLY
-                        f = unpack_context_reply;
-                    }
-                    rec_msg->unpack_partial_message(mtype, pType, req_id, vt_id, vclk);
-                    assert(vclk.clock.size() == ClkSz);
-                    mwrap = new db::message_wrapper(mtype, std::move(rec_msg));
-                    if (S->qm.check_rd_request(vclk.clock)) {
-                        mwrap->time_oracle = time_oracle;
-                        f(mwrap);
-                    } else {
-                        qreq = new db::queued_request(req_id, vclk, f, mwrap);
-                        S->qm.enqueue_read_request(vt_id, qreq);
-                    }
-                    break;
-                }
+            case message::NODE_PROG_CANCEL:
+                mwrap = new db::message_wrapper(mtype, std::move(rec_msg));
+                submit_request(unpack_prog_cancel, mwrap, db::CONTROL_TASK);
+                break;
 
-                case message::PERMANENTLY_DELETED_NODE: {
-                    node_handle_t node;
-                    rec_msg->unpack_message(mtype, node);
-                    update_deleted_node(node);
-                    break;
+            case message::BSP_STEP: {
+                uint64_t step;
+                node_prog::bsp_params params;
+                rec_msg->unpack_partial_message(message::BSP_STEP, req_id, vt_id, vclk, params, step);
+                assert(vclk.clock.size() == ClkSz);
+                mwrap = new db::message_wrapper(mtype, std::move(rec_msg));
+                // graph is read in superstep 0, once the snapshot is ready, later supersteps read only the job
+                if (step > 0 || S->qm.check_rd_request(vclk.clock)) {
+                    submit_request(unpack_bsp_step, mwrap, db::BULK_TASK);
+                } else {
+                    qreq = new db::queued_request(req_id, vclk, unpack_bsp_step, mwrap, db::BULK_TASK);
+                    S->qm.enqueue_read_request(vt_id, qreq);
+                    schedule_drain();
                 }
+                break;
+            }
 
-                case message::MIGRATE_SEND_NODE:
-                case message::MIGRATED_NBR_UPDATE:
-                case message::MIGRATED_NBR_ACK:
-                    mwrap = new db::message_wrapper(mtype, std::move(rec_msg));
-                    mwrap->time_oracle = time_oracle;
-                    unpack_migrate_request(mwrap);
-                    break;
+            case message::BSP_MSGS:
+                mwrap = new db::message_wrapper(mtype, std::move(rec_msg));
+                submit_request(unpack_bsp_msgs, mwrap, db::BULK_TASK);
+                break;
 
-                case message::MIGRATION_TOKEN:
-                    S->migration_mutex.lock();
-                    rec_msg->unpack_message(mtype, S->migr_token_hops, S->migr_num_shards, S->migr_vt);
-                    S->migr_token = true;
-                    S->migrated = false;
-                    S->migration_mutex.unlock();
-                    break;
+            case message::BSP_FINISH:
+                mwrap = new db::message_wrapper(mtype, std::move(rec_msg));
+                submit_request(unpack_bsp_finish, mwrap, db::CONTROL_TASK);
+                break;
 
-                case message::LOADED_GRAPH: {
-                    uint64_t load_time;
-                    rec_msg->unpack_message(message::LOADED_GRAPH, load_time);
-                    S->graph_load_mutex.lock();
-                    if (load_time > S->max_load_time) {
-                        S->max_load_time = load_time;
-                    }
-                    if (++S->load_count == S->bulk_load_num_shards) {
-                        WDEBUG << "Loaded graph on all shards, time taken = " << (S->max_load_time/MEGA) << " ms." << std::endl;
-                    } else {
-                        WDEBUG << "Loaded graph on " << S->load_count << " shards, current time "
-                                << (S->max_load_time/MEGA) << "ms." << std::endl;
-                    }
-                    S->graph_load_mutex.unlock();
-                    break;
+            case message::BIDIR_REACH_STEP:
+                rec_msg->unpack_partial_message(message::BIDIR_REACH_STEP, req_id, vt_id, vclk);
+                assert(vclk.clock.size() == ClkSz);
+                mwrap = new db::message_wrapper(mtype, std::move(rec_msg));
+                if (S->qm.check_rd_request(vclk.clock)) {
+                    submit_request(unpack_bidir_reach_step, mwrap, db::READ_TASK);
+                } else {
+                    qreq = new db::queued_request(req_id, vclk, unpack_bidir_reach_step, mwrap, db::READ_TASK);
+                    S->qm.enqueue_read_request(vt_id, qreq);
+                    schedule_drain();
                 }
+                break;
 
-                case message::EXIT_WEAVER:
-                    exit(0);
-                    
-                default:
-                    WDEBUG << "unexpected msg type " << message::to_string(mtype) << std::endl;
+            case message::NODE_CONTEXT_FETCH:
+            case message::NODE_CONTEXT_REPLY: {
+                void (*f)(db::message_wrapper*);
+                if (mtype == message::NODE_CONTEXT_FETCH) {
+                    f = unpack_and_fetch_context;
+                } else { // NODE_CONTEXT_REPLY
+                    f = unpack_context_reply;
+                }
+                rec_msg->unpack_partial_message(mtype, pType, req_id, vt_id, vclk);
+                assert(vclk.clock.size() == ClkSz);
+                mwrap = new db::message_wrapper(mtype, std::move(rec_msg));
+                if (S->qm.check_rd_request(vclk.clock)) {
+                    // context replies unblock a waiting request, fetches are part of the program's own work
+                    submit_request(f, mwrap, mtype == message::NODE_CONTEXT_REPLY? db::CONTROL_TASK : node_prog_class(pType));
+                } else {
+                    qreq = new db::queued_request(req_id, vclk, f, mwrap,
+                        mtype == message::NODE_CONTEXT_REPLY? db::CONTROL_TASK : node_prog_class(pType));
+                    S->qm.enqueue_read_request(vt_id, qreq);
+                    schedule_drain();
+                }
+                break;
+            }
+
+            case message::PERMANENTLY_DELETED_NODE:
+                mwrap = new db::message_wrapper(mtype, std::move(rec_msg));
+                submit_request(unpack_deleted_node, mwrap, db::CONTROL_TASK);
+                break;
+
+            case message::MIGRATE_SEND_NODE:
+            case message::MIGRATED_NBR_UPDATE:
+            case message::MIGRATED_NBR_ACK:
+                mwrap = new db::message_wrapper(mtype, std::move(rec_msg));
+                submit_request(unpack_migrate_request, mwrap, db::CONTROL_TASK);
+                break;
+
+            case message::NODE_LOC_UPDATE_ACK:
+                rec_msg->unpack_message(mtype, vt_id);
+                S->migration_mutex.lock();
+                S->migr_loc_acks[vt_id] = true;
+                S->migration_mutex.unlock();
+                break;
+
+            case message::MIGRATION_TOKEN:
+                S->migration_mutex.lock();
+                rec_msg->unpack_message(mtype, S->migr_token_hops, S->migr_num_shards, S->migr_vt);
+                S->migr_token = true;
+                S->migrated = false;
+                S->migration_mutex.unlock();
+                break;
+
+            case message::LOADED_GRAPH: {
+                uint64_t load_time;
+                rec_msg->unpack_message(message::LOADED_GRAPH, load_time);
+                S->graph_load_mutex.lock();
+                if (load_time > S->max_load_time) {
+                    S->max_load_time = load_time;
+                }
+                if (++S->load_count == S->bulk_load_num_shards) {
+                    WDEBUG << "Loaded graph on all shards, time taken = " << (S->max_load_time/MEGA) << " ms." << std::endl;
+                } else {
+                    WDEBUG << "Loaded graph on " << S->load_count << " shards, current time "
+                            << (S->max_load_time/MEGA) << "ms." << std::endl;
+                }
+                S->graph_load_mutex.unlock();
+                break;
             }
+
+            case message::EXIT_WEAVER:
+                exit(0);
+                
+            default:
+                WDEBUG << "unexpected msg type " << message::to_string(mtype) << std::endl;
         }
 
-        // execute all queued requests that can be executed now
-        // will break from loop when no more requests can be executed, in which case we need to recv
-        while (S->qm.exec_queued_request(time_oracle));
+        S->io_msgs.fetch_add(1, std::memory_order_relaxed);
+        S->io_nanos.fetch_add(timer.get_time_elapsed() - start, std::memory_order_relaxed);
+    }
+}
+
+void
+exec_pool_loop(uint64_t thread_id)
+{
+    S->exec_pool.worker_loop(thread_id);
+}
+
+void
+frontier_pool_loop(uint64_t thread_id)
+{
+    S->frontier_pool.worker_loop(thread_id);
+}
+
+// single dedicated thread which periodically sends coalesced node prog messages that have waited too long
+void
+coalescer_flush_loop()
+{
+    timespec sleep_time;
+    int sleep_ret;
+    int sleep_flags = 0;
+
+    sleep_time.tv_sec  = 0;
+    sleep_time.tv_nsec = NODE_PROG_COALESCE_TIMEOUT_MICRO * 1000;
+
+    while (true) {
+        sleep_ret = clock_nanosleep(CLOCK_REALTIME, sleep_flags, &sleep_time, NULL);
+        assert((sleep_ret == 0 || sleep_ret == EINTR) && "error in clock_nanosleep");
+        UNUSED(sleep_ret);
+
+        S->coalescer.flush_expired();
     }
 }
 
@@ -1992,10 +2945,19 @@ install_signal_handler(int signum, void (*handler)(int))
 void
 init_worker_threads(std::vector<std::thread*> &threads)
 {
-    for (int i = 0; i < NUM_SHARD_THREADS; i++) {
+    S->qm.set_ready_callback(schedule_drain);
+    S->coalescer.set_done_check(std::bind(&db::prog_state_arena::is_done, &S->prog_states, std::placeholders::_1));
+    for (int i = 0; i < NUM_SHARD_IO_THREADS; i++) {
         std::thread *t = new std::thread(recv_loop, i);
         threads.emplace_back(t);
     }
+    for (uint64_t i = 0; i < S->exec_pool.num_threads(); i++) {
+        threads.emplace_back(new std::thread(exec_pool_loop, i));
+    }
+    threads.emplace_back(new std::thread(coalescer_flush_loop));
+    for (uint64_t i = 0; i < S->frontier_pool.num_threads(); i++) {
+        threads.emplace_back(new std::thread(frontier_pool_loop, i));
+    }
     S->pause_bb = true;
 }
 
@@ -2094,6 +3056,7 @@ main(int argc, const char *argv[])
     uint64_t sid;
     assert(generate_token(&sid));
     S = new db::shard(sid, my_loc);
+    db::element::node::in_nbr_lookup = lookup_in_nbrs;
 
     // server manager link
     std::thread sm_thr(server_manager_link_loop,
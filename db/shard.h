@@ -18,6 +18,7 @@
 #include <set>
 #include <map>
 #include <vector>
+#include <atomic>
 #include <unordered_map>
 #include <po6/threads/mutex.h>
 #include <po6/net/location.h>
@@ -42,6 +43,14 @@
 #include "db/node.h"
 #include "db/edge.h"
 #include "db/queue_manager.h"
+#include "db/msg_coalescer.h"
+#include "db/work_pool.h"
+#include "db/handle_table.h"
+#include "db/node_lock.h"
+#include "db/mem_pool.h"
+#include "db/node_map.h"
+#include "db/prog_state_arena.h"
+#include "db/bsp_job.h"
 #include "db/deferred_write.h"
 #include "db/del_obj.h"
 #include "db/hyper_stub.h"
@@ -63,6 +72,8 @@ namespace db
         GRAPHML
     };
 
+    const uint64_t exec_class_weights[NUM_TASK_CLASSES] = {EXEC_CONTROL_WEIGHT, EXEC_READ_WEIGHT, EXEC_BULK_WEIGHT};
+
     // graph partition state and associated data structures
     class shard
     {
@@ -72,6 +83,16 @@ namespace db
 
             // Messaging infrastructure
             common::comm_wrapper comm;
+            msg_coalescer coalescer;
+
+            // Request execution
+            // io threads receive and classify messages, and hand off runnable requests to exec_pool
+            work_pool exec_pool;
+            std::atomic<bool> drain_scheduled; // true if exec_pool has a pending task which drains qm
+            std::atomic<uint64_t> io_msgs, io_nanos; // messages classified by io threads, and time spent doing so
+
+            // Parallel node program execution
+            work_pool frontier_pool;
 
             // Server manager
             po6::threads::mutex config_mutex, exit_mutex;
@@ -86,23 +107,31 @@ namespace db
             // Consistency
         public:
             queue_manager qm;
-            std::vector<order::oracle*> time_oracles;
             void increment_qts(uint64_t vt_id, uint64_t incr);
             void record_completed_tx(vc::vclock &tx_clk);
             element::node* acquire_node(const node_handle_t &node_handle);
+            element::node* acquire_node(uint64_t handle_id, const node_handle_t *node_handle=NULL);
+            element::node* acquire_node_shared(const node_handle_t &node_handle);
+            element::node* acquire_node_shared(uint64_t handle_id, const node_handle_t *node_handle=NULL);
             element::node* acquire_node_write(const node_handle_t &node, uint64_t vt_id, uint64_t qts);
             element::node* acquire_node_nonlocking(const node_handle_t &node_handle);
             void release_node_write(element::node *n);
             void release_node(element::node *n, bool migr_node);
+            void release_node_shared(element::node *n);
+        private:
+            element::node* lock_node_mtx(uint64_t handle_id, const node_handle_t *node_handle);
+            void release_node_locked(element::node *n);
+        public:
 
             // Graph state
             po6::threads::mutex edge_map_mutex;
-            po6::threads::mutex node_map_mutexes[NUM_NODE_MAPS];
             uint64_t shard_id;
             server_id serv_id;
-            std::unordered_map<node_handle_t, element::node*> nodes[NUM_NODE_MAPS]; // node handle -> ptr to node object
-            std::unordered_map<node_handle_t, // node handle n ->
-                std::unordered_set<node_handle_t>> edge_map; // in-neighbors of n
+            handle_table handles;
+            mem_pool &elem_pool; // nodes and edge arrays are allocated from slabs
+            node_map nodes; // node handle id -> ptr to node object
+            std::unordered_map<uint64_t, // node handle id of n ->
+                std::unordered_set<uint64_t>> edge_map; // handle ids of in-neighbors of n
         public:
             element::node* create_node(const node_handle_t &node_handle,
                 vc::vclock &vclk,
@@ -110,6 +139,8 @@ namespace db
                 bool init_load);
             void delete_node_nonlocking(element::node *n,
                 vc::vclock &tdel);
+            void get_in_nbr_ids(uint64_t handle_id, std::vector<uint64_t> &in_nbrs);
+            void erase_in_nbr(uint64_t nbr_id, uint64_t handle_id);
             void delete_node(const node_handle_t &node_handle,
                 vc::vclock &vclk,
                 uint64_t qts);
@@ -129,6 +160,8 @@ namespace db
             void delete_edge(const edge_handle_t &edge_handle, const node_handle_t &node_handle,
                 vc::vclock &vclk,
                 uint64_t qts);
+            void erase_out_edge(element::node *n, const edge_handle_t &edge_handle);
+            void clear_out_edges(element::node *n);
             // properties
             void set_node_property_nonlocking(element::node *n,
                 std::string &key, std::string &value,
@@ -166,7 +199,7 @@ namespace db
             // Migration
         public:
             po6::threads::mutex migration_mutex;
-            std::unordered_set<node_handle_t> node_list; // list of node ids currently on this shard
+            std::unordered_set<uint64_t> node_list; // handle ids of nodes currently on this shard
             bool current_migr, migr_updating_nbrs, migr_token, migrated;
             node_handle_t migr_node;
             uint64_t migr_chance, migr_shard, migr_token_hops, migr_num_shards, migr_vt;
@@ -182,12 +215,13 @@ namespace db
             std::vector<std::pair<node_handle_t, uint32_t>>::iterator cldg_iter;
             po6::threads::mutex msg_count_mutex;
 #endif
-            std::unordered_set<node_handle_t> ldg_nodes;
-            std::unordered_set<node_handle_t>::iterator ldg_iter;
+            std::unordered_set<uint64_t> ldg_nodes;
+            std::unordered_set<uint64_t>::iterator ldg_iter;
             std::vector<uint64_t> shard_node_count;
             std::unordered_map<node_handle_t, def_write_lst> deferred_writes; // for migrating nodes
             std::unordered_map<node_handle_t, std::vector<std::unique_ptr<message::message>>> deferred_reads; // for migrating nodes
             std::vector<uint64_t> nop_count;
+            std::vector<bool> migr_loc_acks; // VTs which have stopped using old location of migrating node
             vc::vclock max_clk // to compare against for checking if node is deleted
                 , zero_clk; // all zero clock for migration thread in queue
             void update_migrated_nbr_nonlocking(element::node *n, const node_handle_t &migr_node, uint64_t old_loc, uint64_t new_loc);
@@ -202,15 +236,18 @@ namespace db
             // node programs
         private:
             po6::threads::mutex node_prog_state_mutex;
-            std::unordered_set<uint64_t> done_prog_ids; // request ids that have finished
-            std::unordered_map<uint64_t, std::vector<node_handle_t>> outstanding_prog_states; // maps request_id to list of nodes that have created prog state for that req id
-            void clear_all_state(const std::unordered_map<uint64_t, std::vector<node_handle_t>> &outstanding_prog_states);
-            void delete_prog_states(uint64_t req_id, std::vector<node_handle_t> &node_handles);
         public:
-            void mark_nodes_using_state(uint64_t req_id, std::vector<node_handle_t> &node_handles);
+            prog_state_arena prog_states;
             void add_done_requests(std::vector<std::pair<uint64_t, node_prog::prog_type>> &completed_requests);
             bool check_done_request(uint64_t req_id, vc::vclock &clk);
 
+            // bulk synchronous analytics
+            po6::threads::mutex bsp_mtx;
+            std::unordered_map<uint64_t, std::shared_ptr<bsp_job>> bsp_jobs;
+            std::unordered_set<uint64_t> bsp_done; // messages of finished jobs may still be in flight
+            std::shared_ptr<bsp_job> get_bsp_job(uint64_t req_id);
+            std::shared_ptr<bsp_job> remove_bsp_job(uint64_t req_id);
+
             std::unordered_map<std::tuple<cache_key_t, uint64_t, node_handle_t>, void *> node_prog_running_states; // used for fetching cache contexts
             po6::threads::mutex node_prog_running_states_mutex;
 
@@ -231,7 +268,13 @@ namespace db
 
     inline
     shard :: shard(uint64_t serverid, po6::net::location &loc)
-        : comm(loc, NUM_SHARD_THREADS, SHARD_MSGRECV_TIMEOUT)
+        : comm(loc, NUM_SHARD_IO_THREADS, SHARD_MSGRECV_TIMEOUT)
+        , coalescer(comm)
+        , exec_pool(NUM_SHARD_EXEC_THREADS, exec_class_weights)
+        , drain_scheduled(false)
+        , io_msgs(0)
+        , io_nanos(0)
+        , frontier_pool(NUM_FRONTIER_THREADS)
         , sm_stub(server_id(serverid), comm.get_loc())
         , active_backup(false)
         , first_config(false)
@@ -241,12 +284,14 @@ namespace db
         , to_exit(false)
         , shard_id(UINT64_MAX)
         , serv_id(serverid)
+        , elem_pool(mem_pool::get())
         , current_migr(false)
         , migr_updating_nbrs(false)
         , migr_token(false)
         , migrated(false)
         , migr_chance(0)
         , nop_count(NumVts, 0)
+        , migr_loc_acks(NumVts, false)
         , max_clk(UINT64_MAX, UINT64_MAX)
         , zero_clk(0, 0)
         //, max_prog_id(NumVts, 0)
@@ -271,7 +316,6 @@ namespace db
         shard_id = shardid;
         for (int i = 0; i < NUM_SHARD_THREADS; i++) {
             hstub.push_back(new hyper_stub(shard_id));
-            time_oracles.push_back(new order::oracle());
         }
     }
 
@@ -340,7 +384,6 @@ namespace db
         // reset qts if a VTS died
         std::vector<server> delta = prev_config.delta(config);
         bool clear_queued = false;
-        std::unordered_map<uint64_t, std::vector<node_handle_t>> clear_map;
         for (const server &srv: delta) {
             if (srv.type == server::VT) {
                 server::state_t prev_state = prev_config.get_state(srv.id);
@@ -360,7 +403,6 @@ namespace db
                 if (prev_type == server::BACKUP_SHARD) {
                     node_prog_state_mutex.lock();
                     min_prog_epoch = config.version();
-                    clear_map = std::move(outstanding_prog_states);
                     node_prog_state_mutex.unlock();
 
                     clear_queued = true;
@@ -371,7 +413,7 @@ namespace db
         if (clear_queued) {
             // drop reads
             qm.clear_queued_reads();
-            clear_all_state(clear_map);
+            prog_states.clear();
         }
     }
 
@@ -381,7 +423,7 @@ namespace db
         std::vector<std::thread> threads;
         WDEBUG << "hstub.size " << hstub.size() << ", NUM_SHARD_THREADS " << NUM_SHARD_THREADS << std::endl;
         for (uint64_t i = 0; i < hstub.size(); i++) {
-            threads.emplace_back(std::thread(&hyper_stub::bulk_load, hstub[i], (int)i, nodes));
+            threads.emplace_back(std::thread(&hyper_stub::bulk_load, hstub[i], (int)i, &nodes));
         }
         for (uint64_t i = 0; i < hstub.size(); i++) {
             threads[i].join();
@@ -407,21 +449,70 @@ namespace db
     inline element::node*
     shard :: acquire_node(const node_handle_t &node_handle)
     {
-        uint64_t map_idx = hash_node_handle(node_handle) % NUM_NODE_MAPS;
-
-        element::node *n = NULL;
-        node_map_mutexes[map_idx].lock();
-        auto node_iter = nodes[map_idx].find(node_handle);
-        if (node_iter != nodes[map_idx].end()) {
-            n = node_iter->second;
-            n->waiters++;
-            while (n->in_use) {
-                n->cv.wait();
+        uint64_t handle_id;
+        if (!handles.lookup(node_handle, handle_id)) {
+            return NULL;
+        }
+        return acquire_node(handle_id, &node_handle);
+    }
+
+    // find node in map and lock its mutex
+    // return NULL if node does not exist, or was erased after it was found
+    // a node which is locked and not removed cannot be erased, so the read section can end here
+    // node_handle is the handle the id was looked up for, if any: lookup takes no reference on the id,
+    // so the node may have been deleted meanwhile and its id reused by a node with a different handle
+    inline element::node*
+    shard :: lock_node_mtx(uint64_t handle_id, const node_handle_t *node_handle)
+    {
+        nodes.enter();
+        element::node *n = nodes.find(handle_id);
+        if (n != NULL) {
+            n->mtx.lock();
+            if (n->removed || (node_handle != NULL && n->get_handle() != *node_handle)) {
+                n->mtx.unlock();
+                n = NULL;
             }
-            n->waiters--;
+        }
+        nodes.exit();
+
+        return n;
+    }
+
+    inline element::node*
+    shard :: acquire_node(uint64_t handle_id, const node_handle_t *node_handle)
+    {
+        element::node *n = lock_node_mtx(handle_id, node_handle);
+        if (n != NULL) {
+            wait_exclusive(n);
             n->in_use = true;
+            n->mtx.unlock();
+        }
+
+        return n;
+    }
+
+    // find the node corresponding to given id
+    // acquire the node in shared mode, multiple readers can hold the node concurrently
+    // readers must not modify the node, and wait for writers that are already waiting
+    // return NULL if node does not exist (possibly permanently deleted)
+    inline element::node*
+    shard :: acquire_node_shared(const node_handle_t &node_handle)
+    {
+        uint64_t handle_id;
+        if (!handles.lookup(node_handle, handle_id)) {
+            return NULL;
+        }
+        return acquire_node_shared(handle_id, &node_handle);
+    }
+
+    inline element::node*
+    shard :: acquire_node_shared(uint64_t handle_id, const node_handle_t *node_handle)
+    {
+        element::node *n = lock_node_mtx(handle_id, node_handle);
+        if (n != NULL) {
+            wait_shared(n);
+            n->mtx.unlock();
         }
-        node_map_mutexes[map_idx].unlock();
 
         return n;
     }
@@ -429,19 +520,16 @@ namespace db
     inline element::node*
     shard :: acquire_node_write(const node_handle_t &node_handle, uint64_t vt_id, uint64_t qts)
     {
-        uint64_t map_idx = hash_node_handle(node_handle) % NUM_NODE_MAPS;
+        uint64_t handle_id;
+        if (!handles.lookup(node_handle, handle_id)) {
+            return NULL;
+        }
 
-        element::node *n = NULL;
         auto comp = std::make_pair(vt_id, qts);
-        node_map_mutexes[map_idx].lock();
-        auto node_iter = nodes[map_idx].find(node_handle);
-        if (node_iter != nodes[map_idx].end()) {
-            n = node_iter->second;
-            n->waiters++;
+        element::node *n = lock_node_mtx(handle_id, &node_handle);
+        if (n != NULL) {
             // first wait for node to become free
-            while (n->in_use) {
-                n->cv.wait();
-            }
+            wait_exclusive(n);
             // check if write exists in queue---in case we are recovering from failure
             bool exists = false;
             for (auto &p: n->tx_queue) {
@@ -452,32 +540,39 @@ namespace db
             }
             if (exists && n->tx_queue.front() != comp) {
                 // write exists in queue, but cannot be executed right now
-                while (n->in_use || n->tx_queue.front() != comp) {
+                n->waiters++;
+                while (n->in_use || n->readers > 0 || n->tx_queue.front() != comp) {
                     n->cv.wait();
                 }
+                n->waiters--;
                 n->tx_queue.pop_front();
             } else if (exists) {
                 // write exists in queue and is the first
                 n->tx_queue.pop_front();
             }
-            n->waiters--;
             n->in_use = true;
+            n->mtx.unlock();
         }
-        node_map_mutexes[map_idx].unlock();
 
         return n;
     }
 
+    // caution: node may be erased concurrently unless caller otherwise prevents it
     inline element::node*
     shard :: acquire_node_nonlocking(const node_handle_t &node_handle)
     {
-        uint64_t map_idx = hash_node_handle(node_handle) % NUM_NODE_MAPS;
+        uint64_t handle_id;
+        if (!handles.lookup(node_handle, handle_id)) {
+            return NULL;
+        }
 
-        element::node *n = NULL;
-        auto node_iter = nodes[map_idx].find(node_handle);
-        if (node_iter != nodes[map_idx].end()) {
-            n = node_iter->second;
+        nodes.enter();
+        element::node *n = nodes.find(handle_id);
+        if (n != NULL && n->get_handle() != node_handle) {
+            // id reused after the node with this handle was deleted
+            n = NULL;
         }
+        nodes.exit();
         return n;
     }
 
@@ -491,23 +586,44 @@ namespace db
     inline void
     shard :: release_node(element::node *n, bool migr_done=false)
     {
-        uint64_t map_idx = hash_node_handle(n->get_handle()) % NUM_NODE_MAPS;
-
-        node_map_mutexes[map_idx].lock();
+        n->mtx.lock();
         n->in_use = false;
         if (migr_done) {
             n->migr_cv.broadcast();
         }
-        if (n->waiters > 0) {
-            n->cv.signal();
-            node_map_mutexes[map_idx].unlock();
+        release_node_locked(n);
+        n = NULL;
+    }
+
+    // unlock a node previously acquired in shared mode
+    // last reader out wakes waiting threads
+    inline void
+    shard :: release_node_shared(element::node *n)
+    {
+        n->mtx.lock();
+        if (leave_shared(n)) {
+            release_node_locked(n);
+        } else {
+            n->mtx.unlock();
+        }
+        n = NULL;
+    }
+
+    // wake waiting threads, or clean up node if permanently deleted
+    // caution: assume holding n->mtx, which is released here
+    inline void
+    shard :: release_node_locked(element::node *n)
+    {
+        if (wake_waiters(n)) {
+            n->mtx.unlock();
         } else if (n->permanently_deleted) {
             const node_handle_t &node_handle = n->get_handle();
-            nodes[map_idx].erase(node_handle);
-            node_map_mutexes[map_idx].unlock();
+            n->removed = true;
+            nodes.erase(n->handle_id);
+            n->mtx.unlock();
 
             migration_mutex.lock();
-            node_list.erase(node_handle);
+            node_list.erase(n->handle_id);
             shard_node_count[shard_id - ShardIdIncr]--;
             migration_mutex.unlock();
 
@@ -524,9 +640,8 @@ namespace db
 
             permanent_node_delete(n);
         } else {
-            node_map_mutexes[map_idx].unlock();
+            n->mtx.unlock();
         }
-        n = NULL;
     }
 
 
@@ -538,27 +653,20 @@ namespace db
         bool migrate,
         bool init_load=false)
     {
-        uint64_t map_idx = hash_node_handle(node_handle) % NUM_NODE_MAPS;
-        element::node *new_node = new element::node(node_handle, vclk, node_map_mutexes+map_idx);
+        uint64_t handle_id = handles.intern(node_handle);
+        element::node *new_node = elem_pool.create<element::node>(NODE_MEM, node_handle, vclk);
+        new_node->handle_id = handle_id;
         new_node->last_upd_clk = vclk;
         new_node->restore_clk = vclk.clock;
 
-        if (!init_load) {
-            node_map_mutexes[map_idx].lock();
-        }
-
-        bool success = nodes[map_idx].emplace(node_handle, new_node).second;
+        bool success = nodes.insert(handle_id, new_node);
         assert(success);
         UNUSED(success);
 
-        if (!init_load) {
-            node_map_mutexes[map_idx].unlock();
-        }
-
         if (!init_load) {
             migration_mutex.lock();
         }
-        node_list.emplace(node_handle);
+        node_list.emplace(handle_id);
         shard_node_count[shard_id - ShardIdIncr]++;
         if (!init_load) {
             migration_mutex.unlock();
@@ -583,6 +691,7 @@ namespace db
         vc::vclock &tdel)
     {
         n->base.update_del_time(tdel);
+        n->last_upd_clk = tdel;
         n->updated = true;
     }
 
@@ -607,6 +716,35 @@ namespace db
         }
     }
 
+    // handle ids of nodes at this shard with an out-edge to handle_id, which may be at any shard
+    // in-edge map is not versioned, and edges stay in it until they are permanently deleted,
+    // so callers which need a snapshot check the out-edges of each in-nbr at their clock
+    inline void
+    shard :: get_in_nbr_ids(uint64_t handle_id, std::vector<uint64_t> &in_nbrs)
+    {
+        edge_map_mutex.lock();
+        auto edge_map_iter = edge_map.find(handle_id);
+        if (edge_map_iter != edge_map.end()) {
+            in_nbrs.insert(in_nbrs.end(), edge_map_iter->second.begin(), edge_map_iter->second.end());
+        }
+        edge_map_mutex.unlock();
+    }
+
+    // drop handle_id from the in-nbrs of nbr_id
+    // caution: assume holding edge_map_mutex
+    inline void
+    shard :: erase_in_nbr(uint64_t nbr_id, uint64_t handle_id)
+    {
+        auto edge_map_iter = edge_map.find(nbr_id);
+        if (edge_map_iter != edge_map.end()) {
+            auto &node_set = edge_map_iter->second;
+            node_set.erase(handle_id);
+            if (node_set.empty()) {
+                edge_map.erase(edge_map_iter);
+            }
+        }
+    }
+
     inline void
     shard :: create_edge_nonlocking(element::node *n,
         const edge_handle_t &handle,
@@ -614,15 +752,17 @@ namespace db
         vc::vclock &vclk,
         bool init_load=false)
     {
-        element::edge *new_edge = new element::edge(handle, vclk, remote_loc, remote_node);
-        n->add_edge(new_edge);
+        element::edge *new_edge = n->out_edges.emplace(handle, vclk, remote_loc, remote_node);
+        assert(new_edge != NULL);
+        new_edge->nbr_id = handles.intern(remote_node);
+        n->last_upd_clk = vclk;
         n->updated = true;
 
         // update edge map
         if (!init_load) {
             edge_map_mutex.lock();
         }
-        edge_map[remote_node].emplace(n->get_handle());
+        edge_map[new_edge->nbr_id].emplace(n->handle_id);
         if (!init_load) {
             edge_map_mutex.unlock();
         }
@@ -659,24 +799,14 @@ namespace db
         vc::vclock &tdel)
     {
         // already_exec check for fault tolerance
-        auto out_edge_iter = n->out_edges.find(edge_handle);
-        assert(out_edge_iter != n->out_edges.end());
-        element::edge *e = out_edge_iter->second;
+        element::edge *e = n->out_edges.find(edge_handle);
+        assert(e != NULL);
         e->base.update_del_time(tdel);
+        n->last_upd_clk = tdel;
         n->updated = true;
         n->dependent_del++;
-
-        // update edge map
-        const node_handle_t &remote = e->nbr.handle;
-        edge_map_mutex.lock();
-        auto edge_map_iter = edge_map.find(remote);
-        assert(edge_map_iter != edge_map.end());
-        auto &node_set = edge_map_iter->second;
-        node_set.erase(n->get_handle());
-        if (node_set.empty()) {
-            edge_map.erase(remote);
-        }
-        edge_map_mutex.unlock();
+        // edge map entry is kept until permanent deletion, so that backward traversals
+        // at clocks before tdel still find this edge
     }
 
     inline void
@@ -708,6 +838,7 @@ namespace db
         vc::vclock &vclk)
     {
         n->base.add_property(key, value, vclk);
+        n->last_upd_clk = vclk;
     }
 
     inline void
@@ -737,10 +868,10 @@ namespace db
         std::string &key, std::string &value,
         vc::vclock &vclk)
     {
-        auto out_edge_iter = n->out_edges.find(edge_handle);
-        assert(out_edge_iter != n->out_edges.end());
-        element::edge *e = out_edge_iter->second;
+        element::edge *e = n->out_edges.find(edge_handle);
+        assert(e != NULL);
         e->base.add_property(key, value, vclk);
+        n->last_upd_clk = vclk;
     }
 
     inline void
@@ -765,12 +896,52 @@ namespace db
         }
     }
 
+    // drop an edge from its node, releasing the edge's reference on its neighbor's handle id
+    // the node stays an in-nbr of the neighbor if it has another edge to it
+    // caution: assume holding n->mtx
+    inline void
+    shard :: erase_out_edge(element::node *n, const edge_handle_t &edge_handle)
+    {
+        element::edge *e = n->out_edges.find(edge_handle);
+        assert(e != NULL);
+        bool other_edge = false;
+        for (element::edge &x: n->out_edges) {
+            if (&x != e && x.nbr_id == e->nbr_id) {
+                other_edge = true;
+                break;
+            }
+        }
+        if (!other_edge) {
+            edge_map_mutex.lock();
+            erase_in_nbr(e->nbr_id, n->handle_id);
+            edge_map_mutex.unlock();
+        }
+        handles.release(e->nbr_id);
+        n->out_edges.erase(edge_handle);
+    }
+
+    // caution: assume holding n->mtx
+    inline void
+    shard :: clear_out_edges(element::node *n)
+    {
+        for (element::edge &e: n->out_edges) {
+            handles.release(e.nbr_id);
+        }
+        n->out_edges.clear();
+    }
+
     // return true if node already created
     inline bool
     shard :: node_exists_nonlocking(const node_handle_t &node_handle)
     {
-        uint64_t map_idx = hash_node_handle(node_handle) % NUM_NODE_MAPS;
-        return (nodes[map_idx].find(node_handle) != nodes[map_idx].end());
+        uint64_t handle_id;
+        if (!handles.lookup(node_handle, handle_id)) {
+            return false;
+        }
+        nodes.enter();
+        bool exists = (nodes.find(handle_id) != NULL);
+        nodes.exit();
+        return exists;
     }
 
     // permanent deletion
@@ -783,10 +954,7 @@ namespace db
         n->permanently_deleted = true;
         // deleting edges now so as to prevent sending messages to neighbors for permanent edge deletion
         // rest of deletion happens in release_node()
-        for (auto &e: n->out_edges) {
-            delete e.second;
-        }
-        n->out_edges.clear();
+        clear_out_edges(n);
         release_node(n);
     }
 
@@ -809,6 +977,7 @@ namespace db
     shard :: permanent_delete_loop(uint64_t vt_id, bool outstanding_progs, order::oracle *time_oracle)
     {
         element::node *n;
+        element::edge *e;
         del_obj *dobj = nullptr;
 
         perm_del_mutex.lock();
@@ -843,16 +1012,11 @@ namespace db
                     n = acquire_node(dobj->node);
                     if (n != NULL) {
                         n->permanently_deleted = true;
-                        for (auto &e: n->out_edges) {
-                            const node_handle_t &node = e.second->nbr.handle;
-                            auto edge_map_iter = edge_map.find(node);
-                            assert(edge_map_iter != edge_map.end());
-                            auto &node_set = edge_map_iter->second;
-                            node_set.erase(dobj->node);
-                            if (node_set.empty()) {
-                                edge_map.erase(node);
-                            }
+                        edge_map_mutex.lock();
+                        for (element::edge &e: n->out_edges) {
+                            erase_in_nbr(e.nbr_id, n->handle_id);
                         }
+                        edge_map_mutex.unlock();
                         release_node(n);
                     }
                     break;
@@ -860,15 +1024,14 @@ namespace db
                 case transaction::EDGE_DELETE_REQ:
                     n = acquire_node(dobj->node);
                     if (n != NULL) {
-                        auto out_edge_iter = n->out_edges.find(dobj->edge);
-                        assert(out_edge_iter != n->out_edges.end());
+                        e = n->out_edges.find(dobj->edge);
+                        assert(e != NULL);
                         if (n->last_perm_deletion == nullptr
                          || time_oracle->compare_two_vts(*n->last_perm_deletion,
-                                out_edge_iter->second->base.get_del_time()) == 0) {
-                            n->last_perm_deletion.reset(new vc::vclock(std::move(out_edge_iter->second->base.get_del_time())));
+                                e->base.get_del_time()) == 0) {
+                            n->last_perm_deletion.reset(new vc::vclock(std::move(e->base.get_del_time())));
                         }
-                        delete out_edge_iter->second;
-                        n->out_edges.erase(dobj->edge);
+                        erase_out_edge(n, dobj->edge);
                         release_node(n);
                     }
                     break;
@@ -912,12 +1075,23 @@ namespace db
                 msg.prepare_message(message::PERMANENTLY_DELETED_NODE, n->get_handle());
                 comm.send(shard, msg.buf);
             }
-            for (auto &e: n->out_edges) {
-                delete e.second;
+            // drop node from location caches at VTs
+            for (uint64_t vt = 0; vt < NumVts; vt++) {
+                msg.prepare_message(message::NODE_LOC_UPDATE, shard_id, n->get_handle(), UINT64_MAX);
+                comm.send(vt, msg.buf);
             }
-            n->out_edges.clear();
         }
-        delete n;
+        // releases the nbr ids held by the edges, also for a moved node, without messages to the nbrs
+        clear_out_edges(n);
+        // the node no longer holds its handle id, which is freed here unless local edges still point at it
+        handles.release(n->handle_id);
+        // freed once no thread can still be reading it from the node map
+        // slot is then recycled for a later create_node
+        std::vector<element::node*> reclaimed;
+        nodes.retire(n, reclaimed);
+        for (element::node *r: reclaimed) {
+            elem_pool.destroy(r, NODE_MEM);
+        }
     }
 
 
@@ -928,8 +1102,8 @@ namespace db
     {
         bool found = false;
         element::edge *e;
-        for (auto &x: n->out_edges) {
-            e = x.second;
+        for (element::edge &x: n->out_edges) {
+            e = &x;
             if (e->nbr.handle == migr_node && e->nbr.loc == old_loc) {
                 e->nbr.loc = new_loc;
                 found = true;
@@ -941,12 +1115,18 @@ namespace db
     inline void
     shard :: update_migrated_nbr(const node_handle_t &migr_node, uint64_t old_loc, uint64_t new_loc)
     {
-        std::unordered_set<node_handle_t> nbrs;
+        std::unordered_set<uint64_t> nbrs;
         element::node *n;
-        edge_map_mutex.lock();
-        nbrs = edge_map[migr_node];
-        edge_map_mutex.unlock();
-        for (const node_handle_t &nbr: nbrs) {
+        uint64_t migr_node_id;
+        if (handles.lookup(migr_node, migr_node_id)) {
+            edge_map_mutex.lock();
+            auto edge_map_iter = edge_map.find(migr_node_id);
+            if (edge_map_iter != edge_map.end()) {
+                nbrs = edge_map_iter->second;
+            }
+            edge_map_mutex.unlock();
+        }
+        for (uint64_t nbr: nbrs) {
             n = acquire_node(nbr);
             update_migrated_nbr_nonlocking(n, migr_node, old_loc, new_loc);
             release_node(n);
@@ -976,110 +1156,56 @@ namespace db
     // node program
 
     inline void
-    shard :: clear_all_state(const std::unordered_map<uint64_t, std::vector<node_handle_t>> &outstanding_prog_states)
+    shard :: add_done_requests(std::vector<std::pair<uint64_t, node_prog::prog_type>> &completed_requests)
     {
-        std::unordered_set<node_handle_t> to_clean;
-
-        for (auto &p: outstanding_prog_states) {
-            for (const node_handle_t &h: p.second) {
-                to_clean.emplace(h);
-            }
-        }
-
-        for (const node_handle_t &h: to_clean) {
-            db::element::node *n = acquire_node(h);
-            int num_prog_types = n->prog_states.size();
-            n->prog_states.clear();
-            n->prog_states.resize(num_prog_types);
-            release_node(n);
+        for (auto &p: completed_requests) {
+            prog_states.done_request(p.first);
         }
     }
 
-    inline void
-    shard :: delete_prog_states(uint64_t req_id, std::vector<node_handle_t> &node_handles)
+    // job is created by whichever of its messages arrives first, NULL if job has finished
+    inline std::shared_ptr<bsp_job>
+    shard :: get_bsp_job(uint64_t req_id)
     {
-        for (const node_handle_t &node_handle: node_handles) {
-            db::element::node *node = acquire_node(node_handle);
-
-            // check that node not migrated or permanently deleted
-            if (node != NULL) {
-                bool found = false;
-                for (auto &state_map: node->prog_states) {
-                    auto state_iter = state_map.find(req_id);
-                    if (state_iter != state_map.end()) {
-                        assert(state_map.erase(req_id) > 0);
-                    }
-                    found = true;
-                    break;
-                }
-                assert(found);
+        std::shared_ptr<bsp_job> ret;
 
-                release_node(node);
+        bsp_mtx.lock();
+        if (bsp_done.find(req_id) == bsp_done.end()) {
+            std::shared_ptr<bsp_job> &job = bsp_jobs[req_id];
+            if (job == nullptr) {
+                job = std::make_shared<bsp_job>(req_id);
             }
+            ret = job;
         }
-    }
+        bsp_mtx.unlock();
 
-    inline void
-    shard :: mark_nodes_using_state(uint64_t req_id, std::vector<node_handle_t> &node_handles)
-    {
-        node_prog_state_mutex.lock();
-        bool done_request = (done_prog_ids.find(req_id) != done_prog_ids.end());
-        if (!done_request) {
-            auto state_list_iter = outstanding_prog_states.find(req_id);
-            if (state_list_iter == outstanding_prog_states.end()) {
-                outstanding_prog_states.emplace(req_id, std::move(node_handles));
-            } else {
-                std::vector<node_handle_t> &add_to = state_list_iter->second;
-                add_to.reserve(add_to.size() + node_handles.size());
-                add_to.insert(add_to.end(), node_handles.begin(), node_handles.end());
-            }
-            node_prog_state_mutex.unlock();
-        } else { // request is finished, just delete things
-            node_prog_state_mutex.unlock();
-            delete_prog_states(req_id, node_handles);
-        }
+        return ret;
     }
 
-    inline void
-    shard :: add_done_requests(std::vector<std::pair<uint64_t, node_prog::prog_type>> &completed_requests)
+    inline std::shared_ptr<bsp_job>
+    shard :: remove_bsp_job(uint64_t req_id)
     {
-        if (completed_requests.size() == 0) {
-            return;
-        }
-        std::vector<uint64_t> completed_request_ids;
-        for (auto &p: completed_requests) {
-            uint64_t rid = p.first;
-            completed_request_ids.push_back(rid);
-        }
-
-        std::vector<std::pair<uint64_t, std::vector<node_handle_t>>> to_delete;
-
-        node_prog_state_mutex.lock();
-        done_prog_ids.insert(completed_request_ids.begin(), completed_request_ids.end());
-
-        for (auto &p: completed_requests) {
-            uint64_t req_id = p.first;
-            auto node_list_iter = outstanding_prog_states.find(req_id);
-            if (node_list_iter != outstanding_prog_states.end()) {
-                to_delete.emplace_back(std::make_pair(req_id, std::move(node_list_iter->second)));
-                int num_deleted = outstanding_prog_states.erase(req_id);
-                assert(num_deleted == 1);
-            }
+        std::shared_ptr<bsp_job> job;
+
+        bsp_mtx.lock();
+        bsp_done.emplace(req_id);
+        auto iter = bsp_jobs.find(req_id);
+        if (iter != bsp_jobs.end()) {
+            job = std::move(iter->second);
+            bsp_jobs.erase(iter);
         }
-        node_prog_state_mutex.unlock();
+        bsp_mtx.unlock();
 
-        for (auto &p: to_delete) {
-            delete_prog_states(p.first, p.second);
-        }
+        return job;
     }
 
     inline bool
     shard :: check_done_request(uint64_t req_id, vc::vclock &clk)
     {
         node_prog_state_mutex.lock();
-        bool done = (clk.get_epoch() < min_prog_epoch) || (done_prog_ids.find(req_id) != done_prog_ids.end());
+        bool old_epoch = (clk.get_epoch() < min_prog_epoch);
         node_prog_state_mutex.unlock();
-        return done;
+        return old_epoch || prog_states.is_done(req_id);
     }
 
 
@@ -1105,7 +1231,7 @@ namespace db
     inline void
     shard :: restore_backup()
     {
-        hstub.back()->restore_backup(nodes, edge_map, node_map_mutexes);
+        hstub.back()->restore_backup(nodes, edge_map, handles);
     }
 }
 
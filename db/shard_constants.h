@@ -16,11 +16,46 @@
 
 #define NUM_SHARD_THREADS (sysconf(_SC_NPROCESSORS_ONLN ))
 //#define NUM_SHARD_THREADS 128
+#define NUM_SHARD_IO_THREADS 2 // threads which receive and classify messages
+#define NUM_SHARD_EXEC_THREADS (NUM_SHARD_THREADS) // threads which execute txs, node progs, and queued requests
+// weighted round robin between task classes of executor threads, see db::task_class
+#define EXEC_CONTROL_WEIGHT 8
+#define EXEC_READ_WEIGHT 4
+#define EXEC_BULK_WEIGHT 1
 
-#define NUM_NODE_MAPS 1024
-#define SHARD_MSGRECV_TIMEOUT -1 // busybee recv timeout (ms) for shard worker threads
+// node handles interned per shard, see db/handle_table.h
+#define HANDLE_STRIPE_BITS 10
+#define NUM_HANDLE_STRIPES (1 << HANDLE_STRIPE_BITS)
+// node map directory, see db/node_map.h
+#define NODE_MAP_MIN_CHUNK_BITS 6
+#define NODE_MAP_MIN_CHUNK (1 << NODE_MAP_MIN_CHUNK_BITS) // slots in first chunk of a stripe, each next chunk doubles
+#define NODE_MAP_CHUNKS 40
+// node prog state, see db/prog_state_arena.h
+#define NUM_PROG_STATE_STRIPES 64
+#define SHARD_MSGRECV_TIMEOUT -1 // busybee recv timeout (ms) for shard io threads
 
-#define BATCH_MSG_SIZE 1 // 1 == no batching
+#define BATCH_MSG_SIZE 64 // node prog hops of a single request buffered per destination shard before sending
+
+// coalescing of outgoing NODE_PROG messages across requests and worker threads
+// a batch to a shard is sent when it reaches either size limit, or when its oldest message is older than the timeout
+#define NODE_PROG_COALESCE_MSGS 32
+#define NODE_PROG_COALESCE_BYTES 65536
+#define NODE_PROG_COALESCE_TIMEOUT_MICRO 200
+
+// parallel expansion of large breadth first frontiers on the shard work pool
+#define NUM_FRONTIER_THREADS (NUM_SHARD_THREADS - 1) // worker thread which owns the request also expands chunks
+#define FRONTIER_PARALLEL_MIN 256 // min local frontier size for parallel expansion
+#define FRONTIER_CHUNK_SIZE 64 // nodes per chunk
+// bulk synchronous analytics, see db/bsp_job.h
+// supersteps run on frontier_pool, in chunks of consecutive handle stripes
+#define BSP_STRIPES_PER_CHUNK 16
+
+// slab pools for graph elements, see db/mem_pool.h
+#define SLAB_MIN_SLOT 64 // bytes, smallest size class
+#define NUM_SLAB_CLASSES 8 // size classes SLAB_MIN_SLOT, 2*SLAB_MIN_SLOT, ..
+#define SLAB_MAX_SLOT (SLAB_MIN_SLOT << (NUM_SLAB_CLASSES-1))
+#define SLAB_BYTES (1 << 20) // memory carved into slots at a time
+#define SLAB_CACHE_SLOTS 32 // free slots moved between a thread cache and the shared free list at a time
 
 // migration
 //#define WEAVER_CLDG // defined if communication-based LDG, undef otherwise
@@ -0,0 +1,226 @@
+/*
+ * ===============================================================
+ *    Description:  Implementation of shard work-stealing pool.
+ *
+ *        Created:  2014-10-09 10:40:02
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#define weaver_debug_
+#include "common/weaver_constants.h"
+#include "common/clock.h"
+#include "db/work_pool.h"
+
+using db::pool_task;
+using db::queued_task;
+using db::pool_stats;
+using db::task_class;
+using db::work_pool;
+
+// all tasks in a single class
+work_pool :: work_pool(uint64_t num_threads)
+    : pending_cond(&pending_mtx)
+{
+    uint64_t weights[NUM_TASK_CLASSES];
+    for (int c = 0; c < NUM_TASK_CLASSES; c++) {
+        weights[c] = 1;
+    }
+    init(num_threads, weights);
+}
+
+work_pool :: work_pool(uint64_t num_threads, const uint64_t weights[NUM_TASK_CLASSES])
+    : pending_cond(&pending_mtx)
+{
+    init(num_threads, weights);
+}
+
+void
+work_pool :: init(uint64_t num_threads, const uint64_t weights[NUM_TASK_CLASSES])
+{
+    next_queue = 0;
+    pending = 0;
+    for (int c = 0; c < NUM_TASK_CLASSES; c++) {
+        class_pending[c] = 0;
+        max_pending[c] = 0;
+        done_tasks[c] = 0;
+        wait_nanos[c] = 0;
+        run_nanos[c] = 0;
+    }
+
+    queues.reserve(num_threads);
+    for (uint64_t i = 0; i < num_threads; i++) {
+        queues.emplace_back(new pool_queue());
+    }
+
+    // smooth weighted round robin, so that classes are interleaved within a round
+    int64_t total = 0;
+    int64_t current[NUM_TASK_CLASSES];
+    for (int c = 0; c < NUM_TASK_CLASSES; c++) {
+        assert(weights[c] > 0);
+        total += weights[c];
+        current[c] = 0;
+    }
+    for (int64_t i = 0; i < total; i++) {
+        int best = 0;
+        for (int c = 0; c < NUM_TASK_CLASSES; c++) {
+            current[c] += weights[c];
+            if (current[c] > current[best]) {
+                best = c;
+            }
+        }
+        current[best] -= total;
+        schedule.emplace_back((task_class)best);
+    }
+}
+
+uint64_t
+work_pool :: num_threads() const
+{
+    return queues.size();
+}
+
+void
+work_pool :: submit(pool_task task)
+{
+    submit(std::move(task), CONTROL_TASK);
+}
+
+void
+work_pool :: submit(pool_task task, task_class cls)
+{
+    assert(!queues.empty());
+    assert(cls < NUM_TASK_CLASSES);
+    wclock::weaver_timer timer;
+    queued_task qt;
+    qt.task = std::move(task);
+    qt.enq_time = timer.get_time_elapsed();
+
+    pending_mtx.lock();
+    uint64_t q = next_queue++ % queues.size();
+    pending++;
+    if (++class_pending[cls] > max_pending[cls]) {
+        max_pending[cls] = class_pending[cls];
+    }
+    pending_mtx.unlock();
+
+    queues[q]->mtx.lock();
+    queues[q]->tasks[cls].emplace_back(std::move(qt));
+    queues[q]->mtx.unlock();
+
+    pending_cond.signal();
+}
+
+bool
+work_pool :: pop_own(uint64_t thread_id, task_class cls, queued_task &task)
+{
+    pool_queue &q = *queues[thread_id];
+    bool found = false;
+
+    q.mtx.lock();
+    if (!q.tasks[cls].empty()) {
+        task = std::move(q.tasks[cls].front());
+        q.tasks[cls].pop_front();
+        found = true;
+    }
+    q.mtx.unlock();
+
+    return found;
+}
+
+bool
+work_pool :: steal(uint64_t thread_id, task_class cls, queued_task &task)
+{
+    uint64_t num = queues.size();
+    for (uint64_t i = 1; i < num; i++) {
+        pool_queue &q = *queues[(thread_id + i) % num];
+
+        q.mtx.lock();
+        if (!q.tasks[cls].empty()) {
+            task = std::move(q.tasks[cls].front());
+            q.tasks[cls].pop_front();
+            q.mtx.unlock();
+            return true;
+        }
+        q.mtx.unlock();
+    }
+
+    return false;
+}
+
+// try class first, then all classes in priority order
+bool
+work_pool :: get_task(uint64_t thread_id, task_class first, queued_task &task, task_class &cls)
+{
+    if (pop_own(thread_id, first, task) || steal(thread_id, first, task)) {
+        cls = first;
+        return true;
+    }
+    for (int c = 0; c < NUM_TASK_CLASSES; c++) {
+        if (c != first
+         && (pop_own(thread_id, (task_class)c, task) || steal(thread_id, (task_class)c, task))) {
+            cls = (task_class)c;
+            return true;
+        }
+    }
+    return false;
+}
+
+// body of each pool thread, never returns
+void
+work_pool :: worker_loop(uint64_t thread_id)
+{
+    assert(thread_id < queues.size());
+    order::oracle time_oracle;
+    queued_task task;
+    task_class cls;
+    uint64_t turn = thread_id; // threads start at different points in the schedule
+    wclock::weaver_timer timer;
+    uint64_t start, end;
+
+    while (true) {
+        pending_mtx.lock();
+        while (pending == 0) {
+            pending_cond.wait();
+        }
+        pending_mtx.unlock();
+
+        // pending may have been counted before the task was pushed, so retry until some task is found
+        if (get_task(thread_id, schedule[turn++ % schedule.size()], task, cls)) {
+            pending_mtx.lock();
+            pending--;
+            class_pending[cls]--;
+            pending_mtx.unlock();
+
+            start = timer.get_time_elapsed();
+            task.task(&time_oracle);
+            task.task = nullptr;
+            end = timer.get_time_elapsed();
+
+            done_tasks[cls].fetch_add(1, std::memory_order_relaxed);
+            wait_nanos[cls].fetch_add(start - task.enq_time, std::memory_order_relaxed);
+            run_nanos[cls].fetch_add(end - start, std::memory_order_relaxed);
+        }
+    }
+}
+
+void
+work_pool :: get_stats(pool_stats &stats)
+{
+    pending_mtx.lock();
+    for (int c = 0; c < NUM_TASK_CLASSES; c++) {
+        stats.depth[c] = class_pending[c];
+        stats.max_depth[c] = max_pending[c];
+    }
+    pending_mtx.unlock();
+
+    for (int c = 0; c < NUM_TASK_CLASSES; c++) {
+        stats.tasks[c] = done_tasks[c].load(std::memory_order_relaxed);
+        stats.wait_nanos[c] = wait_nanos[c].load(std::memory_order_relaxed);
+        stats.run_nanos[c] = run_nanos[c].load(std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,107 @@
+/*
+ * ===============================================================
+ *    Description:  Work-stealing pool of shard threads which
+ *                  execute chunks of a single node program in
+ *                  parallel.
+ *
+ *        Created:  2014-10-09 10:12:45
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#ifndef weaver_db_work_pool_h_
+#define weaver_db_work_pool_h_
+
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <po6/threads/mutex.h>
+#include <po6/threads/cond.h>
+
+#include "common/event_order.h"
+
+namespace db
+{
+    // each task is run with the time oracle of the pool thread that executes it
+    typedef std::function<void(order::oracle*)> pool_task;
+
+    // classes of tasks, in decreasing order of priority
+    enum task_class
+    {
+        CONTROL_TASK = 0, // ordering and control traffic, e.g. nops, write txs, migration acks, context replies
+        READ_TASK, // short reads
+        BULK_TASK, // long running analytics
+        NUM_TASK_CLASSES
+    };
+
+    struct queued_task
+    {
+        pool_task task;
+        uint64_t enq_time; // nanosecs, see wclock::weaver_timer::get_time_elapsed
+    };
+
+    struct pool_queue
+    {
+        po6::threads::mutex mtx;
+        std::deque<queued_task> tasks[NUM_TASK_CLASSES];
+    };
+
+    // totals since pool creation, per task class
+    struct pool_stats
+    {
+        uint64_t tasks[NUM_TASK_CLASSES]; // tasks completed
+        uint64_t depth[NUM_TASK_CLASSES]; // tasks waiting now
+        uint64_t max_depth[NUM_TASK_CLASSES];
+        uint64_t wait_nanos[NUM_TASK_CLASSES]; // time between submit and start of task
+        uint64_t run_nanos[NUM_TASK_CLASSES];
+    };
+
+    // every pool thread has its own task queue per class
+    // a thread runs tasks from its own queue in arrival order, so old tasks are not starved by a
+    // stream of new ones, and steals the oldest task from other queues when its own is empty
+    // the class to serve next is picked by weighted round robin over the class weights, falling back
+    // to other classes in priority order when the picked class has no tasks, so no class starves and
+    // no thread idles while there is work
+    class work_pool
+    {
+        private:
+            std::vector<std::unique_ptr<pool_queue>> queues;
+            std::vector<task_class> schedule; // one round of weighted round robin
+            uint64_t next_queue; // round robin assignment of submitted tasks
+            uint64_t pending; // total number of tasks in all queues
+            uint64_t class_pending[NUM_TASK_CLASSES];
+            uint64_t max_pending[NUM_TASK_CLASSES];
+            po6::threads::mutex pending_mtx;
+            po6::threads::cond pending_cond;
+            std::atomic<uint64_t> done_tasks[NUM_TASK_CLASSES];
+            std::atomic<uint64_t> wait_nanos[NUM_TASK_CLASSES];
+            std::atomic<uint64_t> run_nanos[NUM_TASK_CLASSES];
+
+        private:
+            void init(uint64_t num_threads, const uint64_t weights[NUM_TASK_CLASSES]);
+            bool pop_own(uint64_t thread_id, task_class cls, queued_task &task);
+            bool steal(uint64_t thread_id, task_class cls, queued_task &task);
+            bool get_task(uint64_t thread_id, task_class first, queued_task &task, task_class &cls);
+
+        public:
+            work_pool(uint64_t num_threads);
+            work_pool(uint64_t num_threads, const uint64_t weights[NUM_TASK_CLASSES]);
+            uint64_t num_threads() const;
+            void submit(pool_task task);
+            void submit(pool_task task, task_class cls);
+            void worker_loop(uint64_t thread_id);
+            void get_stats(pool_stats &stats);
+
+            // delete standard copy onstructors
+            work_pool(const work_pool&) = delete;
+            work_pool& operator=(work_pool const&) = delete;
+    };
+}
+
+#endif
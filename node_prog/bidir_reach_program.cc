@@ -0,0 +1,122 @@
+/*
+ * ===============================================================
+ *    Description:  Bidirectional reachability implementation.
+ *
+ *        Created:  2014-10-16 22:10:41
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#include "common/message.h"
+#include "node_prog/bidir_reach_program.h"
+
+using node_prog::bidir_reach_params;
+using node_prog::bidir_reach_search;
+using db::element::remote_node;
+
+// params
+bidir_reach_params :: bidir_reach_params()
+    : reachable(false)
+    , levels(0)
+{ }
+
+uint64_t
+bidir_reach_params :: size() const
+{
+    uint64_t toRet = message::size(src)
+        + message::size(dst)
+        + message::size(edge_props)
+        + message::size(reachable)
+        + message::size(levels);
+    return toRet;
+}
+
+void
+bidir_reach_params :: pack(e::buffer::packer &packer) const
+{
+    message::pack_buffer(packer, src);
+    message::pack_buffer(packer, dst);
+    message::pack_buffer(packer, edge_props);
+    message::pack_buffer(packer, reachable);
+    message::pack_buffer(packer, levels);
+}
+
+void
+bidir_reach_params :: unpack(e::unpacker &unpacker)
+{
+    message::unpack_buffer(unpacker, src);
+    message::unpack_buffer(unpacker, dst);
+    message::unpack_buffer(unpacker, edge_props);
+    message::unpack_buffer(unpacker, reachable);
+    message::unpack_buffer(unpacker, levels);
+}
+
+// search
+bidir_reach_search :: bidir_reach_search()
+    : met(false)
+    , dir(BIDIR_FORWARD)
+    , done(false)
+    , reachable(false)
+    , levels(0)
+{ }
+
+void
+bidir_reach_search :: init(const remote_node &src, const remote_node &dst)
+{
+    visited[BIDIR_FORWARD].emplace(src.handle);
+    visited[BIDIR_BACKWARD].emplace(dst.handle);
+    frontier[BIDIR_FORWARD].emplace_back(src);
+    frontier[BIDIR_BACKWARD].emplace_back(dst);
+
+    if (src.handle == dst.handle) {
+        done = true;
+        reachable = true;
+    }
+}
+
+void
+bidir_reach_search :: start_level()
+{
+    if (frontier[BIDIR_FORWARD].size() <= frontier[BIDIR_BACKWARD].size()) {
+        dir = BIDIR_FORWARD;
+    } else {
+        dir = BIDIR_BACKWARD;
+    }
+    next.clear();
+}
+
+void
+bidir_reach_search :: add_found(const std::vector<remote_node> &found)
+{
+    bidir_direction other = (dir == BIDIR_FORWARD)? BIDIR_BACKWARD : BIDIR_FORWARD;
+    for (const remote_node &rn: found) {
+        if (visited[other].find(rn.handle) != visited[other].end()) {
+            met = true;
+        }
+        if (visited[dir].emplace(rn.handle).second) {
+            next.emplace_back(rn);
+        }
+    }
+}
+
+bool
+bidir_reach_search :: end_level()
+{
+    levels++;
+    if (met) {
+        done = true;
+        reachable = true;
+    } else {
+        frontier[dir] = std::move(next);
+        next.clear();
+        // nothing left to expand on one side means there is no path
+        if (frontier[dir].empty()) {
+            done = true;
+        }
+    }
+    return done;
+}
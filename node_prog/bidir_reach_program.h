@@ -0,0 +1,82 @@
+/*
+ * ===============================================================
+ *    Description:  Bidirectional reachability: breadth first search
+ *                  forward from the source along out-edges and
+ *                  backward from the destination along in-edges,
+ *                  one level at a time, until the two searches meet.
+ *
+ *        Created:  2014-10-16 22:10:41
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#ifndef weaver_node_prog_bidir_reach_program_h_
+#define weaver_node_prog_bidir_reach_program_h_
+
+#include <vector>
+#include <string>
+#include <unordered_set>
+#include <e/buffer.h>
+
+#include "common/types.h"
+#include "db/remote_node.h"
+
+namespace node_prog
+{
+    enum bidir_direction
+    {
+        BIDIR_FORWARD = 0,
+        BIDIR_BACKWARD
+    };
+
+    class bidir_reach_params
+    {
+        public:
+            node_handle_t src;
+            node_handle_t dst;
+            std::vector<std::pair<std::string, std::string>> edge_props;
+            bool reachable;
+            uint32_t levels; // levels expanded in either direction, set in reply
+
+        public:
+            bidir_reach_params();
+            uint64_t size() const;
+            void pack(e::buffer::packer &packer) const;
+            void unpack(e::unpacker &unpacker);
+    };
+
+    // visited sets and frontiers of both directions, kept at the coordinating timestamper
+    // each level expands the smaller frontier, forward levels go to the shards of frontier nodes,
+    // backward levels go to all shards since in-edges are stored at the shard of the in-nbr
+    class bidir_reach_search
+    {
+        private:
+            std::unordered_set<node_handle_t> visited[2];
+            std::vector<db::element::remote_node> frontier[2];
+            std::vector<db::element::remote_node> next; // found in current level
+            bool met;
+
+        public:
+            bidir_direction dir; // of current level
+            bool done;
+            bool reachable;
+            uint32_t levels;
+
+        public:
+            bidir_reach_search();
+            void init(const db::element::remote_node &src, const db::element::remote_node &dst);
+            // pick direction of next level
+            void start_level();
+            const std::vector<db::element::remote_node>& get_frontier() const { return frontier[dir]; }
+            // nbrs found by a shard in current level
+            void add_found(const std::vector<db::element::remote_node> &found);
+            // all shards done with current level, returns true if search is over
+            bool end_level();
+    };
+}
+
+#endif
@@ -0,0 +1,324 @@
+/*
+ * ===============================================================
+ *    Description:  Bulk synchronous analytics implementation.
+ *
+ *        Created:  2014-10-16 19:52:36
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#include <cmath>
+
+#include "common/message.h"
+#include "node_prog/bsp_program.h"
+
+using node_prog::bsp_params;
+using node_prog::bsp_msg;
+using node_prog::bsp_stats;
+using node_prog::bsp_vertex;
+using node_prog::bsp_send;
+
+// params
+bsp_params :: bsp_params()
+    : algorithm(BSP_PAGERANK)
+    , max_supersteps(30)
+    , damping(0.85)
+    , tolerance(1e-6)
+{ }
+
+uint64_t
+bsp_params :: size() const
+{
+    uint32_t algo = algorithm;
+    uint64_t toRet = message::size(algo)
+        + message::size(max_supersteps)
+        + message::size(damping)
+        + message::size(tolerance);
+    return toRet;
+}
+
+void
+bsp_params :: pack(e::buffer::packer &packer) const
+{
+    uint32_t algo = algorithm;
+    message::pack_buffer(packer, algo);
+    message::pack_buffer(packer, max_supersteps);
+    message::pack_buffer(packer, damping);
+    message::pack_buffer(packer, tolerance);
+}
+
+void
+bsp_params :: unpack(e::unpacker &unpacker)
+{
+    uint32_t algo;
+    message::unpack_buffer(unpacker, algo);
+    algorithm = (bsp_algorithm)algo;
+    message::unpack_buffer(unpacker, max_supersteps);
+    message::unpack_buffer(unpacker, damping);
+    message::unpack_buffer(unpacker, tolerance);
+}
+
+// messages
+bsp_msg :: bsp_msg()
+    : rank_sum(0)
+    , min_label(UINT64_MAX)
+{ }
+
+void
+bsp_msg :: combine(const bsp_msg &other)
+{
+    rank_sum += other.rank_sum;
+    if (other.min_label < min_label) {
+        min_label = other.min_label;
+    }
+    for (const auto &p: other.label_counts) {
+        label_counts[p.first] += p.second;
+    }
+    senders.insert(senders.end(), other.senders.begin(), other.senders.end());
+}
+
+uint64_t
+bsp_msg :: size() const
+{
+    uint64_t toRet = message::size(rank_sum)
+        + message::size(min_label)
+        + message::size(label_counts)
+        + message::size(senders);
+    return toRet;
+}
+
+void
+bsp_msg :: pack(e::buffer::packer &packer) const
+{
+    message::pack_buffer(packer, rank_sum);
+    message::pack_buffer(packer, min_label);
+    message::pack_buffer(packer, label_counts);
+    message::pack_buffer(packer, senders);
+}
+
+void
+bsp_msg :: unpack(e::unpacker &unpacker)
+{
+    message::unpack_buffer(unpacker, rank_sum);
+    message::unpack_buffer(unpacker, min_label);
+    message::unpack_buffer(unpacker, label_counts);
+    message::unpack_buffer(unpacker, senders);
+}
+
+// stats
+bsp_stats :: bsp_stats()
+    : num_vertices(0)
+    , active(0)
+    , changed(0)
+    , delta(0)
+    , dangling(0)
+{ }
+
+void
+bsp_stats :: add(const bsp_stats &other)
+{
+    num_vertices += other.num_vertices;
+    active += other.active;
+    changed += other.changed;
+    delta += other.delta;
+    dangling += other.dangling;
+}
+
+uint64_t
+bsp_stats :: size() const
+{
+    uint64_t toRet = message::size(num_vertices)
+        + message::size(active)
+        + message::size(changed)
+        + message::size(delta)
+        + message::size(dangling);
+    return toRet;
+}
+
+void
+bsp_stats :: pack(e::buffer::packer &packer) const
+{
+    message::pack_buffer(packer, num_vertices);
+    message::pack_buffer(packer, active);
+    message::pack_buffer(packer, changed);
+    message::pack_buffer(packer, delta);
+    message::pack_buffer(packer, dangling);
+}
+
+void
+bsp_stats :: unpack(e::unpacker &unpacker)
+{
+    message::unpack_buffer(unpacker, num_vertices);
+    message::unpack_buffer(unpacker, active);
+    message::unpack_buffer(unpacker, changed);
+    message::unpack_buffer(unpacker, delta);
+    message::unpack_buffer(unpacker, dangling);
+}
+
+bool
+node_prog :: bsp_undirected(bsp_algorithm algorithm)
+{
+    return algorithm == BSP_CONNECTED_COMPONENTS || algorithm == BSP_LABEL_PROPAGATION;
+}
+
+// superstep 0 loads graph, superstep 1 starts with rank 1/N, where N is counted in superstep 0
+// vertices without out-nbrs spread their rank evenly over all vertices
+static bsp_send
+pagerank_compute(const bsp_params &params, uint64_t step, const bsp_stats &prev, bsp_vertex &v, const bsp_msg *msg, bsp_stats &stats)
+{
+    if (step == 0 || prev.num_vertices == 0) {
+        return node_prog::BSP_SEND_NONE;
+    }
+
+    double n = prev.num_vertices;
+    if (step == 1) {
+        v.rank = 1.0 / n;
+    } else {
+        double in_sum = (msg == NULL)? 0 : msg->rank_sum;
+        double new_rank = (1.0 - params.damping) / n + params.damping * (in_sum + prev.dangling / n);
+        stats.delta += std::fabs(new_rank - v.rank);
+        v.rank = new_rank;
+    }
+
+    if (v.out_nbrs.empty()) {
+        stats.dangling += v.rank;
+        return node_prog::BSP_SEND_NONE;
+    } else {
+        return node_prog::BSP_SEND_OUT;
+    }
+}
+
+// superstep 0 sends own id to out-nbrs, superstep 1 takes min over in-nbrs and sends to all nbrs,
+// later supersteps send only when the label drops
+static bsp_send
+components_compute(uint64_t step, bsp_vertex &v, const bsp_msg *msg, bsp_stats &stats)
+{
+    if (step == 0) {
+        v.label = v.id;
+        return node_prog::BSP_SEND_OUT;
+    }
+
+    bool changed = false;
+    if (msg != NULL && msg->min_label < v.label) {
+        v.label = msg->min_label;
+        changed = true;
+        stats.changed++;
+    }
+
+    if (step == 1 || changed) {
+        return node_prog::BSP_SEND_ALL;
+    } else {
+        return node_prog::BSP_SEND_NONE;
+    }
+}
+
+// synchronous label propagation, each vertex takes the most frequent label among all nbrs, ties go to the smaller label
+// superstep 0 and 1 exchange initial labels in both directions, labels change from superstep 2
+// caution: may oscillate on bipartite components, bounded by max_supersteps
+static bsp_send
+label_prop_compute(uint64_t step, bsp_vertex &v, const bsp_msg *msg, bsp_stats &stats)
+{
+    if (step == 0) {
+        v.label = v.id;
+        return node_prog::BSP_SEND_OUT;
+    }
+
+    if (step >= 2 && msg != NULL && !msg->label_counts.empty()) {
+        uint64_t best = UINT64_MAX;
+        uint64_t best_count = 0;
+        for (const auto &p: msg->label_counts) {
+            if (p.second > best_count || (p.second == best_count && p.first < best)) {
+                best = p.first;
+                best_count = p.second;
+            }
+        }
+        if (best != v.label) {
+            v.label = best;
+            stats.changed++;
+        }
+    }
+
+    return node_prog::BSP_SEND_ALL;
+}
+
+bsp_send
+node_prog :: bsp_compute(const bsp_params &params,
+    uint64_t step,
+    const bsp_stats &prev,
+    bsp_vertex &v,
+    const bsp_msg *msg,
+    bsp_stats &stats)
+{
+    bsp_send send = BSP_SEND_NONE;
+    switch (params.algorithm) {
+        case BSP_PAGERANK:
+            send = pagerank_compute(params, step, prev, v, msg, stats);
+            break;
+
+        case BSP_CONNECTED_COMPONENTS:
+            send = components_compute(step, v, msg, stats);
+            break;
+
+        case BSP_LABEL_PROPAGATION:
+            send = label_prop_compute(step, v, msg, stats);
+            break;
+
+        default:
+            WDEBUG << "bad bsp algorithm " << params.algorithm << std::endl;
+    }
+
+    if (step == 0) {
+        stats.num_vertices++;
+    }
+    if (send != BSP_SEND_NONE) {
+        stats.active++;
+    }
+    return send;
+}
+
+void
+node_prog :: bsp_outgoing(const bsp_params &params, const bsp_vertex &v, bsp_msg &out)
+{
+    switch (params.algorithm) {
+        case BSP_PAGERANK:
+            out.rank_sum = v.rank / v.out_nbrs.size();
+            break;
+
+        case BSP_CONNECTED_COMPONENTS:
+            out.min_label = v.label;
+            break;
+
+        case BSP_LABEL_PROPAGATION:
+            out.label_counts[v.label] = 1;
+            break;
+
+        default:
+            WDEBUG << "bad bsp algorithm " << params.algorithm << std::endl;
+    }
+}
+
+bool
+node_prog :: bsp_converged(const bsp_params &params, uint64_t step, const bsp_stats &totals)
+{
+    if (step + 1 >= params.max_supersteps) {
+        return true;
+    }
+
+    switch (params.algorithm) {
+        case BSP_PAGERANK:
+            return step >= 2 && totals.delta < params.tolerance;
+
+        case BSP_CONNECTED_COMPONENTS:
+            return step >= 1 && totals.active == 0;
+
+        case BSP_LABEL_PROPAGATION:
+            return step >= 2 && totals.changed == 0;
+
+        default:
+            return true;
+    }
+}
@@ -0,0 +1,122 @@
+/*
+ * ===============================================================
+ *    Description:  Bulk synchronous whole-graph analytics:
+ *                  pagerank, weakly connected components and
+ *                  label propagation.  Vertex computation and
+ *                  superstep messages, the superstep loop is run
+ *                  by the shards and the coordinating timestamper.
+ *
+ *        Created:  2014-10-16 19:52:36
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#ifndef weaver_node_prog_bsp_program_h_
+#define weaver_node_prog_bsp_program_h_
+
+#include <vector>
+#include <unordered_map>
+#include <e/buffer.h>
+
+#include "db/remote_node.h"
+
+namespace node_prog
+{
+    enum bsp_algorithm
+    {
+        BSP_PAGERANK,
+        BSP_CONNECTED_COMPONENTS, // weakly connected, edges are taken as undirected
+        BSP_LABEL_PROPAGATION // community detection, edges are taken as undirected
+    };
+
+    class bsp_params
+    {
+        public:
+            bsp_algorithm algorithm;
+            uint32_t max_supersteps;
+            double damping; // pagerank
+            double tolerance; // pagerank stops when sum of rank changes in a superstep is below this
+
+        public:
+            bsp_params();
+            uint64_t size() const;
+            void pack(e::buffer::packer &packer) const;
+            void unpack(e::unpacker &unpacker);
+    };
+
+    // all messages to a single vertex in a superstep, combined at the sender
+    class bsp_msg
+    {
+        public:
+            double rank_sum;
+            uint64_t min_label;
+            std::unordered_map<uint64_t, uint64_t> label_counts; // label -> number of nbrs with that label
+            std::vector<db::element::remote_node> senders; // superstep 0 of undirected algorithms, so that vertices learn in-nbrs
+
+        public:
+            bsp_msg();
+            void combine(const bsp_msg &other);
+            uint64_t size() const;
+            void pack(e::buffer::packer &packer) const;
+            void unpack(e::unpacker &unpacker);
+    };
+
+    // counts and sums of one superstep, per shard and over all shards
+    class bsp_stats
+    {
+        public:
+            uint64_t num_vertices;
+            uint64_t active; // vertices that sent messages
+            uint64_t changed; // vertices whose label changed
+            double delta; // sum of absolute rank changes
+            double dangling; // rank of vertices without out-nbrs, spread over all vertices in next superstep
+
+        public:
+            bsp_stats();
+            void add(const bsp_stats &other);
+            uint64_t size() const;
+            void pack(e::buffer::packer &packer) const;
+            void unpack(e::unpacker &unpacker);
+    };
+
+    // value of a vertex for the duration of a job, kept at the shard
+    struct bsp_vertex
+    {
+        uint64_t id; // unique over all shards for this job, initial label
+        double rank;
+        uint64_t label;
+        std::vector<db::element::remote_node> out_nbrs; // visible out-nbrs at the job snapshot
+        std::vector<db::element::remote_node> in_nbrs; // undirected algorithms only
+
+        bsp_vertex() : id(0), rank(0), label(0) { }
+    };
+
+    enum bsp_send
+    {
+        BSP_SEND_NONE,
+        BSP_SEND_OUT, // to out-nbrs
+        BSP_SEND_ALL // to out- and in-nbrs
+    };
+
+    // superstep 0 reads the graph at the snapshot and counts vertices
+    // undirected algorithms also send to out-nbrs in superstep 0 so that every vertex learns its in-nbrs
+    bool bsp_undirected(bsp_algorithm algorithm);
+    // run superstep at vertex, msg is NULL if there were no messages to it
+    // prev is the totals of the previous superstep over all shards, stats accumulates this shard's totals
+    bsp_send bsp_compute(const bsp_params &params,
+        uint64_t step,
+        const bsp_stats &prev,
+        bsp_vertex &v,
+        const bsp_msg *msg,
+        bsp_stats &stats);
+    // message from v to each of its nbrs
+    void bsp_outgoing(const bsp_params &params, const bsp_vertex &v, bsp_msg &out);
+    // totals are over all shards after superstep
+    bool bsp_converged(const bsp_params &params, uint64_t step, const bsp_stats &totals);
+}
+
+#endif
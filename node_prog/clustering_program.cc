@@ -87,15 +87,13 @@ node_prog :: clustering_node_program(
     node &n,
     db::element::remote_node &rn,
     clustering_params &params,
-    std::function<clustering_node_state&()> get_state,
-    std::function<void(std::shared_ptr<node_prog::Cache_Value_Base>,
-        std::shared_ptr<std::vector<db::element::remote_node>>, cache_key_t)>&,
+    node_prog_context<clustering_node_state, Cache_Value_Base> &ctx,
     cache_response<Cache_Value_Base>*)
 {
     // TODO can we change this to a three enum switch to reduce number of if statements
     std::vector<std::pair<db::element::remote_node, clustering_params>> next;
     if (params.is_center) {
-        node_prog::clustering_node_state &cstate = get_state();
+        node_prog::clustering_node_state &cstate = ctx.state();
         if (params.outgoing) {
             params.is_center = false;
             params.center = rn;
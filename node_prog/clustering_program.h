@@ -21,6 +21,7 @@
 #include "node_prog/node.h"
 #include "node_prog/edge.h"
 #include "node_prog/cache_response.h"
+#include "node_prog/node_prog_context.h"
 
 namespace node_prog
 {
@@ -59,9 +60,7 @@ namespace node_prog
             node &n,
             db::element::remote_node &rn,
             clustering_params &params,
-            std::function<clustering_node_state&()> get_state,
-            std::function<void(std::shared_ptr<node_prog::Cache_Value_Base>,
-                std::shared_ptr<std::vector<db::element::remote_node>>, cache_key_t)>&,
+            node_prog_context<clustering_node_state, Cache_Value_Base> &ctx,
             cache_response<Cache_Value_Base>*);
 }
 
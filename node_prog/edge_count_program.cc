@@ -45,9 +45,7 @@ node_prog :: edge_count_node_program(
     node &n,
     db::element::remote_node &,
     edge_count_params &params,
-    std::function<edge_count_state&()>,
-    std::function<void(std::shared_ptr<node_prog::Cache_Value_Base>,
-        std::shared_ptr<std::vector<db::element::remote_node>>, cache_key_t)>&,
+    node_prog_context<edge_count_state, Cache_Value_Base>&,
     cache_response<Cache_Value_Base>*)
 {
     auto elist = n.get_edges();
@@ -21,6 +21,7 @@
 #include "node_prog/base_classes.h"
 #include "node_prog/node.h"
 #include "node_prog/cache_response.h"
+#include "node_prog/node_prog_context.h"
 
 namespace node_prog
 {
@@ -52,9 +53,7 @@ namespace node_prog
             node &n,
             db::element::remote_node &,
             edge_count_params &params,
-            std::function<edge_count_state&()>,
-            std::function<void(std::shared_ptr<node_prog::Cache_Value_Base>,
-                std::shared_ptr<std::vector<db::element::remote_node>>, cache_key_t)>&,
+            node_prog_context<edge_count_state, Cache_Value_Base>&,
             cache_response<Cache_Value_Base>*);
 }
 
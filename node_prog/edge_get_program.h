@@ -22,6 +22,7 @@
 #include "node_prog/base_classes.h"
 #include "node_prog/node.h"
 #include "node_prog/cache_response.h"
+#include "node_prog/node_prog_context.h"
 
 namespace node_prog
 {
@@ -53,9 +54,7 @@ namespace node_prog
             node &n,
             db::element::remote_node &,
             edge_get_params &params,
-            std::function<edge_get_state&()>,
-            std::function<void(std::shared_ptr<node_prog::Cache_Value_Base>,
-                std::shared_ptr<std::vector<db::element::remote_node>>, cache_key_t)>&,
+            node_prog_context<edge_get_state, Cache_Value_Base>&,
             cache_response<Cache_Value_Base>*);
 }
 
@@ -16,73 +16,122 @@
 using node_prog::edge_map_iter;
 using node_prog::edge_list;
 
-edge_map_iter&
-edge_map_iter :: operator++()
+// advance cur to next visible edge, or num_edges if none
+void
+edge_map_iter :: skip_invisible()
 {
-    while (internal_cur != internal_end) {
-        internal_cur++;
-        if (internal_cur != internal_end
-         && time_oracle->clock_creat_before_del_after(*req_time, internal_cur->second->base.get_creat_time(), internal_cur->second->base.get_del_time())) {
+    while (cur < num_edges) {
+        uint64_t word = (*visible)[cur >> 6] >> (cur & 63);
+        if (word != 0) {
+            cur += __builtin_ctzll(word);
             break;
         }
+        cur = (cur | 63) + 1;
+    }
+    if (cur > num_edges) {
+        cur = num_edges;
+    }
+}
+
+edge_map_iter&
+edge_map_iter :: operator++()
+{
+    if (cur < num_edges) {
+        cur++;
+        skip_invisible();
     }
     return *this;
 }
 
-edge_map_iter :: edge_map_iter(edge_map_t::iterator begin,
-    edge_map_t::iterator end,
+edge_map_iter :: edge_map_iter(edge_map_t::iterator edges,
+    const std::vector<uint64_t> *visible,
+    uint64_t cur,
+    uint64_t num_edges,
     std::shared_ptr<vc::vclock> &req_time,
     order::oracle *to)
-    : internal_cur(begin)
-    , internal_end(end)
+    : edges(edges)
+    , visible(visible)
+    , cur(cur)
+    , num_edges(num_edges)
     , req_time(req_time)
     , time_oracle(to)
 {
-    if (internal_cur != internal_end
-     && !time_oracle->clock_creat_before_del_after(*req_time, internal_cur->second->base.get_creat_time(), internal_cur->second->base.get_del_time())) {
-        ++(*this);
-    }
+    skip_invisible();
 }
 
 bool
 edge_map_iter :: operator==(const edge_map_iter& rhs)
 {
-    return internal_cur == rhs.internal_cur && *req_time == *rhs.req_time;
+    return cur == rhs.cur && visible == rhs.visible;
 }
 
 bool
 edge_map_iter :: operator!=(const edge_map_iter& rhs)
 {
-    return internal_cur != rhs.internal_cur || !(*req_time == *rhs.req_time);
+    return !(*this == rhs);
 }
 
 node_prog::edge&
 edge_map_iter :: operator*()
 {
-    db::element::edge &toRet = *internal_cur->second;
+    db::element::edge &toRet = *(edges + cur);
     toRet.base.view_time = req_time;
     toRet.base.time_oracle = time_oracle;
     return (edge&)toRet;
 }
 
 edge_list :: edge_list(edge_map_t &edge_list,
+    const vc::vclock &last_upd_clk,
     std::shared_ptr<vc::vclock> &req_time,
     order::oracle *to)
     : wrapped(edge_list)
+    , last_upd_clk(last_upd_clk)
     , req_time(req_time)
     , time_oracle(to)
+    , filtered(false)
 { }
 
+// single pass over the edge table which sets the visible-edge bitmap
+void
+edge_list :: filter_visible()
+{
+    uint64_t num_edges = wrapped.size();
+    visible.assign((num_edges + 63) / 64, 0);
+
+    // last_upd_clk is empty for nodes created at this shard by migration, before the first write
+    bool all_before = last_upd_clk.clock.size() == req_time->clock.size()
+                   && vc::happens_before(last_upd_clk.clock, req_time->clock);
+
+    uint64_t i = 0;
+    for (const db::element::edge &e: wrapped) {
+        bool vis;
+        if (all_before) {
+            vis = !e.base.is_deleted();
+        } else {
+            vis = time_oracle->clock_creat_before_del_after(*req_time, e.base.get_creat_time(), e.base.get_del_time());
+        }
+        if (vis) {
+            visible[i >> 6] |= (1ULL << (i & 63));
+        }
+        i++;
+    }
+
+    filtered = true;
+}
+
 edge_map_iter
 edge_list :: begin()
 {
-    return edge_map_iter(wrapped.begin(), wrapped.end(), req_time, time_oracle);
+    if (!filtered) {
+        filter_visible();
+    }
+    return edge_map_iter(wrapped.begin(), &visible, 0, wrapped.size(), req_time, time_oracle);
 }
 
 edge_map_iter
 edge_list :: end()
 {
-    return edge_map_iter(wrapped.end(), wrapped.end(), req_time, time_oracle);
+    return edge_map_iter(wrapped.begin(), &visible, wrapped.size(), wrapped.size(), req_time, time_oracle);
 }
 
 uint64_t
@@ -90,4 +139,3 @@ edge_list :: count()
 {
     return wrapped.size();
 }
-
@@ -16,26 +16,35 @@
 
 #include <stdint.h>
 #include <iterator>
-#include <unordered_map>
+#include <vector>
 
 #include "db/edge.h"
+#include "db/edge_table.h"
 #include "common/event_order.h"
 #include "node_prog/edge.h"
 
 namespace node_prog
 {
-    typedef std::unordered_map<edge_handle_t, db::element::edge*> edge_map_t;
+    typedef db::element::edge_table edge_map_t;
+
+    // iterates over the set bits of a visible-edge bitmap
     class edge_map_iter : public std::iterator<std::input_iterator_tag, edge>
     {
-        edge_map_t::iterator internal_cur;
-        edge_map_t::iterator internal_end;
+        edge_map_t::iterator edges;
+        const std::vector<uint64_t> *visible;
+        uint64_t cur;
+        uint64_t num_edges;
         std::shared_ptr<vc::vclock> req_time;
         order::oracle *time_oracle;
 
+        void skip_invisible();
+
         public:
             edge_map_iter& operator++();
-            edge_map_iter(edge_map_t::iterator begin,
-                edge_map_t::iterator end,
+            edge_map_iter(edge_map_t::iterator edges,
+                const std::vector<uint64_t> *visible,
+                uint64_t cur,
+                uint64_t num_edges,
                 std::shared_ptr<vc::vclock> &req_time,
                 order::oracle *time_oracle);
             bool operator==(const edge_map_iter& rhs);
@@ -43,15 +52,25 @@ namespace node_prog
             edge& operator*();
     };
 
+    // edges of a node visible at the request time
+    // visibility of all edges is computed in one pass on begin(), bit i set iff i'th edge in table is visible
+    // if every write to the node happens before the request, an edge is visible iff it is not deleted,
+    // and the per-edge clock comparisons are skipped
     class edge_list
     {
         private:
             edge_map_t &wrapped;
+            const vc::vclock &last_upd_clk;
             std::shared_ptr<vc::vclock> &req_time;
             order::oracle *time_oracle;
+            std::vector<uint64_t> visible;
+            bool filtered;
+
+            void filter_visible();
 
         public:
             edge_list(edge_map_t &edge_list,
+                const vc::vclock &last_upd_clk,
                 std::shared_ptr<vc::vclock> &req_time,
                 order::oracle *time_oracle);
             edge_map_iter begin();
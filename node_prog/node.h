@@ -12,9 +12,13 @@
 #include <iostream>
 #include <iterator>
 #include <vector>
+#include <memory>
 #include <unordered_map>
 
 #include "common/types.h"
+#include "common/vclock.h"
+#include "db/remote_node.h"
+#include "node_prog/base_classes.h"
 #include "node_prog/edge_list.h"
 
 namespace node_prog
@@ -25,9 +29,19 @@ namespace node_prog
             virtual ~node() { }
             virtual node_handle_t get_handle() const = 0;
             virtual edge_list get_edges() = 0;
+            // in-nbrs stored at this shard, in-nbrs at other shards are known only there
+            // in-edges are not versioned, so check the out-edge at an in-nbr at the request clock when visiting it
+            // no program in the tree calls this yet, bidirectional reach expands backward levels from
+            // frontier handles that need not be local to the shard, see bidir_expand_backward in db/shard.cc
+            virtual std::vector<db::element::remote_node> get_local_in_nbrs() = 0;
             virtual prop_list get_properties() = 0;
             virtual bool has_property(std::pair<std::string, std::string> &p) = 0;
             virtual bool has_all_properties(std::vector<std::pair<std::string, std::string>> &props) = 0;
+            // for node programs through node_prog_context::add_cache
+            virtual void add_cache_value(std::shared_ptr<vc::vclock> vc,
+                std::shared_ptr<Cache_Value_Base> cache_value,
+                std::shared_ptr<std::vector<db::element::remote_node>> watch_set,
+                cache_key_t key) = 0;
     };
 }
 
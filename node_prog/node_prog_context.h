@@ -0,0 +1,99 @@
+/*
+ * ===============================================================
+ *    Description:  Per-node context passed to node programs, which
+ *                  gives access to request state and the node
+ *                  program cache at the node being visited.
+ *
+ *        Created:  2014-10-16 18:41:27
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#ifndef weaver_node_prog_node_prog_context_h_
+#define weaver_node_prog_node_prog_context_h_
+
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "common/types.h"
+#include "common/vclock.h"
+#include "db/remote_node.h"
+#include "db/prog_state_arena.h"
+#include "node_prog/node_prog_type.h"
+#include "node_prog/base_classes.h"
+#include "node_prog/node.h"
+
+namespace node_prog
+{
+    // built on the stack by the shard for each node visited, and passed to the node program by reference
+    // types are fixed by the template parameters of particular_node_program, so there is no type erasure or allocation per hop
+    // caution: valid only for the duration of the node program call, while the shard holds the node
+    template <typename NodeStateType, typename CacheValueType>
+    class node_prog_context
+    {
+        private:
+            node &prog_node;
+            db::prog_state_arena &arena; // states of all requests at this shard
+            uint64_t req_id;
+            prog_type type;
+            uint64_t node_id; // handle id of node in shard handle table
+            std::shared_ptr<Node_State_Base> cur_state; // keeps state alive even if request finishes meanwhile
+            const std::shared_ptr<vc::vclock> *req_vclock; // NULL if node prog cache is off
+
+        public:
+            node_prog_context(node &n,
+                db::prog_state_arena &prog_states,
+                uint64_t rid,
+                prog_type ptype,
+                uint64_t nid,
+                const std::shared_ptr<vc::vclock> *cache_vclock)
+                : prog_node(n)
+                , arena(prog_states)
+                , req_id(rid)
+                , type(ptype)
+                , node_id(nid)
+                , req_vclock(cache_vclock)
+            { }
+
+            // state of this request at this node, created on first call
+            NodeStateType& state();
+            // add value to node prog cache at this node, which is invalidated when a node in watch set changes
+            void add_cache(std::shared_ptr<CacheValueType> value,
+                std::shared_ptr<std::vector<db::element::remote_node>> watch_set,
+                cache_key_t key);
+
+            // delete standard copy onstructors
+            node_prog_context(const node_prog_context&) = delete;
+            node_prog_context& operator=(node_prog_context const&) = delete;
+    };
+
+    template <typename NodeStateType, typename CacheValueType>
+    inline NodeStateType&
+    node_prog_context<NodeStateType, CacheValueType> :: state()
+    {
+        if (cur_state == nullptr) {
+            cur_state = arena.find(req_id, node_id);
+            if (cur_state == nullptr) {
+                cur_state = arena.insert(req_id, type, node_id, std::make_shared<NodeStateType>());
+            }
+        }
+        return dynamic_cast<NodeStateType&>(*cur_state);
+    }
+
+    template <typename NodeStateType, typename CacheValueType>
+    inline void
+    node_prog_context<NodeStateType, CacheValueType> :: add_cache(std::shared_ptr<CacheValueType> value,
+        std::shared_ptr<std::vector<db::element::remote_node>> watch_set,
+        cache_key_t key)
+    {
+        assert(req_vclock != NULL && "node prog cache is off");
+        prog_node.add_cache_value(*req_vclock, value, watch_set, key);
+    }
+}
+
+#endif
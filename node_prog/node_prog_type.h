@@ -45,6 +45,41 @@ namespace node_prog
         END
     };
 
+    // programs that neither modify the node they run on nor create state or cache entries there
+    // these run with the node held in shared mode, concurrently with other readers
+    inline bool
+    is_read_only(prog_type type)
+    {
+        switch (type) {
+            case READ_NODE_PROPS:
+            case READ_EDGES_PROPS:
+            case READ_N_EDGES:
+            case EDGE_COUNT:
+            case EDGE_GET:
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
+    // long running analytics which touch large parts of the graph
+    // shards run these at lower priority than short reads, see db::task_class
+    inline bool
+    is_bulk(prog_type type)
+    {
+        switch (type) {
+            case TRIANGLE_COUNT:
+            case DIJKSTRA:
+            case CLUSTERING:
+            case TWO_NEIGHBORHOOD:
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
 }
 
 namespace std
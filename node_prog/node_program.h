@@ -27,6 +27,7 @@
 #include "node_prog/cache_response.h"
 #include "node_prog/node.h"
 #include "node_prog/edge.h"
+#include "node_prog/node_prog_context.h"
 
 #include "node_prog/node_prog_type.h"
 #include "node_prog/reach_program.h"
@@ -59,10 +60,8 @@ namespace node_prog
                 node&, // this node
                 db::element::remote_node&, // this remote node
                 params_type&,
-                std::function<node_state_type&()>,
-                std::function<void(std::shared_ptr<cache_value_type>,
-                    std::shared_ptr<std::vector<db::element::remote_node>>, cache_key_t)> &add_cache_func,
-                    cache_response<cache_value_type> *cache_response);
+                node_prog_context<node_state_type, cache_value_type>&, // request state and cache at this node
+                cache_response<cache_value_type> *cache_response);
 
     };
 
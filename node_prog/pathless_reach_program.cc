@@ -108,12 +108,10 @@ node_prog :: pathless_reach_node_program(
         node &n,
         db::element::remote_node &rn,
         pathless_reach_params &params,
-        std::function<pathless_reach_node_state&()> state_getter,
-        std::function<void(std::shared_ptr<Cache_Value_Base>,
-            std::shared_ptr<std::vector<db::element::remote_node>>, cache_key_t)>&,
+        node_prog_context<pathless_reach_node_state, Cache_Value_Base> &ctx,
         cache_response<Cache_Value_Base>*)
 {
-    pathless_reach_node_state &state = state_getter();
+    pathless_reach_node_state &state = ctx.state();
     std::vector<std::pair<db::element::remote_node, pathless_reach_params>> next;
     if (state.reachable == true) {
         return std::make_pair(search_type::BREADTH_FIRST, next);
@@ -22,6 +22,7 @@
 #include "node_prog/base_classes.h"
 #include "node_prog/node.h"
 #include "node_prog/cache_response.h"
+#include "node_prog/node_prog_context.h"
 
 namespace node_prog
 {
@@ -63,9 +64,7 @@ namespace node_prog
             node &n,
             db::element::remote_node &rn,
             pathless_reach_params &params,
-            std::function<pathless_reach_node_state&()> state_getter,
-            std::function<void(std::shared_ptr<Cache_Value_Base>,
-                std::shared_ptr<std::vector<db::element::remote_node>>, cache_key_t)>& add_cache_func,
+            node_prog_context<pathless_reach_node_state, Cache_Value_Base> &ctx,
             cache_response<Cache_Value_Base>*cache_response);
 }
 
@@ -177,12 +177,10 @@ node_prog :: reach_node_program(
         node &n,
         db::element::remote_node &rn,
         reach_params &params,
-        std::function<reach_node_state&()> state_getter,
-        std::function<void(std::shared_ptr<reach_cache_value>, // TODO make const
-            std::shared_ptr<std::vector<db::element::remote_node>>, cache_key_t)>& add_cache_func,
+        node_prog_context<reach_node_state, reach_cache_value> &ctx,
         cache_response<reach_cache_value>*cache_response)
 {
-    reach_node_state &state = state_getter();
+    reach_node_state &state = ctx.state();
     std::vector<std::pair<db::element::remote_node, reach_params>> next;
     if (state.reachable == true) {
         return std::make_pair(search_type::BREADTH_FIRST, next);
@@ -262,7 +260,7 @@ node_prog :: reach_node_program(
                     // now add to cache
                     std::shared_ptr<node_prog::reach_cache_value> toCache(new reach_cache_value(params.path));
                     std::shared_ptr<std::vector<db::element::remote_node>> watch_set(new std::vector<db::element::remote_node>(params.path)); // copy return path from params
-                    add_cache_func(toCache, watch_set, params.dest);
+                    ctx.add_cache(toCache, watch_set, params.dest);
                 }
             }
             next.emplace_back(std::make_pair(state.prev_node, params));
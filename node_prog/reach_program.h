@@ -22,6 +22,7 @@
 #include "node_prog/base_classes.h"
 #include "node_prog/node.h"
 #include "node_prog/cache_response.h"
+#include "node_prog/node_prog_context.h"
 
 namespace node_prog
 {
@@ -79,9 +80,7 @@ namespace node_prog
             node &n,
             db::element::remote_node &rn,
             reach_params &params,
-            std::function<reach_node_state&()> state_getter,
-            std::function<void(std::shared_ptr<reach_cache_value>, // TODO make const
-                std::shared_ptr<std::vector<db::element::remote_node>>, cache_key_t)> &add_cache_func,
+            node_prog_context<reach_node_state, reach_cache_value> &ctx,
             cache_response<reach_cache_value>*cache_response);
 }
 
@@ -51,9 +51,7 @@ node_prog :: read_edges_props_node_program(
     node &n,
     db::element::remote_node&,
     read_edges_props_params &params,
-    std::function<read_edges_props_state&()>,
-    std::function<void(std::shared_ptr<node_prog::Cache_Value_Base>,
-        std::shared_ptr<std::vector<db::element::remote_node>>, cache_key_t)>&,
+    node_prog_context<read_edges_props_state, Cache_Value_Base>&,
     cache_response<Cache_Value_Base>*)
 {
     for (edge &edge : n.get_edges()) {
@@ -50,8 +50,7 @@ node_prog :: read_n_edges_node_program(
     node &n,
     db::element::remote_node &,
     read_n_edges_params &params,
-    std::function<read_n_edges_state&()>,
-    std::function<void(std::shared_ptr<node_prog::Cache_Value_Base>, std::shared_ptr<std::vector<db::element::remote_node>>, cache_key_t)>&,
+    node_prog_context<read_n_edges_state, Cache_Value_Base>&,
     cache_response<Cache_Value_Base>*)
 {
     auto elist = n.get_edges();
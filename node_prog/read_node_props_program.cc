@@ -48,9 +48,7 @@ node_prog :: read_node_props_node_program(
         node &n,
         db::element::remote_node &,
         read_node_props_params &params,
-        std::function<read_node_props_state&()>,
-        std::function<void(std::shared_ptr<node_prog::Cache_Value_Base>,
-            std::shared_ptr<std::vector<db::element::remote_node>>, cache_key_t)>&,
+        node_prog_context<read_node_props_state, Cache_Value_Base>&,
         cache_response<Cache_Value_Base>*)
 {
     bool fetch_all = params.keys.empty();
@@ -107,11 +107,10 @@ std::pair<search_type, std::vector<std::pair<db::element::remote_node, traverse_
 node_prog :: traverse_props_node_program(node &n,
    db::element::remote_node &rn,
    traverse_props_params &params,
-   std::function<traverse_props_state&()> state_getter,
-   std::function<void(std::shared_ptr<Cache_Value_Base>, std::shared_ptr<std::vector<db::element::remote_node>>, cache_key_t)>&,
+   node_prog_context<traverse_props_state, Cache_Value_Base> &ctx,
    cache_response<Cache_Value_Base>*)
 {
-    traverse_props_state &state = state_getter();
+    traverse_props_state &state = ctx.state();
     std::vector<std::pair<db::element::remote_node, traverse_props_params>> next;
 
     if (!params.returning) {
@@ -25,6 +25,7 @@
 #include "node_prog/node.h"
 #include "node_prog/base_classes.h"
 #include "node_prog/cache_response.h"
+#include "node_prog/node_prog_context.h"
 
 namespace node_prog
 {
@@ -69,8 +70,7 @@ namespace node_prog
    traverse_props_node_program(node &n,
        db::element::remote_node &rn,
        traverse_props_params &params,
-       std::function<traverse_props_state&()> state_getter,
-       std::function<void(std::shared_ptr<Cache_Value_Base>, std::shared_ptr<std::vector<db::element::remote_node>>, cache_key_t)>&,
+       node_prog_context<traverse_props_state, Cache_Value_Base> &ctx,
        cache_response<Cache_Value_Base>*);
 }
 
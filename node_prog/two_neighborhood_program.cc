@@ -187,13 +187,11 @@ node_prog :: two_neighborhood_node_program(
     node &n,
     db::element::remote_node &rn,
     two_neighborhood_params &params,
-    std::function<two_neighborhood_state&()> state_getter,
-    std::function<void(std::shared_ptr<node_prog::two_neighborhood_cache_value>,
-        std::shared_ptr<std::vector<db::element::remote_node>>, cache_key_t)> &add_cache_func,
+    node_prog_context<two_neighborhood_state, two_neighborhood_cache_value> &ctx,
     cache_response<two_neighborhood_cache_value> *cache_response)
 {
     std::vector<std::pair<db::element::remote_node, two_neighborhood_params>> next;
-    two_neighborhood_state &state = state_getter();
+    two_neighborhood_state &state = ctx.state();
 
     if (MaxCacheEntries && params._search_cache  && cache_response != NULL && cache_response->get_value()->prop_key.compare(params.prop_key) == 0) {
         WDEBUG  << "GOT CACHE" << std::endl;
@@ -309,7 +307,7 @@ node_prog :: two_neighborhood_node_program(
                     watch_set->emplace_back(e.get_neighbor());
                 }
                 //WDEBUG << "storing cache" << std::endl;
-                add_cache_func(toCache, watch_set, params.prop_key);
+                ctx.add_cache(toCache, watch_set, params.prop_key);
             } else  {
                 params.on_hop--;
             }
@@ -22,6 +22,7 @@
 #include "db/remote_node.h"
 #include "node_prog/node.h"
 #include "node_prog/cache_response.h"
+#include "node_prog/node_prog_context.h"
 
 namespace node_prog
 {
@@ -76,9 +77,7 @@ namespace node_prog
             node &,
             db::element::remote_node &,
             two_neighborhood_params &,
-            std::function<two_neighborhood_state&()>,
-            std::function<void(std::shared_ptr<two_neighborhood_cache_value>,
-                std::shared_ptr<std::vector<db::element::remote_node>>, cache_key_t)> &,
+            node_prog_context<two_neighborhood_state, two_neighborhood_cache_value>&,
             cache_response<two_neighborhood_cache_value> *);
 }
 
@@ -0,0 +1,80 @@
+/*
+ * ===============================================================
+ *    Description:  Sequential reachability benchmark which runs
+ *                  the same random pairs with pathless reach and
+ *                  bidirectional reach.  Meant for the snap social
+ *                  network graphs used by the python benchmarks,
+ *                  with node handles 0 .. num_nodes-1.
+ *
+ *        Created:  2014-10-16 22:52:19
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#include <random>
+
+#include "common/clock.h"
+#include "client/weaver_client.h"
+
+using cl::client;
+
+void
+run_bidir_reach_bench(uint64_t num_nodes, uint64_t num_requests)
+{
+    client cl("127.0.0.1", 2002, "/usr/local/etc/weaver.yaml");
+
+    std::mt19937_64 gen(42);
+    std::uniform_int_distribution<uint64_t> node_dist(0, num_nodes-1);
+    std::vector<std::pair<std::string, std::string>> reqs;
+    reqs.reserve(num_requests);
+    for (uint64_t i = 0; i < num_requests; i++) {
+        reqs.emplace_back(std::to_string(node_dist(gen)), std::to_string(node_dist(gen)));
+    }
+
+    wclock::weaver_timer timer;
+    uint64_t start, end;
+    uint64_t pathless_reachable = 0, bidir_reachable = 0, mismatch = 0;
+    std::vector<bool> pathless_results;
+    pathless_results.reserve(num_requests);
+
+    start = timer.get_time_elapsed_millis();
+    for (auto &r: reqs) {
+        node_prog::pathless_reach_params rp;
+        rp.dest = r.second;
+        std::vector<std::pair<std::string, node_prog::pathless_reach_params>> args(1, std::make_pair(r.first, rp));
+        bool reachable = cl.run_pathless_reach_program(args).reachable;
+        pathless_results.emplace_back(reachable);
+        if (reachable) {
+            pathless_reachable++;
+        }
+    }
+    end = timer.get_time_elapsed_millis();
+    float pathless_time = (end-start) / 1000.0;
+
+    start = timer.get_time_elapsed_millis();
+    for (uint64_t i = 0; i < num_requests; i++) {
+        node_prog::bidir_reach_params bp;
+        bp.src = reqs[i].first;
+        bp.dst = reqs[i].second;
+        bool reachable = cl.run_bidir_reach_program(bp).reachable;
+        if (reachable) {
+            bidir_reachable++;
+        }
+        if (reachable != pathless_results[i]) {
+            mismatch++;
+        }
+    }
+    end = timer.get_time_elapsed_millis();
+    float bidir_time = (end-start) / 1000.0;
+
+    std::cout << "[bidir reach] requests = " << num_requests << ", nodes = " << num_nodes << std::endl;
+    std::cout << "[bidir reach] pathless reach: time = " << pathless_time
+              << ", reachable = " << pathless_reachable << std::endl;
+    std::cout << "[bidir reach] bidirectional reach: time = " << bidir_time
+              << ", reachable = " << bidir_reachable << std::endl;
+    std::cout << "[bidir reach] mismatched results = " << mismatch << std::endl;
+}
@@ -0,0 +1,125 @@
+/*
+ * ===============================================================
+ *    Description:  Read-only benchmark in which all clients read
+ *                  the same vertex, for increasing number of
+ *                  client threads.  Measures how well concurrent
+ *                  node programs share a single hot node.
+ *
+ *        Created:  2014-10-02 14:12:40
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#include <thread>
+#include <po6/threads/mutex.h>
+#include <po6/threads/cond.h>
+
+#include "common/clock.h"
+#include "client/weaver_client.h"
+
+using cl::client;
+
+void
+exec_hot_reads(std::string *hot_node,
+    client *cl,
+    uint64_t num_clients,
+    uint64_t num_requests,
+    uint64_t *num_start,
+    po6::threads::cond *cond)
+{
+    cond->lock();
+    *num_start = *num_start + 1;
+    while (*num_start < num_clients) {
+        cond->wait();
+    }
+    cond->broadcast();
+    cond->unlock();
+
+    node_prog::read_node_props_params rp;
+    node_prog::edge_count_params ecp;
+
+    for (uint64_t i = 0; i < num_requests; i++) {
+        // alternate between the two read-only programs
+        if (i % 2 == 0) {
+            std::vector<std::pair<std::string, node_prog::read_node_props_params>> args(1, std::make_pair(*hot_node, rp));
+            cl->read_node_props_program(args);
+        } else {
+            std::vector<std::pair<std::string, node_prog::edge_count_params>> args(1, std::make_pair(*hot_node, ecp));
+            cl->edge_count_program(args);
+        }
+    }
+}
+
+// create a single node with num_edges out-edges and a few properties, then read it from
+// 1, 2, 4, ... max_clients client threads and report throughput for each thread count
+void
+run_hot_vertex_read_bench(uint64_t max_clients, uint64_t num_edges, uint64_t num_requests)
+{
+    std::vector<client*> clients;
+    clients.reserve(max_clients);
+    for (uint64_t i = 0; i < max_clients; i++) {
+        clients.emplace_back(new client("127.0.0.1", 2002, "/usr/local/etc/weaver.yaml"));
+    }
+
+    // create hot node
+    std::string hot_node = "hot_vertex_bench_node";
+    std::string empty;
+    client *loader = clients[0];
+    loader->begin_tx();
+    loader->create_node(hot_node);
+    loader->set_node_property(hot_node, "color", "red");
+    loader->set_node_property(hot_node, "weight", "42");
+    for (uint64_t i = 0; i < num_edges; i++) {
+        std::string nbr = "hot_vertex_bench_nbr" + std::to_string(i);
+        loader->create_node(nbr);
+        loader->create_edge(empty, hot_node, nbr);
+    }
+    if (!loader->end_tx()) {
+        std::cerr << "hot vertex bench: could not create graph" << std::endl;
+        return;
+    }
+
+    wclock::weaver_timer timer;
+
+    for (uint64_t num_clients = 1; num_clients <= max_clients; num_clients *= 2) {
+        po6::threads::mutex mtx;
+        po6::threads::cond cond(&mtx);
+        std::vector<std::thread*> threads;
+        threads.reserve(num_clients);
+        uint64_t num_start = 0;
+
+        for (uint64_t i = 0; i < num_clients; i++) {
+            threads.emplace_back(new std::thread(exec_hot_reads, &hot_node, clients[i], num_clients, num_requests, &num_start, &cond));
+        }
+
+        cond.lock();
+        while (num_start < num_clients) {
+            cond.wait();
+        }
+        cond.unlock();
+        uint64_t start = timer.get_time_elapsed_millis();
+
+        for (std::thread *t: threads) {
+            t->join();
+            delete t;
+        }
+        uint64_t end = timer.get_time_elapsed_millis();
+
+        uint64_t ops = num_requests * num_clients;
+        float time = (end-start) / 1000.0;
+        float tput = ops / time;
+
+        std::cout << "[hot vertex] clients = " << num_clients
+                  << ", reads = " << ops
+                  << ", time = " << time
+                  << ", throughput = " << tput << std::endl;
+    }
+
+    for (client *c: clients) {
+        delete c;
+    }
+}
@@ -0,0 +1,179 @@
+/*
+ * ===============================================================
+ *    Description:  Test of shared and exclusive node holding, see
+ *                  db/node_lock.h.  Readers must be able to hold a
+ *                  node together, and a writer must wait for them
+ *                  while holding back readers which come later.
+ *
+ *        Created:  2014-10-17 12:31:44
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <po6/threads/mutex.h>
+#include <po6/threads/cond.h>
+
+#include "db/node_lock.h"
+
+#define NLT_READERS 8
+#define NLT_WAIT_MILLIS 200
+
+// lock state of db::element::node, without the rest of the node
+struct nlt_node
+{
+    po6::threads::mutex mtx;
+    po6::threads::cond cv;
+    bool in_use;
+    uint32_t waiters, readers, shared_waiters, excl_waiters;
+
+    nlt_node() : cv(&mtx), in_use(false), waiters(0), readers(0), shared_waiters(0), excl_waiters(0) { }
+};
+
+// same steps as shard::acquire_node, acquire_node_shared and the release methods
+static void
+nlt_acquire(nlt_node *n)
+{
+    n->mtx.lock();
+    db::wait_exclusive(n);
+    n->in_use = true;
+    n->mtx.unlock();
+}
+
+static void
+nlt_acquire_shared(nlt_node *n)
+{
+    n->mtx.lock();
+    db::wait_shared(n);
+    n->mtx.unlock();
+}
+
+static void
+nlt_release(nlt_node *n)
+{
+    n->mtx.lock();
+    n->in_use = false;
+    db::wake_waiters(n);
+    n->mtx.unlock();
+}
+
+static void
+nlt_release_shared(nlt_node *n)
+{
+    n->mtx.lock();
+    if (db::leave_shared(n)) {
+        db::wake_waiters(n);
+    }
+    n->mtx.unlock();
+}
+
+// hold the node in shared mode until all readers hold it at the same time, or give up after a while
+static void
+nlt_reader(nlt_node *n, std::atomic<uint32_t> *holding, std::atomic<uint32_t> *max_holding)
+{
+    nlt_acquire_shared(n);
+    uint32_t now = ++(*holding);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    // some reader may already have seen all of them and left
+    while (now < NLT_READERS && max_holding->load() < NLT_READERS && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+        now = holding->load();
+    }
+    uint32_t prev = max_holding->load();
+    while (now > prev && !max_holding->compare_exchange_weak(prev, now));
+    --(*holding);
+    nlt_release_shared(n);
+}
+
+static void
+nlt_holder(nlt_node *n, bool shared, std::atomic<bool> *acquired, std::atomic<bool> *release)
+{
+    if (shared) {
+        nlt_acquire_shared(n);
+    } else {
+        nlt_acquire(n);
+    }
+    *acquired = true;
+    while (!release->load()) {
+        std::this_thread::yield();
+    }
+    if (shared) {
+        nlt_release_shared(n);
+    } else {
+        nlt_release(n);
+    }
+}
+
+static void
+nlt_wait_for(nlt_node *n, uint32_t nlt_node::*count, uint32_t val)
+{
+    while (true) {
+        n->mtx.lock();
+        bool done = (n->*count >= val);
+        n->mtx.unlock();
+        if (done) {
+            return;
+        }
+        std::this_thread::yield();
+    }
+}
+
+static void
+nlt_wait_for(std::atomic<bool> *flag)
+{
+    while (!flag->load()) {
+        std::this_thread::yield();
+    }
+}
+
+void
+node_lock_test()
+{
+    nlt_node n;
+
+    // all readers hold the node together
+    std::atomic<uint32_t> holding(0), max_holding(0);
+    std::vector<std::thread*> readers;
+    for (int i = 0; i < NLT_READERS; i++) {
+        readers.emplace_back(new std::thread(nlt_reader, &n, &holding, &max_holding));
+    }
+    for (std::thread *t: readers) {
+        t->join();
+        delete t;
+    }
+    assert(max_holding.load() == NLT_READERS);
+    assert(n.readers == 0 && n.waiters == 0);
+
+    // writer waits for a reader, and a reader which comes after the writer waits for the writer
+    std::atomic<bool> r1_acq(false), r1_rel(false), w_acq(false), w_rel(false), r2_acq(false), r2_rel(false);
+    std::thread r1(nlt_holder, &n, true, &r1_acq, &r1_rel);
+    nlt_wait_for(&r1_acq);
+    std::thread w(nlt_holder, &n, false, &w_acq, &w_rel);
+    nlt_wait_for(&n, &nlt_node::excl_waiters, 1);
+    std::thread r2(nlt_holder, &n, true, &r2_acq, &r2_rel);
+    nlt_wait_for(&n, &nlt_node::shared_waiters, 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(NLT_WAIT_MILLIS));
+    assert(!w_acq.load());
+    assert(!r2_acq.load());
+
+    r1_rel = true;
+    r1.join();
+    nlt_wait_for(&w_acq);
+    std::this_thread::sleep_for(std::chrono::milliseconds(NLT_WAIT_MILLIS));
+    assert(!r2_acq.load());
+
+    w_rel = true;
+    w.join();
+    nlt_wait_for(&r2_acq);
+    r2_rel = true;
+    r2.join();
+    assert(!n.in_use && n.readers == 0 && n.waiters == 0);
+
+    WDEBUG << "Node shared and exclusive holding ok." << std::endl;
+}
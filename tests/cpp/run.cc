@@ -15,6 +15,12 @@
 #include "common/weaver_constants.h"
 
 #include "tests/cpp/read_only_vertex_bench.h"
+#include "tests/cpp/hot_vertex_read_bench.h"
+#include "tests/cpp/vt_tx_bench.h"
+#include "tests/cpp/bidir_reach_bench.h"
+#include "tests/cpp/bsp_test.h"
+#include "tests/cpp/tx_sequencer_test.h"
+#include "tests/cpp/node_lock_test.h"
 //#include "message_test.h"
 //#include "message_tx.h"
 //#include "tx_msg_nmap.h"
@@ -45,7 +51,13 @@ main(int argc, char *argv[])
     UNUSED(argc);
     UNUSED(argv);
 
+    tx_sequencer_test();
+    node_lock_test();
     run_read_only_vertex_bench(100, 81306, 25000);
+    run_bsp_test();
+    //run_hot_vertex_read_bench(64, 1000, 10000);
+    //run_vt_tx_bench(64, 10000);
+    //run_bidir_reach_bench(81306, 1000); // snap twitter-combined
 #ifdef __ALL_TESTS__
     //message_test();
     //WDEBUG << "Message packing/unpacking ok." << std::endl;
@@ -0,0 +1,122 @@
+/*
+ * ===============================================================
+ *    Description:  Concurrency test of the timestamper out queue.
+ *                  Threads take seqs from a shared counter and
+ *                  publish them in whatever order they get to,
+ *                  releasing the way tx_queue_loop does, and the
+ *                  released seqs must come out in order.
+ *
+ *        Created:  2014-10-17 11:20:37
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#include <thread>
+#include <atomic>
+
+#include "coordinator/tx_sequencer.h"
+
+#define TXS_TEST_THREADS 8
+#define TXS_TEST_SEQS (8*VT_SEQ_SLOTS)
+
+struct tx_sequencer_test_state
+{
+    coordinator::tx_sequencer out_queue;
+    std::atomic<uint64_t> next_seq;
+    std::atomic<uint64_t> published;
+    // only touched by the releasing thread
+    std::vector<uint64_t> released;
+    uint64_t skipped;
+
+    tx_sequencer_test_state() : next_seq(1), published(0), skipped(0) { }
+};
+
+static void
+tx_sequencer_release(tx_sequencer_test_state *st)
+{
+    while (st->out_queue.try_begin()) {
+        std::shared_ptr<transaction::pending_tx> tx;
+        while (st->out_queue.pop(tx)) {
+            if (tx == nullptr) {
+                st->skipped++;
+            } else {
+                st->released.emplace_back(tx->vt_seq);
+            }
+        }
+        st->out_queue.end();
+        if (!st->out_queue.ready()) {
+            break;
+        }
+    }
+}
+
+static void
+tx_sequencer_publisher(tx_sequencer_test_state *st)
+{
+    while (true) {
+        uint64_t seq = st->next_seq++;
+        if (seq > TXS_TEST_SEQS) {
+            break;
+        }
+        if (seq == 1) {
+            // hold back the first seq, so that later seqs wrap around the slots and go to the overflow queue
+            while (st->published.load() < 2*VT_SEQ_SLOTS) {
+                std::this_thread::yield();
+            }
+        }
+        if (seq % 5 == 0) {
+            st->out_queue.skip(0, seq);
+        } else {
+            std::shared_ptr<transaction::pending_tx> tx = std::make_shared<transaction::pending_tx>(transaction::UPDATE);
+            tx->timestamp.clock = vc::vclock_t(1, 0);
+            tx->vt_seq = seq;
+            st->out_queue.publish(tx);
+        }
+        st->published++;
+        tx_sequencer_release(st);
+    }
+}
+
+void
+tx_sequencer_test()
+{
+    tx_sequencer_test_state st;
+    std::vector<std::thread*> threads;
+    for (int i = 0; i < TXS_TEST_THREADS; i++) {
+        threads.emplace_back(new std::thread(tx_sequencer_publisher, &st));
+    }
+    for (std::thread *t: threads) {
+        t->join();
+        delete t;
+    }
+
+    // every seq released exactly once, in order
+    assert(st.released.size() + st.skipped == TXS_TEST_SEQS);
+    assert(st.skipped == TXS_TEST_SEQS / 5);
+    for (uint64_t i = 1; i < st.released.size(); i++) {
+        assert(st.released[i-1] < st.released[i]);
+    }
+
+    // epoch change restarts at seq 1 of the new epoch, even if a later seq of it is published first
+    std::shared_ptr<transaction::pending_tx> tx = std::make_shared<transaction::pending_tx>(transaction::EPOCH_CHANGE);
+    tx->timestamp.clock = vc::vclock_t(1, 0);
+    tx->vt_seq = TXS_TEST_SEQS + 1;
+    tx->new_epoch = 1;
+    st.out_queue.publish(tx);
+    for (uint64_t seq = 2; seq > 0; seq--) {
+        tx = std::make_shared<transaction::pending_tx>(transaction::UPDATE);
+        tx->timestamp.clock = vc::vclock_t(1, 1);
+        tx->vt_seq = seq;
+        st.out_queue.publish(tx);
+    }
+    st.released.clear();
+    tx_sequencer_release(&st);
+    assert(st.released.size() == 2);
+    assert(st.released[0] == 1 && st.released[1] == 2);
+
+    WDEBUG << "tx sequencer ok." << std::endl;
+}
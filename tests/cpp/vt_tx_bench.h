@@ -0,0 +1,118 @@
+/*
+ * ===============================================================
+ *    Description:  Write benchmark in which each client thread
+ *                  commits small independent transactions, for
+ *                  increasing number of client threads.  Measures
+ *                  transactions per second through the vector
+ *                  timestampers.
+ *
+ *        Created:  2014-10-16 18:02:47
+ *
+ *         Author:  Ayush Dubey, dubey@cs.cornell.edu
+ *
+ * Copyright (C) 2014, Cornell University, see the LICENSE file
+ *                     for licensing agreement
+ * ===============================================================
+ */
+
+#include <thread>
+#include <po6/threads/mutex.h>
+#include <po6/threads/cond.h>
+
+#include "common/clock.h"
+#include "client/weaver_client.h"
+
+using cl::client;
+
+void
+exec_vt_txs(client *cl,
+    uint64_t client_id,
+    uint64_t round,
+    uint64_t num_clients,
+    uint64_t num_txs,
+    uint64_t *num_start,
+    uint64_t *num_failed,
+    po6::threads::cond *cond)
+{
+    cond->lock();
+    *num_start = *num_start + 1;
+    while (*num_start < num_clients) {
+        cond->wait();
+    }
+    cond->broadcast();
+    cond->unlock();
+
+    uint64_t failed = 0;
+    std::string prefix = "vt_tx_bench_" + std::to_string(round) + "_" + std::to_string(client_id) + "_";
+    for (uint64_t i = 0; i < num_txs; i++) {
+        // each tx touches a distinct node, so txs of different clients never conflict
+        std::string handle = prefix + std::to_string(i);
+        cl->begin_tx();
+        cl->create_node(handle);
+        cl->set_node_property(handle, "tx", std::to_string(i));
+        if (!cl->end_tx()) {
+            failed++;
+        }
+    }
+
+    cond->lock();
+    *num_failed = *num_failed + failed;
+    cond->unlock();
+}
+
+// commit num_txs txs from each of 1, 2, 4, ... max_clients client threads
+// and report tx throughput for each thread count
+// timestampers always run NUM_VT_THREADS threads (coordinator/vt_constants.h), client threads only vary
+// the offered concurrency, rebuild with a different NUM_VT_THREADS to vary timestamper threads
+void
+run_vt_tx_bench(uint64_t max_clients, uint64_t num_txs)
+{
+    std::vector<client*> clients;
+    clients.reserve(max_clients);
+    for (uint64_t i = 0; i < max_clients; i++) {
+        clients.emplace_back(new client("127.0.0.1", 2002, "/usr/local/etc/weaver.yaml"));
+    }
+
+    wclock::weaver_timer timer;
+    uint64_t round = 0;
+
+    for (uint64_t num_clients = 1; num_clients <= max_clients; num_clients *= 2, round++) {
+        po6::threads::mutex mtx;
+        po6::threads::cond cond(&mtx);
+        std::vector<std::thread*> threads;
+        threads.reserve(num_clients);
+        uint64_t num_start = 0;
+        uint64_t num_failed = 0;
+
+        for (uint64_t i = 0; i < num_clients; i++) {
+            threads.emplace_back(new std::thread(exec_vt_txs, clients[i], i, round, num_clients, num_txs, &num_start, &num_failed, &cond));
+        }
+
+        cond.lock();
+        while (num_start < num_clients) {
+            cond.wait();
+        }
+        cond.unlock();
+        uint64_t start = timer.get_time_elapsed_millis();
+
+        for (std::thread *t: threads) {
+            t->join();
+            delete t;
+        }
+        uint64_t end = timer.get_time_elapsed_millis();
+
+        uint64_t ops = num_txs * num_clients;
+        float time = (end-start) / 1000.0;
+        float tput = ops / time;
+
+        std::cout << "[vt tx] clients = " << num_clients
+                  << ", txs = " << ops
+                  << ", failed = " << num_failed
+                  << ", time = " << time
+                  << ", throughput = " << tput << std::endl;
+    }
+
+    for (client *c: clients) {
+        delete c;
+    }
+}